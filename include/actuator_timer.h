@@ -0,0 +1,60 @@
+#ifndef ACTUATOR_TIMER_H
+#define ACTUATOR_TIMER_H
+
+#include <Arduino.h>
+#include "relay_driver.h"
+
+// === HARDWARE-TIMER ACTUATOR TABLE ===
+// ตารางขนาดคงที่ 1 ช่องต่อ relay (K1-K8) รองรับ pulse ครั้งเดียว, วงจร ON/OFF และเพดานเวลาทำงานรวม
+// Timer3 compare-match ทุก 1 ms เทียบ tick ปัจจุบันกับ deadline ที่ใกล้ที่สุดของทั้งตาราง (O(1) ต่อ tick)
+// จะไล่ตารางเฉพาะ tick ที่มีช่องครบกำหนด แล้วสั่งปิด/สลับ relay ภายใน ISR ตรงเวลาโดยไม่ขึ้นกับ loop()
+// ส่วน loop() มีหน้าที่แค่รายงานผลจาก event
+
+#define ACTUATOR_SLOT_COUNT RELAY_MAX   // ช่องที่ i คุม relay index i
+
+enum ActuatorEventKind : uint8_t {
+  ACTUATOR_PULSE_END,     // pulse ครบเวลา relay ปิดแล้ว
+  ACTUATOR_CYCLE_SWITCH,  // วงจร ON/OFF สลับสถานะ
+  ACTUATOR_MAX_RUN        // ถึงเพดานเวลาทำงานรวม relay ถูกปิดและช่องหยุด
+};
+
+// เหตุการณ์ที่ ISR บันทึกไว้ให้ loop() รายงาน
+struct ActuatorEvent {
+  uint8_t relay;         // index 0-7 (K1-K8)
+  uint8_t kind;          // ActuatorEventKind
+  bool state;            // สถานะ relay หลังเหตุการณ์ (false = ปิด)
+  uint32_t elapsedMs;    // เวลาจริงตั้งแต่เริ่มช่วง (MAX_RUN: ตั้งแต่เริ่มงาน) วัดด้วย millis()
+  uint32_t targetMs;     // เวลาเป้าหมายของช่วงที่เพิ่งจบ (MAX_RUN: เพดานที่ตั้งไว้)
+};
+
+// เริ่ม Timer3 (relay ถูกสั่งผ่าน relay_driver ซึ่งต้อง relayDriverBegin() ก่อน)
+void actuatorTimerBegin();
+
+// เปิด relay ทันที แล้วให้ ISR ปิดเมื่อครบ durationMs (0 = หยุดทันที)
+void actuatorStartPulse(uint8_t relay, uint32_t durationMs);
+
+// วนรอบ OFF(offMs) -> ON(onMs) -> OFF ... โดยเริ่มจากช่วง OFF
+// maxRunMs > 0: หยุดและปิด relay เมื่อทำงานรวมครบ maxRunMs
+void actuatorStartCycle(uint8_t relay, uint32_t onMs, uint32_t offMs, uint32_t maxRunMs = 0);
+
+// ยกเลิกช่องและปิด relay ทันที
+void actuatorStop(uint8_t relay);
+
+bool actuatorActive(uint8_t relay);
+
+// bit i = ช่องของ relay i ทำงานอยู่
+uint8_t actuatorActiveMask();
+
+// ความคืบหน้าของช่วงปัจจุบัน (คืนค่า false ถ้าช่องไม่ทำงาน)
+bool actuatorProgress(uint8_t relay, uint32_t& elapsedMs, uint32_t& targetMs);
+
+// ค่าที่ตั้งไว้ของวงจร ON/OFF ที่ทำงานอยู่ (คืนค่า false ถ้าช่องไม่ได้เป็นวงจร)
+bool actuatorCycleConfig(uint8_t relay, uint32_t& onMs, uint32_t& offMs, uint32_t& maxRunMs);
+
+// ดึงเหตุการณ์ถัดไปจาก ISR (คืนค่า false ถ้าไม่มี)
+bool actuatorPopEvent(ActuatorEvent& event);
+
+// นับ 1 ms - เรียกจาก ISR(TIMER3_COMPA_vect) ใน main.cpp (บน native HAL เรียก ISR ตามเวลาจำลอง)
+void actuatorTimerTick();
+
+#endif
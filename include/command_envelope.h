@@ -0,0 +1,61 @@
+#ifndef COMMAND_ENVELOPE_H
+#define COMMAND_ENVELOPE_H
+
+#include <Arduino.h>
+
+// === SEQUENCED COMMAND ENVELOPE (ESP32 -> Mega) ===
+// ห่อคำสั่งแบบเดิมด้วยหมายเลขลำดับและ checksum (ไม่บังคับ บรรทัดที่ไม่ขึ้นต้นด้วย '#' ทำงานเหมือนเดิม)
+//
+//   #<seq>:<คำสั่ง>[;<คำสั่ง>...]*<crc>
+//   เช่น #42:RELAY:00110000;PUMP_TIMING:EC,1500;PUMP_TIMING:PH_ACID,800*A56E
+//
+//   - seq 1-65535 (ESP32 เป็นผู้นับ) crc = CRC16 Modbus ของข้อความระหว่าง '#' กับ '*' เป็น hex 4 หลัก
+//   - คำสั่งในเฟรมเดียวกันไม่เกิน COMMAND_BATCH_MAX คำสั่ง คั่นด้วย ';'
+//   - Mega ตรวจทุกคำสั่งก่อน แล้วทำทั้งหมดหรือไม่ทำเลย ตอบ CMD_ACK / CMD_NAK บรรทัดเดียว
+//   - seq + crc ที่เคยทำสำเร็จแล้ว (ESP32 ส่งซ้ำเพราะไม่เห็น ACK) ตอบ CMD_ACK ซ้ำโดยไม่ทำอีก
+//     seq เดิมแต่ crc ต่าง = คำสั่งใหม่ (เช่น ESP32 รีบูตแล้วนับใหม่)
+
+#define COMMAND_BATCH_MAX 4
+#define COMMAND_DEDUP_SLOTS 8   // จำนวนเฟรมล่าสุดที่จำไว้ตรวจการส่งซ้ำ
+
+enum EnvelopeStatus : uint8_t {
+  ENVELOPE_OK,
+  ENVELOPE_BAD_FORMAT,     // ไม่มี ':' / '*', seq หรือ crc ไม่ใช่ตัวเลข, คำสั่งว่าง
+  ENVELOPE_BAD_CHECKSUM,
+  ENVELOPE_TOO_MANY        // เกิน COMMAND_BATCH_MAX คำสั่ง
+};
+
+struct CommandEnvelope {
+  uint16_t sequence;    // 0 ถ้าแยก seq ไม่ได้
+  uint16_t checksum;
+  uint8_t count;
+  char* commands[COMMAND_BATCH_MAX];   // ชี้เข้าไปในบรรทัดเดิม
+};
+
+/**
+ * แยก envelope (line ขึ้นต้นด้วย '#') ';' และ '*' ถูกแทนด้วย '\0'
+ * sequence ถูกกรอกแม้ checksum ไม่ผ่าน (ใช้ตอบ CMD_NAK)
+ */
+EnvelopeStatus parseCommandEnvelope(char* line, CommandEnvelope& envelope);
+
+// CRC ของข้อความใน envelope (ระหว่าง '#' กับ '*')
+uint16_t commandEnvelopeChecksum(const char* text, size_t length);
+
+// เฟรมที่ทำสำเร็จล่าสุด สำหรับตอบการส่งซ้ำแบบ idempotent
+class EnvelopeHistory {
+public:
+  // คืนค่า true และจำนวนคำสั่งที่ทำไป ถ้า seq + crc นี้เคยทำสำเร็จแล้ว
+  bool find(uint16_t sequence, uint16_t checksum, uint8_t& count) const;
+  void remember(uint16_t sequence, uint16_t checksum, uint8_t count);
+
+private:
+  struct Entry {
+    uint16_t sequence;    // 0 = ว่าง
+    uint16_t checksum;
+    uint8_t count;
+  };
+  Entry entries[COMMAND_DEDUP_SLOTS] = {};
+  uint8_t next = 0;
+};
+
+#endif
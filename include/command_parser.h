@@ -0,0 +1,73 @@
+#ifndef COMMAND_PARSER_H
+#define COMMAND_PARSER_H
+
+#include <Arduino.h>
+
+// === ZERO-ALLOCATION COMMAND PARSER ===
+// รับคำสั่งทีละไบต์ลงบัฟเฟอร์ขนาดคงที่ (ไม่ใช้ String / heap และไม่รอ newline)
+// แล้วจับคู่ keyword จากตารางใน PROGMEM ส่งต่อให้ handler พร้อมอาร์กิวเมนต์ที่แปลงแล้ว
+
+#define COMMAND_LINE_MAX 128  // ความยาวบรรทัดสูงสุด (ไม่รวม '\0') พอสำหรับ envelope ที่มีหลายคำสั่ง
+#define COMMAND_MAX_ARGS 8    // จำนวนอาร์กิวเมนต์สูงสุด (คั่นด้วย ',')
+
+// ประกอบบรรทัดทีละไบต์ บรรทัดที่ยาวเกินจะถูกทิ้งทั้งบรรทัด
+class LineAssembler {
+public:
+  // ป้อน 1 ไบต์ คืนค่า true เมื่อได้บรรทัดสมบูรณ์ (อ่านได้จาก line() จนกว่าจะป้อนไบต์ถัดไป)
+  bool feed(char c);
+  char* line() { return buffer; }
+  uint8_t length() const { return lineLength; }
+  uint16_t overflowCount() const { return overflows; }
+
+private:
+  char buffer[COMMAND_LINE_MAX + 1];
+  uint8_t lineLength = 0;
+  bool discarding = false;     // true = บรรทัดปัจจุบันยาวเกิน รอ newline เพื่อเริ่มใหม่
+  bool lineReady = false;
+  uint16_t overflows = 0;
+};
+
+// อาร์กิวเมนต์ที่แยกแล้ว: token เป็นข้อความ (ชี้เข้าไปในบัฟเฟอร์บรรทัด) และค่าตัวเลขที่แปลงแล้ว
+struct CommandArgs {
+  uint8_t count;
+  const char* text[COMMAND_MAX_ARGS];
+  int32_t value[COMMAND_MAX_ARGS];   // 0 ถ้า token ไม่ใช่ตัวเลข
+  uint8_t numericMask;               // bit i = token i เป็นจำนวนเต็ม
+};
+
+typedef void (*CommandHandler)(const CommandArgs& args);
+
+enum CommandMatch : uint8_t {
+  CMD_EXACT,   // บรรทัดต้องตรงกับ keyword ทั้งหมด
+  CMD_PREFIX   // keyword เป็นส่วนนำหน้า ส่วนที่เหลือคืออาร์กิวเมนต์
+};
+
+#define CMD_ANY_ARGS 0xFF
+
+// รายการในตารางคำสั่ง (ทั้งตารางและ keyword เก็บใน PROGMEM)
+struct CommandEntry {
+  const char* keyword;
+  CommandMatch match;
+  uint8_t argCount;      // จำนวน token ที่ต้องมี หรือ CMD_ANY_ARGS
+  uint8_t numericArgs;   // bit i = token i ต้องเป็นตัวเลข
+  CommandHandler handler;
+};
+
+enum DispatchResult : uint8_t {
+  DISPATCH_OK,
+  DISPATCH_UNKNOWN,   // ไม่พบ keyword
+  DISPATCH_BAD_ARGS   // พบ keyword แต่อาร์กิวเมนต์ไม่ถูกต้อง
+};
+
+// ค้นหา keyword และตรวจอาร์กิวเมนต์โดยไม่เรียก handler (คืน entry ที่ตรงและอาร์กิวเมนต์ที่แยกแล้ว)
+// line จะถูกแก้ไขเหมือน dispatchCommand() ใช้ตรวจคำสั่งหลายคำสั่งก่อนลงมือทำพร้อมกัน
+DispatchResult matchCommand(char* line, const CommandEntry* table, uint8_t tableSize,
+                            CommandEntry& entry, CommandArgs& args);
+
+// ค้นหา keyword ในตารางแล้วเรียก handler (line จะถูกแก้ไข: ',' ถูกแทนด้วย '\0')
+DispatchResult dispatchCommand(char* line, const CommandEntry* table, uint8_t tableSize);
+
+// แปลงข้อความเป็นจำนวนเต็มแบบเข้มงวด (ทั้ง token ต้องเป็นตัวเลข)
+bool parseInt32(const char* text, int32_t& out);
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef CRC16_H
+#define CRC16_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// คำนวณ CRC16 แบบ Modbus (poly 0xA001, init 0xFFFF)
+// ใช้ร่วมกันทั้งเฟรม Modbus RTU และเฟรม telemetry แบบ binary
+uint16_t modbusCrc16(const uint8_t* data, size_t length);
+
+#endif
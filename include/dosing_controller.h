@@ -0,0 +1,113 @@
+#ifndef DOSING_CONTROLLER_H
+#define DOSING_CONTROLLER_H
+
+#include <Arduino.h>
+
+// === CLOSED-LOOP DOSING CONTROLLER ===
+// คุมการเติมปุ๋ย (EC) / กรด-ด่าง (pH) บน Mega เองเป็นรอบ:
+//
+//   วัด -> เกิน deadband? -> pulse ปั๊ม (error x gain) -> รอผสม mixDelay -> วัดใหม่ -> ...
+//
+//   - ค่าที่ใช้ตัดสินต้องวัดหลังครบเวลาผสมเท่านั้น (ไม่ตัดสินจากค่าระหว่างปั๊มทำงาน)
+//   - เวลาปั๊มต่อครั้งไม่เกิน maxPulseMs และรวมในหนึ่งชั่วโมงไม่เกิน maxPerHourMs
+//     (นับเป็นช่องละ 10 นาที DOSING_BUDGET_SLOTS ช่อง)
+//   - หลังเติมแล้วค่าไม่ขยับไปทางที่ควรติดกัน DOSING_NO_RESPONSE_LIMIT ครั้ง (หัววัดเสีย/ถังหมด)
+//     หยุดเป็น FAULT จนกว่าจะสั่งเปิดใหม่
+// ไม่รู้จัก relay หรือ Serial: ผู้เรียกป้อนค่าที่วัดได้ บอกว่าปั๊มว่างหรือไม่ แล้วสั่งปั๊มตามเวลาที่ได้
+// หน่วยเดียวกับเฟรม telemetry (EC = µS/cm x10, pH = pH x100)
+
+#define DOSING_BUDGET_SLOTS 6
+#define DOSING_BUDGET_SLOT_MS 600000UL     // 10 นาทีต่อช่อง
+#define DOSING_NO_RESPONSE_LIMIT 3
+#define DOSING_EVENT_SLOTS 4
+#define DOSING_MIX_MAX_SECONDS 7200UL
+#define DOSING_PULSE_MAX_MS 60000UL
+#define DOSING_HOUR_MAX_MS 3600000UL
+
+enum DosingState : uint8_t {
+  DOSING_OFF,
+  DOSING_WAIT,      // รอค่าที่วัดหลังครบเวลาผสม
+  DOSING_PULSE,     // ปั๊มกำลังทำงาน
+  DOSING_FAULT      // หยุดเพราะค่าไม่ตอบสนอง
+};
+
+enum DosingStep : uint8_t {
+  DOSE_STEP_PULSE,     // value = ค่าที่วัด, reference = setpoint, amount = ms ที่ปั๊ม
+  DOSE_STEP_RESULT,    // value = ค่าหลังผสม, reference = ค่าก่อนเติม, amount = ms ที่ปั๊มไป
+  DOSE_STEP_SETTLED,   // เข้า deadband แล้ว: value, reference = setpoint, amount = 0
+  DOSE_STEP_LIMIT,     // ครบโควตาชั่วโมง: value, reference = setpoint, amount = ms ที่ใช้ไป
+  DOSE_STEP_FAULT      // value, reference = setpoint, amount = จำนวนครั้งที่ไม่ตอบสนอง
+};
+
+struct DosingConfig {
+  int32_t setpoint;
+  uint16_t deadband;        // ไม่เติมถ้า |error| <= deadband
+  uint16_t gain;            // ms ต่อ error 100 หน่วย (EC: ต่อ 10 µS/cm, pH: ต่อ 1.00)
+  bool raises;              // true = ปั๊มทำให้ค่าเพิ่ม (ปุ๋ย, pH base) false = ลด (pH acid)
+  uint32_t mixDelayMs;
+  uint32_t maxPulseMs;
+  uint32_t maxPerHourMs;
+};
+
+struct DoseEvent {
+  uint8_t channel;          // กำหนดโดยผู้เรียก (ดู DosingController::begin)
+  uint8_t step;             // DosingStep
+  int32_t value;
+  int32_t reference;
+  uint32_t amount;
+};
+
+class DosingController {
+public:
+  static bool valid(const DosingConfig& config);
+
+  void begin(uint8_t channel) { eventChannel = channel; }
+
+  // ตั้งค่าใหม่ (สถานะเปิด/ปิดคงเดิม ล้าง FAULT ไม่ได้ ต้อง enable ใหม่)
+  void configure(const DosingConfig& config);
+
+  // เปิด: เริ่มรอค่าที่วัดได้ถัดไป (ล้าง FAULT) / ปิด: หยุดทันที (ปั๊มที่ทำงานอยู่ผู้เรียกต้องหยุดเอง)
+  void enable(bool on, uint32_t nowMs);
+
+  // ค่าที่วัดได้ใหม่ (เฉพาะการอ่านที่สำเร็จและเชื่อถือได้)
+  void sample(int32_t value, uint32_t nowMs);
+
+  // เรียกทุกรอบ loop: pumpBusy = relay ของปั๊มถูกตารางจับเวลาใช้อยู่ (ของเราหรือคำสั่งจาก ESP32)
+  // คืนเวลาที่ต้องสั่งปั๊ม (ms) หรือ 0
+  uint32_t poll(uint32_t nowMs, bool pumpBusy);
+
+  bool popEvent(DoseEvent& event);
+
+  const DosingConfig& config() const { return settings; }
+  DosingState state() const { return current; }
+  bool configured() const { return settings.gain > 0; }
+  uint32_t usedThisHourMs(uint32_t nowMs);
+  uint32_t totalDosedMs() const { return totalMs; }
+  uint16_t doses() const { return doseCount; }
+
+private:
+  void emit(uint8_t step, int32_t value, int32_t reference, uint32_t amount);
+  void rollBudget(uint32_t nowMs);
+  uint32_t decide(uint32_t nowMs, bool pumpBusy);
+
+  DosingConfig settings = {0, 0, 0, true, 0, 0, 0};
+  uint8_t eventChannel = 0;
+  DosingState current = DOSING_OFF;
+  uint32_t readyAtMs = 0;          // ค่าที่วัดตั้งแต่เวลานี้ใช้ตัดสินได้
+  bool sampleReady = false;
+  int32_t lastValue = 0;
+  int32_t valueBeforeDose = 0;
+  uint32_t lastDoseMs = 0;         // 0 = รอบนี้ยังไม่ได้เติม (ไม่ต้องตรวจการตอบสนอง)
+  uint8_t noResponse = 0;
+  bool settled = false;            // รายงาน SETTLED/LIMIT เฉพาะตอนเปลี่ยน
+  bool limited = false;
+  uint32_t budgetMs[DOSING_BUDGET_SLOTS] = {};
+  uint32_t budgetSlot = 0;         // หมายเลขช่อง 10 นาทีล่าสุด (nowMs / DOSING_BUDGET_SLOT_MS)
+  uint32_t totalMs = 0;
+  uint16_t doseCount = 0;
+  DoseEvent events[DOSING_EVENT_SLOTS];
+  uint8_t eventHead = 0;
+  uint8_t eventCount = 0;
+};
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef FIXED_POINT_H
+#define FIXED_POINT_H
+
+#include <stdint.h>
+
+// === FIXED-POINT SENSOR CONVERSION ===
+// ATmega2560 ไม่มี FPU: ค่าจากเซ็นเซอร์จึงเก็บเป็นจำนวนเต็มที่มีสเกลตลอดทาง (หน่วยเดียวกับ TelemetryFrameV1
+// เช่น °C x10, pH x100, µS/cm x10) และแปลงเป็น float เฉพาะตอนเขียน JSON เท่านั้น
+//
+// FixedConversion<NUM, DEN, OFFSET, MIN, MAX>::convert(raw) = clamp(round((raw x NUM + OFFSET) / DEN))
+//   - พารามิเตอร์เป็นค่าคงที่ตอนคอมไพล์ ถูกย่อด้วย ห.ร.ม. ก่อนใช้ (15968/1000 -> 1996/125)
+//   - คำนวณด้วย int32 ล้วน แยก raw เป็นผลหาร/เศษของ DEN จึงไม่ล้นแม้ raw x NUM เกิน 32 บิต
+//   - ปัดครึ่งออกจาก 0 เหมือน lround() ผลลัพธ์ตรงกันทุกครั้ง ไม่ขึ้นกับความละเอียดของ float
+// ไฟล์นี้ไม่ขึ้นกับ Arduino เช่นเดียวกับ telemetry_frame.h
+
+namespace fixed_point_detail {
+
+// avr-libc ประกาศ INT32_MAX ให้ C++ เฉพาะเมื่อมี __STDC_LIMIT_MACROS
+constexpr int32_t INT32_LOWEST = -2147483647L - 1;
+constexpr int32_t INT32_HIGHEST = 2147483647L;
+
+constexpr int32_t absolute(int32_t v) { return v < 0 ? -v : v; }
+constexpr int32_t gcd(int32_t a, int32_t b) { return b == 0 ? absolute(a) : gcd(b, a % b); }
+constexpr int32_t gcd3(int32_t a, int32_t b, int32_t c) { return gcd(gcd(a, b), c); }
+
+}  // namespace fixed_point_detail
+
+// หารแบบปัดเศษใกล้สุด (ครึ่งปัดออกจาก 0) denominator ต้องมากกว่า 0
+inline int32_t divRound(int32_t numerator, int32_t denominator) {
+  return numerator >= 0 ? (numerator + denominator / 2) / denominator
+                        : -((-numerator + denominator / 2) / denominator);
+}
+
+inline uint32_t divRoundUnsigned(uint32_t numerator, uint32_t denominator) {
+  return numerator / denominator + (numerator % denominator >= denominator - denominator / 2 ? 1 : 0);
+}
+
+template <int32_t NUM, int32_t DEN = 1, int32_t OFFSET = 0,
+          int32_t MIN_OUT = fixed_point_detail::INT32_LOWEST,
+          int32_t MAX_OUT = fixed_point_detail::INT32_HIGHEST>
+struct FixedConversion {
+  static_assert(DEN > 0, "DEN must be positive");
+  static_assert(MIN_OUT <= MAX_OUT, "empty output range");
+
+  static constexpr int32_t G = fixed_point_detail::gcd3(NUM, DEN, OFFSET);
+  static constexpr int32_t num = NUM / G;
+  static constexpr int32_t den = DEN / G;
+  static constexpr int32_t offset = OFFSET / G;
+
+  // ส่วนเศษ (den - 1) x num + offset ต้องไม่ล้น int32
+  static_assert((int64_t)(den - 1) * fixed_point_detail::absolute(num) + fixed_point_detail::absolute(offset)
+                    <= fixed_point_detail::INT32_HIGHEST, "conversion overflows int32");
+
+  static int32_t convert(int32_t raw) {
+    // raw x num + offset = (q x den + r) x num + offset -> q x num + round((r x num + offset) / den)
+    int32_t value = (raw / den) * num + divRound((raw % den) * num + offset, den);
+    if (value < MIN_OUT) return MIN_OUT;
+    if (value > MAX_OUT) return MAX_OUT;
+    return value;
+  }
+};
+
+/**
+ * อัตราต่อเวลาแบบ fixed-point: round(count x NUM / (DEN x periodMs))
+ * เช่น พัลส์ของ flow sensor ในช่วง periodMs -> L/min x100
+ * count x (NUM/ห.ร.ม.) ต้องไม่เกิน 32 บิต
+ */
+template <uint32_t NUM, uint32_t DEN>
+inline uint32_t fixedRate(uint32_t count, uint32_t periodMs) {
+  static_assert(DEN > 0, "DEN must be positive");
+  constexpr uint32_t G = (uint32_t)fixed_point_detail::gcd((int32_t)NUM, (int32_t)DEN);
+  if (periodMs == 0) {
+    return 0;
+  }
+  return divRoundUnsigned(count * (NUM / G), (DEN / G) * periodMs);
+}
+
+#endif
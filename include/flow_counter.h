@@ -0,0 +1,28 @@
+#ifndef FLOW_COUNTER_H
+#define FLOW_COUNTER_H
+
+#include <Arduino.h>
+
+// === INTERRUPT-BASED FLOW PULSE COUNTER ===
+// ขา D22-24 อยู่บน PORTA ซึ่งไม่มี PCINT/INT บน ATmega2560
+// จึงสุ่มอ่านขาจาก ISR ของ Timer3 ทุก 1 ms (จับพัลส์ที่กว้าง >= 1 ms ได้ครบ
+// ไม่ว่า loop() จะช้าแค่ไหน) และนับขอบขาลงลงตัวนับ 32 บิตแบบสะสม
+
+#define FLOW_CHANNELS 3
+
+// ค่าตัวนับ ณ เวลาเดียวกันทุกช่อง (คัดลอกขณะปิด interrupt)
+struct FlowSnapshot {
+  uint32_t pulses[FLOW_CHANNELS];  // จำนวนพัลส์สะสมตั้งแต่เริ่มระบบ (ไม่ถูกรีเซ็ต)
+  uint32_t timeMs;                 // millis() ตอนถ่าย snapshot
+};
+
+// ตั้งค่าขา (INPUT + pull-up) และอ่านสถานะเริ่มต้น
+void flowCounterBegin(const uint8_t* pins);
+
+// สุ่มอ่านทุกช่อง 1 ครั้ง - เรียกจาก ISR ของ Timer3
+void flowCounterSample();
+
+// คัดลอกตัวนับทั้งหมดแบบ atomic
+void flowCounterSnapshot(FlowSnapshot& snapshot);
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef LINK_MONITOR_H
+#define LINK_MONITOR_H
+
+#include <Arduino.h>
+
+// === ESP32 LINK MONITOR ===
+// วัดคุณภาพลิงก์ Serial2 แบบไม่บล็อก: Mega ส่ง probe (MEGA_TEST) เป็นระยะ คำตอบ (ESP32_OK) มาทางตัวแยกคำสั่งปกติ
+// ไม่มีการรอหรือล้าง RX buffer ทุกบรรทัดที่ถูกต้องจาก ESP32 ถือเป็นสัญญาณว่าลิงก์ยังอยู่
+//
+//   - RTT: ล่าสุด, เฉลี่ยแบบ EWMA (1/8) และสูงสุด ของ probe ที่ได้คำตอบ
+//   - loss: สัดส่วน probe ที่ไม่ได้คำตอบภายใน timeout จาก LINK_LOSS_WINDOW ครั้งล่าสุด
+//   - silence: เวลาตั้งแต่บรรทัดที่ถูกต้องล่าสุด (ยังไม่เคยได้ยิน = ตั้งแต่ begin())
+//
+// probe ถูกจับคู่กับคำตอบทีละ 1 (ส่ง probe ใหม่ขณะยังรออยู่ = probe เดิมหาย)
+
+#define LINK_LOSS_WINDOW 16              // จำนวน probe ที่ใช้คิด loss (บิตละ 1 probe)
+#define LINK_DEGRADED_LOSS_PERCENT 25    // loss ตั้งแต่ค่านี้ = ลิงก์แย่
+#define LINK_DEGRADED_RTT_MS 250         // RTT เฉลี่ยตั้งแต่ค่านี้ = ลิงก์แย่
+
+class LinkMonitor {
+public:
+  void begin(uint32_t nowMs);
+
+  // ส่ง probe แล้ว
+  void probeSent(uint32_t nowMs);
+
+  // ได้คำตอบของ probe (คำตอบที่ไม่มี probe รอ เช่น มาช้าเกิน timeout ไม่ถูกนับ RTT)
+  void probeAnswered(uint32_t nowMs);
+
+  // ได้บรรทัดที่ถูกต้องจาก ESP32 (คำสั่งใดๆ รวมคำตอบของ probe)
+  void frameReceived(uint32_t nowMs);
+
+  // probe ที่รอเกิน timeoutMs ถือว่าหาย - เรียกทุก loop
+  void poll(uint32_t nowMs, uint32_t timeoutMs);
+
+  bool probePending() const { return pending; }
+  uint32_t silenceMs(uint32_t nowMs) const { return nowMs - lastFrameMs; }
+  uint16_t rttLastMs() const { return rttLast; }
+  uint16_t rttAverageMs() const { return (uint16_t)((rttAverageX8 + 4) / 8); }
+  uint16_t rttMaxMs() const { return rttMax; }
+  uint8_t lossPercent() const;
+  uint32_t probesSent() const { return sent; }
+  uint32_t probesLost() const { return lost; }
+
+  // loss หรือ RTT เฉลี่ยเกินเกณฑ์ (ยังใช้งานได้แต่ไม่น่าเชื่อถือ)
+  bool degraded() const;
+
+private:
+  void recordResult(bool wasLost);
+
+  uint32_t lastFrameMs = 0;
+  uint32_t probeSentMs = 0;
+  bool pending = false;
+  uint32_t sent = 0;
+  uint32_t lost = 0;
+  uint32_t answered = 0;
+  uint16_t lossHistory = 0;    // บิต 1 = probe นั้นหาย (บิต 0 = ล่าสุด)
+  uint8_t resolved = 0;        // จำนวน probe ที่รู้ผลแล้วใน lossHistory (ไม่เกิน LINK_LOSS_WINDOW)
+  uint16_t rttLast = 0;
+  uint16_t rttMax = 0;
+  uint32_t rttAverageX8 = 0;   // EWMA x8
+};
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <Arduino.h>
+
+// === COMPILE-TIME LOGGING ===
+// ข้อความต่ำกว่า LOG_LEVEL ถูกตัดทิ้งตอนคอมไพล์ (อาร์กิวเมนต์ไม่ถูกคำนวณ ไม่มีโค้ดเหลือ)
+// format string อยู่ใน flash (PSTR) และข้อความถูกเขียนลง ring buffer ก่อน
+// logFlush() ส่งออก Serial เท่าที่ TX buffer ว่าง ไม่บล็อก ถ้า ring เต็มจะทิ้งข้อความและนับไว้
+//
+// ตั้งระดับใน platformio.ini เช่น  build_flags = -D LOG_LEVEL=LOG_LEVEL_INFO
+//
+// หมายเหตุ: printf บน AVR ไม่รองรับ %f ให้ใช้ logFloat(ค่า, ทศนิยม) คู่กับ %s
+// ค่า fixed-point (fixed_point.h) ใช้ logFixed(ค่า, ทศนิยม) ซึ่งไม่ผ่าน float เลย เช่น logFixed(253, 1) = "25.3"
+
+#define LOG_LEVEL_OFF   0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+
+// ระดับที่ปิดอยู่: if (0) ทำให้คอมไพเลอร์ยังตรวจ argument แต่ตัดโค้ดทิ้งทั้งหมด
+#define LOG_DISABLED(level, fmt, ...) do { if (0) logWrite(level, PSTR(fmt), ##__VA_ARGS__); } while (0)
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_RING_SIZE 256   // ขนาด ring buffer (ไบต์, ต้องเป็นกำลังของ 2)
+#define LOG_LINE_MAX 96     // ความยาวข้อความสูงสุดต่อครั้ง (ยาวกว่านี้ถูกตัด)
+
+// เขียนข้อความลง ring buffer (format อยู่ใน PROGMEM)
+void logWrite(char level, const char* formatP, ...);
+
+#if LOG_LEVEL > LOG_LEVEL_OFF
+
+// ส่งข้อความจาก ring buffer ออก Serial เท่าที่ TX buffer ว่าง - เรียกทุก loop
+void logFlush();
+
+// แปลง float เป็นข้อความ (ใช้ buffer หมุนเวียน 4 ชุด - ใช้ได้ถึง 4 ค่าต่อข้อความ)
+const char* logFloat(float value, uint8_t decimals);
+
+// แปลงค่าที่คูณ 10^decimals ไว้เป็นข้อความ (ใช้ buffer ชุดเดียวกับ logFloat)
+const char* logFixed(int32_t value, uint8_t decimals);
+
+// จำนวนข้อความที่ถูกทิ้งเพราะ ring เต็ม
+uint16_t logDroppedCount();
+
+#else
+
+inline void logFlush() {}
+inline const char* logFloat(float, uint8_t) { return ""; }
+inline const char* logFixed(int32_t, uint8_t) { return ""; }
+inline uint16_t logDroppedCount() { return 0; }
+
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(fmt, ...) logWrite('E', PSTR(fmt), ##__VA_ARGS__)
+#else
+#define LOG_ERROR(fmt, ...) LOG_DISABLED('E', fmt, ##__VA_ARGS__)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(fmt, ...) logWrite('W', PSTR(fmt), ##__VA_ARGS__)
+#else
+#define LOG_WARN(fmt, ...) LOG_DISABLED('W', fmt, ##__VA_ARGS__)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(fmt, ...) logWrite('I', PSTR(fmt), ##__VA_ARGS__)
+#else
+#define LOG_INFO(fmt, ...) LOG_DISABLED('I', fmt, ##__VA_ARGS__)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(fmt, ...) logWrite('D', PSTR(fmt), ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(fmt, ...) LOG_DISABLED('D', fmt, ##__VA_ARGS__)
+#endif
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef LOOP_STATS_H
+#define LOOP_STATS_H
+
+#include <Arduino.h>
+
+// === LOOP STAGE TIMING ===
+// จับเวลาแต่ละขั้นของ loop() ด้วย micros() เก็บ min/max/mean และ histogram แบบ log2
+// รวมถึงช่วงห่างสูงสุดระหว่างการเรียก checkPumpTiming() สองครั้งติดกัน
+// ESP32 ขอดูด้วยคำสั่ง STATS และล้างด้วย STATS_RESET
+
+enum LoopStage : uint8_t {
+  STAGE_COMM_TEST,     // serviceEsp32Link()
+  STAGE_MODBUS,        // pollModbusSensors()
+  STAGE_FLOW,          // checkFlowSensors()
+  STAGE_AC_POWER,      // pollACPowerSensor()
+  STAGE_SEND,          // serviceTelemetry() -> sendDataToESP32()
+  STAGE_REPLAY,        // serviceOutbox()
+  STAGE_HISTORY,       // serviceHistoryStream()
+  STAGE_COMMANDS,      // receiveCommandFromESP32()
+  STAGE_PUMP_TIMING,   // checkPumpTiming()
+  STAGE_STORAGE,       // servicePersistence()
+  STAGE_LOG,           // logFlush()
+  STAGE_LOOP,          // loop() ทั้งรอบ
+  STAGE_COUNT
+};
+
+// histogram: bin 0 = < 128 us, bin k = [2^(k+6), 2^(k+7)) us, bin สุดท้าย = >= 32.8 ms
+#define LOOP_STATS_BINS 10
+
+struct StageStats {
+  uint32_t count;
+  uint32_t minUs;
+  uint32_t maxUs;
+  uint64_t totalUs;
+  uint16_t histogram[LOOP_STATS_BINS];   // นับค้างที่ 65535
+};
+
+void loopStatsReset();
+
+// เริ่มรอบ loop() ใหม่ คืนค่าเวลาเริ่ม (ใช้กับ STAGE_LOOP)
+uint32_t loopStatsBeginPass();
+
+// บันทึกเวลาที่ใช้ตั้งแต่ startUs (micros()) ลงขั้นที่ระบุ
+void loopStatsEnd(uint8_t stage, uint32_t startUs);
+void loopStatsRecord(uint8_t stage, uint32_t durationUs);
+
+// เรียกตอนเริ่ม checkPumpTiming() ทุกครั้ง เพื่อวัดช่วงห่างระหว่างการตรวจปั๊ม
+void loopStatsPumpCheck();
+
+// ไม่นับเวลาที่เหลือของรอบนี้ (เช่น รอบที่พิมพ์ STATS ยาวๆ ออก Serial2)
+void loopStatsDiscardPass();
+
+const StageStats& loopStatsStage(uint8_t stage);
+uint32_t loopStatsMaxPumpGapUs();
+uint8_t loopStatsBin(uint32_t durationUs);
+
+// พิมพ์ทั้งหมดเป็นบรรทัดเดียว (ไม่รวม prefix และ newline):
+//   T=<ms>,GAP=<us>;COMM=<n>,<min>,<mean>,<max>,<h0>:<h1>:...:<h9>;MB=...;LOOP=...
+void loopStatsPrint(Print& out);
+
+#endif
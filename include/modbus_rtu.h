@@ -0,0 +1,78 @@
+#ifndef MODBUS_RTU_H
+#define MODBUS_RTU_H
+
+#include <Arduino.h>
+#include "crc16.h"
+
+// === NON-BLOCKING MODBUS RTU MASTER ===
+// ส่งคำขอแล้วคืนค่าทันที จากนั้นเรียก poll() ทุก loop เพื่อประกอบเฟรมตอบกลับ
+// จัดการ CRC, ช่วงเงียบ 3.5 ตัวอักษร และขา DE/RE ของ MAX485 ภายในคลาสนี้
+
+#define MODBUS_NO_PIN 0xFF           // ไม่มีขา DE/RE (เช่น บัสที่ไม่ผ่าน MAX485)
+#define MODBUS_MAX_FRAME 64          // ขนาดเฟรมสูงสุดที่รองรับ (ตอบกลับได้ถึง 29 รีจิสเตอร์)
+#define MODBUS_MAX_REGISTERS 29
+#define MODBUS_REQUEST_FRAME 8       // คำขออ่าน register: id, func, addr(2), qty(2), crc(2)
+#define MODBUS_COMMAND_FRAME 4       // คำสั่งไม่มีข้อมูล: id, func, crc(2) - slave ตอบ echo 4 ไบต์
+
+class ModbusRtuMaster {
+public:
+  // รหัสผลลัพธ์ (ใช้ค่าเดียวกับไลบรารี ModbusMaster เดิม)
+  static const uint8_t ku8MBSuccess = 0x00;
+  static const uint8_t ku8MBIllegalFunction = 0x01;
+  static const uint8_t ku8MBIllegalDataAddress = 0x02;
+  static const uint8_t ku8MBIllegalDataValue = 0x03;
+  static const uint8_t ku8MBSlaveDeviceFailure = 0x04;
+  static const uint8_t ku8MBInvalidSlaveID = 0xE0;
+  static const uint8_t ku8MBInvalidFunction = 0xE1;
+  static const uint8_t ku8MBResponseTimedOut = 0xE2;
+  static const uint8_t ku8MBInvalidCRC = 0xE3;
+
+  void begin(HardwareSerial& serial, unsigned long baud, uint8_t dePin = MODBUS_NO_PIN, uint8_t rePin = MODBUS_NO_PIN);
+  void setResponseTimeout(uint16_t timeoutMs) { responseTimeoutMs = timeoutMs; }
+
+  // เริ่มธุรกรรมใหม่ (คืนค่า false ถ้ายังมีธุรกรรมค้างอยู่)
+  bool readInputRegisters(uint8_t slaveId, uint16_t address, uint16_t quantity);
+  bool readHoldingRegisters(uint8_t slaveId, uint16_t address, uint16_t quantity);
+
+  // คำสั่งเฉพาะอุปกรณ์ที่ไม่มีข้อมูล (เช่น PZEM-004T 0x42 = reset energy) สำเร็จเมื่อ slave ตอบ echo กลับ
+  bool sendCommand(uint8_t slaveId, uint8_t function);
+
+  // เดินสถานะเครื่อง คืนค่า true ในรอบที่ธุรกรรมเสร็จ (สำเร็จหรือผิดพลาด)
+  bool poll();
+
+  bool isBusy() const { return state != IDLE; }
+  uint8_t result() const { return lastResult; }
+  uint8_t slaveId() const { return requestFrame[0]; }
+  uint16_t getResponseBuffer(uint8_t index) const;
+
+private:
+  enum State : uint8_t { IDLE, WAIT_SILENCE, TRANSMITTING, WAIT_RESPONSE };
+
+  bool startRequest(uint8_t slaveId, uint8_t function, uint16_t address, uint16_t quantity);
+  void setTransmit(bool enable);
+  void finish(uint8_t code);
+  uint8_t expectedLength() const;
+  uint8_t validateResponse();
+
+  HardwareSerial* port = nullptr;
+  uint8_t dePin = MODBUS_NO_PIN;
+  uint8_t rePin = MODBUS_NO_PIN;
+  unsigned long charTimeUs = 0;       // เวลาส่ง 1 ตัวอักษร (11 บิต)
+  unsigned long silenceUs = 0;        // ช่วงเงียบ 3.5 ตัวอักษร
+  uint16_t responseTimeoutMs = 300;
+
+  State state = IDLE;
+  uint8_t lastResult = ku8MBSuccess;
+  unsigned long lastActivityUs = 0;   // เวลาล่าสุดที่มีข้อมูลบนบัส
+  unsigned long phaseStartUs = 0;     // เวลาเริ่มสถานะปัจจุบัน
+  unsigned long txDurationUs = 0;
+
+  uint8_t requestFrame[MODBUS_REQUEST_FRAME];
+  uint8_t requestLength = MODBUS_REQUEST_FRAME;
+  uint8_t responseFrame[MODBUS_MAX_FRAME];
+  uint8_t responseLength = 0;
+  uint16_t registers[MODBUS_MAX_REGISTERS];
+  uint8_t registerCount = 0;
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef OUTBOUND_QUEUE_H
+#define OUTBOUND_QUEUE_H
+
+#include <Arduino.h>
+#include "telemetry_frame.h"
+
+// === STORE-AND-FORWARD QUEUE (Mega -> ESP32) ===
+// เก็บข้อความที่ส่งไม่ได้ขณะลิงก์กับ ESP32 ขาด (เหตุการณ์ของ relay/ปั๊ม และ snapshot ของค่าเซ็นเซอร์)
+// แล้วส่งซ้ำตามลำดับเมื่อลิงก์กลับมา ESP32 ตอบ ACK:<sequence> เพื่อลบออกจากคิว
+//
+//   - ทุก record ได้ sequence ใหม่เพิ่มทีละ 1 (uint16 ข้าม 0) เรียงตามลำดับที่เกิด
+//   - คิวจำกัด OUTBOUND_QUEUE_SLOTS ช่อง (payload ไม่เกิน OUTBOUND_PAYLOAD_MAX ไบต์ = snapshot 1 เฟรม)
+//   - คิวเต็ม: ทิ้ง record ที่เก่าที่สุดในระดับความสำคัญต่ำสุดที่ไม่สูงกว่าของใหม่
+//     ถ้าทุกช่องสำคัญกว่าของใหม่ ของใหม่ถูกทิ้งแทน (นับใน dropped())
+//   - ACK เป็นแบบสะสม: ACK:n ลบทุก record ที่ sequence <= n
+
+#define OUTBOUND_QUEUE_SLOTS 10
+#define OUTBOUND_PAYLOAD_MAX sizeof(TelemetryFrameV1)
+
+// ความสำคัญเมื่อคิวเต็ม (ค่ามากกว่า = เก็บไว้ก่อน)
+enum OutboundPriority : uint8_t {
+  OUTBOUND_ROUTINE,    // snapshot ของค่าเซ็นเซอร์
+  OUTBOUND_STATUS,     // เหตุการณ์ที่เกิดซ้ำบ่อย (รอบ ON/OFF ของพัดลม)
+  OUTBOUND_CRITICAL    // ปั๊มหยุด, ถึงเพดานเวลาทำงาน
+};
+
+struct OutboundRecord {
+  uint16_t sequence;
+  uint8_t kind;        // ชนิด payload (ผู้ใช้คิวกำหนดเอง)
+  uint8_t priority;    // OutboundPriority
+  uint32_t queuedMs;   // millis() ตอนเข้าคิว (ใช้บอกอายุตอนส่งซ้ำ)
+  uint8_t payload[OUTBOUND_PAYLOAD_MAX];
+};
+
+class OutboundQueue {
+public:
+  /**
+   * เพิ่ม record ท้ายคิว (คัดลอก payload length ไบต์)
+   * @return sequence ของ record หรือ 0 ถ้าถูกทิ้งเพราะคิวเต็มด้วย record ที่สำคัญกว่า
+   */
+  uint16_t push(uint8_t kind, uint8_t priority, const void* payload, uint8_t length, uint32_t nowMs);
+
+  // record ที่เก่าที่สุด (ส่งก่อน) หรือ NULL ถ้าคิวว่าง
+  const OutboundRecord* front() const { return count > 0 ? &records[0] : NULL; }
+
+  // ลบทุก record ที่ sequence <= upTo (รองรับ sequence วน) คืนจำนวนที่ลบ
+  uint8_t acknowledge(uint16_t upTo);
+
+  uint8_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  uint16_t dropped() const { return droppedCount; }
+  uint16_t lastSequence() const { return sequence; }   // 0 = ยังไม่เคยเข้าคิว
+
+private:
+  void removeAt(uint8_t index);
+
+  OutboundRecord records[OUTBOUND_QUEUE_SLOTS];   // เรียงตาม sequence
+  uint8_t count = 0;
+  uint16_t sequence = 0;
+  uint16_t droppedCount = 0;
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef POLL_SCHEDULER_H
+#define POLL_SCHEDULER_H
+
+#include <Arduino.h>
+
+// === ADAPTIVE BUS POLLING SCHEDULER ===
+// แต่ละงาน (1 slave บนบัส) มีคาบของตัวเองที่ปรับได้ระหว่าง minPeriodMs..maxPeriodMs
+// ค่าที่เปลี่ยนเร็ว (>= deltaThreshold ต่อการอ่าน) หรืออยู่ใกล้เกณฑ์ควบคุม (|ค่า - threshold| <= band)
+// จะกลับไปอ่านที่ minPeriodMs ทันที ค่าที่นิ่งจะค่อยๆ ยืดคาบออก 25% ต่อการอ่านจนถึง maxPeriodMs
+//
+// เลือกงานที่ครบกำหนดตาม priority (0 = สำคัญสุด) ยกเว้นงานที่รอเกิน jitterMs แล้วจะได้ไปก่อน
+// ทุกอย่างเป็น static array ไม่มี heap
+
+#define POLL_MAX_JOBS 8
+#define POLL_NONE 0xFF
+
+struct PollConfig {
+  uint32_t minPeriodMs;     // คาบเร็วสุด (ค่ากำลังเปลี่ยน/ใกล้เกณฑ์)
+  uint32_t maxPeriodMs;     // คาบช้าสุด (ค่านิ่ง)
+  uint8_t priority;         // 0 = สำคัญสุด
+  uint16_t jitterMs;        // ยอมให้ถูกเลื่อนหลังงานที่สำคัญกว่าได้นานเท่านี้
+  int32_t threshold;        // เกณฑ์ควบคุมของค่าที่เฝ้าดู (หน่วยเดียวกับ telemetry)
+  int32_t band;             // 0 = ไม่ใช้เกณฑ์
+  int32_t deltaThreshold;   // 0 = ไม่ดูอัตราการเปลี่ยน
+};
+
+class PollScheduler {
+public:
+  // เพิ่มงาน คืนค่า index หรือ POLL_NONE ถ้าตารางเต็ม (งานใหม่ครบกำหนดทันที)
+  uint8_t add(const PollConfig& config);
+  uint8_t count() const { return jobCount; }
+
+  // เปลี่ยน config ขณะทำงาน (คาบปัจจุบันถูกจำกัดให้อยู่ในช่วงใหม่)
+  void configure(uint8_t job, const PollConfig& config);
+  const PollConfig& config(uint8_t job) const { return jobs[job].config; }
+
+  // งานที่ควรเริ่มตอนนี้ หรือ POLL_NONE
+  uint8_t next(uint32_t nowMs) const;
+
+  // บันทึกว่าเริ่มอ่านงานนี้แล้ว (กำหนดครั้งถัดไป = nowMs + คาบปัจจุบัน)
+  void started(uint8_t job, uint32_t nowMs);
+
+  // รายงานค่าที่อ่านได้เพื่อปรับคาบ
+  void reportValue(uint8_t job, int32_t value);
+
+  // อ่านไม่สำเร็จ: เลื่อนครั้งถัดไปเป็น delayMs นับจากตอนที่เริ่มอ่าน (ใช้กับ backoff ของ slave ที่ไม่ตอบ)
+  void retryAfter(uint8_t job, uint32_t delayMs);
+
+  uint32_t periodMs(uint8_t job) const { return jobs[job].periodMs; }
+
+private:
+  struct Job {
+    PollConfig config;
+    uint32_t periodMs;      // คาบปัจจุบัน
+    uint32_t dueMs;         // เวลาที่ควรเริ่มครั้งถัดไป
+    uint32_t startedMs;     // เวลาที่เริ่มอ่านครั้งล่าสุด
+    int32_t lastValue;
+    bool hasValue;
+  };
+
+  static uint32_t clampPeriod(uint32_t period, const PollConfig& config);
+
+  Job jobs[POLL_MAX_JOBS];
+  uint8_t jobCount = 0;
+};
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef PZEM_METER_H
+#define PZEM_METER_H
+
+#include <Arduino.h>
+#include "modbus_rtu.h"
+
+// === NON-BLOCKING PZEM-004T v3.0 DRIVER ===
+// อ่าน input register 0x0000-0x0009 ทั้ง 10 ตัวในคำขอเดียว แล้วแยกค่าทั้ง 6 จากเฟรมเดียวกัน
+// ใช้ ModbusRtuMaster ของตัวเองบน Serial3 จึงทำงานพร้อมกับ Modbus บน Serial1 ได้ (เรียก poll() ทุก loop)
+//
+// register map (ค่า 32 บิตส่ง word ต่ำก่อน):
+//   0 = V x0.1 | 1-2 = A x0.001 | 3-4 = W x0.1 | 5-6 = Wh | 7 = Hz x0.1 | 8 = PF x0.01 | 9 = alarm
+
+#define PZEM_DEFAULT_ADDRESS 0xF8    // address ทั่วไป (general address) เมื่อมีมิเตอร์ตัวเดียวบนบัส
+#define PZEM_REGISTER_COUNT 10
+#define PZEM_CMD_RESET_ENERGY 0x42
+
+// ค่าตามหน่วยของ register โดยตรง (ตรงกับ TelemetryFrameV1 ไม่ต้องแปลงผ่าน float)
+struct PzemReading {
+  uint16_t voltage;     // V x10
+  uint32_t current;     // mA
+  uint32_t power;       // W x10
+  uint32_t energy;      // Wh
+  uint16_t frequency;   // Hz x10
+  uint8_t pf;           // x100
+  bool alarm;           // เกินเกณฑ์กำลังไฟที่ตั้งในมิเตอร์
+};
+
+class PzemMeter {
+public:
+  enum Operation : uint8_t { OP_NONE, OP_READ, OP_RESET_ENERGY };
+
+  void begin(HardwareSerial& serial, uint8_t address = PZEM_DEFAULT_ADDRESS);
+
+  // เริ่มอ่านค่าทั้งหมด (คืนค่า false ถ้ายังมีธุรกรรมค้างอยู่)
+  bool requestRead();
+
+  // ขอ reset energy: ถ้าบัสว่างส่งทันที ไม่งั้นส่งต่อจากธุรกรรมปัจจุบัน
+  void requestEnergyReset();
+
+  // เดินสถานะเครื่อง คืนค่า true ในรอบที่ธุรกรรมเสร็จ (ดู completed() / result())
+  bool poll();
+
+  bool isBusy() const { return bus.isBusy() || resetPending; }
+  Operation completed() const { return lastOperation; }
+  uint8_t result() const { return bus.result(); }
+  const PzemReading& reading() const { return values; }
+
+private:
+  void parse();
+
+  ModbusRtuMaster bus;
+  uint8_t address = PZEM_DEFAULT_ADDRESS;
+  bool resetPending = false;
+  Operation operation = OP_NONE;      // ธุรกรรมที่กำลังทำ
+  Operation lastOperation = OP_NONE;  // ธุรกรรมที่เพิ่งเสร็จ
+  PzemReading values = {};
+};
+
+#endif
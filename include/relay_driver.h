@@ -0,0 +1,28 @@
+#ifndef RELAY_DRIVER_H
+#define RELAY_DRIVER_H
+
+#include <Arduino.h>
+
+// === ATOMIC RELAY DRIVER ===
+// เก็บสถานะ relay เป็น mask 8 บิต (bit i = K(i+1) เปิด) และรวมขั้วของแต่ละตัวเป็น XOR mask
+// เปลี่ยนทั้ง pattern ด้วยการเขียน PORTx แบบ mask ครั้งเดียวต่อพอร์ต (K1-K8 อยู่บน PORTA/PORTC)
+// ภายใน critical section สั้นๆ relay ทุกตัวจึงเปลี่ยนพร้อมกัน และเรียกจาก ISR ได้อย่างปลอดภัย
+//
+// ทุกส่วนที่สั่ง relay (คำสั่ง RELAY:, ปั๊ม, พัดลม) ต้องผ่าน driver นี้เท่านั้น
+
+#define RELAY_MAX 8
+
+// ตั้งค่าขา OUTPUT และปิด relay ทั้งหมด
+// activeHigh[i] = true: HIGH = เปิด, false: LOW = เปิด
+void relayDriverBegin(const int* pins, const bool* activeHigh, uint8_t count);
+
+// เปลี่ยนเฉพาะ relay ใน changeMask ให้เป็นค่าใน onMask (ตัวอื่นคงเดิม) แบบ atomic
+void relayApply(uint8_t changeMask, uint8_t onMask);
+
+// สั่ง relay ตัวเดียว (index 0-7)
+void relaySet(uint8_t index, bool on);
+
+uint8_t relayStateMask();
+bool relayIsOn(uint8_t index);
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef RULE_ENGINE_H
+#define RULE_ENGINE_H
+
+#include <Arduino.h>
+
+// === LOCAL RELAY RULES ===
+// กฎ threshold + hysteresis บน Mega: ค่าของฟิลด์ telemetry ใดก็ได้คุม relay ใดก็ได้ ไม่ต้องรอ ESP32
+//
+//   onValue > offValue: ON เมื่อค่า >= onValue, OFF เมื่อค่า <= offValue (เช่นทำความเย็น 25.0/22.0 °C)
+//   onValue < offValue: ON เมื่อค่า <= onValue, OFF เมื่อค่า >= offValue (เช่นเพิ่มความชื้น)
+//   ระหว่างสองค่า relay คงสถานะเดิม
+//
+// ต้องเปิดค้างอย่างน้อย minOnSeconds / ปิดค้างอย่างน้อย minOffSeconds ก่อนสลับอีกครั้ง
+// (นับจากการสลับครั้งก่อนของกฎนี้ กฎที่เพิ่งตั้งสลับได้ทันที) ยังไม่ครบ = รอตัดสินใหม่กับค่าถัดไป
+// ตารางขนาดคงที่ RULE_MAX ช่อง relay ละไม่เกิน 1 กฎ หน่วยของค่าเดียวกับเฟรม telemetry
+
+#define RULE_MAX 4
+#define RULE_NONE 0xFF
+
+struct RelayRule {
+  uint8_t field;            // TelemetryField ต้นทาง (RULE_NONE = ช่องว่าง)
+  uint8_t relay;            // index 0-7 (K1-K8)
+  int32_t onValue;
+  int32_t offValue;
+  uint16_t minOnSeconds;
+  uint16_t minOffSeconds;
+};
+
+class RuleEngine {
+public:
+  RuleEngine();
+
+  // onValue ต้องต่างจาก offValue, relay 0-7, field < 32 (ผู้เรียกตรวจเองว่าเป็นฟิลด์ค่า ไม่ใช่ bit)
+  static bool valid(const RelayRule& rule);
+
+  // เพิ่มกฎ หรือแทนกฎเดิมของ relay เดียวกัน (คืนค่า false ถ้าตารางเต็ม)
+  bool set(const RelayRule& rule);
+  bool clear(uint8_t relay);   // คืนค่า false ถ้า relay นี้ไม่มีกฎ
+
+  // นับเวลาขั้นต่ำของทุกกฎจาก nowMs (หลังบูต: relay เพิ่งดับไปพร้อมไฟ คอมเพรสเซอร์ต้องพักครบ minOff ก่อน)
+  void restartTimers(uint32_t nowMs);
+
+  const RelayRule& rule(uint8_t index) const { return rules[index]; }
+  uint8_t relayMask() const;     // bit i = relay i มีกฎคุม
+  uint32_t fieldMask() const;    // bit f = มีกฎที่ใช้ฟิลด์ f
+
+  /**
+   * ตัดสินกฎ index จากค่าใหม่ของฟิลด์ต้นทาง
+   * @param relayOn สถานะจริงของ relay ตอนนี้
+   * @param turnOn สถานะที่ต้องสั่ง (ใช้เมื่อคืนค่า true)
+   * @return true ถ้าต้องสลับ relay (บันทึกเวลาสลับแล้ว)
+   */
+  bool evaluate(uint8_t index, int32_t value, bool relayOn, uint32_t nowMs, bool& turnOn);
+
+  bool waiting(uint8_t index) const { return held[index]; }   // ต้องสลับแต่ยังไม่ครบเวลาขั้นต่ำ
+  uint16_t switches(uint8_t index) const { return switchCount[index]; }
+
+private:
+  RelayRule rules[RULE_MAX];
+  uint32_t lastSwitchMs[RULE_MAX];
+  bool switched[RULE_MAX];       // มีการสลับตั้งแต่ตั้งกฎแล้ว (ใช้เวลาขั้นต่ำ)
+  bool held[RULE_MAX];
+  uint16_t switchCount[RULE_MAX];
+};
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef SENSOR_FILTER_H
+#define SENSOR_FILTER_H
+
+#include <Arduino.h>
+
+// === SENSOR FILTER PIPELINE ===
+// กรองค่าจาก Modbus ก่อนเก็บลงตัวแปรที่ telemetry/การควบคุมใช้ ทีละช่องตามลำดับ:
+//
+//   raw -> median-of-N (ตัดค่าโดดตัวเดียว) -> จำกัดอัตราเปลี่ยนต่อวินาที -> EMA (ค่าเฉลี่ยถ่วงน้ำหนัก)
+//
+//   - median: N = 1 (ปิด), 3, 5 หรือ 7 ตัวอย่างล่าสุด ช่วงแรกที่ยังไม่ครบใช้เท่าที่มี
+//   - rate: ค่าเปลี่ยนได้ไม่เกิน maxRatePerSec ต่อวินาทีตามเวลาระหว่างตัวอย่างจริง (0 = ไม่จำกัด)
+//   - EMA: ค่าใหม่มีน้ำหนัก 1/2^emaShift (0 = ปิด) เก็บสถานะเป็น x2^FILTER_EMA_FRACTION_BITS
+// หน่วยเดียวกับค่าที่ป้อน (หน่วยของเฟรม telemetry เช่น pH x100) ไม่มี heap บัฟเฟอร์ขนาดคงที่ต่อช่อง
+// งานต่อตัวอย่างมีขอบเขต: เรียง FILTER_MEDIAN_MAX ค่าแบบ insertion sort (ไม่เกิน 21 การเปรียบเทียบ)
+
+#define FILTER_MEDIAN_MAX 7
+#define FILTER_EMA_SHIFT_MAX 6
+#define FILTER_EMA_FRACTION_BITS 6
+#define FILTER_RATE_MAX 1000000UL                 // maxRatePerSec สูงสุด
+#define FILTER_VALUE_LIMIT 33554431L              // |ค่า| ที่รับได้ (2^25 - 1) ไม่ให้สถานะ EMA ล้น int32
+#define FILTER_NONE 0xFF
+#define FILTER_CHANNEL_NAME_MAX 6                 // ชื่อยาวสุด + '\0'
+
+enum FilterChannel : uint8_t {
+  FILTER_CO2,     // ppm
+  FILTER_LIGHT,   // lux
+  FILTER_EC,      // µS/cm x10
+  FILTER_PH,      // pH x100
+  FILTER_CHANNEL_COUNT
+};
+
+// ชื่อช่องตรงกับชื่อใน JSON ("co2", "light", "ec", "ph")
+uint8_t filterChannelFromName(const char* name);   // FILTER_NONE ถ้าไม่พบ
+const char* filterChannelName(uint8_t channel, char* buffer);   // buffer ขนาด FILTER_CHANNEL_NAME_MAX
+
+struct FilterConfig {
+  uint8_t median;           // 1, 3, 5, 7
+  uint8_t emaShift;         // 0..FILTER_EMA_SHIFT_MAX
+  uint32_t maxRatePerSec;   // 0 = ไม่จำกัด
+};
+
+class SensorFilter {
+public:
+  static bool valid(const FilterConfig& config);
+
+  // ตั้งค่าใหม่และล้างประวัติ (ตัวอย่างถัดไปผ่านไปตรงๆ)
+  void configure(const FilterConfig& config);
+
+  // ป้อนตัวอย่างใหม่ คืนค่าที่กรองแล้ว
+  int32_t update(int32_t raw, uint32_t nowMs);
+
+  const FilterConfig& config() const { return settings; }
+  int32_t raw() const { return lastRaw; }
+  int32_t value() const { return output; }
+  uint16_t rateLimited() const { return limitedCount; }   // จำนวนตัวอย่างที่ถูกจำกัดอัตรา
+
+private:
+  int32_t median(int32_t sample);
+
+  FilterConfig settings = {1, 0, 0};
+  int32_t window[FILTER_MEDIAN_MAX];
+  uint8_t head = 0;
+  uint8_t count = 0;
+  bool primed = false;
+  int32_t lastRaw = 0;
+  int32_t limited = 0;       // ค่าหลังจำกัดอัตราของตัวอย่างก่อนหน้า
+  int32_t emaScaled = 0;
+  int32_t output = 0;
+  uint32_t lastMs = 0;
+  uint16_t limitedCount = 0;
+};
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef SENSOR_HISTORY_H
+#define SENSOR_HISTORY_H
+
+#include <Arduino.h>
+
+// === ON-DEVICE SENSOR HISTORY ===
+// เก็บ min/max/mean ของช่องสำคัญย้อนหลังใน RAM เพื่อให้ ESP32 ดึงคืนได้หลัง ESP32/MQTT ขาดไป (HISTORY:<ช่อง>,<from>)
+// ค่าเข้ามาทีละตัวอย่าง (sample) แล้วสรุปเป็นช่องละ 1 นาที จากนั้นยุบรวมเป็นช่องที่หยาบขึ้นเป็นชั้น:
+//
+//   ชั้น | ความยาวช่อง | จำนวนช่อง | ย้อนหลัง
+//   0    | 1 นาที      | 15        | 15 นาที
+//   1    | 15 นาที     | 8         | 2 ชั่วโมง
+//   2    | 2 ชั่วโมง    | 12        | 24 ชั่วโมง
+//
+// ชั้นที่ละเอียดกว่ามีจำนวนช่องพอดี 1 ช่องของชั้นถัดไป จึงยุบรวมจากช่องในชั้นก่อนหน้าได้เลยโดยไม่ต้องมีตัวสะสมแยก
+// เวลาเป็น "นาทีตั้งแต่บูต" (ไม่มี RTC) ฝั่ง ESP32 แปลงเป็นเวลาจริงจากนาทีปัจจุบันที่ได้ในคำตอบ
+//
+// หน่วยเก็บเป็น int16 (หน่วยของแต่ละช่องดูที่ HistoryChannel) ค่าที่เกินถูกจำกัดไว้
+// หน่วยความจำทั้งหมด (sizeof(SensorHistory)) ต้องไม่เกิน HISTORY_RAM_BUDGET - ตรวจตอนคอมไพล์
+// ไม่ mirror ลง EEPROM: EEPROM ทั้ง 4 KB เป็นของ state_journal เพื่อกระจายการสึก
+
+#define HISTORY_TIERS 3
+#define HISTORY_TIER0_SLOTS 15
+#define HISTORY_TIER1_SLOTS 8
+#define HISTORY_TIER2_SLOTS 12
+#define HISTORY_SLOTS (HISTORY_TIER0_SLOTS + HISTORY_TIER1_SLOTS + HISTORY_TIER2_SLOTS)
+#define HISTORY_RAM_BUDGET 1600   // ไบต์ (SRAM ของ ATmega2560 มี 8 KB ใช้ร่วมกับ Serial buffer, JSON และ stack)
+#define HISTORY_NONE 0xFF
+#define HISTORY_CHANNEL_NAME_MAX 10   // ชื่อยาวสุด + '\0'
+
+enum HistoryChannel : uint8_t {
+  HISTORY_AIR_TEMP,     // °C x10
+  HISTORY_CO2,          // ppm
+  HISTORY_EC,           // µS/cm (x1: x10 ของเฟรมเกินช่วง int16)
+  HISTORY_PH,           // pH x100
+  HISTORY_WATER_TEMP,   // °C x10
+  HISTORY_FLOW,         // L/min x100 รวมทุกช่อง
+  HISTORY_AC_POWER,     // W (x1)
+  HISTORY_CHANNEL_COUNT
+};
+
+// ชื่อช่องตรงกับชื่อใน JSON ("airTemp", "co2", "ec", "ph", "waterTemp", "flow", "acPower")
+uint8_t historyChannelFromName(const char* name);   // HISTORY_NONE ถ้าไม่พบ
+const char* historyChannelName(uint8_t channel, char* buffer);   // buffer ขนาด HISTORY_CHANNEL_NAME_MAX
+
+struct HistoryBucket {
+  int16_t min;
+  int16_t max;
+  int16_t mean;
+};
+
+// ช่องเวลาที่อ่านออกมา
+struct HistoryEntry {
+  uint32_t startMinute;   // นาทีตั้งแต่บูตที่ช่องเริ่ม
+  uint16_t minutes;       // ความยาวช่อง
+  HistoryBucket value;
+};
+
+class SensorHistory {
+public:
+  SensorHistory();
+
+  // เพิ่มตัวอย่างในนาทีปัจจุบัน (ช่องที่ไม่มีตัวอย่างทั้งนาทีถือว่าไม่มีข้อมูล)
+  void sample(uint8_t channel, int32_t value);
+
+  // ปิดนาทีที่ครบแล้วและยุบรวมชั้นที่ครบช่อง - เรียกบ่อยๆ (รองรับ millis() ล้น)
+  void update(uint32_t nowMs);
+
+  // นาทีปัจจุบันตั้งแต่บูต (ช่องที่ยังไม่ปิด)
+  uint32_t currentMinute() const { return minute; }
+
+  /**
+   * ช่องถัดไปของ channel ที่เริ่มตั้งแต่นาที fromMinute เรียงจากเก่าไปใหม่
+   * ช่วงเวลาเดียวกันใช้ชั้นที่ละเอียดที่สุดที่ยังมีอยู่ ช่องที่ไม่มีข้อมูลถูกข้าม
+   * เรียกซ้ำโดยตั้ง fromMinute = entry.startMinute + entry.minutes (ทนต่อการเพิ่มช่องใหม่ระหว่างอ่าน)
+   * @return false ถ้าไม่มีช่องที่ปิดแล้วเหลือ
+   */
+  bool next(uint8_t channel, uint32_t fromMinute, HistoryEntry& entry) const;
+
+private:
+  struct Accumulator {
+    int32_t sum;
+    uint16_t count;
+    int16_t min;
+    int16_t max;
+  };
+
+  struct Tier {
+    uint8_t head;          // ช่องที่จะเขียนถัดไป
+    uint8_t count;         // ช่องที่มีอยู่ (ไม่เกินจำนวนช่องของชั้น)
+    uint32_t closed;       // จำนวนช่องที่ปิดไปทั้งหมดของชั้นนี้ (ช่องใหม่สุดจบที่นาที closed x ความยาวช่อง)
+  };
+
+  void closeMinute();
+  void push(uint8_t tier, const HistoryBucket* values);
+  void rollUp(uint8_t tier);
+  const HistoryBucket& bucket(uint8_t tier, uint8_t age, uint8_t channel) const;
+
+  HistoryBucket buckets[HISTORY_SLOTS][HISTORY_CHANNEL_COUNT];
+  Tier tiers[HISTORY_TIERS];
+  Accumulator current[HISTORY_CHANNEL_COUNT];
+  uint32_t minute = 0;        // นาทีปัจจุบันตั้งแต่บูต
+  uint32_t minuteStartMs = 0;
+};
+
+#endif
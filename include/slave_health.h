@@ -0,0 +1,35 @@
+#ifndef SLAVE_HEALTH_H
+#define SLAVE_HEALTH_H
+
+#include <Arduino.h>
+
+// === MODBUS SLAVE HEALTH ===
+// บันทึกผลการอ่านของแต่ละ slave: จำนวนครั้งที่พลาดติดกัน, เวลาที่อ่านสำเร็จล่าสุด และจำนวน error แยกตามชนิด
+// slave ที่พลาดติดกันถูกถือว่า offline และเว้นระยะการลองใหม่แบบ exponential (ยังลองเป็นระยะเพื่อตรวจว่ากลับมาหรือยัง)
+// ค่าที่อ่านได้ครั้งล่าสุดยังเก็บไว้ แต่ถูกตั้ง flag ว่า stale แทนการเขียนค่า 0 ทับ
+
+#define SLAVE_STALE_FAILURES 2       // พลาดติดกันเท่านี้ = ค่าที่มีอยู่ไม่น่าเชื่อถือ
+#define SLAVE_OFFLINE_FAILURES 3     // พลาดติดกันเท่านี้ = เริ่ม backoff
+#define SLAVE_BACKOFF_MAX_MS 60000UL // ระยะ probe ยาวสุดของ slave ที่ offline
+
+struct SlaveHealth {
+  uint16_t consecutiveFailures;
+  bool everGood;              // เคยอ่านสำเร็จอย่างน้อย 1 ครั้ง
+  uint32_t lastGoodMs;        // millis() ของการอ่านสำเร็จล่าสุด
+  uint16_t timeouts;
+  uint16_t crcErrors;
+  uint16_t exceptions;        // slave ตอบ exception (0x01-0x04)
+  uint16_t otherErrors;       // ID/function ไม่ตรง ฯลฯ
+
+  void recordSuccess(uint32_t nowMs);
+  void recordFailure(uint8_t code);
+
+  // ยังไม่เคยอ่านได้ หรือพลาดติดกันจนค่าล่าสุดไม่น่าเชื่อถือ
+  bool stale() const { return !everGood || consecutiveFailures >= SLAVE_STALE_FAILURES; }
+  bool offline() const { return consecutiveFailures >= SLAVE_OFFLINE_FAILURES; }
+
+  // ระยะก่อนลองใหม่: คาบปกติจนกว่าจะ offline แล้วเพิ่มเท่าตัวทุกครั้งที่พลาด จนถึง SLAVE_BACKOFF_MAX_MS
+  uint32_t retryDelayMs(uint32_t periodMs) const;
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef STATE_JOURNAL_H
+#define STATE_JOURNAL_H
+
+#include <Arduino.h>
+
+// === WEAR-LEVELLED EEPROM STATE JOURNAL ===
+// EEPROM (ทั้ง 4 KB หรือช่วงที่กำหนด) แบ่งเป็นช่องละ JOURNAL_RECORD_SIZE ไบต์ record ใหม่ต่อท้ายในช่องถัดไปเสมอ (วนทับช่องเก่าสุด)
+// ทุก cell จึงสึกเท่าๆ กัน แทนการเขียนทับ address เดิมทุกครั้ง (~100k รอบต่อ cell)
+//
+// record: sequence (uint32) | bytesWritten (uint32) | payload | crc16 (Modbus, ครอบทุกไบต์ก่อนหน้า)
+//   - ตอนบูตอ่าน sequence ของทุกช่องรอบเดียว แล้วตรวจ CRC เฉพาะช่องที่ใหม่สุด (ไม่ผ่าน = ถอยไปช่องก่อนหน้า)
+//     record ที่ CRC ถูกและ sequence ใหม่สุดคือสถานะล่าสุด
+//   - เขียนทีละไบต์ใน poll() เมื่อ EEPROM ว่าง (AVR ใช้ ~3.3 ms ต่อไบต์) จึงไม่บล็อก loop()
+//     ไบต์ที่ค่าเท่าเดิมถูกข้ามไป ถ้าไฟดับกลางคัน record ที่เขียนไม่ครบ CRC ไม่ผ่าน และ record ก่อนหน้ายังใช้ได้
+//   - bytesWritten = จำนวนไบต์ที่เขียนสะสมตลอดอายุ (รวม record นี้) ใช้ประเมินอายุ EEPROM
+//     ไบต์ของตัวนับและ CRC ถูกนับทุกครั้ง ค่านี้จึงไม่ต่ำกว่าที่เขียนจริง
+
+#define JOURNAL_RECORD_SIZE 64
+#define JOURNAL_HEADER_SIZE 8
+#define JOURNAL_PAYLOAD_SIZE (JOURNAL_RECORD_SIZE - JOURNAL_HEADER_SIZE - 2)
+
+class StateJournal {
+public:
+  // ช่วง EEPROM ของ journal นี้ (length 0 = ถึงท้าย EEPROM) journal หลายตัวต้องใช้ช่วงที่ไม่ทับกัน
+  explicit StateJournal(uint16_t address = 0, uint16_t length = 0) : baseAddress(address), regionLength(length) {}
+
+  // สแกน EEPROM หา record ล่าสุด คัดลอก payload (JOURNAL_PAYLOAD_SIZE ไบต์) และคืนค่า true ถ้าพบ
+  bool begin(void* payload);
+
+  // เริ่มเขียน record ใหม่ (คืนค่า false ถ้า record ก่อนหน้ายังเขียนไม่เสร็จ)
+  bool append(const void* payload);
+
+  // เขียนไบต์ถัดไปเมื่อ EEPROM ว่าง - เรียกทุก loop
+  void poll();
+
+  bool busy() const { return writing; }
+  uint32_t sequence() const { return lastSequence; }     // 0 = ยังไม่มี record
+  uint32_t bytesWritten() const { return totalBytes; }
+  uint16_t slotCount() const { return slots; }
+  uint16_t nextSlot() const { return next; }
+
+private:
+  uint16_t slotAddress(uint16_t slot) const { return baseAddress + slot * JOURNAL_RECORD_SIZE; }
+
+  uint16_t baseAddress;
+  uint16_t regionLength;
+  uint16_t slots = 0;
+  uint16_t next = 0;              // ช่องที่จะเขียน record ถัดไป
+  uint32_t lastSequence = 0;
+  uint32_t totalBytes = 0;
+
+  bool writing = false;
+  uint8_t writePosition = 0;
+  uint8_t staged[JOURNAL_RECORD_SIZE];
+};
+
+#endif
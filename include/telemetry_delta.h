@@ -0,0 +1,106 @@
+#ifndef TELEMETRY_DELTA_H
+#define TELEMETRY_DELTA_H
+
+#include "telemetry_frame.h"
+
+// === CHANGE-DRIVEN (DELTA) TELEMETRY ===
+// แทนการส่งค่าทั้งหมดทุกรอบ: ส่งเฉพาะฟิลด์ที่เปลี่ยนเกิน deadband นับจากค่าที่ส่งไปครั้งล่าสุด
+// และส่งเฟรมเต็ม (keyframe = TelemetryFrameV1) เป็นระยะเพื่อให้ฝั่งรับกลับมาตรงกันเสมอ
+// ฟิลด์ที่ข้ามเกณฑ์ alert (เช่น บิตน้ำใน flags) ทำให้ส่งทันทีโดยไม่รอรอบถัดไป
+//
+// ค่า deadband / เกณฑ์ใช้หน่วยเดียวกับ TelemetryFrameV1 (fixed-point)
+// ฟิลด์แบบบิต (flags, relayStates) ไม่มี deadband: บิตไหนเปลี่ยนก็ถือว่าเปลี่ยน
+// และ "เกณฑ์ alert" ของฟิลด์แบบบิตคือ mask ของบิตที่เปลี่ยนแล้วต้องส่งทันที
+//
+// เฟรม delta บนสาย: 0x00 | COBS( type | sequence | fieldMask | ค่าของฟิลด์ที่ตั้งบิต | crc ) | 0x00
+//   type = TELEMETRY_DELTA_TYPE, fieldMask uint32 (bit i = ฟิลด์ i) ค่าเรียงตาม index ขนาดเท่ากับใน V1
+// ไฟล์นี้ไม่ขึ้นกับ Arduino เช่นเดียวกับ telemetry_frame.h
+
+#define TELEMETRY_DELTA_TYPE 0x81   // ไบต์แรกของเฟรม delta (เฟรมเต็มขึ้นต้นด้วย TELEMETRY_FRAME_VERSION)
+
+enum TelemetryField : uint8_t {
+  TELEMETRY_FIELD_FLAGS,
+  TELEMETRY_FIELD_CO2,
+  TELEMETRY_FIELD_AIR_TEMP,
+  TELEMETRY_FIELD_AIR_HUMIDITY,
+  TELEMETRY_FIELD_LUX,
+  TELEMETRY_FIELD_EC,
+  TELEMETRY_FIELD_PH,
+  TELEMETRY_FIELD_WATER_TEMP,
+  TELEMETRY_FIELD_AC_VOLTAGE,
+  TELEMETRY_FIELD_AC_CURRENT,
+  TELEMETRY_FIELD_AC_POWER,
+  TELEMETRY_FIELD_AC_ENERGY,
+  TELEMETRY_FIELD_AC_FREQUENCY,
+  TELEMETRY_FIELD_AC_POWER_FACTOR,
+  TELEMETRY_FIELD_FLOW_RATE_1,
+  TELEMETRY_FIELD_FLOW_RATE_2,
+  TELEMETRY_FIELD_FLOW_RATE_3,
+  TELEMETRY_FIELD_FLOW_TOTAL_1,
+  TELEMETRY_FIELD_FLOW_TOTAL_2,
+  TELEMETRY_FIELD_FLOW_TOTAL_3,
+  TELEMETRY_FIELD_RELAYS,
+  TELEMETRY_FIELD_COUNT
+};
+
+#define TELEMETRY_ALL_FIELDS ((1UL << TELEMETRY_FIELD_COUNT) - 1)
+
+// ค่าของทุกฟิลด์รวมกัน 53 ไบต์ -> เฟรม delta ยาวสุด 62 ไบต์
+#define TELEMETRY_FIELD_BYTES (sizeof(TelemetryFrameV1) - 5)
+#define TELEMETRY_DELTA_MAX (1 + 2 + 4 + TELEMETRY_FIELD_BYTES + 2)
+#define TELEMETRY_DELTA_WIRE_MAX (TELEMETRY_DELTA_MAX + 3)
+
+// อ่าน/เขียนค่าฟิลด์ (ฟิลด์ที่มีเครื่องหมายคืนค่าแบบ sign-extend)
+uint32_t telemetryFieldValue(const TelemetryFrameV1& frame, uint8_t field);
+void setTelemetryFieldValue(TelemetryFrameV1& frame, uint8_t field, uint32_t value);
+bool telemetryFieldIsBits(uint8_t field);
+
+class TelemetryDeltaTracker {
+public:
+  TelemetryDeltaTracker();   // deadband/alert ค่าเริ่มต้น
+
+  void setDeadband(uint8_t field, uint16_t deadband) { deadbands[field] = deadband; }
+  uint16_t deadband(uint8_t field) const { return deadbands[field]; }
+
+  // เปิด alert: ส่งทันทีเมื่อค่าข้ามเกณฑ์ (ฟิลด์แบบบิต: threshold = mask ของบิต)
+  void setAlert(uint8_t field, int32_t threshold);
+  void clearAlert(uint8_t field) { alertMask &= ~(1UL << field); }
+  bool alertEnabled(uint8_t field) const { return alertMask & (1UL << field); }
+  int32_t alertThreshold(uint8_t field) const { return thresholds[field]; }
+
+  // ลืมค่าที่ส่งไปแล้ว (การส่งครั้งถัดไปต้องเป็น keyframe)
+  void reset() { baseline = false; }
+  bool hasBaseline() const { return baseline; }
+
+  // ฟิลด์ที่เปลี่ยนเกิน deadband จากค่าที่ส่งล่าสุด (ทุกฟิลด์ถ้ายังไม่มี baseline)
+  uint32_t changedFields(const TelemetryFrameV1& frame) const;
+
+  // ฟิลด์ที่ข้ามเกณฑ์ alert เทียบกับค่าที่ส่งล่าสุด
+  uint32_t alertFields(const TelemetryFrameV1& frame) const;
+
+  // บันทึกว่าส่งฟิลด์เหล่านี้แล้ว (TELEMETRY_ALL_FIELDS = keyframe ตั้ง baseline ใหม่)
+  void markSent(const TelemetryFrameV1& frame, uint32_t fields);
+
+private:
+  TelemetryFrameV1 lastSent;
+  bool baseline = false;
+  uint16_t deadbands[TELEMETRY_FIELD_COUNT];
+  int32_t thresholds[TELEMETRY_FIELD_COUNT];
+  uint32_t alertMask = 0;
+};
+
+/**
+ * เข้ารหัสเฟรม delta ของฟิลด์ใน fields (ค่าจาก frame) พร้อมตัวคั่น 0x00 หน้าและท้าย
+ * @param output บัฟเฟอร์ขนาดอย่างน้อย TELEMETRY_DELTA_WIRE_MAX
+ * @return จำนวนไบต์ที่ต้องส่ง หรือ 0 ถ้าบัฟเฟอร์ไม่พอ
+ */
+size_t encodeTelemetryDelta(const TelemetryFrameV1& frame, uint32_t fields, uint16_t sequence,
+                            uint8_t* output, size_t outputSize);
+
+/**
+ * ถอดเฟรม delta (ข้อมูล COBS ระหว่างตัวคั่น) แล้วเขียนค่าที่มีลงใน state และ state.sequence
+ * state ต้องมาจาก keyframe ก่อนหน้า ถ้า sequence ไม่ต่อเนื่องควรรอ keyframe ถัดไป
+ */
+TelemetryDecodeResult applyTelemetryDelta(const uint8_t* encoded, size_t length, TelemetryFrameV1& state);
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef TELEMETRY_FRAME_H
+#define TELEMETRY_FRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// === BINARY TELEMETRY FRAME (V1) ===
+// ทางเลือกแทน JSON SENSOR_DATA: struct ขนาดคงที่ ค่าเป็น fixed-point (little-endian)
+// ปิดท้ายด้วย CRC16/MODBUS แล้วเข้ารหัส COBS เพื่อไม่ให้มีไบต์ 0x00 ในเฟรม
+//
+// บนสาย: 0x00 | COBS(frame) | 0x00
+//   - 0x00 นำหน้าใช้ตัดข้อความ text ที่อาจค้างอยู่ก่อนเฟรม
+//   - ฝั่งรับแยกข้อมูลด้วย 0x00 แล้วส่งแต่ละช่วงให้ decodeTelemetryFrame()
+//     ช่วงที่ถอดไม่ผ่าน (เช่นข้อความ RELAY_OK) ให้ทิ้งหรือส่งต่อให้ตัวอ่าน text
+//
+// ไฟล์นี้ไม่ขึ้นกับ Arduino จึงใช้ถอดเฟรมในโปรแกรมฝั่ง host/test ได้โดยตรง
+
+#define TELEMETRY_FRAME_VERSION 1
+
+// บิตใน flags
+#define TELEMETRY_FLAG_WATER_DETECTED  0x01
+#define TELEMETRY_FLAG_AC_CONNECTED    0x02
+#define TELEMETRY_FLAG_EC_RANGE_4400   0x04
+// ค่าของ slave นั้นไม่สดแล้ว (อ่านไม่ได้ติดกัน) ฟิลด์ยังเป็นค่าล่าสุดที่อ่านได้ ไม่ใช่ 0
+#define TELEMETRY_FLAG_STALE_AIR       0x08   // co2Ppm, airTemp, airHumidity (ID 1)
+#define TELEMETRY_FLAG_STALE_LIGHT     0x10   // lux (ID 2)
+#define TELEMETRY_FLAG_STALE_EC        0x20   // ec (ID 3)
+#define TELEMETRY_FLAG_STALE_PH        0x40   // ph, waterTemp (ID 4)
+#define TELEMETRY_FLAG_LINK_DEGRADED   0x80   // ลิงก์ ESP32 มี loss/RTT เกินเกณฑ์ (ดู link_monitor.h)
+
+struct __attribute__((packed)) TelemetryFrameV1 {
+  uint8_t version;             // TELEMETRY_FRAME_VERSION
+  uint8_t flags;               // TELEMETRY_FLAG_*
+  uint16_t sequence;           // เพิ่มทีละ 1 ต่อเฟรม (ใช้ตรวจเฟรมหาย)
+  uint16_t co2Ppm;             // ppm
+  int16_t airTemp;             // °C x10
+  uint16_t airHumidity;        // %RH x10
+  uint32_t lux;                // lux
+  uint16_t ec;                 // µS/cm x10
+  uint16_t ph;                 // pH x100
+  int16_t waterTemp;           // °C x10
+  uint16_t acVoltage;          // V x10
+  uint32_t acCurrent;          // mA
+  uint32_t acPower;            // W x10
+  uint32_t acEnergy;           // Wh
+  uint16_t acFrequency;        // Hz x10
+  uint8_t acPowerFactor;       // x100
+  uint16_t flowRate[3];        // L/min x100
+  uint32_t flowTotal[3];       // mL
+  uint8_t relayStates;         // bit0 = K1 ... bit7 = K8
+  uint16_t crc;                // CRC16/MODBUS ของทุกไบต์ก่อนหน้า
+};
+
+static_assert(sizeof(TelemetryFrameV1) == 58, "TelemetryFrameV1 layout changed - bump TELEMETRY_FRAME_VERSION");
+
+// ขนาดสูงสุดบนสาย: ตัวคั่น 2 ไบต์ + COBS overhead 1 ไบต์
+#define TELEMETRY_WIRE_MAX (sizeof(TelemetryFrameV1) + 3)
+
+enum TelemetryDecodeResult : uint8_t {
+  TELEMETRY_OK,
+  TELEMETRY_BAD_COBS,      // ข้อมูลเข้ารหัส COBS ไม่ถูกต้อง
+  TELEMETRY_BAD_LENGTH,    // ความยาวไม่ตรงกับ TelemetryFrameV1
+  TELEMETRY_BAD_VERSION,   // version ไม่รองรับ
+  TELEMETRY_BAD_CRC        // CRC ไม่ตรง
+};
+
+// COBS: คืนจำนวนไบต์ผลลัพธ์ หรือ 0 ถ้าบัฟเฟอร์ไม่พอ/ข้อมูลผิดรูปแบบ
+size_t cobsEncode(const uint8_t* input, size_t length, uint8_t* output, size_t outputSize);
+size_t cobsDecode(const uint8_t* input, size_t length, uint8_t* output, size_t outputSize);
+
+/**
+ * เติม version/sequence/CRC ลงใน frame แล้วเข้ารหัสเป็นข้อมูลพร้อมส่งบนสาย
+ * @param frame    ค่าที่ต้องการส่ง (version, sequence, crc จะถูกเขียนทับ)
+ * @param output   บัฟเฟอร์ขนาดอย่างน้อย TELEMETRY_WIRE_MAX
+ * @return จำนวนไบต์ที่ต้องส่ง (รวมตัวคั่น 0x00 หน้าและท้าย) หรือ 0 ถ้าบัฟเฟอร์ไม่พอ
+ */
+size_t encodeTelemetryFrame(TelemetryFrameV1& frame, uint16_t sequence, uint8_t* output, size_t outputSize);
+
+/**
+ * ถอดเฟรม 1 เฟรม (ข้อมูล COBS ระหว่างตัวคั่น 0x00 โดยไม่รวมตัวคั่น)
+ * ตรวจความยาว, version และ CRC ก่อนคัดลอกลง out
+ */
+TelemetryDecodeResult decodeTelemetryFrame(const uint8_t* encoded, size_t length, TelemetryFrameV1& out);
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef TELEMETRY_SUBSCRIPTIONS_H
+#define TELEMETRY_SUBSCRIPTIONS_H
+
+#include <Arduino.h>
+#include "telemetry_delta.h"
+
+// === TELEMETRY SUBSCRIPTIONS ===
+// ESP32 ขอรับแต่ละกลุ่มฟิลด์ด้วยคาบของตัวเอง (SUBSCRIBE:<กลุ่ม>,<ms> / UNSUBSCRIBE:<กลุ่ม>)
+// กลุ่ม ALL คือสตรีมหลัก (เฟรมเต็ม หรือ delta + keyframe) ค่าเริ่มต้นทุก SEND_INTERVAL
+// กลุ่มอื่นส่งเป็นข้อความสั้นเฉพาะฟิลด์ของกลุ่ม (binary ใช้รูปแบบเฟรม delta)
+// ตารางมีช่องละกลุ่ม (คาบ 0 = ไม่ได้ subscribe) ไม่มี heap
+
+#define TELEMETRY_SUBSCRIBE_MIN_MS 100UL
+#define TELEMETRY_SUBSCRIBE_MAX_MS 3600000UL
+#define TELEMETRY_GROUP_NONE 0xFF
+
+enum TelemetryGroup : uint8_t {
+  TELEMETRY_GROUP_ALL,      // ทุกฟิลด์ (สตรีมหลัก)
+  TELEMETRY_GROUP_AIR,      // co2, airTemp, airHumidity
+  TELEMETRY_GROUP_LIGHT,    // lux
+  TELEMETRY_GROUP_WATER,    // ec, ph, waterTemp
+  TELEMETRY_GROUP_AC,       // acVoltage ... acPowerFactor
+  TELEMETRY_GROUP_FLOW,     // flowRate 1-3, flowTotal 1-3
+  TELEMETRY_GROUP_STATUS,   // flags (ระดับน้ำ, AC, stale) และสถานะ relay/ปั๊ม
+  TELEMETRY_GROUP_COUNT
+};
+
+#define TELEMETRY_GROUP_NAME_MAX 8   // ชื่อกลุ่มยาวสุด + '\0'
+
+// mask ของ TelemetryField ในกลุ่ม
+uint32_t telemetryGroupFields(uint8_t group);
+
+// ชื่อกลุ่ม ("all", "air", "light", "water", "ac", "flow", "status") <-> TelemetryGroup
+uint8_t telemetryGroupFromName(const char* name);   // TELEMETRY_GROUP_NONE ถ้าไม่พบ
+const char* telemetryGroupName(uint8_t group, char* buffer);   // buffer ขนาด TELEMETRY_GROUP_NAME_MAX
+
+class TelemetrySubscriptions {
+public:
+  // ตั้งคาบของกลุ่ม (ข้อความแรกครบกำหนดทันที)
+  void subscribe(uint8_t group, uint32_t periodMs);
+  void unsubscribe(uint8_t group) { periods[group] = 0; }
+  uint32_t periodMs(uint8_t group) const { return periods[group]; }
+
+  // กลุ่มที่ครบกำหนดและเลยกำหนดมานานที่สุด หรือ TELEMETRY_GROUP_NONE
+  uint8_t nextDue(uint32_t nowMs) const;
+
+  // บันทึกว่าส่งกลุ่มนี้แล้ว (ครั้งถัดไป = nowMs + คาบ)
+  void markSent(uint8_t group, uint32_t nowMs);
+
+private:
+  uint32_t periods[TELEMETRY_GROUP_COUNT] = {};
+  uint32_t dueMs[TELEMETRY_GROUP_COUNT] = {};
+  bool pending[TELEMETRY_GROUP_COUNT] = {};   // เพิ่ง subscribe: ส่งรอบถัดไปทันที
+};
+
+#endif
@@ -0,0 +1,297 @@
+#include "native_hal.h"
+
+#define HAL_PIN_COUNT 70
+#define HAL_MAX_PERIPHERALS 8
+
+HardwareSerial Serial(0);
+HardwareSerial Serial1(1);
+HardwareSerial Serial2(2);
+HardwareSerial Serial3(3);
+
+uint8_t TCCR3A = 0;
+uint8_t TCCR3B = 0;
+uint16_t TCNT3 = 0;
+uint16_t OCR3A = 0;
+uint8_t TIFR3 = 0;
+uint8_t TIMSK3 = 0;
+
+// firmware ที่ไม่มี ISR ของ Timer3 (เช่น test ที่ไม่ link main.cpp) ยังรันได้
+extern "C" void TIMER3_COMPA_vect(void) __attribute__((weak));
+
+struct HalPeripheral {
+  HalPeripheralFn fn;
+  void* context;
+};
+
+static uint64_t nowUs = 0;
+static uint64_t nextTimerTickUs = 0;
+static uint64_t nextPeripheralUs = 0;
+static uint8_t pinModes[HAL_PIN_COUNT];
+static uint8_t outputLevels[HAL_PIN_COUNT];
+static uint8_t inputLevels[HAL_PIN_COUNT];
+static bool inputDriven[HAL_PIN_COUNT];
+static int analogValues[HAL_PIN_COUNT];
+static uint32_t writeCounts[HAL_PIN_COUNT];
+static HalPeripheral peripherals[HAL_MAX_PERIPHERALS];
+static uint8_t peripheralCount = 0;
+static bool advancing = false;
+
+// === เวลา ===
+
+unsigned long millis() {
+  return (uint32_t)(nowUs / 1000);
+}
+
+unsigned long micros() {
+  return (uint32_t)nowUs;
+}
+
+void delay(unsigned long ms) {
+  halAdvanceMicros(ms * 1000UL);
+}
+
+void delayMicroseconds(unsigned int us) {
+  halAdvanceMicros(us);
+}
+
+uint32_t halTimer3PeriodMicros() {
+  if (!(TIMSK3 & _BV(OCIE3A))) {
+    return 0;
+  }
+  static const uint16_t prescalers[8] = {0, 1, 8, 64, 256, 1024, 0, 0};
+  uint16_t prescaler = prescalers[TCCR3B & 0x07];
+  if (prescaler == 0) {
+    return 0; // timer หยุด หรือใช้ clock ภายนอก
+  }
+  // 16 MHz: 1 count = prescaler / 16 us
+  return (uint32_t)(((uint64_t)OCR3A + 1) * prescaler / 16);
+}
+
+static void runPeripherals() {
+  for (uint8_t i = 0; i < peripheralCount; i++) {
+    peripherals[i].fn(peripherals[i].context);
+  }
+}
+
+void halAdvanceMicros(uint32_t us) {
+  // delay() ภายใน ISR หรือ peripheral ไม่เดินเวลาซ้อน
+  if (advancing) {
+    return;
+  }
+  advancing = true;
+
+  uint64_t target = nowUs + us;
+  while (true) {
+    uint32_t period = halTimer3PeriodMicros();
+    if (period == 0) {
+      nextTimerTickUs = 0;
+    } else if (nextTimerTickUs <= nowUs) {
+      nextTimerTickUs = nowUs + period; // เพิ่งเปิด timer: นับคาบแรกจากตอนนี้
+    }
+
+    uint64_t step = target;
+    if (nextTimerTickUs != 0 && nextTimerTickUs < step) step = nextTimerTickUs;
+    if (nextPeripheralUs > nowUs && nextPeripheralUs < step) step = nextPeripheralUs;
+    nowUs = step;
+
+    if (nextTimerTickUs != 0 && nowUs == nextTimerTickUs) {
+      nextTimerTickUs += period;
+      if (TIMER3_COMPA_vect) {
+        TIMER3_COMPA_vect();
+      }
+    }
+    if (nowUs >= nextPeripheralUs || nowUs == target) {
+      runPeripherals();
+      nextPeripheralUs = (nowUs / 1000 + 1) * 1000;
+    }
+    if (nowUs >= target) {
+      break;
+    }
+  }
+
+  advancing = false;
+}
+
+void halAdvanceMillis(uint32_t ms) {
+  halAdvanceMicros(ms * 1000UL);
+}
+
+void halSetMicros(uint64_t us) {
+  nowUs = us;
+  nextTimerTickUs = 0;
+  nextPeripheralUs = 0;
+}
+
+uint64_t halNowMicros() {
+  return nowUs;
+}
+
+void halRunLoop(uint32_t durationMs, uint32_t stepUs) {
+  uint64_t end = nowUs + (uint64_t)durationMs * 1000;
+  while (nowUs < end) {
+    loop();
+    halAdvanceMicros(stepUs);
+  }
+}
+
+bool halAttachPeripheral(HalPeripheralFn fn, void* context) {
+  if (peripheralCount >= HAL_MAX_PERIPHERALS) {
+    return false;
+  }
+  peripherals[peripheralCount].fn = fn;
+  peripherals[peripheralCount].context = context;
+  peripheralCount++;
+  return true;
+}
+
+void halReset() {
+  nowUs = 0;
+  nextTimerTickUs = 0;
+  nextPeripheralUs = 0;
+  peripheralCount = 0;
+  for (uint8_t i = 0; i < HAL_PIN_COUNT; i++) {
+    pinModes[i] = INPUT;
+    outputLevels[i] = LOW;
+    inputLevels[i] = LOW;
+    inputDriven[i] = false;
+    analogValues[i] = 0;
+    writeCounts[i] = 0;
+  }
+  TCCR3A = 0;
+  TCCR3B = 0;
+  TCNT3 = 0;
+  OCR3A = 0;
+  TIFR3 = 0;
+  TIMSK3 = 0;
+  Serial.reset();
+  Serial1.reset();
+  Serial2.reset();
+  Serial3.reset();
+}
+
+// === GPIO ===
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin < HAL_PIN_COUNT) pinModes[pin] = mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  if (pin >= HAL_PIN_COUNT) return;
+  outputLevels[pin] = value ? HIGH : LOW;
+  writeCounts[pin]++;
+}
+
+int digitalRead(uint8_t pin) {
+  if (pin >= HAL_PIN_COUNT) return LOW;
+  if (pinModes[pin] == OUTPUT) return outputLevels[pin];
+  if (inputDriven[pin]) return inputLevels[pin];
+  return pinModes[pin] == INPUT_PULLUP ? HIGH : LOW; // ขาลอย: pull-up อ่านได้ HIGH
+}
+
+int analogRead(uint8_t pin) {
+  return pin < HAL_PIN_COUNT ? analogValues[pin] : 0;
+}
+
+void halSetPinInput(uint8_t pin, uint8_t level) {
+  if (pin >= HAL_PIN_COUNT) return;
+  inputLevels[pin] = level ? HIGH : LOW;
+  inputDriven[pin] = true;
+}
+
+void halSetAnalog(uint8_t pin, int value) {
+  if (pin < HAL_PIN_COUNT) analogValues[pin] = value;
+}
+
+uint8_t halPinLevel(uint8_t pin) {
+  return pin < HAL_PIN_COUNT ? outputLevels[pin] : LOW;
+}
+
+uint8_t halPinMode(uint8_t pin) {
+  return pin < HAL_PIN_COUNT ? pinModes[pin] : INPUT;
+}
+
+uint32_t halPinWriteCount(uint8_t pin) {
+  return pin < HAL_PIN_COUNT ? writeCounts[pin] : 0;
+}
+
+// === String / Print / Stream ===
+
+void String::trim() {
+  size_t first = value.find_first_not_of(" \t\r\n");
+  if (first == std::string::npos) {
+    value.clear();
+    return;
+  }
+  size_t last = value.find_last_not_of(" \t\r\n");
+  value = value.substr(first, last - first + 1);
+}
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+  size_t n = 0;
+  while (size--) {
+    n += write(*buffer++);
+  }
+  return n;
+}
+
+size_t Print::printSigned(long value, int base) {
+  if (base == DEC && value < 0) {
+    return write('-') + printNumber((unsigned long)(-value), DEC);
+  }
+  return printNumber((unsigned long)value, base);
+}
+
+size_t Print::printNumber(unsigned long value, int base) {
+  char buffer[8 * sizeof(long) + 1];
+  char* p = &buffer[sizeof(buffer) - 1];
+  *p = '\0';
+  if (base < 2) base = DEC;
+  do {
+    unsigned long digit = value % base;
+    *--p = digit < 10 ? '0' + digit : 'A' + digit - 10;
+    value /= base;
+  } while (value > 0);
+  return write(p);
+}
+
+size_t Print::print(double value, int digits) {
+  if (isnan(value)) return write("nan");
+  if (isinf(value)) return write("inf");
+  char buffer[48];
+  snprintf(buffer, sizeof(buffer), "%.*f", digits, value);
+  return write(buffer);
+}
+
+String Stream::readStringUntil(char terminator) {
+  std::string text;
+  while (available() > 0) {
+    int c = read();
+    if (c == terminator) break;
+    text += (char)c;
+  }
+  return String(text);
+}
+
+int HardwareSerial::read() {
+  if (rx.empty()) return -1;
+  uint8_t b = rx.front();
+  rx.pop_front();
+  return b;
+}
+
+size_t HardwareSerial::write(uint8_t b) {
+  if (echo) {
+    fputc(b, stdout);
+  } else {
+    tx += (char)b;
+  }
+  return 1;
+}
+
+void HardwareSerial::reset() {
+  baudRate = 0;
+  rx.clear();
+  tx.clear();
+  txRoom = 63;
+  echo = false;
+}
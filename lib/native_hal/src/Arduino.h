@@ -0,0 +1,214 @@
+#ifndef NATIVE_HAL_ARDUINO_H
+#define NATIVE_HAL_ARDUINO_H
+
+// === ARDUINO HAL SHIM (env:native) ===
+// แทน Arduino core บนเครื่อง Linux เพื่อคอมไพล์ firmware จริงและรัน unit test แบบ deterministic
+// - เวลาเป็นเวลาจำลอง เดินเฉพาะเมื่อเรียก delay() หรือ halAdvance*() (ดู native_hal.h)
+// - GPIO เก็บระดับไว้ในหน่วยความจำ, Serial0-3 เป็น buffer ในหน่วยความจำ
+// - จำลอง register ของ Timer3 เท่าที่ actuator_timer ใช้ และเรียก ISR(TIMER3_COMPA_vect) ตามคาบจริง
+// หมายเหตุ: int บน host เป็น 32 บิต (AVR เป็น 16 บิต) แต่ millis()/micros() วนรอบที่ 32 บิตเหมือนบอร์ดจริง
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <deque>
+#include <string>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+#define DEC 10
+#define HEX 16
+#define BIN 2
+
+#define SERIAL_8N1 0x06
+
+// --- PROGMEM: บน host ข้อมูลทั้งหมดอยู่ใน RAM ---
+#define PROGMEM
+#define PSTR(s) (s)
+#define pgm_read_byte(p) (*(const uint8_t*)(p))
+#define pgm_read_word(p) (*(const uint16_t*)(p))
+#define pgm_read_dword(p) (*(const uint32_t*)(p))
+#define pgm_read_ptr(p) (*(void* const*)(p))
+#define strlen_P strlen
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define memcpy_P memcpy
+#define snprintf_P snprintf
+#define vsnprintf_P vsnprintf
+
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper*>(s))
+
+// --- Interrupt: ISR ทำงานเฉพาะระหว่าง halAdvance*() จึงไม่ต้องปิดจริง ---
+#define noInterrupts() do {} while (0)
+#define interrupts() do {} while (0)
+#define ISR(vector) extern "C" void vector(void)
+
+#ifndef _BV
+#define _BV(bit) (1 << (bit))
+#endif
+
+// --- Timer3 registers (จำลอง) ---
+extern uint8_t TCCR3A;
+extern uint8_t TCCR3B;
+extern uint16_t TCNT3;
+extern uint16_t OCR3A;
+extern uint8_t TIFR3;
+extern uint8_t TIMSK3;
+#define WGM32 3
+#define CS32 2
+#define CS31 1
+#define CS30 0
+#define OCF3A 1
+#define OCIE3A 1
+
+// --- เวลา / GPIO ---
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+
+// --- Math helpers แบบเดียวกับ Arduino core ---
+using std::min;
+using std::max;
+#define constrain(x, low, high) ((x) < (low) ? (low) : ((x) > (high) ? (high) : (x)))
+#define lowByte(w) ((uint8_t)((w) & 0xFF))
+#define highByte(w) ((uint8_t)((w) >> 8))
+inline uint16_t word(uint8_t high, uint8_t low) { return (uint16_t)((high << 8) | low); }
+
+// --- String (เท่าที่ firmware ใช้) ---
+class String {
+public:
+  String(const char* text = "") : value(text ? text : "") {}
+  String(const std::string& text) : value(text) {}
+  String(const __FlashStringHelper* text) : value(reinterpret_cast<const char*>(text)) {}
+
+  unsigned int length() const { return value.size(); }
+  const char* c_str() const { return value.c_str(); }
+  char operator[](unsigned int index) const { return index < value.size() ? value[index] : 0; }
+
+  int indexOf(char c, unsigned int from = 0) const { return toIndex(value.find(c, from)); }
+  int indexOf(const String& text, unsigned int from = 0) const { return toIndex(value.find(text.value, from)); }
+  bool startsWith(const String& prefix) const { return value.compare(0, prefix.value.size(), prefix.value) == 0; }
+  String substring(unsigned int from) const { return from < value.size() ? String(value.substr(from)) : String(); }
+  String substring(unsigned int from, unsigned int to) const {
+    return from < to && from < value.size() ? String(value.substr(from, to - from)) : String();
+  }
+  long toInt() const { return atol(value.c_str()); }
+  void trim();
+
+  bool operator==(const String& other) const { return value == other.value; }
+  bool operator!=(const String& other) const { return value != other.value; }
+  String& operator+=(const String& other) { value += other.value; return *this; }
+  String& operator+=(char c) { value += c; return *this; }
+
+private:
+  static int toIndex(size_t position) { return position == std::string::npos ? -1 : (int)position; }
+  std::string value;
+};
+
+// --- Print / Stream ---
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t b) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size);
+  size_t write(const char* text) { return text ? write((const uint8_t*)text, strlen(text)) : 0; }
+  size_t write(const char* buffer, size_t size) { return write((const uint8_t*)buffer, size); }
+  virtual int availableForWrite() { return 0; }
+  virtual void flush() {}
+
+  size_t print(const __FlashStringHelper* text) { return write(reinterpret_cast<const char*>(text)); }
+  size_t print(const String& text) { return write(text.c_str()); }
+  size_t print(const char* text) { return write(text); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(unsigned char value, int base = DEC) { return printNumber(value, base); }
+  size_t print(int value, int base = DEC) { return printSigned(value, base); }
+  size_t print(unsigned int value, int base = DEC) { return printNumber(value, base); }
+  size_t print(long value, int base = DEC) { return printSigned(value, base); }
+  size_t print(unsigned long value, int base = DEC) { return printNumber(value, base); }
+  size_t print(double value, int digits = 2);
+
+  size_t println() { return write("\r\n"); }
+  template <typename T>
+  size_t println(const T& value) { size_t n = print(value); return n + println(); }
+  template <typename T>
+  size_t println(const T& value, int format) { size_t n = print(value, format); return n + println(); }
+
+private:
+  size_t printSigned(long value, int base);
+  size_t printNumber(unsigned long value, int base);
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  // ไม่มีการรอ timeout บน host: อ่านเฉพาะข้อมูลที่อยู่ใน buffer แล้ว
+  String readStringUntil(char terminator);
+};
+
+// --- HardwareSerial: buffer RX/TX ในหน่วยความจำ ---
+class HardwareSerial : public Stream {
+public:
+  explicit HardwareSerial(uint8_t portNumber) : number(portNumber) {}
+
+  void begin(unsigned long baud, uint8_t config = SERIAL_8N1) { baudRate = baud; (void)config; }
+  void end() { baudRate = 0; }
+  operator bool() const { return true; }
+
+  int available() override { return (int)rx.size(); }
+  int read() override;
+  int peek() override { return rx.empty() ? -1 : rx.front(); }
+  size_t write(uint8_t b) override;
+  using Print::write;
+  int availableForWrite() override { return txRoom; }
+  void flush() override {}
+
+  // --- ใช้จาก test / simulator ---
+  uint8_t port() const { return number; }
+  unsigned long baud() const { return baudRate; }
+  void inject(const uint8_t* data, size_t length) { rx.insert(rx.end(), data, data + length); }
+  void inject(const char* text) { inject((const uint8_t*)text, strlen(text)); }
+  const std::string& output() const { return tx; }       // ข้อมูลที่ firmware ส่งออก
+  std::string takeOutput() { std::string out; out.swap(tx); return out; }
+  void setTxRoom(int bytes) { txRoom = bytes; }           // ค่าที่ availableForWrite() คืน
+  void setEcho(bool enable) { echo = enable; }            // พิมพ์ออก stdout แทนการเก็บ
+  void reset();
+
+private:
+  uint8_t number;
+  unsigned long baudRate = 0;
+  std::deque<uint8_t> rx;
+  std::string tx;
+  int txRoom = 63;
+  bool echo = false;
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+extern HardwareSerial Serial2;
+extern HardwareSerial Serial3;
+
+void setup();
+void loop();
+
+#endif
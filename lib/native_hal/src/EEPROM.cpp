@@ -0,0 +1,62 @@
+#include "EEPROM.h"
+#include "native_hal.h"
+
+#include <string.h>
+
+EEPROMClass EEPROM;
+
+static uint8_t cells[HAL_EEPROM_SIZE];
+static uint32_t cellWrites[HAL_EEPROM_SIZE];
+static bool initialized = false;
+
+static void ensureInitialized() {
+  if (!initialized) {
+    halEepromErase();
+  }
+}
+
+uint8_t EEPROMClass::read(int index) const {
+  ensureInitialized();
+  return (index >= 0 && index < HAL_EEPROM_SIZE) ? cells[index] : 0xFF;
+}
+
+void EEPROMClass::write(int index, uint8_t value) {
+  ensureInitialized();
+  if (index >= 0 && index < HAL_EEPROM_SIZE) {
+    cells[index] = value;
+    cellWrites[index]++;
+  }
+}
+
+void EEPROMClass::update(int index, uint8_t value) {
+  if (read(index) != value) {
+    write(index, value);
+  }
+}
+
+void halEepromErase() {
+  memset(cells, 0xFF, sizeof(cells));
+  memset(cellWrites, 0, sizeof(cellWrites));
+  initialized = true;
+}
+
+void halEepromPoke(uint16_t address, uint8_t value) {
+  ensureInitialized();
+  if (address < HAL_EEPROM_SIZE) {
+    cells[address] = value;
+  }
+}
+
+uint32_t halEepromCellWrites(uint16_t address) {
+  ensureInitialized();
+  return address < HAL_EEPROM_SIZE ? cellWrites[address] : 0;
+}
+
+uint32_t halEepromTotalWrites() {
+  ensureInitialized();
+  uint32_t total = 0;
+  for (uint16_t i = 0; i < HAL_EEPROM_SIZE; i++) {
+    total += cellWrites[i];
+  }
+  return total;
+}
@@ -0,0 +1,22 @@
+#ifndef NATIVE_EEPROM_H
+#define NATIVE_EEPROM_H
+
+#include <Arduino.h>
+
+// === EEPROM จำลอง (ATmega2560: 4 KB) ===
+// API ส่วนที่ firmware ใช้จาก EEPROM.h ของ Arduino core ค่าเริ่มต้นเป็น 0xFF (ลบแล้ว)
+// เนื้อหาไม่ถูกล้างโดย halReset() เพื่อจำลองการรีบูตที่ข้อมูลยังอยู่ (ดู halEeprom* ใน native_hal.h)
+
+#define HAL_EEPROM_SIZE 4096
+
+class EEPROMClass {
+public:
+  uint8_t read(int index) const;
+  void write(int index, uint8_t value);
+  void update(int index, uint8_t value);   // เขียนเฉพาะเมื่อค่าต่างจากเดิม
+  uint16_t length() const { return HAL_EEPROM_SIZE; }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
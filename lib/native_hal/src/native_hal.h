@@ -0,0 +1,46 @@
+#ifndef NATIVE_HAL_H
+#define NATIVE_HAL_H
+
+#include <Arduino.h>
+
+// === NATIVE HAL CONTROL (ใช้จาก test เท่านั้น) ===
+// เวลาเดินทีละช่วงตามที่ test สั่ง ระหว่างทาง HAL จะ
+//   1) เรียก ISR(TIMER3_COMPA_vect) ทุกคาบของ Timer3 (คำนวณจาก OCR3A + prescaler เมื่อเปิด OCIE3A)
+//   2) เรียก peripheral ที่ลงทะเบียนไว้ (เช่น Modbus slave จำลอง) ทุก 1 ms และตอนสิ้นสุดช่วง
+
+typedef void (*HalPeripheralFn)(void* context);
+
+// ล้างเวลา GPIO Serial Timer3 และ peripheral ทั้งหมดกลับเป็นค่าเริ่มต้น (EEPROM คงเดิม)
+void halReset();
+
+// เดินเวลาจำลอง
+void halAdvanceMicros(uint32_t us);
+void halAdvanceMillis(uint32_t ms);
+
+// ตั้งเวลาปัจจุบันตรงๆ (ใช้ทดสอบการวนรอบของ millis()/micros())
+void halSetMicros(uint64_t us);
+uint64_t halNowMicros();
+
+// GPIO: ระดับขา input ที่อุปกรณ์ภายนอกขับ / ระดับและโหมดที่ firmware ตั้ง
+void halSetPinInput(uint8_t pin, uint8_t level);
+void halSetAnalog(uint8_t pin, int value);
+uint8_t halPinLevel(uint8_t pin);
+uint8_t halPinMode(uint8_t pin);
+uint32_t halPinWriteCount(uint8_t pin);   // จำนวนครั้งที่ digitalWrite() ขานี้
+
+// คาบของ Timer3 ตาม register ปัจจุบัน (0 = ปิดอยู่)
+uint32_t halTimer3PeriodMicros();
+
+// ลงทะเบียน peripheral ที่ต้องทำงานตามเวลา (สูงสุด 8 ตัว)
+bool halAttachPeripheral(HalPeripheralFn fn, void* context);
+
+// EEPROM (EEPROM.h): ไม่ถูกล้างโดย halReset() เพื่อจำลองการรีบูต
+void halEepromErase();                               // ทุกไบต์เป็น 0xFF และล้างตัวนับ
+void halEepromPoke(uint16_t address, uint8_t value);  // แก้ค่าตรงๆ โดยไม่นับเป็นการเขียน (จำลองข้อมูลเสีย)
+uint32_t halEepromCellWrites(uint16_t address);       // จำนวนครั้งที่ไบต์นี้ถูกเขียนจริง
+uint32_t halEepromTotalWrites();
+
+// วน loop() โดยเดินเวลา stepUs ต่อรอบ จนครบ durationMs (test เรียก setup() เองก่อน)
+void halRunLoop(uint32_t durationMs, uint32_t stepUs = 100);
+
+#endif
@@ -0,0 +1,156 @@
+#include "sim_modbus.h"
+#include "native_hal.h"
+
+static void serviceBus(void* context) {
+  static_cast<SimModbusBus*>(context)->service();
+}
+
+void SimModbusBus::attach(HardwareSerial& serial) {
+  port = &serial;
+  slaveCount = 0;
+  requestLength = 0;
+  pendingLength = 0;
+  rejected = 0;
+  halAttachPeripheral(serviceBus, this);
+}
+
+SimModbusSlave* SimModbusBus::addSlave(uint8_t id) {
+  if (slaveCount >= SIM_MODBUS_MAX_SLAVES) {
+    return nullptr;
+  }
+  SimModbusSlave* s = &slaves[slaveCount++];
+  memset(s, 0, sizeof(*s));
+  s->id = id;
+  s->online = true;
+  s->latencyMs = 10;
+  return s;
+}
+
+SimModbusSlave* SimModbusBus::slave(uint8_t id) {
+  for (uint8_t i = 0; i < slaveCount; i++) {
+    if (slaves[i].id == id) return &slaves[i];
+  }
+  return nullptr;
+}
+
+uint16_t SimModbusBus::crc(const uint8_t* data, size_t length) {
+  uint16_t value = 0xFFFF;
+  for (size_t i = 0; i < length; i++) {
+    value ^= data[i];
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      value = (value & 1) ? (value >> 1) ^ 0xA001 : value >> 1;
+    }
+  }
+  return value;
+}
+
+void SimModbusBus::service() {
+  if (port == nullptr) {
+    return;
+  }
+
+  // ส่งคำตอบที่ถึงเวลาแล้วเข้า RX ของ master
+  if (pendingLength > 0 && halNowMicros() >= pendingAtUs) {
+    port->inject(pending, pendingLength);
+    pendingLength = 0;
+  }
+
+  // รับคำขอจาก TX ของ master (อ่าน register ยาว 8 ไบต์, คำสั่ง 0x42 ยาว 4 ไบต์)
+  std::string out = port->takeOutput();
+  for (size_t i = 0; i < out.size(); i++) {
+    request[requestLength++] = (uint8_t)out[i];
+    if (requestLength == 4 && request[1] == SIM_MODBUS_RESET_ENERGY) {
+      handleResetEnergy(request);
+      requestLength = 0;
+    } else if (requestLength == sizeof(request)) {
+      handleRequest(request);
+      requestLength = 0;
+    }
+  }
+}
+
+void SimModbusBus::handleRequest(const uint8_t* frame) {
+  uint16_t expected = crc(frame, 6);
+  if (frame[6] != lowByte(expected) || frame[7] != highByte(expected)) {
+    rejected++;
+    return;
+  }
+
+  SimModbusSlave* s = slave(frame[0]);
+  if (s == nullptr || !s->online) {
+    return; // ไม่มีใครตอบ
+  }
+  s->requests++;
+
+  uint8_t function = frame[1];
+  uint16_t address = word(frame[2], frame[3]);
+  uint16_t quantity = word(frame[4], frame[5]);
+
+  uint8_t response[sizeof(pending)];
+  size_t length = 0;
+  response[length++] = s->id;
+
+  uint8_t exception = s->exceptionCode;
+  if (exception == 0 && function != 0x03 && function != 0x04) {
+    exception = 0x01; // illegal function
+  }
+  if (exception == 0 && (quantity == 0 || address + quantity > SIM_MODBUS_REGISTERS)) {
+    exception = 0x02; // illegal data address
+  }
+
+  if (exception != 0) {
+    response[length++] = function | 0x80;
+    response[length++] = exception;
+  } else {
+    const uint16_t* table = (function == 0x03) ? s->holding : s->input;
+    response[length++] = function;
+    response[length++] = quantity * 2;
+    for (uint16_t i = 0; i < quantity; i++) {
+      response[length++] = highByte(table[address + i]);
+      response[length++] = lowByte(table[address + i]);
+    }
+  }
+
+  uint16_t value = crc(response, length);
+  response[length++] = lowByte(value);
+  response[length++] = highByte(value);
+  if (s->corruptNext > 0) {
+    s->corruptNext--;
+    response[length - 1] ^= 0xFF;
+  }
+
+  queueResponse(response, length, s->latencyMs, sizeof(request));
+}
+
+void SimModbusBus::handleResetEnergy(const uint8_t* frame) {
+  uint16_t expected = crc(frame, 2);
+  if (frame[2] != lowByte(expected) || frame[3] != highByte(expected)) {
+    rejected++;
+    return;
+  }
+
+  SimModbusSlave* s = slave(frame[0]);
+  if (s == nullptr || !s->online) {
+    return;
+  }
+  s->requests++;
+  s->energyResets++;
+  s->input[5] = 0;   // energy Wh (low word)
+  s->input[6] = 0;   // energy Wh (high word)
+
+  uint8_t response[4];
+  memcpy(response, frame, sizeof(response));
+  if (s->corruptNext > 0) {
+    s->corruptNext--;
+    response[3] ^= 0xFF;
+  }
+  queueResponse(response, sizeof(response), s->latencyMs, sizeof(response));
+}
+
+void SimModbusBus::queueResponse(const uint8_t* frame, size_t length, uint16_t latencyMs, size_t requestBytes) {
+  // คำตอบมาถึงครบหลังคำขอส่งจบ + latency + เวลาส่งคำตอบบนสาย (11 บิตต่อไบต์)
+  uint32_t wireUs = port->baud() > 0 ? (uint32_t)((length + requestBytes) * 11000000ULL / port->baud()) : 0;
+  memcpy(pending, frame, length);
+  pendingLength = length;
+  pendingAtUs = halNowMicros() + (uint64_t)latencyMs * 1000 + wireUs;
+}
@@ -0,0 +1,58 @@
+#ifndef SIM_MODBUS_H
+#define SIM_MODBUS_H
+
+#include <Arduino.h>
+
+// === SIMULATED MODBUS RTU SLAVES ===
+// ต่อกับ HardwareSerial จำลอง: อ่านคำขอที่ firmware เขียนออก TX แล้วตอบกลับเข้า RX
+// หลังจากเวลาส่งบนสาย + latency ของ slave รองรับ function 0x03 / 0x04
+// และ 0x42 ของ PZEM-004T (reset energy: ล้าง input register 5-6 แล้วตอบ echo 4 ไบต์)
+// ใช้ CRC แบบ bitwise ของตัวเอง (ไม่ใช้ crc16.cpp) เพื่อไม่ให้บั๊กเดียวกันซ่อนกันเอง
+
+#define SIM_MODBUS_MAX_SLAVES 8
+#define SIM_MODBUS_REGISTERS 32
+#define SIM_MODBUS_RESET_ENERGY 0x42
+
+struct SimModbusSlave {
+  uint8_t id;
+  bool online;                              // false = ไม่ตอบ (ให้ master timeout)
+  uint16_t latencyMs;                       // เวลาที่ slave ใช้ก่อนเริ่มตอบ
+  uint16_t holding[SIM_MODBUS_REGISTERS];   // function 0x03
+  uint16_t input[SIM_MODBUS_REGISTERS];     // function 0x04
+  uint8_t exceptionCode;                    // != 0 ตอบ exception แทนข้อมูล
+  uint8_t corruptNext;                      // จำนวนคำตอบถัดไปที่จะส่ง CRC ผิด
+  uint32_t requests;                        // คำขอที่ได้รับ (CRC ถูกต้อง)
+  uint32_t energyResets;                    // คำสั่ง 0x42 ที่ได้รับ
+};
+
+class SimModbusBus {
+public:
+  // ผูกกับพอร์ต (เช่น Serial1) และลงทะเบียนกับ HAL ให้ทำงานตามเวลา
+  void attach(HardwareSerial& serial);
+
+  // เพิ่ม slave ใหม่ (ค่าเริ่มต้น online, latency 10 ms, register เป็น 0)
+  SimModbusSlave* addSlave(uint8_t id);
+  SimModbusSlave* slave(uint8_t id);
+
+  uint32_t badFrames() const { return rejected; }   // คำขอที่ CRC/รูปแบบผิด
+  void service();
+
+  static uint16_t crc(const uint8_t* data, size_t length);
+
+private:
+  void handleRequest(const uint8_t* frame);
+  void handleResetEnergy(const uint8_t* frame);
+  void queueResponse(const uint8_t* frame, size_t length, uint16_t latencyMs, size_t requestBytes);
+
+  HardwareSerial* port = nullptr;
+  SimModbusSlave slaves[SIM_MODBUS_MAX_SLAVES];
+  uint8_t slaveCount = 0;
+  uint8_t request[8];
+  uint8_t requestLength = 0;
+  uint32_t rejected = 0;
+  uint8_t pending[3 + SIM_MODBUS_REGISTERS * 2 + 2];
+  uint8_t pendingLength = 0;
+  uint64_t pendingAtUs = 0;
+};
+
+#endif
@@ -0,0 +1,251 @@
+#include "actuator_timer.h"
+
+#define ACTUATOR_EVENT_QUEUE 16   // ต้องเป็นกำลังของ 2 (ทุกช่องสลับใน tick เดียวกันได้)
+
+enum ActuatorMode : uint8_t { MODE_IDLE, MODE_PULSE, MODE_CYCLE };
+
+struct ActuatorSlotState {
+  ActuatorMode mode;
+  bool state;
+  bool capped;               // มีเพดานเวลาทำงานรวม
+  uint32_t dueTick;          // tick ที่ช่วงปัจจุบันจบ
+  uint32_t stopTick;         // tick ที่ถึงเพดาน (ใช้เมื่อ capped)
+  uint32_t periodMs;         // ความยาวช่วงปัจจุบัน
+  uint32_t onMs;
+  uint32_t offMs;
+  uint32_t maxRunMs;
+  uint32_t phaseStartMillis; // millis() ตอนเริ่มช่วงปัจจุบัน
+  uint32_t runStartMillis;   // millis() ตอนเริ่มงาน
+};
+
+static ActuatorSlotState slots[ACTUATOR_SLOT_COUNT];
+static volatile uint32_t tickCount = 0;
+static volatile uint8_t activeMask = 0;   // bit i = slots[i] ทำงาน
+static uint32_t nextDueTick = 0;          // deadline ที่ใกล้ที่สุดของทุกช่องที่ทำงาน
+
+static ActuatorEvent events[ACTUATOR_EVENT_QUEUE];
+static volatile uint8_t eventHead = 0;
+static volatile uint8_t eventTail = 0;
+
+// ช่วงเวลายาวสุดที่เทียบ tick แบบวนรอบได้ถูกต้อง (~24 วัน)
+static inline uint32_t clampMs(uint32_t ms) {
+  return ms > 0x7FFFFFFFUL ? 0x7FFFFFFFUL : ms;
+}
+
+// true ถ้า tick a มาก่อน b (รองรับ tickCount วนรอบ)
+static inline bool tickBefore(uint32_t a, uint32_t b) {
+  return (int32_t)(a - b) < 0;
+}
+
+// tick ถัดไปที่ช่องนี้ต้องทำอะไรสักอย่าง
+static inline uint32_t slotDeadline(const ActuatorSlotState& s) {
+  return (s.capped && tickBefore(s.stopTick, s.dueTick)) ? s.stopTick : s.dueTick;
+}
+
+// คำนวณ deadline ที่ใกล้ที่สุดใหม่ (เรียกขณะปิด interrupt, เฉพาะตอนตารางเปลี่ยน)
+static void updateNextDue() {
+  bool first = true;
+  for (uint8_t i = 0; i < ACTUATOR_SLOT_COUNT; i++) {
+    if (!(activeMask & (1 << i))) {
+      continue;
+    }
+    uint32_t due = slotDeadline(slots[i]);
+    if (first || tickBefore(due, nextDueTick)) {
+      nextDueTick = due;
+      first = false;
+    }
+  }
+}
+
+// สั่ง relay ผ่าน relay driver (เรียกจาก ISR หรือขณะปิด interrupt)
+static void writeRelay(uint8_t relay, bool on) {
+  relaySet(relay, on);
+  slots[relay].state = on;
+}
+
+static void releaseSlot(uint8_t relay) {
+  slots[relay].mode = MODE_IDLE;
+  activeMask &= ~(1 << relay);
+}
+
+static void pushEvent(uint8_t relay, uint8_t kind, bool state, uint32_t elapsedMs, uint32_t targetMs) {
+  uint8_t next = (eventHead + 1) & (ACTUATOR_EVENT_QUEUE - 1);
+  if (next == eventTail) {
+    return; // คิวเต็ม: relay ถูกสั่งแล้ว แค่ไม่มีรายงาน
+  }
+  events[eventHead].relay = relay;
+  events[eventHead].kind = kind;
+  events[eventHead].state = state;
+  events[eventHead].elapsedMs = elapsedMs;
+  events[eventHead].targetMs = targetMs;
+  eventHead = next;
+}
+
+// จัดการช่องที่ครบกำหนดใน tick นี้
+static void serviceSlot(uint8_t relay, uint32_t tick, uint32_t now) {
+  ActuatorSlotState& s = slots[relay];
+
+  if (s.capped && !tickBefore(tick, s.stopTick)) {
+    writeRelay(relay, false);
+    releaseSlot(relay);
+    pushEvent(relay, ACTUATOR_MAX_RUN, false, now - s.runStartMillis, s.maxRunMs);
+    return;
+  }
+  if (tickBefore(tick, s.dueTick)) {
+    return;
+  }
+
+  uint32_t elapsed = now - s.phaseStartMillis;
+  uint32_t target = s.periodMs;
+
+  if (s.mode == MODE_PULSE) {
+    writeRelay(relay, false);
+    releaseSlot(relay);
+    pushEvent(relay, ACTUATOR_PULSE_END, false, elapsed, target);
+  } else {
+    writeRelay(relay, !s.state);
+    s.periodMs = s.state ? s.onMs : s.offMs;
+    s.dueTick += s.periodMs;   // ต่อจาก deadline เดิม ไม่สะสมความคลาดเคลื่อน
+    s.phaseStartMillis = now;
+    pushEvent(relay, ACTUATOR_CYCLE_SWITCH, s.state, elapsed, target);
+  }
+}
+
+void actuatorTimerTick() {
+  uint32_t tick = ++tickCount;
+  if (activeMask == 0 || tickBefore(tick, nextDueTick)) {
+    return; // ทางปกติ: ไม่มีช่องไหนครบกำหนด
+  }
+
+  uint32_t now = millis();
+  for (uint8_t i = 0; i < ACTUATOR_SLOT_COUNT; i++) {
+    if (activeMask & (1 << i)) {
+      serviceSlot(i, tick, now);
+    }
+  }
+  updateNextDue();
+}
+
+void actuatorTimerBegin() {
+  noInterrupts();
+  for (uint8_t i = 0; i < ACTUATOR_SLOT_COUNT; i++) {
+    slots[i].mode = MODE_IDLE;
+  }
+  activeMask = 0;
+  interrupts();
+
+#if defined(ARDUINO_ARCH_AVR) || defined(NATIVE_HAL)
+  // Timer3: CTC, prescaler 64 -> 250 kHz, OCR3A = 249 -> interrupt ทุก 1 ms (native HAL จำลอง register ชุดนี้)
+  noInterrupts();
+  TCCR3A = 0;
+  TCCR3B = _BV(WGM32) | _BV(CS31) | _BV(CS30);
+  TCNT3 = 0;
+  OCR3A = 249;
+  TIFR3 = _BV(OCF3A);
+  TIMSK3 = _BV(OCIE3A);
+  interrupts();
+#endif
+}
+
+// เตรียมช่องให้เริ่มงานใหม่ที่ tick ปัจจุบัน (เรียกขณะปิด interrupt)
+static void armSlot(uint8_t relay, ActuatorMode mode, uint32_t periodMs, uint32_t maxRunMs) {
+  ActuatorSlotState& s = slots[relay];
+  uint32_t now = millis();
+  s.mode = mode;
+  s.periodMs = periodMs;
+  s.dueTick = tickCount + periodMs;
+  s.maxRunMs = maxRunMs;
+  s.capped = (maxRunMs > 0);
+  s.stopTick = tickCount + maxRunMs;
+  s.phaseStartMillis = now;
+  s.runStartMillis = now;
+  activeMask |= (1 << relay);
+  updateNextDue();
+}
+
+void actuatorStartPulse(uint8_t relay, uint32_t durationMs) {
+  if (relay >= ACTUATOR_SLOT_COUNT) {
+    return;
+  }
+  if (durationMs == 0) {
+    actuatorStop(relay);
+    return;
+  }
+
+  noInterrupts();
+  armSlot(relay, MODE_PULSE, clampMs(durationMs), 0);
+  writeRelay(relay, true);
+  interrupts();
+}
+
+void actuatorStartCycle(uint8_t relay, uint32_t onMs, uint32_t offMs, uint32_t maxRunMs) {
+  if (relay >= ACTUATOR_SLOT_COUNT) {
+    return;
+  }
+
+  noInterrupts();
+  ActuatorSlotState& s = slots[relay];
+  s.onMs = onMs > 0 ? clampMs(onMs) : 1;
+  s.offMs = offMs > 0 ? clampMs(offMs) : 1;
+  armSlot(relay, MODE_CYCLE, s.offMs, clampMs(maxRunMs));
+  writeRelay(relay, false); // เริ่มด้วยช่วง OFF
+  interrupts();
+}
+
+void actuatorStop(uint8_t relay) {
+  if (relay >= ACTUATOR_SLOT_COUNT) {
+    return;
+  }
+
+  noInterrupts();
+  if (slots[relay].mode != MODE_IDLE) {
+    writeRelay(relay, false);
+    releaseSlot(relay);
+    updateNextDue();
+  }
+  interrupts();
+}
+
+bool actuatorActive(uint8_t relay) {
+  return relay < ACTUATOR_SLOT_COUNT && (activeMask & (1 << relay));
+}
+
+uint8_t actuatorActiveMask() {
+  return activeMask;
+}
+
+bool actuatorProgress(uint8_t relay, uint32_t& elapsedMs, uint32_t& targetMs) {
+  if (!actuatorActive(relay)) {
+    return false;
+  }
+  noInterrupts();
+  elapsedMs = millis() - slots[relay].phaseStartMillis;
+  targetMs = slots[relay].periodMs;
+  interrupts();
+  return true;
+}
+
+bool actuatorCycleConfig(uint8_t relay, uint32_t& onMs, uint32_t& offMs, uint32_t& maxRunMs) {
+  if (!actuatorActive(relay)) {
+    return false;
+  }
+  noInterrupts();
+  const ActuatorSlotState& s = slots[relay];
+  bool cycle = (s.mode == MODE_CYCLE);
+  onMs = s.onMs;
+  offMs = s.offMs;
+  maxRunMs = s.maxRunMs;
+  interrupts();
+  return cycle;
+}
+
+bool actuatorPopEvent(ActuatorEvent& event) {
+  if (eventTail == eventHead) {
+    return false;
+  }
+  noInterrupts();
+  event = events[eventTail];
+  eventTail = (eventTail + 1) & (ACTUATOR_EVENT_QUEUE - 1);
+  interrupts();
+  return true;
+}
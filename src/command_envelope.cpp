@@ -0,0 +1,106 @@
+#include "command_envelope.h"
+#include "command_parser.h"
+#include "crc16.h"
+
+uint16_t commandEnvelopeChecksum(const char* text, size_t length) {
+  return modbusCrc16((const uint8_t*)text, length);
+}
+
+static bool parseHex16(const char* text, uint16_t& out) {
+  if (strlen(text) != 4) {
+    return false;
+  }
+  out = 0;
+  for (uint8_t i = 0; i < 4; i++) {
+    char c = text[i];
+    uint8_t digit;
+    if (c >= '0' && c <= '9') {
+      digit = c - '0';
+    } else if (c >= 'A' && c <= 'F') {
+      digit = c - 'A' + 10;
+    } else if (c >= 'a' && c <= 'f') {
+      digit = c - 'a' + 10;
+    } else {
+      return false;
+    }
+    out = (out << 4) | digit;
+  }
+  return true;
+}
+
+EnvelopeStatus parseCommandEnvelope(char* line, CommandEnvelope& envelope) {
+  envelope.sequence = 0;
+  envelope.checksum = 0;
+  envelope.count = 0;
+  if (line[0] != '#') {
+    return ENVELOPE_BAD_FORMAT;
+  }
+
+  char* body = line + 1;
+  char* star = strrchr(body, '*');
+  char* colon = strchr(body, ':');
+  if (star == nullptr || colon == nullptr || colon > star) {
+    return ENVELOPE_BAD_FORMAT;
+  }
+
+  // seq ก่อน (ใช้ตอบ CMD_NAK แม้ checksum ไม่ผ่าน)
+  *colon = '\0';
+  int32_t sequence;
+  bool sequenceOk = parseInt32(body, sequence) && sequence >= 1 && sequence <= 65535;
+  *colon = ':';
+  if (sequenceOk) {
+    envelope.sequence = (uint16_t)sequence;
+  }
+
+  uint16_t checksum;
+  if (!parseHex16(star + 1, checksum)) {
+    return ENVELOPE_BAD_FORMAT;
+  }
+  envelope.checksum = checksum;
+  if (commandEnvelopeChecksum(body, star - body) != checksum) {
+    return ENVELOPE_BAD_CHECKSUM;
+  }
+  if (!sequenceOk) {
+    return ENVELOPE_BAD_FORMAT;
+  }
+
+  *star = '\0';
+  char* command = colon + 1;
+  while (true) {
+    char* separator = strchr(command, ';');
+    if (separator != nullptr) {
+      *separator = '\0';
+    }
+    if (*command == '\0') {
+      return ENVELOPE_BAD_FORMAT;
+    }
+    if (envelope.count == COMMAND_BATCH_MAX) {
+      return ENVELOPE_TOO_MANY;
+    }
+    envelope.commands[envelope.count++] = command;
+    if (separator == nullptr) {
+      break;
+    }
+    command = separator + 1;
+  }
+  return ENVELOPE_OK;
+}
+
+bool EnvelopeHistory::find(uint16_t sequence, uint16_t checksum, uint8_t& count) const {
+  for (uint8_t i = 0; i < COMMAND_DEDUP_SLOTS; i++) {
+    if (entries[i].sequence == sequence && entries[i].checksum == checksum) {
+      count = entries[i].count;
+      return true;
+    }
+  }
+  return false;
+}
+
+void EnvelopeHistory::remember(uint16_t sequence, uint16_t checksum, uint8_t count) {
+  // แทนที่ช่องเก่าสุด (seq เดิมที่ crc ต่างก็ถูกเก็บเพิ่ม ช่องเก่าจะหลุดไปเอง)
+  Entry& entry = entries[next];
+  entry.sequence = sequence;
+  entry.checksum = checksum;
+  entry.count = count;
+  next = (next + 1) % COMMAND_DEDUP_SLOTS;
+}
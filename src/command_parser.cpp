@@ -0,0 +1,138 @@
+#include "command_parser.h"
+
+bool LineAssembler::feed(char c) {
+  if (lineReady) {
+    // บรรทัดก่อนหน้าถูกใช้ไปแล้ว เริ่มบรรทัดใหม่
+    lineReady = false;
+    lineLength = 0;
+  }
+
+  if (c == '\n') {
+    if (discarding) {
+      discarding = false;
+      lineLength = 0;
+      return false;
+    }
+    // ตัดช่องว่างท้ายบรรทัด
+    while (lineLength > 0 && buffer[lineLength - 1] == ' ') {
+      lineLength--;
+    }
+    buffer[lineLength] = '\0';
+    if (lineLength == 0) {
+      return false; // ข้ามบรรทัดว่าง
+    }
+    lineReady = true;
+    return true;
+  }
+
+  if (c == '\r' || discarding) {
+    return false;
+  }
+  if ((c == ' ' || c == '\t') && lineLength == 0) {
+    return false; // ตัดช่องว่างหน้าบรรทัด
+  }
+  if (c == '\t') {
+    c = ' ';
+  }
+
+  if (lineLength >= COMMAND_LINE_MAX) {
+    discarding = true;
+    overflows++;
+    return false;
+  }
+  buffer[lineLength++] = c;
+  return false;
+}
+
+bool parseInt32(const char* text, int32_t& out) {
+  bool negative = false;
+  if (*text == '-') {
+    negative = true;
+    text++;
+  }
+  if (*text == '\0') {
+    return false;
+  }
+
+  // avr-libc ประกาศ INT32_MAX ให้ C++ เฉพาะเมื่อมี __STDC_LIMIT_MACROS
+  const int32_t highest = 2147483647L;
+  int32_t result = 0;
+  while (*text != '\0') {
+    if (*text < '0' || *text > '9') {
+      return false;
+    }
+    int32_t digit = *text - '0';
+    if (result > (highest - digit) / 10) {
+      return false;   // เกิน int32 (ไม่ปล่อยให้ล้นแล้วกลายเป็นค่าอื่นที่ผ่านการตรวจช่วง)
+    }
+    result = result * 10 + digit;
+    text++;
+  }
+  out = negative ? -result : result;
+  return true;
+}
+
+// แยก token คั่นด้วย ',' และแปลงเป็นตัวเลขล่วงหน้า
+static void splitArgs(char* text, CommandArgs& args) {
+  args.count = 0;
+  args.numericMask = 0;
+  if (*text == '\0') {
+    return;
+  }
+
+  while (args.count < COMMAND_MAX_ARGS) {
+    uint8_t i = args.count++;
+    args.text[i] = text;
+
+    char* comma = strchr(text, ',');
+    if (comma != nullptr) {
+      *comma = '\0';
+    }
+    if (parseInt32(text, args.value[i])) {
+      args.numericMask |= (1 << i);
+    } else {
+      args.value[i] = 0;
+    }
+
+    if (comma == nullptr) {
+      break;
+    }
+    text = comma + 1;
+  }
+}
+
+DispatchResult matchCommand(char* line, const CommandEntry* table, uint8_t tableSize,
+                            CommandEntry& entry, CommandArgs& args) {
+  for (uint8_t i = 0; i < tableSize; i++) {
+    memcpy_P(&entry, &table[i], sizeof(entry));
+
+    size_t keywordLength = strlen_P(entry.keyword);
+    if (strncmp_P(line, entry.keyword, keywordLength) != 0) {
+      continue;
+    }
+    if (entry.match == CMD_EXACT && line[keywordLength] != '\0') {
+      continue;
+    }
+
+    splitArgs(line + keywordLength, args);
+
+    if (entry.argCount != CMD_ANY_ARGS && args.count != entry.argCount) {
+      return DISPATCH_BAD_ARGS;
+    }
+    if ((args.numericMask & entry.numericArgs) != entry.numericArgs) {
+      return DISPATCH_BAD_ARGS;
+    }
+    return DISPATCH_OK;
+  }
+  return DISPATCH_UNKNOWN;
+}
+
+DispatchResult dispatchCommand(char* line, const CommandEntry* table, uint8_t tableSize) {
+  CommandEntry entry;
+  CommandArgs args;
+  DispatchResult result = matchCommand(line, table, tableSize, entry, args);
+  if (result == DISPATCH_OK) {
+    entry.handler(args);
+  }
+  return result;
+}
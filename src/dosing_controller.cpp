@@ -0,0 +1,164 @@
+#include "dosing_controller.h"
+
+bool DosingController::valid(const DosingConfig& config) {
+  return config.setpoint > 0 && config.setpoint <= 65535L && config.gain > 0 &&
+         config.mixDelayMs >= 1000UL && config.mixDelayMs <= DOSING_MIX_MAX_SECONDS * 1000UL &&
+         config.maxPulseMs > 0 && config.maxPulseMs <= DOSING_PULSE_MAX_MS &&
+         config.maxPerHourMs > 0 && config.maxPerHourMs <= DOSING_HOUR_MAX_MS;
+}
+
+void DosingController::configure(const DosingConfig& config) {
+  settings = config;
+  // ให้รายงานสถานะเทียบกับค่าตั้งใหม่อีกครั้ง
+  settled = false;
+  limited = false;
+}
+
+void DosingController::enable(bool on, uint32_t nowMs) {
+  if (!on) {
+    current = DOSING_OFF;
+    return;
+  }
+  current = DOSING_WAIT;
+  readyAtMs = nowMs;
+  sampleReady = false;
+  lastDoseMs = 0;
+  noResponse = 0;
+  settled = false;
+  limited = false;
+}
+
+void DosingController::sample(int32_t value, uint32_t nowMs) {
+  lastValue = value;
+  if (current == DOSING_WAIT && (int32_t)(nowMs - readyAtMs) >= 0) {
+    sampleReady = true;
+  }
+}
+
+uint32_t DosingController::poll(uint32_t nowMs, bool pumpBusy) {
+  if (current == DOSING_PULSE) {
+    // ปั๊มหยุดแล้ว (ครบเวลา หรือถูกหยุดด้วย TIMER_STOP/PUMP_TIMING:...,0): เริ่มนับเวลาผสม
+    if (!pumpBusy) {
+      current = DOSING_WAIT;
+      readyAtMs = nowMs + settings.mixDelayMs;
+      sampleReady = false;
+    }
+    return 0;
+  }
+  if (current != DOSING_WAIT || !sampleReady) {
+    return 0;
+  }
+  sampleReady = false;
+  return decide(nowMs, pumpBusy);
+}
+
+uint32_t DosingController::decide(uint32_t nowMs, bool pumpBusy) {
+  int32_t value = lastValue;
+
+  // ผลของการเติมครั้งก่อน
+  if (lastDoseMs > 0) {
+    int32_t moved = settings.raises ? value - valueBeforeDose : valueBeforeDose - value;
+    emit(DOSE_STEP_RESULT, value, valueBeforeDose, lastDoseMs);
+    lastDoseMs = 0;
+    noResponse = moved > 0 ? 0 : noResponse + 1;
+    if (noResponse >= DOSING_NO_RESPONSE_LIMIT) {
+      current = DOSING_FAULT;
+      emit(DOSE_STEP_FAULT, value, settings.setpoint, noResponse);
+      return 0;
+    }
+  }
+
+  int32_t error = settings.raises ? settings.setpoint - value : value - settings.setpoint;
+  if (error <= (int32_t)settings.deadband) {
+    if (!settled) {
+      emit(DOSE_STEP_SETTLED, value, settings.setpoint, 0);
+    }
+    settled = true;
+    limited = false;
+    return 0;
+  }
+  settled = false;
+
+  // ESP32 สั่งปั๊มตัวเดียวกันอยู่: ไม่ซ้อน รอตัดสินใหม่จากค่าถัดไป
+  if (pumpBusy) {
+    return 0;
+  }
+
+  uint32_t used = usedThisHourMs(nowMs);
+  if (used >= settings.maxPerHourMs) {
+    if (!limited) {
+      emit(DOSE_STEP_LIMIT, value, settings.setpoint, used);
+    }
+    limited = true;
+    return 0;
+  }
+  limited = false;
+
+  // error และ gain ไม่เกิน 16 บิต ผลคูณจึงไม่ล้น uint32
+  uint32_t scaledError = error > 65535L ? 65535UL : (uint32_t)error;
+  uint32_t dose = scaledError * settings.gain / 100;
+  if (dose > settings.maxPulseMs) dose = settings.maxPulseMs;
+  if (dose > settings.maxPerHourMs - used) dose = settings.maxPerHourMs - used;
+  if (dose == 0) {
+    return 0;
+  }
+
+  budgetMs[budgetSlot % DOSING_BUDGET_SLOTS] += dose;
+  totalMs += dose;
+  doseCount++;
+  valueBeforeDose = value;
+  lastDoseMs = dose;
+  current = DOSING_PULSE;
+  emit(DOSE_STEP_PULSE, value, settings.setpoint, dose);
+  return dose;
+}
+
+void DosingController::rollBudget(uint32_t nowMs) {
+  uint32_t slot = nowMs / DOSING_BUDGET_SLOT_MS;
+  if (slot == budgetSlot) {
+    return;
+  }
+  // ข้ามเกินหนึ่งชั่วโมง หรือ millis() ล้น: ล้างทั้งหมด
+  if (slot < budgetSlot || slot - budgetSlot >= DOSING_BUDGET_SLOTS) {
+    memset(budgetMs, 0, sizeof(budgetMs));
+  } else {
+    for (uint32_t i = budgetSlot + 1; i <= slot; i++) {
+      budgetMs[i % DOSING_BUDGET_SLOTS] = 0;
+    }
+  }
+  budgetSlot = slot;
+}
+
+uint32_t DosingController::usedThisHourMs(uint32_t nowMs) {
+  rollBudget(nowMs);
+  uint32_t used = 0;
+  for (uint8_t i = 0; i < DOSING_BUDGET_SLOTS; i++) {
+    used += budgetMs[i];
+  }
+  return used;
+}
+
+void DosingController::emit(uint8_t step, int32_t value, int32_t reference, uint32_t amount) {
+  if (eventCount == DOSING_EVENT_SLOTS) {
+    // ผู้เรียกดึงทุกรอบ loop จึงไม่ควรเต็ม ถ้าเต็มทิ้งตัวเก่าสุด (ขั้นล่าสุดสำคัญกว่า)
+    eventHead = (eventHead + 1) % DOSING_EVENT_SLOTS;
+    eventCount--;
+  }
+  DoseEvent& event = events[(eventHead + eventCount) % DOSING_EVENT_SLOTS];
+  event.channel = eventChannel;
+  event.step = step;
+  event.value = value;
+  event.reference = reference;
+  event.amount = amount;
+  eventCount++;
+}
+
+bool DosingController::popEvent(DoseEvent& event) {
+  if (eventCount == 0) {
+    return false;
+  }
+  event = events[eventHead];
+  eventHead = (eventHead + 1) % DOSING_EVENT_SLOTS;
+  eventCount--;
+  return true;
+}
@@ -0,0 +1,60 @@
+#include "flow_counter.h"
+
+static volatile uint32_t pulseCounts[FLOW_CHANNELS];
+static uint8_t lastLevels = 0;   // bit i = ระดับล่าสุดของช่อง i
+static uint8_t flowPins[FLOW_CHANNELS];
+#ifdef ARDUINO_ARCH_AVR
+static volatile uint8_t* inputRegs[FLOW_CHANNELS];
+static uint8_t inputBits[FLOW_CHANNELS];
+#endif
+
+static inline bool readLevel(uint8_t channel) {
+#ifdef ARDUINO_ARCH_AVR
+  return (*inputRegs[channel] & inputBits[channel]) != 0;
+#else
+  return digitalRead(flowPins[channel]) == HIGH;
+#endif
+}
+
+void flowCounterBegin(const uint8_t* pins) {
+  noInterrupts();
+  lastLevels = 0;
+  for (uint8_t i = 0; i < FLOW_CHANNELS; i++) {
+    flowPins[i] = pins[i];
+    pinMode(pins[i], INPUT_PULLUP);
+#ifdef ARDUINO_ARCH_AVR
+    inputRegs[i] = portInputRegister(digitalPinToPort(pins[i]));
+    inputBits[i] = digitalPinToBitMask(pins[i]);
+#endif
+    pulseCounts[i] = 0;
+    if (readLevel(i)) {
+      lastLevels |= (1 << i);
+    }
+  }
+  interrupts();
+}
+
+void flowCounterSample() {
+  for (uint8_t i = 0; i < FLOW_CHANNELS; i++) {
+    uint8_t mask = (1 << i);
+    bool level = readLevel(i);
+    // นับเฉพาะขอบขาลง (HIGH -> LOW) เหมือนวิธีเดิม
+    if ((lastLevels & mask) && !level) {
+      pulseCounts[i]++;
+    }
+    if (level) {
+      lastLevels |= mask;
+    } else {
+      lastLevels &= ~mask;
+    }
+  }
+}
+
+void flowCounterSnapshot(FlowSnapshot& snapshot) {
+  noInterrupts();
+  for (uint8_t i = 0; i < FLOW_CHANNELS; i++) {
+    snapshot.pulses[i] = pulseCounts[i];
+  }
+  snapshot.timeMs = millis();
+  interrupts();
+}
@@ -0,0 +1,72 @@
+#include "link_monitor.h"
+
+static_assert(LINK_LOSS_WINDOW <= 16, "lossHistory is 16 bits");
+
+void LinkMonitor::begin(uint32_t nowMs) {
+  *this = LinkMonitor();
+  lastFrameMs = nowMs;
+}
+
+void LinkMonitor::probeSent(uint32_t nowMs) {
+  if (pending) {
+    recordResult(true);
+  }
+  pending = true;
+  probeSentMs = nowMs;
+  sent++;
+}
+
+void LinkMonitor::probeAnswered(uint32_t nowMs) {
+  frameReceived(nowMs);
+  if (!pending) {
+    return;
+  }
+  pending = false;
+  uint32_t rtt = nowMs - probeSentMs;
+  rttLast = rtt > 65535UL ? 65535 : (uint16_t)rtt;
+  if (rttLast > rttMax) {
+    rttMax = rttLast;
+  }
+  // EWMA: avg += (rtt - avg) / 8 (ค่าแรกใช้ rtt ตรงๆ)
+  rttAverageX8 = answered == 0 ? (uint32_t)rttLast * 8 : rttAverageX8 - rttAverageX8 / 8 + rttLast;
+  answered++;
+  recordResult(false);
+}
+
+void LinkMonitor::frameReceived(uint32_t nowMs) {
+  lastFrameMs = nowMs;
+}
+
+void LinkMonitor::poll(uint32_t nowMs, uint32_t timeoutMs) {
+  if (pending && nowMs - probeSentMs >= timeoutMs) {
+    pending = false;
+    recordResult(true);
+  }
+}
+
+void LinkMonitor::recordResult(bool wasLost) {
+  lossHistory = (uint16_t)(lossHistory << 1) | (wasLost ? 1 : 0);
+  lossHistory &= (uint16_t)((1UL << LINK_LOSS_WINDOW) - 1);
+  if (resolved < LINK_LOSS_WINDOW) {
+    resolved++;
+  }
+  if (wasLost) {
+    lost++;
+  }
+}
+
+uint8_t LinkMonitor::lossPercent() const {
+  if (resolved == 0) {
+    return 0;
+  }
+  uint8_t losses = 0;
+  for (uint16_t bits = lossHistory; bits != 0; bits &= bits - 1) {
+    losses++;
+  }
+  return (uint8_t)((losses * 100U + resolved / 2) / resolved);
+}
+
+bool LinkMonitor::degraded() const {
+  return lossPercent() >= LINK_DEGRADED_LOSS_PERCENT ||
+         (answered > 0 && rttAverageMs() >= LINK_DEGRADED_RTT_MS);
+}
@@ -0,0 +1,127 @@
+#include "log.h"
+
+#if LOG_LEVEL > LOG_LEVEL_OFF
+
+#include <stdarg.h>
+
+static char ring[LOG_RING_SIZE];
+static uint16_t ringHead = 0;   // ตำแหน่งเขียนถัดไป
+static uint16_t ringTail = 0;   // ตำแหน่งอ่านถัดไป
+static uint16_t dropped = 0;
+static uint16_t droppedReported = 0;
+
+static uint16_t ringFree() {
+  return (LOG_RING_SIZE - 1) - ((ringHead - ringTail) & (LOG_RING_SIZE - 1));
+}
+
+static void ringPut(const char* text, uint16_t length) {
+  for (uint16_t i = 0; i < length; i++) {
+    ring[ringHead] = text[i];
+    ringHead = (ringHead + 1) & (LOG_RING_SIZE - 1);
+  }
+}
+
+void logWrite(char level, const char* formatP, ...) {
+  char line[LOG_LINE_MAX];
+  line[0] = '[';
+  line[1] = level;
+  line[2] = ']';
+  line[3] = ' ';
+
+  va_list args;
+  va_start(args, formatP);
+  int length = vsnprintf_P(line + 4, sizeof(line) - 6, formatP, args);
+  va_end(args);
+
+  if (length < 0) {
+    return;
+  }
+  length += 4;
+  if (length > (int)sizeof(line) - 3) {
+    length = sizeof(line) - 3; // ข้อความยาวเกิน ถูกตัด (ไม่รวม NUL ที่ vsnprintf_P ปิดท้าย)
+  }
+  line[length++] = '\r';
+  line[length++] = '\n';
+
+  // ทิ้งทั้งข้อความถ้าที่ไม่พอ (ไม่รอ Serial)
+  if (ringFree() < length) {
+    dropped++;
+    return;
+  }
+  ringPut(line, length);
+}
+
+void logFlush() {
+  // แจ้งจำนวนข้อความที่หายไปเมื่อมีที่ว่างพอ
+  if (dropped != droppedReported && ringFree() >= 32) {
+    char note[32];
+    int length = snprintf_P(note, sizeof(note), PSTR("[W] log dropped %u\r\n"), dropped - droppedReported);
+    if (length > 0) {
+      ringPut(note, length);
+      droppedReported = dropped;
+    }
+  }
+
+  int room = Serial.availableForWrite();
+  while (room > 0 && ringTail != ringHead) {
+    Serial.write((uint8_t)ring[ringTail]);
+    ringTail = (ringTail + 1) & (LOG_RING_SIZE - 1);
+    room--;
+  }
+}
+
+// buffer หมุนเวียน 4 ชุดที่ logFloat/logFixed ใช้ร่วมกัน
+#define LOG_VALUE_SIZE 14   // "-2147483648" พร้อมจุดทศนิยม
+
+static char* nextValueBuffer() {
+  static char buffers[4][LOG_VALUE_SIZE];
+  static uint8_t next = 0;
+  char* out = buffers[next];
+  next = (next + 1) & 3;
+  return out;
+}
+
+const char* logFloat(float value, uint8_t decimals) {
+  char* out = nextValueBuffer();
+#ifdef ARDUINO_ARCH_AVR
+  dtostrf(value, 1, decimals, out);
+#else
+  snprintf(out, LOG_VALUE_SIZE, "%.*f", decimals, (double)value);
+#endif
+  return out;
+}
+
+const char* logFixed(int32_t value, uint8_t decimals) {
+  char* out = nextValueBuffer();
+  uint32_t magnitude = value < 0 ? 0UL - (uint32_t)value : (uint32_t)value;
+  if (decimals > 9) {
+    decimals = 9;
+  }
+
+  // หลักเรียงจากหลักหน่วย มีอย่างน้อย decimals + 1 หลัก (5 ทศนิยม 2 -> "0.05")
+  char digits[10];
+  uint8_t count = 0;
+  do {
+    digits[count++] = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude > 0 || count <= decimals);
+
+  uint8_t at = 0;
+  if (value < 0) {
+    out[at++] = '-';
+  }
+  while (count > 0 && at < LOG_VALUE_SIZE - 2) {
+    if (count == decimals) {
+      out[at++] = '.';
+    }
+    out[at++] = digits[--count];
+  }
+  out[at] = '\0';
+  return out;
+}
+
+uint16_t logDroppedCount() {
+  return dropped;
+}
+
+#endif
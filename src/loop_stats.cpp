@@ -0,0 +1,109 @@
+#include "loop_stats.h"
+
+static StageStats stages[STAGE_COUNT];
+static uint32_t maxPumpGapUs = 0;
+static uint32_t lastPumpCheckUs = 0;
+static bool pumpCheckSeen = false;
+static bool discardPass = false;
+static uint32_t resetMillis = 0;
+
+// ชื่อย่อในบรรทัด STATS (ลำดับเดียวกับ LoopStage)
+static const char STAGE_NAMES[STAGE_COUNT][5] PROGMEM = {
+  "COMM", "MB", "FLOW", "AC", "TX", "RPL", "HIST", "CMD", "PUMP", "EEP", "LOG", "LOOP"
+};
+
+void loopStatsReset() {
+  for (uint8_t i = 0; i < STAGE_COUNT; i++) {
+    memset(&stages[i], 0, sizeof(stages[i]));
+    stages[i].minUs = 0xFFFFFFFF;
+  }
+  maxPumpGapUs = 0;
+  pumpCheckSeen = false;
+  discardPass = false;
+  resetMillis = millis();
+}
+
+uint8_t loopStatsBin(uint32_t durationUs) {
+  uint8_t bin = 0;
+  durationUs >>= 7;
+  while (durationUs > 0 && bin < LOOP_STATS_BINS - 1) {
+    durationUs >>= 1;
+    bin++;
+  }
+  return bin;
+}
+
+void loopStatsRecord(uint8_t stage, uint32_t durationUs) {
+  if (stage >= STAGE_COUNT) {
+    return;
+  }
+  StageStats& s = stages[stage];
+  s.count++;
+  s.totalUs += durationUs;
+  if (durationUs < s.minUs) s.minUs = durationUs;
+  if (durationUs > s.maxUs) s.maxUs = durationUs;
+  uint16_t& bucket = s.histogram[loopStatsBin(durationUs)];
+  if (bucket < 0xFFFF) bucket++;
+}
+
+uint32_t loopStatsBeginPass() {
+  discardPass = false;
+  return micros();
+}
+
+void loopStatsEnd(uint8_t stage, uint32_t startUs) {
+  if (!discardPass) {
+    loopStatsRecord(stage, micros() - startUs);
+  }
+}
+
+void loopStatsPumpCheck() {
+  uint32_t now = micros();
+  if (pumpCheckSeen && !discardPass) {
+    uint32_t gap = now - lastPumpCheckUs;
+    if (gap > maxPumpGapUs) maxPumpGapUs = gap;
+  }
+  lastPumpCheckUs = now;
+  pumpCheckSeen = true;
+}
+
+void loopStatsDiscardPass() {
+  discardPass = true;
+}
+
+const StageStats& loopStatsStage(uint8_t stage) {
+  return stages[stage < STAGE_COUNT ? stage : (uint8_t)STAGE_LOOP];
+}
+
+uint32_t loopStatsMaxPumpGapUs() {
+  return maxPumpGapUs;
+}
+
+void loopStatsPrint(Print& out) {
+  out.print(F("T="));
+  out.print(millis() - resetMillis);
+  out.print(F(",GAP="));
+  out.print(maxPumpGapUs);
+
+  for (uint8_t i = 0; i < STAGE_COUNT; i++) {
+    const StageStats& s = stages[i];
+    char name[5];
+    memcpy_P(name, STAGE_NAMES[i], sizeof(name));
+
+    out.print(';');
+    out.print(name);
+    out.print('=');
+    out.print(s.count);
+    out.print(',');
+    out.print(s.count > 0 ? s.minUs : 0UL);
+    out.print(',');
+    out.print(s.count > 0 ? (uint32_t)(s.totalUs / s.count) : 0UL);
+    out.print(',');
+    out.print(s.maxUs);
+    out.print(',');
+    for (uint8_t b = 0; b < LOOP_STATS_BINS; b++) {
+      if (b > 0) out.print(':');
+      out.print(s.histogram[b]);
+    }
+  }
+}
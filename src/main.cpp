@@ -1,6 +1,26 @@
-#include <ModbusMaster.h>
 #include <ArduinoJson.h>
-#include <PZEM004Tv30.h>  // เพิ่มไลบรารีสำหรับ PZEM004T
+#include "modbus_rtu.h"      // Modbus RTU master แบบ non-blocking
+#include "pzem_meter.h"      // PZEM-004T แบบ non-blocking บน Serial3
+#include "poll_scheduler.h"  // คาบอ่านของแต่ละเซ็นเซอร์แบบปรับตัวเอง
+#include "slave_health.h"    // สถานะ/backoff ของแต่ละ Modbus slave
+#include "command_parser.h"  // ตัวแยกคำสั่งจาก ESP32 แบบไม่ใช้ heap
+#include "telemetry_frame.h" // เฟรม telemetry แบบ binary
+#include "telemetry_delta.h" // ส่งเฉพาะฟิลด์ที่เปลี่ยน + keyframe
+#include "telemetry_subscriptions.h" // คาบส่งแยกตามกลุ่มฟิลด์
+#include "relay_driver.h"    // สั่ง relay หลายตัวพร้อมกันผ่าน PORTx
+#include "actuator_timer.h"  // ตารางจับเวลา relay ด้วย hardware timer
+#include "flow_counter.h"    // นับพัลส์ flow sensor จาก interrupt
+#include "fixed_point.h"     // แปลงค่าเซ็นเซอร์เป็นจำนวนเต็มมีสเกล ไม่ใช้ float
+#include "log.h"             // log แบบ compile-time level + ring buffer
+#include "loop_stats.h"      // จับเวลาแต่ละขั้นของ loop()
+#include "state_journal.h"   // บันทึกสถานะ relay/วงจรลง EEPROM แบบกระจายการสึก
+#include "sensor_history.h"  // ประวัติ min/max/mean ย้อนหลังใน RAM
+#include "outbound_queue.h"  // คิวเก็บข้อความขณะลิงก์ ESP32 ขาด แล้วส่งซ้ำพร้อม ACK
+#include "link_monitor.h"    // RTT/loss/silence ของลิงก์ Serial2
+#include "command_envelope.h" // คำสั่งแบบมี seq + checksum และหลายคำสั่งต่อเฟรม
+#include "sensor_filter.h"   // median/อัตราเปลี่ยน/EMA ของค่าจาก Modbus
+#include "dosing_controller.h" // คุม EC/pH แบบวงปิดบน Mega
+#include "rule_engine.h"     // กฎ threshold/hysteresis ของ relay บน Mega (ทำความเย็น/ระบายอากาศ)
 
 // กำหนดขา MAX485 (ใช้เลขขาจริงแทนตัวแปร A4, A5)
 #define MAX485_DE      2 // ใช้ขา Digital 2 แทน A4
@@ -23,1235 +43,2635 @@ int relayPins[] = {26, 28, 30, 27, 33, 31, 29, 32};
 bool relayActiveHigh[] = {true, false, false, false, false, false, false, false}; // K1=Active High, K2-K8=Active Low
 
 int relayPinCount = sizeof(relayPins) / sizeof(relayPins[0]);
-String lastRelayCommand = "00000000"; // เก็บคำสั่งล่าสุด
-bool relayStates[8] = {false}; // เก็บสถานะปัจจุบันของแต่ละ relay
+char lastRelayCommand[9] = "00000000"; // เก็บคำสั่งล่าสุด (สถานะจริงอยู่ใน relay_driver)
 
-// สร้าง PZEM004Tv30 object สำหรับวัดไฟฟ้า (Serial3: ขา 14 = TX3, 15 = RX3 บน Arduino Mega)
-PZEM004Tv30 pzem(Serial3);
+// มิเตอร์ไฟฟ้า PZEM-004T (Serial3: ขา 14 = TX3, 15 = RX3 บน Arduino Mega)
+// มี master ของตัวเองจึงอ่านพร้อมกับบัส Serial1 ได้
+PzemMeter pzem;
 
-// สร้าง ModbusMaster objects สำหรับแต่ละเซ็นเซอร์
-ModbusMaster co2Sensor;    // ID 1: CO2, Temp, Humidity
-ModbusMaster lightSensor;  // ID 2: Light Intensity
-ModbusMaster ecSensor;     // ID 3: EC
-ModbusMaster phSensor;     // ID 4: PH & Temp
+// Modbus RTU master ตัวเดียวบน Serial1 ใช้ร่วมกันทุกเซ็นเซอร์
+// ID 1: CO2, Temp, Humidity | ID 2: Light Intensity | ID 3: EC | ID 4: PH & Temp
+ModbusRtuMaster modbus;
 
-// ตัวแปรเก็บค่าจากเซ็นเซอร์
+// ตัวแปรเก็บค่าจากเซ็นเซอร์ เป็นจำนวนเต็มหน่วยเดียวกับ TelemetryFrameV1 (float ใช้เฉพาะตอนเขียน JSON)
 // CO2 Sensor (ID 1)
-float airTemp = 0.0;
-float airHumidity = 0.0;
+int16_t airTemp = 0;       // °C x10
+uint16_t airHumidity = 0;  // %RH x10
 int co2Ppm = 0;
 
 // Light Sensor (ID 2)
 uint32_t luxValue = 0;
 
 // EC Sensor (ID 3)
-float ecValue = 0.0;
-float ecCalibration = 0.0;
+uint16_t ecValue = 0;        // µS/cm x10 (แคลิเบรตแล้ว)
+uint16_t ecCalibration = 0;  // register 0 ตามที่อ่านได้
 bool isEcSensorRange4400 = true; // true = 0~4400 uS/cm, false = 0~44000 uS/cm
 
 // PH Sensor (ID 4)
-float phValue = 0.0;
-float waterTemp = 0.0;
+uint16_t phValue = 0;      // pH x100
+int16_t waterTemp = 0;     // °C x10
 
 // Water Level Sensor (Digital, connected to A0)
 bool waterDetected = false;
 
 // AC Power Sensor (PZEM-004T v3.0) ตัวแปรสำหรับเก็บค่าพลังงานไฟฟ้า
-float acVoltage = 0.0;
-float acCurrent = 0.0;
-float acPower = 0.0;
-float acEnergy = 0.0;
-float acFrequency = 0.0;
-float acPowerFactor = 0.0;
+uint16_t acVoltage = 0;      // V x10
+uint32_t acCurrent = 0;      // mA
+uint32_t acPower = 0;        // W x10
+uint32_t acEnergy = 0;       // Wh
+uint16_t acFrequency = 0;    // Hz x10
+uint8_t acPowerFactor = 0;   // x100
 bool acSensorConnected = false;
 
 // ตัวแปรสำหรับเวลา
 unsigned long lastReadTime = 0;
-unsigned long lastSendTime = 0;
-unsigned long lastAcReadTime = 0;  // เพิ่มตัวแปรสำหรับอ่านค่า AC
-const unsigned long READ_INTERVAL = 1000;  // อ่านค่าทุก 1 วินาที
-const unsigned long SEND_INTERVAL = 2000; // ส่งข้อมูลไปยัง ESP32 ทุก 2 วินาที (เร็วขึ้น)
+unsigned long lastAcReadTime = 0;  // เวลาที่เริ่มอ่าน PZEM ครั้งล่าสุด
+const unsigned long READ_INTERVAL = 1000;  // อ่านระดับน้ำและสรุปค่าทุก 1 วินาที (เซ็นเซอร์ Modbus ใช้ busScheduler)
+const unsigned long SEND_INTERVAL = 2000; // คาบเริ่มต้นของสตรีมหลัก (SUBSCRIBE:all) ทุก 2 วินาที
 const unsigned long AC_READ_INTERVAL = 1000;  // อ่านค่า AC ทุก 1 วินาที
-
-// ตัวแปรสำหรับการทดสอบและตรวจสอบการสื่อสาร
-unsigned long lastCommunicationTest = 0;
-const unsigned long COMM_TEST_INTERVAL = 30000; // ทดสอบการสื่อสารทุก 30 วินาที (ลดลง)
-bool communicationOK = false;
+const unsigned long AC_RECONNECT_INTERVAL = 10000; // มิเตอร์ไม่ตอบ: ลองใหม่ทุก 10 วินาที
+
+// === ESP32 LINK HEARTBEAT ===
+// MEGA_TEST ถูกส่งทุก HEARTBEAT_INTERVAL (ครั้งแรกในรอบแรกของ loop()) คำตอบ ESP32_OK รับผ่านตารางคำสั่งปกติ
+// ไม่มีการรอและไม่ล้าง RX: ทุกบรรทัดที่ถูกต้องจาก ESP32 นับเป็นสัญญาณว่าลิงก์ยังอยู่ (ดู LINK command)
+LinkMonitor esp32Link;
+unsigned long lastHeartbeat = 0;
+const unsigned long HEARTBEAT_INTERVAL = 5000;    // ส่ง probe ทุก 5 วินาที (ข้อความ 11 ไบต์)
+const unsigned long HEARTBEAT_TIMEOUT = 1000;     // ไม่ได้คำตอบใน 1 วินาที = probe หาย
+const unsigned long LINK_SILENCE_LIMIT = 12000;   // ไม่มีบรรทัดที่ถูกต้องนานเท่านี้ (probe หาย 2 ครั้งติด) = ลิงก์ขาด
+bool esp32LinkLost = false;
 int sendAttempts = 0;
 const int MAX_SEND_ATTEMPTS = 3;
 
-// ตัวแปรสำหรับเก็บสถานะปัจจุบันและสถานะก่อนหน้า
-int currentState1 = 0, lastState1 = 0;
-int currentState2 = 0, lastState2 = 0;
-int currentState3 = 0, lastState3 = 0;
+// รูปแบบ telemetry ที่ส่งให้ ESP32 (false = JSON เดิม, true = binary frame)
+// เปลี่ยนได้ด้วย CONFIG:TELEMETRY:BINARY / CONFIG:TELEMETRY:JSON
+bool binaryTelemetry = false;
+uint16_t telemetrySequence = 0;
 
-// ตัวแปรสำหรับเก็บจำนวนพัลส์
-int pulseCount1 = 0;
-int pulseCount2 = 0;
-int pulseCount3 = 0;
+// คาบของแต่ละกลุ่มฟิลด์ที่ ESP32 ขอ (SUBSCRIBE/UNSUBSCRIBE) กลุ่ม all = สตรีมหลัก
+TelemetrySubscriptions telemetrySubscriptions;
 
-// ตัวแปรสำหรับคำนวณอัตราการไหล
-float flowRate1 = 0.0;
-float flowRate2 = 0.0;
-float flowRate3 = 0.0;
+// โหมด delta: สตรีมหลักส่งเฉพาะฟิลด์ที่เปลี่ยนเกิน deadband + keyframe ทุก KEYFRAME_INTERVAL
+// และส่งทันทีเมื่อฟิลด์ข้ามเกณฑ์ alert (ตรวจทุก ALERT_CHECK_INTERVAL) เปิดด้วย CONFIG:TELEMETRY:DELTA
+bool deltaTelemetry = false;
+TelemetryDeltaTracker telemetryTracker;
+unsigned long lastKeyframeTime = 0;
+unsigned long lastAlertCheckTime = 0;
+const unsigned long KEYFRAME_INTERVAL = 30000;
+const unsigned long ALERT_CHECK_INTERVAL = 50;
 
-// ตัวแปรเก็บปริมาณน้ำสะสม (มิลลิลิตร)
-float totalMilliLitres1 = 0;
-float totalMilliLitres2 = 0;
-float totalMilliLitres3 = 0;
+// ขา flow sensor (นับพัลส์ใน ISR ของ Timer3 ดู flow_counter.h)
+const uint8_t flowSensorPins[FLOW_CHANNELS] = {FLOW_SENSOR_1, FLOW_SENSOR_2, FLOW_SENSOR_3};
+FlowSnapshot lastFlowSnapshot; // snapshot ล่าสุดที่ใช้คำนวณอัตราการไหล
 
-// ตัวแปรเก็บเวลา
-unsigned long oldTime = 0;
+// อัตราการไหล (L/min x100) และพัลส์สะสมตั้งแต่ CONFIG:RESET_FLOW ของแต่ละช่อง
+uint16_t flowRate[FLOW_CHANNELS] = {0, 0, 0};
+uint32_t flowPulseTotal[FLOW_CHANNELS] = {0, 0, 0};
 
-// ค่าคงที่สำหรับแปลงพัลส์เป็นอัตราการไหล
-const float calibrationFactor = 7.5; // พัลส์ต่อวินาทีต่อลิตรต่อนาที
+// ค่าคงที่สำหรับแปลงพัลส์เป็นอัตราการไหล: 7.5 พัลส์ต่อวินาทีต่อลิตรต่อนาที = 450 พัลส์ต่อลิตร
+const int32_t FLOW_PULSES_PER_LITRE = 450;
 
 // === EC CALIBRATION EQUATION: y = 15.968x - 53.913, R² = 0.9973 ===
-// สมการหลักสำหรับการคำนวณค่า EC ที่แม่นยำ
-const float EC_SLOPE = 15.968;      // ความชัน (m) 
-const float EC_INTERCEPT = -53.913; // จุดตัดแกน y (b)
+// สมการหลักสำหรับการคำนวณค่า EC ที่แม่นยำ (ค่าคงที่ x1000 เพื่อคำนวณด้วยจำนวนเต็ม)
+const int32_t EC_SLOPE_X1000 = 15968;      // ความชัน (m)
+const int32_t EC_INTERCEPT_X1000 = -53913; // จุดตัดแกน y (b)
 // x = ค่า raw จากเซ็นเซอร์, y = ค่า EC ที่แคลิเบรตแล้ว (uS/cm)
 
-// === ULTRA-PRECISE TIMING VARIABLES ===
-// ตัวแปรสำหรับปั๊ม EC
-unsigned long ecPumpStartTime = 0;
-unsigned long ecPumpDuration = 0;
-bool ecPumpRunning = false;
-
-// ตัวแปรสำหรับปั๊ม PH
-unsigned long phPumpStartTime = 0;
-unsigned long phPumpDuration = 0;
-bool phPumpRunning = false;
-
-// ตัวแปรสำหรับ Internal Fan cycle
-unsigned long fanCycleStartTime = 0;
-bool fanCycleState = false; // false = OFF period, true = ON period
-unsigned long fanDelayOn = 0;
-unsigned long fanDelayOff = 0;
-int fanRelayIndex = 0;
-bool fanCycleActive = false;
-
-// ฟังก์ชันควบคุมการส่ง/รับข้อมูลผ่าน MAX485
-void preTransmission() {
-  digitalWrite(MAX485_RE, HIGH);
-  digitalWrite(MAX485_DE, HIGH);
-}
-
-void postTransmission() {
-  digitalWrite(MAX485_RE, LOW);
-  digitalWrite(MAX485_DE, LOW);
-}
-
-void readCO2Sensor();
-void readLightSensor();
-void readECSensor();
-void readPHSensor();
+// === SENSOR CONVERSIONS (register -> หน่วยของ TelemetryFrameV1) ===
+// อุณหภูมิ/ความชื้น (x10) CO2 lux และค่าจาก PZEM อยู่ในหน่วยของเฟรมอยู่แล้ว
+typedef FixedConversion<10> PhConversion;                                   // pH x10 -> x100
+typedef FixedConversion<EC_SLOPE_X1000, 1000, EC_INTERCEPT_X1000 * 10, 0, 50000>
+    EcConversion4400;                                                       // raw x10 -> µS/cm x10 (0-5000)
+typedef FixedConversion<EC_SLOPE_X1000 * 10, 1000, EC_INTERCEPT_X1000 * 10, 0, 50000>
+    EcConversion44000;                                                      // raw x1 -> µS/cm x10 (0-5000)
+typedef FixedConversion<1000, FLOW_PULSES_PER_LITRE> FlowVolumeConversion; // พัลส์ -> mL
+
+// === PERSISTENT STATE (EEPROM journal) ===
+// สถานะที่ต้องกลับมาหลังไฟดับ: relay ที่สั่งค้างไว้, วงจร ON/OFF, ช่วง EC และปริมาณน้ำสะสม
+// pulse ของปั๊มไม่ถูกบันทึก (ปั๊มที่ค้างอยู่ตอนไฟดับต้องไม่เปิดต่อเองหลังบูต)
+// EEPROM แบ่งสองช่วง: สถานะหลัก 3 KB (48 ช่อง) และกฎ relay 1 KB (16 ช่อง) แต่ละช่วงกระจายการสึกเอง
+// version 2: ช่วงสถานะหลักเล็กลง record ของ version 1 จึงถูกข้ามหนึ่งครั้งหลังอัปเดต
+#define PERSIST_VERSION 2
+#define PERSIST_STATE_BYTES 3072
+#define PERSIST_RULES_BYTES 1024
+#define PERSIST_MAX_CYCLES 4
+#define PERSIST_FLAG_EC_RANGE_4400 0x01
+
+struct __attribute__((packed)) PersistedCycle {
+  uint8_t relay;             // index 0-7
+  uint16_t onSeconds;        // ความละเอียด 1 วินาที (เกิน 65535 ถูกจำกัดไว้)
+  uint16_t offSeconds;
+  uint32_t maxRunSeconds;    // 0 = ไม่มีเพดาน (นับใหม่ตั้งแต่บูต)
+};
+
+struct __attribute__((packed)) PersistentState {
+  uint8_t version;
+  uint8_t relays;            // relay ที่เปิดค้าง (ไม่รวม relay ที่ตารางจับเวลาหรือกฎคุมอยู่)
+  uint8_t flags;             // PERSIST_FLAG_*
+  uint8_t cycleCount;
+  PersistedCycle cycles[PERSIST_MAX_CYCLES];
+  uint32_t flowPulseTotal[FLOW_CHANNELS];
+};
+
+static_assert(sizeof(PersistentState) <= JOURNAL_PAYLOAD_SIZE, "PersistentState does not fit a journal record");
+
+StateJournal stateJournal(0, PERSIST_STATE_BYTES);
+PersistentState persistedState;          // สถานะที่อยู่ใน journal แล้ว (หรือกำลังเขียน)
+unsigned long lastPersistCheck = 0;
+unsigned long lastFlowPersistTime = 0;
+const unsigned long PERSIST_CHECK_INTERVAL = 1000;    // เทียบสถานะทุก 1 วินาที
+const unsigned long FLOW_PERSIST_INTERVAL = 600000;   // ปริมาณน้ำเปลี่ยนตลอดเวลา: บันทึกไม่บ่อยกว่า 10 นาทีครั้ง
+
+// กฎ relay: บันทึกทั้งตารางเมื่อ RULE:/RULE_CLEAR: เปลี่ยน (target = field | relay << 5, 0xFF = ช่องว่าง)
+#define RULES_PERSIST_VERSION 0x52
+#define RULES_PERSIST_EMPTY 0xFF
+
+struct __attribute__((packed)) PersistedRule {
+  uint8_t target;
+  int32_t onValue;
+  int32_t offValue;
+  uint16_t minOnSeconds;
+  uint16_t minOffSeconds;
+};
+
+struct __attribute__((packed)) PersistentRules {
+  uint8_t version;
+  PersistedRule rules[RULE_MAX];
+};
+
+static_assert(sizeof(PersistentRules) <= JOURNAL_PAYLOAD_SIZE, "PersistentRules does not fit a journal record");
+
+StateJournal rulesJournal(PERSIST_STATE_BYTES, PERSIST_RULES_BYTES);
+bool rulesDirty = false;                 // ตารางกฎเปลี่ยนแล้วยังไม่ได้เริ่มเขียน
+
+// === SENSOR HISTORY ===
+// ค่าของแต่ละช่องถูกเก็บทุก READ_INTERVAL (เฉพาะค่าที่สด) แล้วสรุปเป็นนาที/ชั้นที่หยาบขึ้นใน sensorHistory
+// HISTORY:<ช่อง>,<from> ส่งกลับทีละช่องต่อรอบ loop เมื่อ TX buffer ของ Serial2 ว่างพอ จึงไม่บล็อก
+SensorHistory sensorHistory;
+uint8_t historyStreamChannel = HISTORY_NONE;   // ช่องที่กำลังส่ง (HISTORY_NONE = ไม่มี)
+uint32_t historyStreamFrom = 0;                // นาทีเริ่มของช่องถัดไปที่จะส่ง
+uint16_t historyStreamCount = 0;
+const int HISTORY_LINE_MAX = 40;               // "H:<start>,<minutes>,<min>,<max>,<mean>\r\n" ยาวสุด
+
+// === STORE-AND-FORWARD ===
+// ลิงก์ขาด (ESP32 เงียบเกิน LINK_SILENCE_LIMIT ดู serviceEsp32Link()): เหตุการณ์ของ relay/ปั๊ม และ snapshot ทุก OUTBOX_SNAPSHOT_INTERVAL
+// เข้าคิวแทนการเขียนลง UART ที่ไม่มีใครอ่าน เมื่อลิงก์กลับมาส่งซ้ำทีละ record ตามลำดับ แล้วรอ ACK:<seq>
+// (ดู STORE_AND_FORWARD.md)
+OutboundQueue outbox;
+enum OutboxKind : uint8_t { OUTBOX_EVENT, OUTBOX_SNAPSHOT, OUTBOX_DOSE, OUTBOX_RULE };
+uint16_t replayInFlight = 0;        // sequence ที่ส่งซ้ำแล้วรอ ACK (0 = ไม่มี)
+unsigned long replaySentTime = 0;
+unsigned long lastSnapshotQueued = 0;
+bool snapshotQueued = false;        // เข้าคิว snapshot แล้วตั้งแต่ลิงก์ขาดครั้งนี้
+const unsigned long REPLAY_ACK_TIMEOUT = 1000;          // ไม่ได้ ACK ภายใน 1 วินาที: ส่ง record เดิมซ้ำ
+const unsigned long OUTBOX_SNAPSHOT_INTERVAL = 60000;   // 10 ช่องครอบคลุม ~10 นาที (ช่วงยาวกว่านั้นดู HISTORY)
+
+// === ULTRA-PRECISE TIMING ===
+// relay ทุกตัวจับเวลาได้ผ่านตารางใน Timer3 ISR (actuator_timer) ปั๊ม EC (K7) และปั๊ม PH (K6) ใช้ช่องของตัวเอง
+const uint8_t EC_PUMP_RELAY = 6; // K7
+const uint8_t PH_PUMP_RELAY = 5; // K6
+
+// === CLOSED-LOOP DOSING ===
+// ESP32 ส่งค่าตั้ง (DOSE_CONFIG:) แล้วเปิด (DOSE_MODE:...,AUTO) จากนั้น Mega เติม-รอผสม-วัดเองจากค่าที่
+// readECSensor()/readPHSensor() อ่านได้ รายงานทุกขั้นเป็น DOSE:<ช่อง>,<ขั้น>,... (ดู DOSING_CONTROLLER.md)
+// ไม่บันทึกลง EEPROM: หลังรีบูตเป็น OFF จนกว่า ESP32 จะส่งค่าตั้งมาใหม่
+enum DoseChannel : uint8_t { DOSE_EC, DOSE_PH, DOSE_CHANNEL_COUNT };
+DosingController dosing[DOSE_CHANNEL_COUNT];
+const uint8_t dosePumpRelays[DOSE_CHANNEL_COUNT] = {EC_PUMP_RELAY, PH_PUMP_RELAY};
+
+// === LOCAL RELAY RULES ===
+// RULE:K2,waterTemp,250,220,60,180 = ทำความเย็นเปิดเมื่อน้ำ >= 25.0 °C ปิดเมื่อ <= 22.0 °C (เปิด/ปิดค้างอย่างน้อย 60/180 s)
+// ตัดสินทันทีหลังเซ็นเซอร์ของฟิลด์นั้นอ่านสำเร็จ จึงทำงานต่อได้แม้ ESP32 หาย (ดู RELAY_RULES.md)
+// relay ที่มีกฎ: RELAY: สั่งไม่ได้ ตารางจับเวลา (PUMP_TIMING/FAN_TIMING) มาก่อนกฎจนกว่าจะหมดเวลา
+RuleEngine ruleEngine;
+
+struct RuleSwitchEvent {
+  uint8_t relay;
+  bool on;
+  int32_t value;            // ค่าของฟิลด์ที่ทำให้สลับ
+};
+
+uint32_t readCO2Sensor(uint8_t result);
+uint32_t readLightSensor(uint8_t result);
+uint32_t readECSensor(uint8_t result);
+uint32_t readPHSensor(uint8_t result);
+void initSensorPolling();
+void pollModbusSensors();
 void readWaterLevel();
 void printAllValues();
 void checkFlowSensors();
-void readACPowerSensor();
-void sendDataToESP32();
+void pollACPowerSensor();
+bool serviceTelemetry();
+bool sendDataToESP32();
+bool sendTelemetryDelta(TelemetryFrameV1& frame, uint32_t extraFields);
+void buildTelemetryFrame(TelemetryFrameV1& frame);
+void sendTelemetry(TelemetryFrameV1& frame, uint32_t fields, uint8_t group = TELEMETRY_GROUP_NONE);
+void sendJsonTelemetry(const TelemetryFrameV1& frame, uint32_t fields, uint8_t group, bool live = true);
+void sendBinaryTelemetry(TelemetryFrameV1& frame, uint32_t fields);
 void receiveCommandFromESP32();
-void testESP32Communication();
-void testACPowerSensor();
+void serviceEsp32Link();
 void checkPumpTiming();
+void restorePersistentState();
+void servicePersistence();
+void recordHistorySamples();
+bool serviceHistoryStream();
+void reportActuatorEvent(const ActuatorEvent& event);
+void printActuatorEvent(const ActuatorEvent& event);
+void queueSnapshot();
+bool serviceOutbox();
+void serviceDosing();
+void reportDoseEvent(const DoseEvent& event);
+void printDoseEvent(const DoseEvent& event);
+void evaluateRelayRules(uint32_t updatedFields);
+void reportRuleEvent(const RuleSwitchEvent& event);
+void printRuleEvent(const RuleSwitchEvent& event);
 
 // === Calibration Functions ===
-float calibrateEC(float rawValue);
+uint16_t calibrateEC(uint16_t rawValue);
 
 // === Relay Control Functions ===
 void initRelays();
-void applyRelayCommand(String command);
+void printRelayWiring();
+void applyRelayCommand(const char* command);
 void printRelayStatus();
 
+// === FAST BOOT ===
+// เวลาตั้งแต่ reset (micros() เริ่มนับใน init() ก่อน setup() ไม่รวม bootloader)
+// ready = relay กลับสู่สถานะล่าสุดแล้ว, setup = setup() จบและ loop() เริ่ม (ดูด้วยคำสั่ง BOOT)
+uint32_t bootReadyMicros = 0;
+uint32_t bootSetupMicros = 0;
+
 void setup() {
+  // ขั้นที่ 1: คืนสถานะ relay/วงจรจาก EEPROM ก่อนอย่างอื่นทั้งหมด (ไม่มีการรอ ไม่มี Serial)
+  initRelays();
+  // ISR ของ Timer3 สุ่มขา flow ด้วย จึงต้องตั้งขา/ตัวนับก่อนเริ่ม timer
+  // (INPUT + Pull-Up, นับพัลส์ใน ISR)
+  flowCounterBegin(flowSensorPins);
+  flowCounterSnapshot(lastFlowSnapshot);
+  actuatorTimerBegin();
+  restorePersistentState();
+  bootReadyMicros = micros();
+
+  // ขั้นที่ 2: เริ่มพอร์ตสื่อสารและเซ็นเซอร์ (ทุกอย่างไม่บล็อก การทดสอบ ESP32 และการอ่านเซ็นเซอร์ทำใน loop())
   // เริ่มต้น Serial Monitor
   Serial.begin(115200);
   Serial.println("เริ่มต้นการทำงานเซ็นเซอร์...");
   
   // เริ่มต้น Serial2 สำหรับสื่อสารกับ ESP32
   Serial2.begin(115200);
+  esp32Link.begin(millis());
+  telemetrySubscriptions.subscribe(TELEMETRY_GROUP_ALL, SEND_INTERVAL); // สตรีมหลักตามค่าเริ่มต้น
   
   // เริ่มต้น Serial1 สำหรับ Modbus RTU (ขา 18=TX1, 19=RX1 บน Arduino Mega)
-  Serial1.begin(9600, SERIAL_8N1);
+  // driver จัดการขา MAX485 (DE/RE) เองทั้งหมด
+  modbus.begin(Serial1, 9600, MAX485_DE, MAX485_RE);
+  initSensorPolling();
+  for (uint8_t i = 0; i < DOSE_CHANNEL_COUNT; i++) {
+    dosing[i].begin(i);
+  }
   
   // เริ่มต้น Serial3 สำหรับ PZEM-004T (ขา 14=TX3, 15=RX3 บน Arduino Mega)
-  Serial3.begin(9600, SERIAL_8N1);
-  
-  // ตั้งค่าขา MAX485
-  pinMode(MAX485_DE, OUTPUT);
-  pinMode(MAX485_RE, OUTPUT);
-  digitalWrite(MAX485_RE, LOW);
-  digitalWrite(MAX485_DE, LOW);
+  // การอ่านครั้งแรกเริ่มใน loop() จึงไม่บล็อกตอนบูต
+  pzem.begin(Serial3);
   
   // ตั้งค่าขาวัดระดับน้ำ
   pinMode(WATER_LEVEL_PIN, INPUT);
   
-  // ตั้งค่า CO2 Sensor (ID 1)
-  co2Sensor.begin(1, Serial1);
-  co2Sensor.preTransmission(preTransmission);
-  co2Sensor.postTransmission(postTransmission);
-  
-  // ตั้งค่า Light Sensor (ID 2)
-  lightSensor.begin(2, Serial1);
-  lightSensor.preTransmission(preTransmission);
-  lightSensor.postTransmission(postTransmission);
-  
-  // ตั้งค่า EC Sensor (ID 3)
-  ecSensor.begin(3, Serial1);
-  ecSensor.preTransmission(preTransmission);
-  ecSensor.postTransmission(postTransmission);
-  
-  // ตั้งค่า PH Sensor (ID 4)
-  phSensor.begin(4, Serial1);
-  phSensor.preTransmission(preTransmission);
-  phSensor.postTransmission(postTransmission);
-  
-  // ตั้งค่าสำหรับเซนเซอร์วัดอัตราการไหล
-  pinMode(FLOW_SENSOR_1, INPUT);
-  pinMode(FLOW_SENSOR_2, INPUT);
-  pinMode(FLOW_SENSOR_3, INPUT);
-  
-  // เปิดใช้งาน Pull-Up Resistor ภายใน
-  digitalWrite(FLOW_SENSOR_1, HIGH);
-  digitalWrite(FLOW_SENSOR_2, HIGH);
-  digitalWrite(FLOW_SENSOR_3, HIGH);
-  
-  // อ่านสถานะเริ่มต้น
-  lastState1 = digitalRead(FLOW_SENSOR_1);
-  lastState2 = digitalRead(FLOW_SENSOR_2);
-  lastState3 = digitalRead(FLOW_SENSOR_3);
-  
-  oldTime = millis();
-  
   Serial.println("Modbus Ready");
   Serial.println("CO2:ID1 Light:ID2 EC:ID3 PH:ID4");
   Serial.println("EC Calib: y=15.968x-53.913");
   Serial.println("Water:A0 AC:Serial3 Flow:D22-24");
   
-  // เริ่มต้นระบบ Relay Control
-  initRelays();
+  printRelayWiring();
   Serial.println("Relay System: Ready (K1-K8 on pins 26,28,30,27,33,31,29,32)");
-  
-  // ทดสอบการสื่อสารกับ ESP32
-  testESP32Communication(); // เปิดการทดสอบ ESP32
-  
-  // ทดสอบการเชื่อมต่อกับ PZEM-004T
-  testACPowerSensor();
-  
-  // รอให้ระบบเริ่มต้นทำงาน
-  delay(2000);
+
+  // เริ่มเก็บสถิติเวลาหลังช่วงเริ่มต้น
+  loopStatsReset();
+
+  bootSetupMicros = micros();
+  LOG_INFO("⚡ Boot: relays ready %lu us, setup %lu us after reset",
+           (unsigned long)bootReadyMicros, (unsigned long)bootSetupMicros);
 }
 
 void loop() {
-  // ตรวจสอบการสื่อสารกับ ESP32 เป็นระยะ
-  if (millis() - lastCommunicationTest >= COMM_TEST_INTERVAL) {
-    lastCommunicationTest = millis();
-    testESP32Communication();
-  }
-
-  // อ่านค่าเซ็นเซอร์ทั่วไปทุกๆ READ_INTERVAL ms
-  if (millis() - lastReadTime >= READ_INTERVAL) {
-    lastReadTime = millis();
-    
-    readCO2Sensor();
-    readLightSensor();
-    readECSensor();
-    readPHSensor();
-    readWaterLevel();
-    
-    // แสดงค่าทั้งหมดบน Serial Monitor
-    printAllValues();
-  }
+  // จับเวลาแต่ละขั้นของ loop (ดูผลด้วยคำสั่ง STATS)
+  uint32_t passStart = loopStatsBeginPass();
+  uint32_t stageStart;
+
+  // heartbeat ของลิงก์ ESP32 (คำตอบรับใน receiveCommandFromESP32())
+  stageStart = micros();
+  serviceEsp32Link();
+  loopStatsEnd(STAGE_COMM_TEST, stageStart);
+
+  // อ่านค่าเซ็นเซอร์ Modbus แบบ non-blocking (แต่ละตัวตามคาบของตัวเอง)
+  stageStart = micros();
+  pollModbusSensors();
+  loopStatsEnd(STAGE_MODBUS, stageStart);
+
+  // อ่าน PZEM-004T บน Serial3 แบบ non-blocking (ทำงานคู่ขนานกับธุรกรรมบน Serial1)
+  stageStart = micros();
+  pollACPowerSensor();
+  loopStatsEnd(STAGE_AC_POWER, stageStart);
   
   // ตรวจสอบและคำนวณอัตราการไหลของน้ำ
+  stageStart = micros();
   checkFlowSensors();
+  loopStatsEnd(STAGE_FLOW, stageStart);
   
-  // อ่านค่าเซ็นเซอร์ AC ทุกๆ AC_READ_INTERVAL ms
-  if (millis() - lastAcReadTime >= AC_READ_INTERVAL) {
-    lastAcReadTime = millis();
-    readACPowerSensor();
+  // ส่งข้อมูลไปยัง ESP32 ตามคาบของแต่ละกลุ่มที่ subscribe ไว้ หรือทันทีเมื่อมี alert ในโหมด delta (ไม่ต้องรอการตอบกลับ)
+  stageStart = micros();
+  if (serviceTelemetry()) {
+    loopStatsEnd(STAGE_SEND, stageStart);
   }
   
-  // ส่งข้อมูลไปยัง ESP32 ทุกๆ SEND_INTERVAL ms (ไม่ต้องรอการตอบกลับ)
-  if (millis() - lastSendTime >= SEND_INTERVAL) {
-    lastSendTime = millis();
-    sendDataToESP32();
+  // ส่งข้อความที่ค้างในคิวตอนลิงก์ขาดซ้ำทีละ record
+  stageStart = micros();
+  if (serviceOutbox()) {
+    loopStatsEnd(STAGE_REPLAY, stageStart);
   }
-  
+
+  // ส่งประวัติที่ ESP32 ขอ (HISTORY:) ต่ออีก 1 ช่อง
+  stageStart = micros();
+  if (serviceHistoryStream()) {
+    loopStatsEnd(STAGE_HISTORY, stageStart);
+  }
+
   // รับคำสั่งจาก ESP32 (ถ้ามี)
+  stageStart = micros();
   receiveCommandFromESP32();
+  loopStatsEnd(STAGE_COMMANDS, stageStart);
   
   // === ULTRA-PRECISE TIMING SYSTEM ===
   // ตรวจสอบการจับเวลาปั๊ม EC และ PH แบบแม่นยำสูงสุด
+  stageStart = micros();
   checkPumpTiming();
+  serviceDosing();
+  loopStatsEnd(STAGE_PUMP_TIMING, stageStart);
+
+  // บันทึกสถานะที่เปลี่ยนลง EEPROM ทีละไบต์ (ไม่รอ EEPROM)
+  stageStart = micros();
+  servicePersistence();
+  loopStatsEnd(STAGE_STORAGE, stageStart);
+
+  // ส่ง log ที่ค้างใน ring buffer ออก Serial เท่าที่ TX buffer ว่าง (ไม่บล็อก)
+  stageStart = micros();
+  logFlush();
+  loopStatsEnd(STAGE_LOG, stageStart);
+
+  loopStatsEnd(STAGE_LOOP, passStart);
 }
 
 // === ULTRA-PRECISE TIMING FUNCTION ===
+// relay ถูกปิด/สลับตรงเวลาใน ISR ของ Timer3 แล้ว ฟังก์ชันนี้แค่รายงานเหตุการณ์ให้ ESP32
 void checkPumpTiming() {
+  loopStatsPumpCheck();
   unsigned long currentTime = millis();
-  
-  // ตรวจสอบ Internal Fan cycle (ใช้ global variables)
-  
-  if (fanCycleActive) {
-    unsigned long elapsedTime;
-    
-    // ป้องกัน overflow
-    if (currentTime >= fanCycleStartTime) {
-      elapsedTime = currentTime - fanCycleStartTime;
-    } else {
-      elapsedTime = (0xFFFFFFFF - fanCycleStartTime) + currentTime + 1;
-    }
-    
-    unsigned long cycleInterval = fanCycleState ? fanDelayOn : fanDelayOff;
-    
-    if (elapsedTime >= cycleInterval) {
-      fanCycleState = !fanCycleState; // สลับสถานะ
-      fanCycleStartTime = currentTime;
-      
-      // ควบคุม relay
-      relayStates[fanRelayIndex] = fanCycleState;
-      if (relayActiveHigh[fanRelayIndex]) {
-        digitalWrite(relayPins[fanRelayIndex], fanCycleState ? HIGH : LOW);
-      } else {
-        digitalWrite(relayPins[fanRelayIndex], fanCycleState ? LOW : HIGH);
-      }
-      
-      // คำนวณความแม่นยำ
-      float accuracy = 100.0 - (abs((long)(elapsedTime - cycleInterval)) * 100.0 / cycleInterval);
-      String stateStr = fanCycleState ? "ON" : "OFF";
-      String periodStr = fanCycleState ? "OFF" : "ON";
-      
-      Serial.println("🌀 MEGA Internal Fan: " + stateStr + " period started after " + String(elapsedTime) + " ms");
-      Serial.println("   Previous " + periodStr + " period: " + String(cycleInterval/1000) + "s (Target: " + String(cycleInterval/1000) + "s)");
-      Serial.println("⚡ Timing Accuracy: " + String(accuracy, 2) + "% (Error: ±" + String(abs((long)(elapsedTime - cycleInterval))) + "ms)");
-      
-      // ส่งสถานะกลับไป ESP32
-      Serial2.println("FAN_CYCLE_STATE:" + String(fanCycleState ? "ON" : "OFF") + "," + String(elapsedTime) + "," + String(accuracy, 2));
-    }
-  }
-  
-  // 🔥 ULTRA-PRECISE EC PUMP TIMING - ตรวจสอบทุก loop
-  if (ecPumpRunning && ecPumpDuration > 0 && ecPumpStartTime > 0) {
-    unsigned long elapsedTime;
-    
-    // ป้องกัน overflow
-    if (currentTime >= ecPumpStartTime) {
-      elapsedTime = currentTime - ecPumpStartTime;
-    } else {
-      elapsedTime = (0xFFFFFFFF - ecPumpStartTime) + currentTime + 1;
-    }
-    
-    // DEBUG: แสดงสถานะปัจจุบันทุก 2 วินาที
+
+  // DEBUG: แสดงสถานะปั๊ม EC ทุก 2 วินาทีขณะทำงาน (ถูกตัดทิ้งตอนคอมไพล์ถ้า LOG_LEVEL < DEBUG)
+  uint32_t progressElapsed, progressTarget;
+  if (actuatorProgress(EC_PUMP_RELAY, progressElapsed, progressTarget)) {
     static unsigned long lastDebugTime = 0;
     if (currentTime - lastDebugTime >= 2000) { // ทุก 2 วินาที
       lastDebugTime = currentTime;
-      Serial.println("🔍 EC Pump ULTRA-PRECISE DEBUG:");
-      Serial.println("   - Running: " + String(ecPumpRunning));
-      Serial.println("   - Duration: " + String(ecPumpDuration) + " ms");
-      Serial.println("   - Start Time: " + String(ecPumpStartTime) + " ms");
-      Serial.println("   - Current Time: " + String(currentTime) + " ms");
-      Serial.println("   - Elapsed: " + String(elapsedTime) + " ms");
-      Serial.println("   - Remaining: " + String(ecPumpDuration - elapsedTime) + " ms");
-      Serial.println("   - Progress: " + String((elapsedTime * 100.0 / ecPumpDuration), 1) + "%");
+      LOG_DEBUG("EC pump: %lu/%lu ms (remaining %lu ms)",
+                (unsigned long)progressElapsed, (unsigned long)progressTarget,
+                (unsigned long)(progressTarget - progressElapsed));
     }
-    
-    // 🔥 ULTRA-PRECISE: ตรวจสอบเวลาทุก loop (ไม่ใช่ทุก 1 วินาที)
-    if (elapsedTime >= ecPumpDuration) {
-      // ปิดปั๊ม EC ทันที (K7 = position 6)
-      relayStates[6] = false; // K7 OFF
-      if (relayActiveHigh[6]) {
-        digitalWrite(relayPins[6], LOW);
-      } else {
-        digitalWrite(relayPins[6], HIGH);
-      }
-      
-      ecPumpRunning = false;
-      
-      // คำนวณความแม่นยำแบบ Ultra-Precise
-      float accuracy = 100.0 - (abs((long)(elapsedTime - ecPumpDuration)) * 100.0 / ecPumpDuration);
-      long timingError = abs((long)(elapsedTime - ecPumpDuration));
-      
-      Serial.println("🧪 MEGA EC Pump: ULTRA-PRECISE STOP!");
-      Serial.println("   - Target Duration: " + String(ecPumpDuration) + " ms");
-      Serial.println("   - Actual Duration: " + String(elapsedTime) + " ms");
-      Serial.println("   - Timing Error: ±" + String(timingError) + " ms");
-      Serial.println("   - Timing Accuracy: " + String(accuracy, 2) + "%");
-      
-      if (timingError <= 1) {
-        Serial.println("🎯 PERFECT TIMING: Error ≤ 1ms (Ultra-Precise!)");
-      } else if (timingError <= 5) {
-        Serial.println("✅ EXCELLENT TIMING: Error ≤ 5ms (Very Good!)");
-      } else if (timingError <= 10) {
-        Serial.println("👍 GOOD TIMING: Error ≤ 10ms (Acceptable)");
-      } else {
-        Serial.println("⚠️ TIMING WARNING: Error > 10ms (Needs improvement)");
+  }
+
+  ActuatorEvent event;
+  while (actuatorPopEvent(event)) {
+    unsigned long elapsedTime = event.elapsedMs;
+    long timingError = abs((long)(event.elapsedMs - event.targetMs));
+
+    if (event.kind == ACTUATOR_CYCLE_SWITCH) {
+      // ตรวจสอบวงจร ON/OFF (Internal Fan หรือ relay อื่นที่สั่งด้วย FAN_TIMING)
+      LOG_INFO("🌀 K%d cycle: %s after %lu ms (target %lu ms, error ±%ld ms)", event.relay + 1,
+               event.state ? "ON" : "OFF", elapsedTime, (unsigned long)event.targetMs, timingError);
+
+    } else if (event.kind == ACTUATOR_MAX_RUN) {
+      // ถึงเพดานเวลาทำงานรวม: relay ถูกปิดและช่องหยุดแล้ว
+      LOG_WARN("⏹️ K%d reached max run %lu ms, stopped", event.relay + 1, (unsigned long)event.targetMs);
+
+    } else if (event.relay == EC_PUMP_RELAY) {
+      // 🔥 ULTRA-PRECISE EC PUMP: K7 ถูกปิดใน ISR ตรงเวลาแล้ว
+      LOG_INFO("🧪 EC Pump STOP: %lu ms (target %lu ms, error ±%ld ms)",
+               elapsedTime, (unsigned long)event.targetMs, timingError);
+      if (timingError > 10) {
+        LOG_WARN("⚠️ TIMING WARNING: Error > 10ms");
       }
-      
-      // ส่งสถานะกลับไป ESP32 พร้อมข้อมูลแม่นยำ
-      Serial2.println("EC_PUMP_STOPPED:" + String(elapsedTime) + "," + String(ecPumpDuration) + "," + String(accuracy, 2) + "," + String(timingError));
+
+    } else if (event.relay == PH_PUMP_RELAY) {
+      // ปั๊ม PH: K6 ถูกปิดใน ISR ตรงเวลาแล้ว
+      LOG_INFO("🧪 PH Pump STOP: %lu ms (target %lu ms, error ±%ld ms)",
+               elapsedTime, (unsigned long)event.targetMs, timingError);
+
+    } else {
+      // pulse ของ relay อื่น (PUMP_TIMING:K<n>,ms)
+      LOG_INFO("⏱️ K%d pulse STOP: %lu ms (target %lu ms, error ±%ld ms)", event.relay + 1,
+               elapsedTime, (unsigned long)event.targetMs, timingError);
     }
+
+    // ส่งสถานะกลับไป ESP32 (หรือเข้าคิวถ้าลิงก์ขาด)
+    reportActuatorEvent(event);
   }
-  
-  // ตรวจสอบปั๊ม PH
-  if (phPumpRunning && phPumpDuration > 0 && phPumpStartTime > 0) {
-    unsigned long elapsedTime;
-    
-    // ป้องกัน overflow
-    if (currentTime >= phPumpStartTime) {
-      elapsedTime = currentTime - phPumpStartTime;
-    } else {
-      elapsedTime = (0xFFFFFFFF - phPumpStartTime) + currentTime + 1;
+}
+
+// บรรทัดรายงานเหตุการณ์ของ actuator ไปยัง ESP32 (ใช้ทั้งตอนเกิดและตอนส่งซ้ำจากคิว)
+void printActuatorEvent(const ActuatorEvent& event) {
+  unsigned long elapsedTime = event.elapsedMs;
+  long timingError = abs((long)(event.elapsedMs - event.targetMs));
+  float accuracy = 100.0 - (timingError * 100.0 / event.targetMs);
+
+  if (event.kind == ACTUATOR_CYCLE_SWITCH) {
+    // ต่อท้ายด้วย relay เพราะหลายวงจรทำงานพร้อมกันได้
+    Serial2.print(F("FAN_CYCLE_STATE:")); Serial2.print(event.state ? F("ON") : F("OFF"));
+    Serial2.print(','); Serial2.print(elapsedTime);
+    Serial2.print(','); Serial2.print(accuracy, 2);
+    Serial2.print(F(",K")); Serial2.println(event.relay + 1);
+
+  } else if (event.kind == ACTUATOR_MAX_RUN) {
+    Serial2.print(F("TIMER_MAX_RUN:K")); Serial2.print(event.relay + 1);
+    Serial2.print(','); Serial2.println(elapsedTime);
+
+  } else if (event.relay == EC_PUMP_RELAY) {
+    // ส่งสถานะพร้อมข้อมูลแม่นยำ
+    Serial2.print(F("EC_PUMP_STOPPED:")); Serial2.print(elapsedTime);
+    Serial2.print(','); Serial2.print(event.targetMs);
+    Serial2.print(','); Serial2.print(accuracy, 2);
+    Serial2.print(','); Serial2.println(timingError);
+
+  } else if (event.relay == PH_PUMP_RELAY) {
+    Serial2.print(F("PH_PUMP_STOPPED:")); Serial2.print(elapsedTime);
+    Serial2.print(','); Serial2.print(event.targetMs);
+    Serial2.print(','); Serial2.println(accuracy, 2);
+
+  } else {
+    Serial2.print(F("PUMP_STOPPED:K")); Serial2.print(event.relay + 1);
+    Serial2.print(','); Serial2.print(elapsedTime);
+    Serial2.print(','); Serial2.print(event.targetMs);
+    Serial2.print(','); Serial2.println(accuracy, 2);
+  }
+}
+
+// === CLOSED-LOOP DOSING ===
+// ตัดสินใจเมื่อมีค่าที่วัดหลังผสมครบเวลา แล้วสั่ง pulse ผ่านตารางเดียวกับ PUMP_TIMING (ISR ปิดตรงเวลา)
+// ปั๊มที่ ESP32 สั่งเองอยู่ถือว่าไม่ว่าง ตัวควบคุมจะรอ ไม่สั่งซ้อน
+void serviceDosing() {
+  unsigned long now = millis();
+  for (uint8_t i = 0; i < DOSE_CHANNEL_COUNT; i++) {
+    uint8_t relay = dosePumpRelays[i];
+    uint32_t duration = dosing[i].poll(now, actuatorActive(relay));
+    if (duration > 0) {
+      actuatorStartPulse(relay, duration);
     }
-    
-    if (elapsedTime >= phPumpDuration) {
-      // ปิดปั๊ม PH ทันที (K6 = position 5)
-      relayStates[5] = false; // K6 OFF
-      if (relayActiveHigh[5]) {
-        digitalWrite(relayPins[5], LOW);
-      } else {
-        digitalWrite(relayPins[5], HIGH);
-      }
-      
-      phPumpRunning = false;
-      
-      // คำนวณความแม่นยำ
-      float accuracy = 100.0 - (abs((long)(elapsedTime - phPumpDuration)) * 100.0 / phPumpDuration);
-      Serial.println("🧪 MEGA PH Pump: ULTRA-PRECISE STOP after " + String(elapsedTime) + " ms (Target: " + String(phPumpDuration) + " ms)");
-      Serial.println("⚡ Timing Accuracy: " + String(accuracy, 2) + "% (Error: ±" + String(abs((long)(elapsedTime - phPumpDuration))) + "ms)");
-      
-      // ส่งสถานะกลับไป ESP32
-      Serial2.println("PH_PUMP_STOPPED:" + String(elapsedTime) + "," + String(phPumpDuration) + "," + String(accuracy, 2));
+    DoseEvent event;
+    while (dosing[i].popEvent(event)) {
+      LOG_INFO("🧪 Dose %s step %d: value %ld ref %ld amount %lu", i == DOSE_EC ? "EC" : "PH", event.step,
+               (long)event.value, (long)event.reference, (unsigned long)event.amount);
+      reportDoseEvent(event);
     }
   }
 }
 
-// ฟังก์ชันตรวจสอบและคำนวณอัตราการไหลของน้ำ
-void checkFlowSensors() {
-  // ตรวจสอบเซนเซอร์ที่ 1
-  currentState1 = digitalRead(FLOW_SENSOR_1);
-  if (lastState1 != currentState1 && currentState1 == LOW) {
-    pulseCount1++;
+// DOSE:<EC|PH>,<PULSE|RESULT|SETTLED|LIMIT|FAULT>,<value>,<reference>,<amount> (ความหมายตาม DosingStep)
+void printDoseEvent(const DoseEvent& event) {
+  Serial2.print(event.channel == DOSE_EC ? F("DOSE:EC,") : F("DOSE:PH,"));
+  switch (event.step) {
+    case DOSE_STEP_PULSE:   Serial2.print(F("PULSE")); break;
+    case DOSE_STEP_RESULT:  Serial2.print(F("RESULT")); break;
+    case DOSE_STEP_SETTLED: Serial2.print(F("SETTLED")); break;
+    case DOSE_STEP_LIMIT:   Serial2.print(F("LIMIT")); break;
+    default:                Serial2.print(F("FAULT")); break;
   }
-  lastState1 = currentState1;
-  
-  // ตรวจสอบเซนเซอร์ที่ 2
-  currentState2 = digitalRead(FLOW_SENSOR_2);
-  if (lastState2 != currentState2 && currentState2 == LOW) {
-    pulseCount2++;
-  }
-  lastState2 = currentState2;
-  
-  // ตรวจสอบเซนเซอร์ที่ 3
-  currentState3 = digitalRead(FLOW_SENSOR_3);
-  if (lastState3 != currentState3 && currentState3 == LOW) {
-    pulseCount3++;
+  Serial2.print(',');
+  Serial2.print(event.value);
+  Serial2.print(',');
+  Serial2.print(event.reference);
+  Serial2.print(',');
+  Serial2.println(event.amount);
+}
+
+// === LOCAL RELAY RULES ===
+// เรียกทันทีหลังค่าของ updatedFields เปลี่ยน (Modbus/PZEM อ่านสำเร็จ, flow ทุก 1 วินาที)
+// ค่าที่ไม่สดไม่ถูกตัดสินซ้ำ relay จึงคงสถานะล่าสุดเมื่อเซ็นเซอร์หาย
+void evaluateRelayRules(uint32_t updatedFields) {
+  if (!(ruleEngine.fieldMask() & updatedFields)) {
+    return;
   }
-  lastState3 = currentState3;
-  
-  // คำนวณอัตราการไหลทุก 1 วินาที
-  if ((millis() - oldTime) > 1000) {
-    // คำนวณอัตราการไหล (ลิตร/นาที)
-    flowRate1 = (pulseCount1 / calibrationFactor);
-    flowRate2 = (pulseCount2 / calibrationFactor);
-    flowRate3 = (pulseCount3 / calibrationFactor);
-    
-    // คำนวณปริมาณน้ำที่ไหลในช่วง 1 วินาที (มิลลิลิตร)
-    float flowMilliLitres1 = (flowRate1 / 60) * 1000;
-    float flowMilliLitres2 = (flowRate2 / 60) * 1000;
-    float flowMilliLitres3 = (flowRate3 / 60) * 1000;
-    
-    // รวมปริมาณน้ำสะสม
-    totalMilliLitres1 += flowMilliLitres1;
-    totalMilliLitres2 += flowMilliLitres2;
-    totalMilliLitres3 += flowMilliLitres3;
-    
-    // รีเซ็ตตัวแปรพัลส์
-    pulseCount1 = 0;
-    pulseCount2 = 0;
-    pulseCount3 = 0;
-    oldTime = millis();
-    
-    // แสดงข้อมูลเซนเซอร์วัดอัตราการไหลแบบสั้น (เฉพาะเมื่อมีการไหล)
-    if (flowRate1 > 0 || flowRate2 > 0 || flowRate3 > 0) {
-      Serial.print("Flow: ");
-      Serial.print(flowRate1, 1); Serial.print(",");
-      Serial.print(flowRate2, 1); Serial.print(",");
-      Serial.print(flowRate3, 1); Serial.println(" L/min");
+  TelemetryFrameV1 frame;
+  buildTelemetryFrame(frame);
+  unsigned long now = millis();
+  for (uint8_t i = 0; i < RULE_MAX; i++) {
+    const RelayRule& rule = ruleEngine.rule(i);
+    // ตารางจับเวลาคุม relay อยู่: รอให้หมดเวลาก่อน แล้วตัดสินจากค่าถัดไป
+    if (rule.field == RULE_NONE || !(updatedFields & (1UL << rule.field)) || actuatorActive(rule.relay)) {
+      continue;
     }
+    RuleSwitchEvent event;
+    event.relay = rule.relay;
+    event.value = (int32_t)telemetryFieldValue(frame, rule.field);
+    if (!ruleEngine.evaluate(i, event.value, relayIsOn(rule.relay), now, event.on)) {
+      continue;
+    }
+    relaySet(rule.relay, event.on);
+    LOG_INFO("📏 Rule K%d %s (value %ld)", rule.relay + 1, event.on ? "ON" : "OFF", (long)event.value);
+    reportRuleEvent(event);
   }
 }
 
-// ฟังก์ชันทดสอบการเชื่อมต่อกับเซ็นเซอร์ AC Power
-void testACPowerSensor() {
-  Serial.println("\n-- ทดสอบ AC Power Sensor (PZEM-004T) --");
-  float voltage = pzem.voltage();
-  
-  if (isnan(voltage)) {
-    acSensorConnected = false;
-    Serial.println("❌ ไม่สามารถเชื่อมต่อกับ AC Power Sensor ได้");
-  } else if (voltage >= 999999) {
-    acSensorConnected = true;
-    Serial.println("⚠️ พบ overflow (ไม่มีโหลด/เชื่อมต่อผิด)");
-  } else {
-    acSensorConnected = true;
-    Serial.println("✅ เชื่อมต่อสำเร็จ แรงดัน: " + String(voltage) + " V");
+// RULE_SWITCH:K<n>,<ON|OFF>,<ค่าที่ทำให้สลับ>
+void printRuleEvent(const RuleSwitchEvent& event) {
+  Serial2.print(F("RULE_SWITCH:K"));
+  Serial2.print(event.relay + 1);
+  Serial2.print(event.on ? F(",ON,") : F(",OFF,"));
+  Serial2.println(event.value);
+}
+
+// Timer3 ทุก 1 ms: เดินเวลาปั๊ม/พัดลม และสุ่มอ่าน flow sensor (env:native: HAL เรียกตามเวลาจำลอง)
+#if defined(ARDUINO_ARCH_AVR) || defined(NATIVE_HAL)
+ISR(TIMER3_COMPA_vect) {
+  actuatorTimerTick();
+  flowCounterSample();
+}
+#endif
+
+// ปริมาณน้ำสะสมของช่อง channel (mL)
+uint32_t flowTotalMilliLitres(uint8_t channel) {
+  return FlowVolumeConversion::convert(flowPulseTotal[channel]);
+}
+
+// ฟังก์ชันคำนวณอัตราการไหลของน้ำจาก snapshot ของตัวนับพัลส์
+void checkFlowSensors() {
+  // คำนวณอัตราการไหลทุก 1 วินาที
+  if (millis() - lastFlowSnapshot.timeMs <= 1000) {
+    return;
+  }
+
+  FlowSnapshot snapshot;
+  flowCounterSnapshot(snapshot);
+
+  // ใช้ผลต่างระหว่าง snapshot (ตัวนับสะสมไม่ถูกรีเซ็ต จึงไม่มีพัลส์หายระหว่างอ่าน)
+  unsigned long windowMs = snapshot.timeMs - lastFlowSnapshot.timeMs;
+  bool flowing = false;
+  for (uint8_t i = 0; i < FLOW_CHANNELS; i++) {
+    uint32_t pulses = snapshot.pulses[i] - lastFlowSnapshot.pulses[i];
+    // อัตราการไหล (L/min x100) จากความถี่พัลส์จริงในช่วงเวลานี้
+    flowRate[i] = fixedRate<60000UL * 100, FLOW_PULSES_PER_LITRE>(pulses, windowMs);
+    // เก็บเป็นพัลส์สะสม แปลงเป็น mL ตอนส่ง จึงไม่มีเศษปัดสะสม
+    flowPulseTotal[i] += pulses;
+    flowing = flowing || flowRate[i] > 0;
+  }
+  lastFlowSnapshot = snapshot;
+  evaluateRelayRules(telemetryGroupFields(TELEMETRY_GROUP_FLOW));
+
+  // แสดงข้อมูลเซนเซอร์วัดอัตราการไหลแบบสั้น (เฉพาะเมื่อมีการไหล)
+  if (flowing) {
+    LOG_INFO("Flow: %s,%s,%s L/min",
+             logFixed(flowRate[0], 2), logFixed(flowRate[1], 2), logFixed(flowRate[2], 2));
   }
 }
 
-// ฟังก์ชันอ่านค่าจาก AC Power Sensor (PZEM-004T)
-void readACPowerSensor() {
-  if (!acSensorConnected) {
-    // ลองเชื่อมต่อใหม่เมื่อไม่สามารถเชื่อมต่อได้
-    static unsigned long lastReconnectAttempt = 0;
-    if (millis() - lastReconnectAttempt >= 10000) { // ลองเชื่อมต่อใหม่ทุก 10 วินาที
-      lastReconnectAttempt = millis();
-      testACPowerSensor();
+// ฟังก์ชันอ่านค่าจาก AC Power Sensor (PZEM-004T) แบบ non-blocking
+// เริ่มอ่านทุก AC_READ_INTERVAL (หรือ AC_RECONNECT_INTERVAL เมื่อมิเตอร์ไม่ตอบ) แล้วรับผลในรอบถัดๆ ไป
+void pollACPowerSensor() {
+  if (pzem.poll()) {
+    bool ok = (pzem.result() == ModbusRtuMaster::ku8MBSuccess);
+    if (pzem.completed() == PzemMeter::OP_READ) {
+      if (ok) {
+        const PzemReading& reading = pzem.reading();
+        acVoltage = reading.voltage;
+        acCurrent = reading.current;
+        acPower = reading.power;
+        acEnergy = reading.energy;
+        acFrequency = reading.frequency;
+        acPowerFactor = reading.pf;
+        if (!acSensorConnected) {
+          LOG_INFO("✅ PZEM-004T เชื่อมต่อสำเร็จ แรงดัน: %s V", logFixed(acVoltage, 1));
+        }
+        evaluateRelayRules(telemetryGroupFields(TELEMETRY_GROUP_AC));
+      } else if (acSensorConnected) {
+        LOG_WARN("❌ AC Power Sensor (PZEM-004T) ไม่ตอบสนอง (0x%02X)", pzem.result());
+      }
+      acSensorConnected = ok;
+    } else if (pzem.completed() == PzemMeter::OP_RESET_ENERGY) {
+      if (ok) {
+        acEnergy = 0;
+        LOG_INFO("PZEM-004T reset energy สำเร็จ");
+      } else {
+        LOG_WARN("PZEM-004T reset energy ล้มเหลว (0x%02X)", pzem.result());
+      }
     }
+  }
+
+  unsigned long interval = acSensorConnected ? AC_READ_INTERVAL : AC_RECONNECT_INTERVAL;
+  if (!pzem.isBusy() && (lastAcReadTime == 0 || millis() - lastAcReadTime >= interval)) {
+    lastAcReadTime = millis();
+    pzem.requestRead();
+  }
+}
+
+// ส่ง probe ตามคาบ, นับ probe ที่หมดเวลา และตัดสินว่าลิงก์ขาด/กลับมา
+void serviceEsp32Link() {
+  unsigned long now = millis();
+  if (esp32Link.probesSent() == 0 || now - lastHeartbeat >= HEARTBEAT_INTERVAL) {
+    lastHeartbeat = now;
+    Serial2.println(F("MEGA_TEST"));
+    esp32Link.probeSent(now);
+  }
+  esp32Link.poll(now, HEARTBEAT_TIMEOUT);
+
+  bool lost = esp32Link.silenceMs(now) >= LINK_SILENCE_LIMIT;
+  if (lost == esp32LinkLost) {
     return;
   }
-  
-  // อ่านค่าทั้งหมด
-  float voltage = pzem.voltage();
-  float current = pzem.current();
-  float power = pzem.power();
-  float energy = pzem.energy();
-  float frequency = pzem.frequency();
-  float pf = pzem.pf();
-  
-  // ตรวจสอบการเชื่อมต่อ
-  if (isnan(voltage) && isnan(current) && isnan(power) && isnan(energy) && isnan(frequency) && isnan(pf)) {
-    acSensorConnected = false;
+  esp32LinkLost = lost;
+  if (lost) {
+    LOG_WARN("❌ ESP32 link lost (silent %lu ms)", (unsigned long)esp32Link.silenceMs(now));
     return;
   }
-  
-  // เก็บค่าโดยตรวจสอบ overflow
-  acVoltage = (!isnan(voltage) && voltage < 999999) ? voltage : 0.0;
-  acCurrent = (!isnan(current) && current < 999999) ? current : 0.0;
-  acPower = (!isnan(power) && power < 999999) ? power : 0.0;
-  acEnergy = (!isnan(energy) && energy < 999999) ? energy : 0.0;
-  acFrequency = (!isnan(frequency) && frequency < 999999) ? frequency : 0.0;
-  acPowerFactor = (!isnan(pf) && pf < 999999) ? pf : 0.0;
+  // ลิงก์กลับมา: ESP32 อาจรีบูตมา จึงส่ง keyframe รอบถัดไป และเริ่มส่งคิวซ้ำจาก record แรก
+  LOG_INFO("✅ ESP32 link restored");
+  lastKeyframeTime = now - KEYFRAME_INTERVAL;
+  replayInFlight = 0;
+  snapshotQueued = false;
+  if (!outbox.empty()) {
+    LOG_INFO("📦 Replaying %d queued messages", outbox.size());
+  }
 }
 
-// ฟังก์ชันทดสอบการสื่อสารกับ ESP32
-void testESP32Communication() {
-  Serial.println("\n---- ทดสอบการสื่อสารกับ ESP32 ----");
+// === NON-BLOCKING MODBUS SENSOR POLLING ===
+// ตารางคำขอของแต่ละเซ็นเซอร์ แต่ละตัวมีคาบของตัวเองตาม busScheduler (ดู poll_scheduler.h)
+// ส่งทีละคำขอ แล้วเรียก handler เมื่อได้คำตอบ และรายงานค่าที่เฝ้าดูให้ scheduler ปรับคาบ
+struct ModbusSensorJob {
+  uint8_t slaveId;
+  uint8_t function;   // 0x03 = Holding, 0x04 = Input
+  uint16_t address;
+  uint16_t quantity;
+  uint32_t (*handler)(uint8_t result);   // คืนฟิลด์ที่ได้ค่าวัดจริงจากคำตอบนี้
+  int32_t (*watchValue)();   // ค่าที่ใช้ตัดสินความเร็วในการอ่าน (หน่วยเดียวกับ telemetry)
+  uint8_t staleFlag;         // TELEMETRY_FLAG_STALE_* ของฟิลด์จาก slave นี้
+  uint32_t fields;           // TelemetryField ที่ slave นี้ให้ค่า (ตัดสินกฎ relay เฉพาะที่ handler คืนมา)
+};
+
+// === SENSOR FILTERS ===
+// ค่าที่เก็บใน co2Ppm/luxValue/ecValue/phValue คือค่าที่กรองแล้ว ค่าดิบอยู่ใน sensorFilters[].raw()
+// ปรับได้ด้วย FILTER: ดูสถานะด้วย FILTERS (ดู SENSOR_FILTERS.md)
+SensorFilter sensorFilters[FILTER_CHANNEL_COUNT];
+uint16_t filterCostMaxUs = 0;   // เวลาที่ใช้กรอง 1 ตัวอย่างนานสุด
+
+// median, emaShift, maxRatePerSec (ลำดับเดียวกับ FilterChannel)
+const FilterConfig defaultFilterConfigs[FILTER_CHANNEL_COUNT] = {
+  {3, 2, 0},   // CO2: ค่าแกว่งตามลมหายใจ/พัดลม
+  {1, 0, 0},   // แสง: คุม K1 ต้องตามทันทันที
+  {3, 0, 0},   // EC: ตัดค่าโดดหลังเติมปุ๋ย
+  {3, 0, 0},   // pH: ตัดค่าโดดหลังเติมกรด/ด่าง
+};
+
+int32_t filterSample(uint8_t channel, int32_t raw) {
+  uint32_t start = micros();
+  int32_t value = sensorFilters[channel].update(raw, millis());
+  uint32_t cost = micros() - start;
+  if (cost > filterCostMaxUs) {
+    filterCostMaxUs = cost > 65535UL ? 65535 : (uint16_t)cost;
+  }
+  return value;
+}
 
-  // ล้าง buffer เพื่อเริ่มต้นใหม่
-  while (Serial2.available() > 0) {
-    Serial2.read();
+// scheduler ดูค่าดิบ: ค่าที่กระโดดทำให้อ่านถี่ขึ้น median จึงยืนยันหรือตัดทิ้งได้เร็ว
+int32_t watchAirTemp() { return airTemp; }                                 // °C x10 (K2/K3 hysteresis)
+int32_t watchLux() { return sensorFilters[FILTER_LIGHT].raw(); }          // lux (K1 light)
+int32_t watchEc() { return sensorFilters[FILTER_EC].raw(); }              // µS/cm x10
+int32_t watchPh() { return sensorFilters[FILTER_PH].raw(); }              // pH x100
+
+#define FIELD_BIT(field) (1UL << (field))
+
+const ModbusSensorJob sensorJobs[] = {
+  {1, 0x04, 0x0000, 4, readCO2Sensor, watchAirTemp, TELEMETRY_FLAG_STALE_AIR,    // register 0-3: -, Temp x10, Humidity x10, CO2
+   FIELD_BIT(TELEMETRY_FIELD_CO2) | FIELD_BIT(TELEMETRY_FIELD_AIR_TEMP) | FIELD_BIT(TELEMETRY_FIELD_AIR_HUMIDITY)},
+  {2, 0x04, 0x0001, 2, readLightSensor, watchLux, TELEMETRY_FLAG_STALE_LIGHT,    // lux low/high word
+   FIELD_BIT(TELEMETRY_FIELD_LUX)},
+  {3, 0x03, 0x0000, 2, readECSensor, watchEc, TELEMETRY_FLAG_STALE_EC,           // calibration, EC raw
+   FIELD_BIT(TELEMETRY_FIELD_EC)},
+  {4, 0x03, 0x0000, 3, readPHSensor, watchPh, TELEMETRY_FLAG_STALE_PH,           // water temp, pH, ID
+   FIELD_BIT(TELEMETRY_FIELD_PH) | FIELD_BIT(TELEMETRY_FIELD_WATER_TEMP)},
+};
+const uint8_t SENSOR_JOB_COUNT = sizeof(sensorJobs) / sizeof(sensorJobs[0]);
+
+// ค่าเริ่มต้นของแต่ละเซ็นเซอร์ (ลำดับเดียวกับ sensorJobs) ปรับได้ด้วย POLL: / POLL_WATCH:
+// min, max, priority, jitter, threshold, band, delta
+const PollConfig defaultPollConfigs[SENSOR_JOB_COUNT] = {
+  {1000, 10000, 1, 500, 0, 0, 5},       // CO2/อากาศ: เปลี่ยนระดับสิบวินาที, เร่งเมื่อ Temp เปลี่ยน >= 0.5 °C
+  {1000, 5000, 0, 200, 0, 0, 500},      // แสง: คุม K1 จึงสำคัญสุด
+  {2000, 30000, 2, 2000, 0, 0, 50},     // EC: เปลี่ยนระดับนาที, เร่งเมื่อเปลี่ยน >= 5 µS/cm
+  {2000, 30000, 2, 2000, 0, 0, 10},     // pH: เร่งเมื่อเปลี่ยน >= 0.1
+};
+
+PollScheduler busScheduler;
+SlaveHealth sensorHealth[SENSOR_JOB_COUNT]; // ลำดับเดียวกับ sensorJobs
+uint8_t activeSensorJob = POLL_NONE; // งานที่กำลังรอคำตอบ
+
+// flag ของฟิลด์ที่ค่าไม่สดแล้ว (TELEMETRY_FLAG_STALE_*)
+uint8_t staleSensorFlags() {
+  uint8_t flags = 0;
+  for (uint8_t i = 0; i < SENSOR_JOB_COUNT; i++) {
+    if (sensorHealth[i].stale()) flags |= sensorJobs[i].staleFlag;
   }
+  return flags;
+}
 
-  // ส่งคำขอทดสอบการสื่อสาร
-  Serial2.println("MEGA_TEST");
+// หา index ในตาราง sensorJobs จาก Modbus ID (คืนค่า POLL_NONE ถ้าไม่พบ)
+uint8_t sensorJobForSlave(int32_t slaveId) {
+  for (uint8_t i = 0; i < SENSOR_JOB_COUNT; i++) {
+    if (sensorJobs[i].slaveId == slaveId) return i;
+  }
+  return POLL_NONE;
+}
 
-  // รอการตอบกลับไม่เกิน 1 วินาที
-  unsigned long startTime = millis();
-  bool responseReceived = false;
+void initSensorPolling() {
+  for (uint8_t i = 0; i < SENSOR_JOB_COUNT; i++) {
+    busScheduler.add(defaultPollConfigs[i]);
+  }
+  for (uint8_t i = 0; i < FILTER_CHANNEL_COUNT; i++) {
+    sensorFilters[i].configure(defaultFilterConfigs[i]);
+  }
+}
 
-  while (millis() - startTime < 1000 && !responseReceived) {
-    if (Serial2.available() > 0) {
-      String response = Serial2.readStringUntil('\n');
-      Serial.println("ESP32 ตอบกลับ: " + response);
+// เรียกทุก loop: เดินสถานะ Modbus และส่งคำขอที่ครบกำหนดถัดไปโดยไม่บล็อก
+void pollModbusSensors() {
+  if (modbus.poll() && activeSensorJob != POLL_NONE) {
+    const ModbusSensorJob& job = sensorJobs[activeSensorJob];
+    SlaveHealth& health = sensorHealth[activeSensorJob];
+    uint8_t result = modbus.result();
+    uint32_t measured = job.handler(result) & job.fields;
+
+    if (result == ModbusRtuMaster::ku8MBSuccess) {
+      if (health.offline()) {
+        LOG_INFO("✅ Modbus ID%d back online after %u failures", job.slaveId, health.consecutiveFailures);
+      }
+      health.recordSuccess(millis());
+      busScheduler.reportValue(activeSensorJob, job.watchValue());
+      evaluateRelayRules(measured);   // ฟิลด์ที่ไม่มีการวัดจริง (ค่า 0) ไม่ถูกตัดสิน
+    } else {
+      health.recordFailure(result);
+      if (health.consecutiveFailures == SLAVE_OFFLINE_FAILURES) {
+        LOG_WARN("⚠️ Modbus ID%d offline, backing off", job.slaveId);
+      }
+      // ค่าเดิมยังอยู่ (ถูกตั้ง stale) และลองใหม่ห่างขึ้นเรื่อยๆ จนกว่าจะตอบ
+      busScheduler.retryAfter(activeSensorJob, health.retryDelayMs(busScheduler.periodMs(activeSensorJob)));
+    }
+    activeSensorJob = POLL_NONE;
+  }
 
-      // ✅ แก้ตรงนี้: ยอมรับได้ทั้ง "ESP32_OK" และ "ESP32_TEST"
-      if (response.indexOf("ESP32_OK") >= 0 || response.indexOf("ESP32_TEST") >= 0) {
-        communicationOK = true;
-        responseReceived = true;
-        Serial.println("✅ การสื่อสารกับ ESP32 ปกติ");
+  if (!modbus.isBusy()) {
+    uint32_t now = millis();
+    uint8_t next = busScheduler.next(now);
+    if (next != POLL_NONE) {
+      const ModbusSensorJob& job = sensorJobs[next];
+      bool sent;
+      if (job.function == 0x04) {
+        sent = modbus.readInputRegisters(job.slaveId, job.address, job.quantity);
+      } else {
+        sent = modbus.readHoldingRegisters(job.slaveId, job.address, job.quantity);
+      }
+      if (sent) {
+        activeSensorJob = next;
+        busScheduler.started(next, now);
       }
     }
-    delay(10);
   }
 
-  if (!responseReceived) {
-    communicationOK = false;
-    Serial.println("❌ ไม่ได้รับการตอบกลับจาก ESP32");
+  // ระดับน้ำและสรุปค่าทุก READ_INTERVAL (ไม่ขึ้นกับคาบของแต่ละเซ็นเซอร์)
+  if (millis() - lastReadTime >= READ_INTERVAL) {
+    lastReadTime = millis();
+    readWaterLevel();
+    printAllValues();
+    recordHistorySamples();
   }
 }
 
-// ฟังก์ชันอ่านค่าจาก CO2 Sensor (ID 1)
-void readCO2Sensor() {
-  Serial.println("\n--- อ่านค่าจาก CO2 Sensor (ID 1) ---");
-
-  // อ่าน 4 รีจิสเตอร์ (register 0 ถึง 3)
-  uint8_t result = co2Sensor.readInputRegisters(0x0000, 4);
-
-  if (result == co2Sensor.ku8MBSuccess) {
+// ฟังก์ชันประมวลผลค่าจาก CO2 Sensor (ID 1)
+uint32_t readCO2Sensor(uint8_t result) {
+  if (result == ModbusRtuMaster::ku8MBSuccess) {
     // แสดงค่าดิบเพื่อ debug
-    Serial.println("Raw values:");
-    for (uint8_t i = 0; i < 4; i++) {
-      Serial.print("Register ");
-      Serial.print(i);
-      Serial.print(": ");
-      Serial.println(co2Sensor.getResponseBuffer(i));
-    }
+    LOG_DEBUG("CO2 raw: %u %u %u %u", modbus.getResponseBuffer(0), modbus.getResponseBuffer(1),
+              modbus.getResponseBuffer(2), modbus.getResponseBuffer(3));
 
     // ถอดรหัสค่าจากรีจิสเตอร์:
     // - Register 1: Temperature (x10)
     // - Register 2: Humidity (x10)
     // - Register 3: CO2 (ppm)
-    airTemp = co2Sensor.getResponseBuffer(1) / 10.0;
-    airHumidity = co2Sensor.getResponseBuffer(2) / 10.0;
-    co2Ppm = co2Sensor.getResponseBuffer(3);
-
-    // แสดงค่าที่ถอดรหัสแล้ว
-    Serial.print("🌡️ อุณหภูมิ: ");
-    Serial.print(airTemp);
-    Serial.println(" °C");
-
-    Serial.print("💧 ความชื้น: ");
-    Serial.print(airHumidity);
-    Serial.println(" %RH");
-
-    Serial.print("🫁 CO2: ");
-    Serial.print(co2Ppm);
-    Serial.println(" ppm");
-
-    Serial.println("✅ อ่านข้อมูล CO2 Sensor สำเร็จ");
-
-  } else {
-    // ถ้าอ่านไม่ได้ให้เคลียร์ค่า
-    airTemp = 0.0;
-    airHumidity = 0.0;
-    co2Ppm = 0;
-
-    Serial.println("❌ ไม่สามารถอ่านข้อมูล CO2 Sensor ได้");
-    Serial.print("Error Code: ");
-    Serial.println(result);
+    airTemp = (int16_t)modbus.getResponseBuffer(1);   // ติดลบส่งแบบ two's complement
+    airHumidity = modbus.getResponseBuffer(2);
+    co2Ppm = filterSample(FILTER_CO2, modbus.getResponseBuffer(3));
+    return FIELD_BIT(TELEMETRY_FIELD_CO2) | FIELD_BIT(TELEMETRY_FIELD_AIR_TEMP) | FIELD_BIT(TELEMETRY_FIELD_AIR_HUMIDITY);
   }
+  // ค่าเดิมคงไว้ sensorHealth ตั้ง flag stale ให้ telemetry เอง
+  LOG_WARN("❌ CO2 Sensor (ID 1) error 0x%02X", result);
+  return 0;
 }
 
-// ฟังก์ชันอ่านค่าจาก Light Sensor (ID 2)
-void readLightSensor() {
-  Serial.println("\n--- อ่านค่าจาก Light Sensor (ID 2) ---");
-  uint8_t result = lightSensor.readInputRegisters(0x0001, 2);
-  
-  if (result == lightSensor.ku8MBSuccess) {
-    uint16_t luxLow = lightSensor.getResponseBuffer(0);
-    uint16_t luxHigh = lightSensor.getResponseBuffer(1);
-    luxValue = ((uint32_t)luxHigh << 16) | luxLow;
-    Serial.println("✅ อ่านข้อมูล Light Sensor สำเร็จ");
-  } else {
-    Serial.println("❌ ไม่สามารถอ่านข้อมูล Light Sensor ได้");
-    Serial.print("Error Code: ");
-    Serial.println(result);
+// ฟังก์ชันประมวลผลค่าจาก Light Sensor (ID 2)
+uint32_t readLightSensor(uint8_t result) {
+  if (result == ModbusRtuMaster::ku8MBSuccess) {
+    uint16_t luxLow = modbus.getResponseBuffer(0);
+    uint16_t luxHigh = modbus.getResponseBuffer(1);
+    luxValue = (uint32_t)filterSample(FILTER_LIGHT, (int32_t)(((uint32_t)luxHigh << 16) | luxLow));
+    return FIELD_BIT(TELEMETRY_FIELD_LUX);
   }
+  LOG_WARN("❌ Light Sensor (ID 2) error 0x%02X", result);
+  return 0;
 }
 
-// ฟังก์ชันอ่านค่าจาก EC Sensor (ID 3)
-void readECSensor() {
-  Serial.println("\n--- อ่านค่าจาก EC Sensor (ID 3) ---");
-  uint8_t result = ecSensor.readHoldingRegisters(0x00, 2);
-  
-  if (result == ecSensor.ku8MBSuccess) {
-    uint16_t ecCalibrationRaw = ecSensor.getResponseBuffer(0);
-    uint16_t ecValueRaw = ecSensor.getResponseBuffer(1);
+// ฟังก์ชันประมวลผลค่าจาก EC Sensor (ID 3)
+uint32_t readECSensor(uint8_t result) {
+  if (result == ModbusRtuMaster::ku8MBSuccess) {
+    uint16_t ecCalibrationRaw = modbus.getResponseBuffer(0);
+    uint16_t ecValueRaw = modbus.getResponseBuffer(1);
     
     // แสดงค่าดิบเพื่อดีบัก
-    Serial.print("EC Calibration Raw: ");
-    Serial.println(ecCalibrationRaw);
-    Serial.print("EC Value Raw: ");
-    Serial.println(ecValueRaw);
+    LOG_DEBUG("EC raw: calib=%u value=%u", ecCalibrationRaw, ecValueRaw);
     
     // ตรวจสอบว่าค่าเป็น 0 หรือค่าที่น้อยเกินไป (เช่น 1 ซึ่งจะกลายเป็น 0.1 เมื่อหารด้วย 10)
-    if (ecValueRaw <= 1) {
-      ecValue = 0.0;  // กำหนดค่าเป็น 0 ถ้ายังไม่มีการวัดที่แท้จริง
-      Serial.println("ℹ️ กำหนดค่า EC เป็น 0 (ยังไม่มีการวัดที่แท้จริง)");
-    } else {
-      // ขั้นตอนที่ 1: แปลงค่า raw ตามช่วงของเซ็นเซอร์
-      float rawEcValue;
-      if (isEcSensorRange4400) {
-        ecCalibration = ecCalibrationRaw / 10.0;
-        rawEcValue = ecValueRaw / 10.0;  // ค่า raw ก่อน calibration
-      } else {
-        ecCalibration = ecCalibrationRaw;
-        rawEcValue = ecValueRaw;         // ค่า raw ก่อน calibration
-      }
-      
-      // ขั้นตอนที่ 2: ใช้สมการหลัก y = 15.968x - 53.913 (R² = 0.9973)
-      ecValue = calibrateEC(rawEcValue);
-      
-      // แสดงผลการคำนวณ
-      Serial.println("=== EC CALIBRATION ===");
-      Serial.print("📊 Raw EC Input (x): ");
-      Serial.println(rawEcValue, 3);
-      Serial.print("🧮 สมการ: y = 15.968 × ");
-      Serial.print(rawEcValue, 3);
-      Serial.print(" + (-53.913)");
-      Serial.print(" = ");
-      Serial.println(ecValue, 2);
-      Serial.print("✅ Final EC Value: ");
-      Serial.print(ecValue, 2);
-      Serial.println(" µS/cm");
-      Serial.println("======================");
+    ecCalibration = ecCalibrationRaw;
+    uint16_t ecCalibrated = 0;  // 0 ถ้ายังไม่มีการวัดที่แท้จริง
+    if (ecValueRaw > 1) {
+      // ใช้สมการหลัก y = 15.968x - 53.913 (R² = 0.9973) ตามช่วงของเซ็นเซอร์
+      ecCalibrated = calibrateEC(ecValueRaw);
+      LOG_DEBUG("EC: y = 15.968 x %s - 53.913 = %s uS/cm",
+                isEcSensorRange4400 ? logFixed(ecValueRaw, 1) : logFixed(ecValueRaw, 0), logFixed(ecCalibrated, 1));
     }
-  } else {
-    Serial.println("❌ ไม่สามารถอ่านข้อมูล EC Sensor ได้");
-    Serial.print("Error Code: ");
-    Serial.println(result);
-    
-    // กำหนดค่าเป็น 0 เมื่อไม่สามารถอ่านได้
-    ecValue = 0.0;
+    if (ecCalibrated > 0) {
+      ecValue = filterSample(FILTER_EC, ecCalibrated);
+      dosing[DOSE_EC].sample(ecValue, millis());
+      return FIELD_BIT(TELEMETRY_FIELD_EC);
+    }
+    // ไม่มีการวัด: รายงาน 0 แต่ไม่ป้อนเข้าตัวกรองและกฎ relay (0 ในหน้าต่าง median จะกลบค่าจริงที่อ่านได้ถัดไป)
+    ecValue = 0;
+    return 0;
   }
+  LOG_WARN("❌ EC Sensor (ID 3) error 0x%02X", result);
+  return 0;
 }
 
-void readPHSensor() {
-  Serial.println("\n--- อ่านค่าจาก PH Sensor (ID 4) ---");
-  
-  // ตั้งค่าเริ่มต้นเป็น 0 ก่อนการอ่าน
-  phValue = 0.0;
-  waterTemp = 0.0;
-  
-  // อ่าน 3 registers เริ่มจาก register 0
-  uint8_t result = phSensor.readHoldingRegisters(0x00, 3);
-  
-  if (result == phSensor.ku8MBSuccess) {
-    uint16_t waterTempRaw = phSensor.getResponseBuffer(0); // อุณหภูมิน้ำ (register 0)
-    uint16_t phValueRaw = phSensor.getResponseBuffer(1);   // ค่า pH (register 1)
-    uint16_t idValue = phSensor.getResponseBuffer(2);      // ID (register 2)
+// ฟังก์ชันประมวลผลค่าจาก PH Sensor (ID 4)
+uint32_t readPHSensor(uint8_t result) {
+  if (result == ModbusRtuMaster::ku8MBSuccess) {
+    uint16_t waterTempRaw = modbus.getResponseBuffer(0); // อุณหภูมิน้ำ (register 0)
+    uint16_t phValueRaw = modbus.getResponseBuffer(1);   // ค่า pH (register 1)
+    uint16_t idValue = modbus.getResponseBuffer(2);      // ID (register 2)
     
     // แสดงค่าดิบเพื่อดีบัก
-    Serial.print("Water Temp Raw: ");
-    Serial.println(waterTempRaw);
-    Serial.print("pH Raw: ");
-    Serial.println(phValueRaw);
-    Serial.print("ID Value: ");
-    Serial.println(idValue);
+    LOG_DEBUG("PH raw: temp=%u ph=%u id=%u", waterTempRaw, phValueRaw, idValue);
     
     // ตรวจสอบว่าเซ็นเซอร์มีการวัดจริงหรือไม่ (ค่า raw ควรมากกว่า 10 สำหรับการวัดจริง)
+    uint32_t measured = 0;
     if (phValueRaw > 10) {  // ปรับค่านี้ตามความเหมาะสม
-      phValue = phValueRaw / 10.0;
-      Serial.print("🧪 ค่า pH: ");
-      Serial.println(phValue);
+      phValue = filterSample(FILTER_PH, PhConversion::convert(phValueRaw));
+      dosing[DOSE_PH].sample(phValue, millis());
+      measured |= FIELD_BIT(TELEMETRY_FIELD_PH);
     } else {
-      Serial.println("ℹ️ ไม่พบการวัด pH ที่ถูกต้อง (ค่า raw ต่ำเกินไป)");
+      phValue = 0;   // ไม่ป้อนเข้าตัวกรอง เช่นเดียวกับ EC
+      LOG_DEBUG("ℹ️ ไม่พบการวัด pH ที่ถูกต้อง (ค่า raw ต่ำเกินไป)");
     }
     
     if (waterTempRaw > 10) {  // ปรับค่านี้ตามความเหมาะสม
-      waterTemp = waterTempRaw / 10.0;
-      Serial.print("🌡️ อุณหภูมิน้ำ: ");
-      Serial.print(waterTemp);
-      Serial.println(" °C");
+      waterTemp = (int16_t)waterTempRaw;
+      measured |= FIELD_BIT(TELEMETRY_FIELD_WATER_TEMP);
     } else {
-      Serial.println("ℹ️ ไม่พบการวัดอุณหภูมิน้ำที่ถูกต้อง (ค่า raw ต่ำเกินไป)");
+      waterTemp = 0;
+      LOG_DEBUG("ℹ️ ไม่พบการวัดอุณหภูมิน้ำที่ถูกต้อง (ค่า raw ต่ำเกินไป)");
     }
-    
-    Serial.println("✅ อ่านข้อมูล PH Sensor สำเร็จ");
-  } else {
-    Serial.println("❌ ไม่สามารถอ่านข้อมูล PH Sensor ได้");
-    Serial.print("Error Code: ");
-    Serial.println(result);
+    return measured;
   }
+  LOG_WARN("❌ PH Sensor (ID 4) error 0x%02X", result);
+  return 0;
 }
 
 // ฟังก์ชันอ่านค่าจาก Water Level Sensor (ต่อกับขา A0)
 void readWaterLevel() {
-  Serial.println("\n--- อ่านค่าจาก Water Level Sensor (A0) ---");
   waterDetected = digitalRead(WATER_LEVEL_PIN) == 1;
-  Serial.println("✅ อ่านข้อมูล Water Level Sensor สำเร็จ");
 }
 
 // ฟังก์ชันแสดงค่าจากเซ็นเซอร์ทั้งหมด (แบบกระชับ)
 void printAllValues() {
-  // แสดงเฉพาะข้อมูลสำคัญในบรรทัดเดียว
-  Serial.print("T:");
-  Serial.print(airTemp, 1);
-  Serial.print("C H:");
-  Serial.print(airHumidity, 1);
-  Serial.print("% CO2:");
-  Serial.print(co2Ppm);
-  Serial.print("ppm Light:");
-  Serial.print(luxValue);
-  Serial.print("Lux EC:");
-  Serial.print(ecValue, 1);
-  Serial.print(" PH:");
-  Serial.print(phValue, 1);
-  Serial.print(" WTemp:");
-  Serial.print(waterTemp, 1);
-  Serial.print("C");
+  // แสดงเฉพาะข้อมูลสำคัญ (logFloat ใช้ได้ไม่เกิน 4 ค่าต่อข้อความ)
+  LOG_INFO("T:%sC H:%s%% CO2:%dppm Light:%luLux",
+           logFixed(airTemp, 1), logFixed(airHumidity, 1), co2Ppm, (unsigned long)luxValue);
+  LOG_INFO("EC:%s PH:%s WTemp:%sC", logFixed(ecValue, 1), logFixed(phValue, 2), logFixed(waterTemp, 1));
   
   if (acSensorConnected) {
-    Serial.print(" AC:");
-    Serial.print(acVoltage, 1);
-    Serial.print("V ");
-    Serial.print(acPower, 1);
-    Serial.print("W");
+    LOG_INFO("AC:%sV %sW", logFixed(acVoltage, 1), logFixed(acPower, 1));
   }
-  Serial.println();
 }
 
-// ฟังก์ชันรับคำสั่งจาก ESP32
-void receiveCommandFromESP32() {
-  if (Serial2.available() > 0) {
-    String command = Serial2.readStringUntil('\n');
-    command.trim(); // ตัดช่องว่างและ newline
-    
-    // แสดงคำสั่งที่ได้รับ
-    Serial.println("\n---- ได้รับคำสั่งจาก ESP32 ----");
-    Serial.println("Command: '" + command + "'");
-    Serial.println("Length: " + String(command.length()));
-    Serial.println("Raw bytes:");
-    for (int i = 0; i < command.length(); i++) {
-      Serial.print("0x");
-      Serial.print(command[i], HEX);
-      Serial.print(" ");
-    }
-    Serial.println();
-    
-    // ตรวจสอบข้อความคำสั่งพิเศษ
-    if (command == "MEGA_TEST") {
-      Serial2.println("MEGA_OK");
-      return;
-    }
-    
-    // === ULTRA-PRECISE TIMING COMMANDS ===
-    // คำสั่งเริ่มจับเวลา Internal Fan: FAN_TIMING:K5,10,5
-    if (command.startsWith("FAN_TIMING:K")) {
-      int firstComma = command.indexOf(',');
-      int secondComma = command.indexOf(',', firstComma + 1);
-      
-      if (firstComma > 0 && secondComma > 0) {
-        String relayStr = command.substring(12, firstComma); // K5
-        String delayOnStr = command.substring(firstComma + 1, secondComma); // 10
-        String delayOffStr = command.substring(secondComma + 1); // 5
-        
-        int relayNum = relayStr.substring(1).toInt() - 1; // K5 -> 4 (index 4 = K5)
-        unsigned long delayOn = delayOnStr.toInt() * 1000; // แปลงวินาทีเป็นมิลลิวินาที
-        unsigned long delayOff = delayOffStr.toInt() * 1000; // แปลงวินาทีเป็นมิลลิวินาที
-        
-        // เริ่มต้น Internal Fan cycle
-        fanCycleStartTime = millis();
-        fanCycleState = false; // เริ่มด้วย OFF period
-        fanDelayOn = delayOn;
-        fanDelayOff = delayOff;
-        fanRelayIndex = relayNum;
-        fanCycleActive = true;
-        
-        Serial.println("🌀 MEGA INTERNAL FAN: Started Ultra-Precise Cycle Timer");
-        Serial.println("   Relay: K" + String(relayNum + 1) + " (Pin " + String(relayPins[relayNum]) + ")");
-        Serial.println("   Delay ON: " + String(delayOn/1000) + "s, Delay OFF: " + String(delayOff/1000) + "s");
-        Serial.println("   Starting with OFF period");
-        
-        Serial2.println("FAN_TIMING_OK");
-      }
-      return;
-    }
-    
-    // คำสั่งเริ่มจับเวลา EC Pump: PUMP_TIMING:EC,5000 หรือ PUMP_TIMING:EC,0 (หยุดทันที)
-    if (command.startsWith("PUMP_TIMING:EC,")) {
-      String durationStr = command.substring(15); // ตัด "PUMP_TIMING:EC," ออก
-      ecPumpDuration = durationStr.toInt();
-      
-      // 🔥 FIX: ตรวจสอบว่าคำสั่งเป็นหยุดทันทีหรือไม่
-      if (ecPumpDuration == 0) {
-        // หยุดปั๊ม EC ทันที
-        ecPumpRunning = false;
-        ecPumpStartTime = 0;
-        ecPumpDuration = 0;
-        
-        // ปิด relay K7 (EC Pump) ทันที
-        relayStates[6] = false; // K7 OFF
-        if (relayActiveHigh[6]) {
-          digitalWrite(relayPins[6], LOW);
-        } else {
-          digitalWrite(relayPins[6], HIGH);
-        }
-        
-        Serial.println("🛑 MEGA EC PUMP: STOPPED IMMEDIATELY");
-        Serial.println("   Reason: Duration = 0 (EC too high)");
-        Serial.println("✅ K7 (EC Pump) turned OFF immediately");
-        
-        Serial2.println("EC_PUMP_STOPPED:0,0,100.0,0");
-        return;
-      }
-      
-      // เริ่มจับเวลาปกติ
-      ecPumpStartTime = millis();
-      ecPumpRunning = true;
-      
-      // เปิด relay K7 (EC Pump) ทันที
-      relayStates[6] = true; // K7 ON
-      if (relayActiveHigh[6]) {
-        digitalWrite(relayPins[6], HIGH);
-      } else {
-        digitalWrite(relayPins[6], LOW);
-      }
-      
-      Serial.println("🧪 MEGA EC PUMP: Started Ultra-Precise Timer");
-      Serial.println("   Duration: " + String(ecPumpDuration) + " ms");
-      Serial.println("   Start Time: " + String(ecPumpStartTime) + " ms");
-      Serial.println("✅ K7 (EC Pump) turned ON immediately");
-      
-      Serial2.println("EC_PUMP_TIMING_OK");
-      return;
-    }
-    
-    // คำสั่งเริ่มจับเวลา PH Pump: PUMP_TIMING:PH_ACID,3000 หรือ PUMP_TIMING:PH_BASE,3000 หรือ PUMP_TIMING:PH_ACID,0 (หยุดทันที)
-    if (command.startsWith("PUMP_TIMING:PH_")) {
-      int commaIndex = command.indexOf(',');
-      if (commaIndex > 0) {
-        String pumpType = command.substring(15, commaIndex); // ACID หรือ BASE
-        String durationStr = command.substring(commaIndex + 1);
-        phPumpDuration = durationStr.toInt();
-        
-        // 🔥 FIX: ตรวจสอบว่าคำสั่งเป็นหยุดทันทีหรือไม่
-        if (phPumpDuration == 0) {
-          // หยุดปั๊ม PH ทันที
-          phPumpRunning = false;
-          phPumpStartTime = 0;
-          phPumpDuration = 0;
-          
-          // ปิด relay K6 (PH Pump) ทันที
-          relayStates[5] = false; // K6 OFF
-          if (relayActiveHigh[5]) {
-            digitalWrite(relayPins[5], LOW);
-          } else {
-            digitalWrite(relayPins[5], HIGH);
-          }
-          
-          Serial.println("🛑 MEGA PH " + pumpType + " PUMP: STOPPED IMMEDIATELY");
-          Serial.println("   Reason: Duration = 0 (PH perfect)");
-          Serial.println("✅ K6 (PH Pump) turned OFF immediately");
-          
-          Serial2.println("PH_PUMP_STOPPED:0,0,100.0,0");
-          return;
-        }
-        
-        // เริ่มจับเวลาปกติ
-        phPumpStartTime = millis();
-        phPumpRunning = true;
-        
-        // เปิด relay K6 (PH Pump) ทันที
-        relayStates[5] = true; // K6 ON
-        if (relayActiveHigh[5]) {
-          digitalWrite(relayPins[5], HIGH);
-        } else {
-          digitalWrite(relayPins[5], LOW);
-        }
-        
-        Serial.println("🧪 MEGA PH " + pumpType + " PUMP: Started Ultra-Precise Timer");
-        Serial.println("   Duration: " + String(phPumpDuration) + " ms");
-        Serial.println("   Start Time: " + String(phPumpStartTime) + " ms");
-        Serial.println("✅ K6 (PH Pump) turned ON immediately");
-        
-        Serial2.println("PH_PUMP_TIMING_OK");
-      }
-      return;
-    }
+// === ESP32 COMMAND HANDLERS ===
+// handler แต่ละตัวได้รับอาร์กิวเมนต์ที่แยกและแปลงเป็นตัวเลขแล้วจาก command_parser
 
-    // === RELAY CONTROL COMMANDS ===
-    // รูปแบบ: RELAY:12345678 (1=ON, 0=OFF)
-    if (command.startsWith("RELAY:")) {
-      String relayPattern = command.substring(6); // ตัด "RELAY:" ออก
-      Serial.println("📌 Relay pattern received: " + relayPattern);
-      
-      // ✅ อนุญาตให้ควบคุม relay อื่นๆ แต่ป้องกันเฉพาะ K6, K7
-      if (ecPumpRunning || phPumpRunning) {
-        Serial.println("🔒 Ultra-Precise pumps active - Protecting K6/K7 only (EC:" + String(ecPumpRunning) + ", PH:" + String(phPumpRunning) + ")");
-      }
-      
-      if (relayPattern.length() == 8) {
-        // ✅ ป้องกันเฉพาะ K6, K7 ขณะ Ultra-Precise Timing ทำงาน
-        String protectedPattern = relayPattern;
-        bool patternModified = false;
-        
-        // ถ้า EC Pump กำลังทำงาน ให้คงสถานะ K7 (ตำแหน่งที่ 6)
-        if (ecPumpRunning && relayPattern.charAt(6) == '0') {
-          protectedPattern.setCharAt(6, '1'); // บังคับให้ K7 เปิดต่อ
-          Serial.println("🔒 Protected K7 (EC Pump) - kept ON during Ultra-Precise timing");
-          patternModified = true;
-        }
-        
-        // ถ้า PH Pump กำลังทำงาน ให้คงสถานะ K6 (ตำแหน่งที่ 5)
-        if (phPumpRunning && relayPattern.charAt(5) == '0') {
-          protectedPattern.setCharAt(5, '1'); // บังคับให้ K6 เปิดต่อ
-          Serial.println("🔒 Protected K6 (PH Pump) - kept ON during Ultra-Precise timing");
-          patternModified = true;
-        }
-        
-        applyRelayCommand(protectedPattern);
-        Serial2.println("RELAY_OK");
-        Serial.println("✅ Relay command applied: " + protectedPattern);
-        
-        if (patternModified) {
-          Serial.println("⚡ Pattern modified to protect Ultra-Precise pumps (K6/K7 only)");
-        } else {
-          Serial.println("✅ All relay states applied as requested");
-        }
-      } else {
-        Serial2.println("RELAY_ERROR:INVALID_LENGTH");
-        Serial.println("❌ Invalid relay command length: " + String(relayPattern.length()));
-      }
-      return;
-    }
-    
-    // คำสั่งแสดงสถานะ relay
-    if (command == "RELAY_STATUS") {
-      printRelayStatus();
-      String status = "RELAY_STATUS:";
-      for (int i = 0; i < 8; i++) {
-        status += relayStates[i] ? "1" : "0";
-      }
-      Serial2.println(status);
-      return;
-    }
-    
-    // === CONFIG COMMANDS ===
-    
-    // ตรวจสอบคำสั่งอื่นๆ (เดิม)
-    if (command.indexOf("CONFIG:") >= 0) {
-      // ตัวอย่างการปรับเปลี่ยนการตั้งค่า
-      if (command.indexOf("EC_RANGE:4400") >= 0) {
-        isEcSensorRange4400 = true;
-        Serial2.println("CONFIG_OK:EC_RANGE_4400");
-      } else if (command.indexOf("EC_RANGE:44000") >= 0) {
-        isEcSensorRange4400 = false;
-        Serial2.println("CONFIG_OK:EC_RANGE_44000");
-      } else if (command.indexOf("RESET_ENERGY") >= 0) {
-        pzem.resetEnergy();
-        Serial2.println("CONFIG_OK:ENERGY_RESET");
-      } else if (command.indexOf("RESET_FLOW") >= 0) {
-        totalMilliLitres1 = 0;
-        totalMilliLitres2 = 0;
-        totalMilliLitres3 = 0;
-        Serial2.println("CONFIG_OK:FLOW_RESET");
-      }
-      return;
-    }
-    
-    // คำสั่งที่ไม่รู้จัก
-    // ป้องกันการส่ง INVALID_FORMAT กลับไปเป็นลูปไม่รู้จบ
-    if (command != "INVALID_FORMAT" && command != "UNKNOWN_COMMAND" && command != "DATA_RECEIVED") {
-      Serial.println("⚠️ Unknown command received: " + command);
-      Serial2.println("UNKNOWN_COMMAND");
-    }
+// MEGA_TEST
+void cmdMegaTest(const CommandArgs& args) {
+  Serial2.println(F("MEGA_OK"));
+}
+
+// ESP32_OK / ESP32_TEST - คำตอบของ MEGA_TEST ที่ Mega ส่งไป
+void cmdEsp32Ok(const CommandArgs& args) {
+  esp32Link.probeAnswered(millis());
+  LOG_DEBUG("ESP32 heartbeat RTT %u ms", esp32Link.rttLastMs());
+}
+
+// LINK - คุณภาพลิงก์ Serial2 ตามที่ Mega เห็น:
+// LINK:rtt=<ล่าสุด>,avg=<เฉลี่ย>,max=<สูงสุด>,loss=<% จาก 16 probe>,silence=<ms>,sent=<probe>,lost=<probe>,state=<OK|DEGRADED|DOWN>
+void cmdLink(const CommandArgs& args) {
+  Serial2.print(F("LINK:rtt="));
+  Serial2.print(esp32Link.rttLastMs());
+  Serial2.print(F(",avg="));
+  Serial2.print(esp32Link.rttAverageMs());
+  Serial2.print(F(",max="));
+  Serial2.print(esp32Link.rttMaxMs());
+  Serial2.print(F(",loss="));
+  Serial2.print(esp32Link.lossPercent());
+  Serial2.print(F(",silence="));
+  Serial2.print(esp32Link.silenceMs(millis()));
+  Serial2.print(F(",sent="));
+  Serial2.print(esp32Link.probesSent());
+  Serial2.print(F(",lost="));
+  Serial2.print(esp32Link.probesLost());
+  Serial2.print(F(",state="));
+  if (esp32LinkLost) {
+    Serial2.println(F("DOWN"));
+  } else if (esp32Link.degraded()) {
+    Serial2.println(F("DEGRADED"));
+  } else {
+    Serial2.println(F("OK"));
   }
 }
 
-// ฟังก์ชันส่งข้อมูลไปยัง ESP32
-void sendDataToESP32() {
-  // สร้าง JSON เพื่อส่งข้อมูลทั้งหมดในครั้งเดียว
-  JsonDocument jsonDoc; // ใช้ JsonDocument แทน StaticJsonDocument
-  
-  // เพิ่ม marker เพื่อระบุว่านี่เป็นข้อมูลเซ็นเซอร์
-  jsonDoc["msgType"] = "SENSOR_DATA";
-  
-  // ข้อมูล CO2 Sensor - ส่งค่าเต็ม
-  jsonDoc["co2"] = co2Ppm;
-  
-  // ปรับรูปแบบให้มีทศนิยม 1 ตำแหน่ง
-  jsonDoc["airTemp"] = round(airTemp * 10) / 10.0;
-  jsonDoc["airHumidity"] = round(airHumidity * 10) / 10.0;
-  
-  // ข้อมูล Light Sensor - ส่งค่าเต็ม
-  jsonDoc["light"] = luxValue;
-  
-  // ข้อมูล EC Sensor - ปรับรูปแบบให้มีทศนิยม 1 ตำแหน่ง
-  jsonDoc["ec"] = round(ecValue * 10) / 10.0;
-  
-  // ข้อมูล PH Sensor - ปรับรูปแบบให้มีทศนิยม 1 ตำแหน่ง
-  jsonDoc["ph"] = round(phValue * 10) / 10.0;
-  jsonDoc["waterTemp"] = round(waterTemp * 10) / 10.0;
-  
-  // ข้อมูล Water Level
-  jsonDoc["waterLevel"] = waterDetected ? 100 : 0;
-  
-  // เพิ่มข้อมูล AC Power Sensor
-  if (acSensorConnected) {
-    jsonDoc["acVoltage"] = acVoltage;
-    jsonDoc["acCurrent"] = acCurrent;
-    jsonDoc["acPower"] = acPower;
-    jsonDoc["acEnergy"] = acEnergy;
-    jsonDoc["acFrequency"] = acFrequency;
-    jsonDoc["acPowerFactor"] = acPowerFactor;
+// BOOT - เวลาตั้งแต่ reset จนคืนสถานะ relay และจนจบ setup(): BOOT:ready_us=<us>,setup_us=<us>
+void cmdBoot(const CommandArgs& args) {
+  Serial2.print(F("BOOT:ready_us="));
+  Serial2.print(bootReadyMicros);
+  Serial2.print(F(",setup_us="));
+  Serial2.println(bootSetupMicros);
+}
+
+// === ULTRA-PRECISE TIMING COMMANDS ===
+// แปลง K<n> จากคำสั่งเป็น index 0-7 (คืนค่า -1 ถ้าไม่อยู่ในช่วง)
+int relayIndexFromArg(int32_t relayNumber) {
+  int relayNum = relayNumber - 1; // K5 -> 4 (index 4 = K5)
+  return (relayNum >= 0 && relayNum < relayPinCount) ? relayNum : -1;
+}
+
+// คำสั่งเริ่มวงจร ON/OFF ของ relay ใดก็ได้: FAN_TIMING:K5,10,5[,3600]
+// (relay, delayOn วินาที, delayOff วินาที, เพดานเวลาทำงานรวมวินาที - ไม่ใส่ = ไม่จำกัด)
+// หลาย relay วนพร้อมกันได้ เช่น K3 และ K5
+void cmdFanTiming(const CommandArgs& args) {
+  if (args.count < 3 || args.count > 4 || (args.count == 4 && !(args.numericMask & 0x08))) {
+    Serial2.println(F("INVALID_FORMAT"));
+    return;
   }
-  
-  // เพิ่มข้อมูลจากเซนเซอร์วัดอัตราการไหลของน้ำ (Flow Sensors)
-  jsonDoc["flowSensor1_LPM"] = round(flowRate1 * 10) / 10.0;
-  jsonDoc["flowSensor2_LPM"] = round(flowRate2 * 10) / 10.0;
-  jsonDoc["flowSensor3_LPM"] = round(flowRate3 * 10) / 10.0;
-  
-  jsonDoc["flowSensor1_Liters"] = round((totalMilliLitres1 / 1000.0) * 100) / 100.0;
-  jsonDoc["flowSensor2_Liters"] = round((totalMilliLitres2 / 1000.0) * 100) / 100.0;
-  jsonDoc["flowSensor3_Liters"] = round((totalMilliLitres3 / 1000.0) * 100) / 100.0;
-  
-  // แปลง JSON เป็น String และส่งไปยัง ESP32
-  serializeJson(jsonDoc, Serial2);
-  Serial2.println();  // ปิดท้ายบรรทัดให้ ESP32 อ่านง่าย
-  
-  // แสดงข้อมูลที่ส่งไป ESP32 ครบถ้วน
-  Serial.println("📤 === Data sent to ESP32 ===");
-  Serial.print("CO2="); Serial.print(co2Ppm);
-  Serial.print(" T="); Serial.print(airTemp, 1); Serial.print("C");
-  Serial.print(" H="); Serial.print(airHumidity, 1); Serial.print("%");
-  Serial.print(" Light="); Serial.print(luxValue);
-  Serial.print(" EC="); Serial.print(ecValue, 1);
-  Serial.print(" PH="); Serial.print(phValue, 1);
-  Serial.print(" WTemp="); Serial.print(waterTemp, 1); Serial.print("C");
-  Serial.print(" WLevel="); Serial.print(waterDetected ? "YES" : "NO");
-  
-  if (acSensorConnected) {
-    Serial.print(" ACV="); Serial.print(acVoltage, 1);
-    Serial.print("V ACP="); Serial.print(acPower, 1); Serial.print("W");
+  int relayNum = relayIndexFromArg(args.value[0]);
+  if (relayNum < 0) {
+    Serial2.println(F("FAN_TIMING_ERROR:INVALID_RELAY"));
+    return;
   }
-  
-  Serial.print(" Flow1="); Serial.print(flowRate1, 1);
-  Serial.print(" Flow2="); Serial.print(flowRate2, 1);
-  Serial.print(" Flow3="); Serial.print(flowRate3, 1); Serial.print("L/min");
-  Serial.println();
-  Serial.println("===============================");
-}
+  unsigned long delayOn = (unsigned long)args.value[1] * 1000UL;  // แปลงวินาทีเป็นมิลลิวินาที
+  unsigned long delayOff = (unsigned long)args.value[2] * 1000UL; // แปลงวินาทีเป็นมิลลิวินาที
+  unsigned long maxRun = args.count == 4 ? (unsigned long)args.value[3] * 1000UL : 0;
 
-// ===== RELAY CONTROL FUNCTIONS =====
+  // เริ่มวงจร (เริ่มด้วย OFF period, ISR สลับสถานะเอง)
+  actuatorStartCycle(relayNum, delayOn, delayOff, maxRun);
 
-/**
+  LOG_INFO("🌀 K%d cycle: ON %lus / OFF %lus, max run %lus (starting with OFF)",
+           relayNum + 1, delayOn / 1000, delayOff / 1000, maxRun / 1000);
+
+  Serial2.println(F("FAN_TIMING_OK"));
+}
+
+// คำสั่ง pulse ของ relay ใดก็ได้: PUMP_TIMING:K3,5000 หรือ PUMP_TIMING:K3,0 (หยุดทันที)
+void cmdPumpTimingRelay(const CommandArgs& args) {
+  int relayNum = relayIndexFromArg(args.value[0]);
+  if (relayNum < 0 || args.value[1] < 0) {
+    Serial2.println(F("PUMP_TIMING_ERROR:INVALID_RELAY"));
+    return;
+  }
+  unsigned long duration = (unsigned long)args.value[1];
+
+  if (duration == 0) {
+    actuatorStop(relayNum);
+    relaySet(relayNum, false);
+    LOG_INFO("🛑 K%d pulse STOPPED IMMEDIATELY (duration = 0)", relayNum + 1);
+  } else {
+    actuatorStartPulse(relayNum, duration);
+    LOG_INFO("⏱️ K%d ON for %lu ms", relayNum + 1, duration);
+  }
+
+  Serial2.print(F("PUMP_TIMING_OK:K"));
+  Serial2.println(relayNum + 1);
+}
+
+// คำสั่งหยุดงานจับเวลาของ relay และปิด relay: TIMER_STOP:K5
+void cmdTimerStop(const CommandArgs& args) {
+  int relayNum = relayIndexFromArg(args.value[0]);
+  if (relayNum < 0) {
+    Serial2.println(F("TIMER_STOP_ERROR:INVALID_RELAY"));
+    return;
+  }
+  actuatorStop(relayNum);
+  LOG_INFO("🛑 K%d timer stopped", relayNum + 1);
+
+  Serial2.print(F("TIMER_STOP_OK:K"));
+  Serial2.println(relayNum + 1);
+}
+
+// คำสั่งเริ่มจับเวลา EC Pump: PUMP_TIMING:EC,5000 หรือ PUMP_TIMING:EC,0 (หยุดทันที)
+void cmdPumpTimingEC(const CommandArgs& args) {
+  if (args.value[0] < 0) {
+    Serial2.println(F("PUMP_TIMING_ERROR:INVALID_DURATION"));
+    return;
+  }
+  unsigned long duration = (unsigned long)args.value[0];
+
+  // 🔥 FIX: ตรวจสอบว่าคำสั่งเป็นหยุดทันทีหรือไม่
+  if (duration == 0) {
+    // หยุดปั๊ม EC และปิด relay K7 ทันที
+    actuatorStop(EC_PUMP_RELAY);
+    relaySet(EC_PUMP_RELAY, false);
+
+    LOG_INFO("🛑 EC Pump (K7) STOPPED IMMEDIATELY (duration = 0)");
+
+    Serial2.println(F("EC_PUMP_STOPPED:0,0,100.0,0"));
+    return;
+  }
+
+  // เปิด relay K7 (EC Pump) ทันที และให้ Timer3 ISR ปิดเมื่อครบเวลา
+  actuatorStartPulse(EC_PUMP_RELAY, duration);
+
+  LOG_INFO("🧪 EC Pump (K7) ON for %lu ms", duration);
+
+  Serial2.println(F("EC_PUMP_TIMING_OK"));
+}
+
+// คำสั่งเริ่มจับเวลา PH Pump: PUMP_TIMING:PH_ACID,3000 หรือ PUMP_TIMING:PH_BASE,3000 หรือ PUMP_TIMING:PH_ACID,0 (หยุดทันที)
+void cmdPumpTimingPH(const CommandArgs& args) {
+  const char* pumpType = args.text[0]; // ACID หรือ BASE
+  if (args.value[1] < 0) {
+    Serial2.println(F("PUMP_TIMING_ERROR:INVALID_DURATION"));
+    return;
+  }
+  unsigned long duration = (unsigned long)args.value[1];
+
+  // 🔥 FIX: ตรวจสอบว่าคำสั่งเป็นหยุดทันทีหรือไม่
+  if (duration == 0) {
+    // หยุดปั๊ม PH และปิด relay K6 ทันที
+    actuatorStop(PH_PUMP_RELAY);
+    relaySet(PH_PUMP_RELAY, false);
+
+    LOG_INFO("🛑 PH %s Pump (K6) STOPPED IMMEDIATELY (duration = 0)", pumpType);
+
+    Serial2.println(F("PH_PUMP_STOPPED:0,0,100.0,0"));
+    return;
+  }
+
+  // เปิด relay K6 (PH Pump) ทันที และให้ Timer3 ISR ปิดเมื่อครบเวลา
+  actuatorStartPulse(PH_PUMP_RELAY, duration);
+
+  LOG_INFO("🧪 PH %s Pump (K6) ON for %lu ms", pumpType, duration);
+
+  Serial2.println(F("PH_PUMP_TIMING_OK"));
+}
+
+// === RELAY CONTROL COMMANDS ===
+// รูปแบบ: RELAY:12345678 (1=ON, 0=OFF)
+void cmdRelay(const CommandArgs& args) {
+  const char* relayPattern = args.text[0];
+
+  size_t patternLength = strlen(relayPattern);
+  if (patternLength != 8) {
+    Serial2.println(F("RELAY_ERROR:INVALID_LENGTH"));
+    LOG_WARN("❌ Invalid relay command length: %u", (unsigned)patternLength);
+    return;
+  }
+
+  // ✅ ป้องกัน relay ที่ตารางจับเวลาคุมอยู่ (pulse/วงจร) ปล่อยให้ Timer3 ISR สั่งเองตามเวลา
+  // ('-' = คงสถานะเดิม ป้องกันการสั่งเปิดซ้ำหลัง ISR ปิดไปแล้ว) ใช้ TIMER_STOP เพื่อคืน relay
+  // relay ที่มีกฎ (RULE:) ก็เช่นกัน ใช้ RULE_CLEAR: เพื่อคืน relay
+  char protectedPattern[9];
+  memcpy(protectedPattern, relayPattern, sizeof(protectedPattern));
+  uint8_t timedMask = actuatorActiveMask() | ruleEngine.relayMask();
+  bool patternModified = false;
+
+  for (int i = 0; i < 8; i++) {
+    if ((timedMask & (1 << i)) && protectedPattern[i] != '-') {
+      protectedPattern[i] = '-';
+      patternModified = true;
+    }
+  }
+
+  applyRelayCommand(protectedPattern);
+  Serial2.println(F("RELAY_OK"));
+
+  if (patternModified) {
+    LOG_INFO("✅ Relay %s (🔒 timed relays protected)", protectedPattern);
+  } else {
+    LOG_INFO("✅ Relay %s", protectedPattern);
+  }
+}
+
+// คำสั่งแสดงสถานะ relay
+void cmdRelayStatus(const CommandArgs& args) {
+  printRelayStatus();
+  Serial2.print(F("RELAY_STATUS:"));
+  for (int i = 0; i < 8; i++) {
+    Serial2.print(relayIsOn(i) ? '1' : '0');
+  }
+  Serial2.println();
+}
+
+// === CONFIG COMMANDS ===
+void cmdConfigEcRange4400(const CommandArgs& args) {
+  isEcSensorRange4400 = true;
+  Serial2.println(F("CONFIG_OK:EC_RANGE_4400"));
+}
+
+void cmdConfigEcRange44000(const CommandArgs& args) {
+  isEcSensorRange4400 = false;
+  Serial2.println(F("CONFIG_OK:EC_RANGE_44000"));
+}
+
+void cmdConfigResetEnergy(const CommandArgs& args) {
+  pzem.requestEnergyReset();   // ส่งผ่านบัส Serial3 ต่อจากการอ่านที่ค้างอยู่ (ถ้ามี)
+  Serial2.println(F("CONFIG_OK:ENERGY_RESET"));
+}
+
+void cmdConfigResetFlow(const CommandArgs& args) {
+  for (uint8_t i = 0; i < FLOW_CHANNELS; i++) {
+    flowPulseTotal[i] = 0;
+  }
+  Serial2.println(F("CONFIG_OK:FLOW_RESET"));
+}
+
+void cmdConfigTelemetryBinary(const CommandArgs& args) {
+  binaryTelemetry = true;
+  Serial2.println(F("CONFIG_OK:TELEMETRY_BINARY"));
+}
+
+void cmdConfigTelemetryJson(const CommandArgs& args) {
+  binaryTelemetry = false;
+  Serial2.println(F("CONFIG_OK:TELEMETRY_JSON"));
+}
+
+void cmdConfigTelemetryDelta(const CommandArgs& args) {
+  deltaTelemetry = true;
+  telemetryTracker.reset();   // เฟรมถัดไปเป็น keyframe
+  Serial2.println(F("CONFIG_OK:TELEMETRY_DELTA"));
+}
+
+void cmdConfigTelemetryFull(const CommandArgs& args) {
+  deltaTelemetry = false;
+  Serial2.println(F("CONFIG_OK:TELEMETRY_FULL"));
+}
+
+// ชื่อฟิลด์สำหรับ TELEMETRY_DEADBAND / TELEMETRY_ALERT (เรียงตาม TelemetryField)
+const char FIELD_FLAGS[] PROGMEM = "flags";
+const char FIELD_CO2[] PROGMEM = "co2";
+const char FIELD_AIR_TEMP[] PROGMEM = "airTemp";
+const char FIELD_AIR_HUMIDITY[] PROGMEM = "airHumidity";
+const char FIELD_LIGHT[] PROGMEM = "light";
+const char FIELD_EC[] PROGMEM = "ec";
+const char FIELD_PH[] PROGMEM = "ph";
+const char FIELD_WATER_TEMP[] PROGMEM = "waterTemp";
+const char FIELD_AC_VOLTAGE[] PROGMEM = "acVoltage";
+const char FIELD_AC_CURRENT[] PROGMEM = "acCurrent";
+const char FIELD_AC_POWER[] PROGMEM = "acPower";
+const char FIELD_AC_ENERGY[] PROGMEM = "acEnergy";
+const char FIELD_AC_FREQUENCY[] PROGMEM = "acFrequency";
+const char FIELD_AC_POWER_FACTOR[] PROGMEM = "acPowerFactor";
+const char FIELD_FLOW_RATE_1[] PROGMEM = "flowSensor1_LPM";
+const char FIELD_FLOW_RATE_2[] PROGMEM = "flowSensor2_LPM";
+const char FIELD_FLOW_RATE_3[] PROGMEM = "flowSensor3_LPM";
+const char FIELD_FLOW_TOTAL_1[] PROGMEM = "flowSensor1_Liters";
+const char FIELD_FLOW_TOTAL_2[] PROGMEM = "flowSensor2_Liters";
+const char FIELD_FLOW_TOTAL_3[] PROGMEM = "flowSensor3_Liters";
+const char FIELD_RELAYS[] PROGMEM = "relays";
+
+const char* const telemetryFieldNames[TELEMETRY_FIELD_COUNT] PROGMEM = {
+  FIELD_FLAGS, FIELD_CO2, FIELD_AIR_TEMP, FIELD_AIR_HUMIDITY, FIELD_LIGHT, FIELD_EC, FIELD_PH,
+  FIELD_WATER_TEMP, FIELD_AC_VOLTAGE, FIELD_AC_CURRENT, FIELD_AC_POWER, FIELD_AC_ENERGY,
+  FIELD_AC_FREQUENCY, FIELD_AC_POWER_FACTOR, FIELD_FLOW_RATE_1, FIELD_FLOW_RATE_2, FIELD_FLOW_RATE_3,
+  FIELD_FLOW_TOTAL_1, FIELD_FLOW_TOTAL_2, FIELD_FLOW_TOTAL_3, FIELD_RELAYS,
+};
+
+// หา index ของฟิลด์จากชื่อ คืนค่า TELEMETRY_FIELD_COUNT ถ้าไม่พบ
+uint8_t telemetryFieldFromName(const char* name) {
+  for (uint8_t i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+    if (strcmp_P(name, (const char*)pgm_read_ptr(&telemetryFieldNames[i])) == 0) {
+      return i;
+    }
+  }
+  return TELEMETRY_FIELD_COUNT;
+}
+
+// SUBSCRIBE:<group>,<period_ms> - ส่งกลุ่มฟิลด์นี้ทุก period_ms (100 ms - 1 ชม.) ข้อความแรกส่งทันที
+void cmdSubscribe(const CommandArgs& args) {
+  uint8_t group = telemetryGroupFromName(args.text[0]);
+  if (group == TELEMETRY_GROUP_NONE || args.value[1] < (int32_t)TELEMETRY_SUBSCRIBE_MIN_MS ||
+      args.value[1] > (int32_t)TELEMETRY_SUBSCRIBE_MAX_MS) {
+    Serial2.println(F("SUBSCRIBE_ERROR:INVALID_ARGS"));
+    return;
+  }
+  telemetrySubscriptions.subscribe(group, args.value[1]);
+  Serial2.print(F("SUBSCRIBE_OK:"));
+  Serial2.print(args.text[0]);
+  Serial2.print(',');
+  Serial2.println(telemetrySubscriptions.periodMs(group));
+}
+
+// UNSUBSCRIBE:<group> - หยุดส่งกลุ่มนี้ (UNSUBSCRIBE:all หยุดสตรีมหลัก เหลือเฉพาะกลุ่มและ alert)
+void cmdUnsubscribe(const CommandArgs& args) {
+  uint8_t group = telemetryGroupFromName(args.text[0]);
+  if (group == TELEMETRY_GROUP_NONE) {
+    Serial2.println(F("SUBSCRIBE_ERROR:INVALID_ARGS"));
+    return;
+  }
+  telemetrySubscriptions.unsubscribe(group);
+  Serial2.print(F("UNSUBSCRIBE_OK:"));
+  Serial2.println(args.text[0]);
+}
+
+// SUBSCRIPTIONS - กลุ่มที่ subscribe อยู่: SUBSCRIPTIONS:all=2000;flow=250
+void cmdSubscriptions(const CommandArgs& args) {
+  char name[TELEMETRY_GROUP_NAME_MAX];
+  bool first = true;
+  Serial2.print(F("SUBSCRIPTIONS:"));
+  for (uint8_t i = 0; i < TELEMETRY_GROUP_COUNT; i++) {
+    if (telemetrySubscriptions.periodMs(i) == 0) {
+      continue;
+    }
+    if (!first) Serial2.print(';');
+    first = false;
+    Serial2.print(telemetryGroupName(i, name));
+    Serial2.print('=');
+    Serial2.print(telemetrySubscriptions.periodMs(i));
+  }
+  Serial2.println();
+}
+
+// TELEMETRY_DEADBAND:<field>,<value> - การเปลี่ยนที่น้อยกว่านี้ไม่ถูกส่งในโหมด delta
+// (หน่วยเดียวกับเฟรม binary เช่น airTemp x10, ph x100, flowSensor1_Liters เป็น mL)
+void cmdTelemetryDeadband(const CommandArgs& args) {
+  uint8_t field = telemetryFieldFromName(args.text[0]);
+  if (field == TELEMETRY_FIELD_COUNT || telemetryFieldIsBits(field) ||
+      args.value[1] < 0 || args.value[1] > 65535) {
+    Serial2.println(F("TELEMETRY_ERROR:INVALID_ARGS"));
+    return;
+  }
+  telemetryTracker.setDeadband(field, args.value[1]);
+  Serial2.print(F("TELEMETRY_DEADBAND_OK:"));
+  Serial2.println(args.text[0]);
+}
+
+// TELEMETRY_ALERT:<field>,<threshold> - ส่งทันทีเมื่อค่าข้ามเกณฑ์ (flags/relays: mask ของบิต)
+// TELEMETRY_ALERT:<field>,OFF - ปิด alert ของฟิลด์นั้น
+void cmdTelemetryAlert(const CommandArgs& args) {
+  uint8_t field = telemetryFieldFromName(args.text[0]);
+  bool off = strcmp_P(args.text[1], PSTR("OFF")) == 0;
+  if (field == TELEMETRY_FIELD_COUNT || (!off && !(args.numericMask & 0x02))) {
+    Serial2.println(F("TELEMETRY_ERROR:INVALID_ARGS"));
+    return;
+  }
+  if (off) {
+    telemetryTracker.clearAlert(field);
+  } else {
+    telemetryTracker.setAlert(field, args.value[1]);
+  }
+  Serial2.print(F("TELEMETRY_ALERT_OK:"));
+  Serial2.println(args.text[0]);
+}
+
+// STATS: เวลาที่ใช้ในแต่ละขั้นของ loop() (ดู loop_stats.h)
+void cmdStats(const CommandArgs& args) {
+  Serial2.print(F("STATS:"));
+  loopStatsPrint(Serial2);
+  Serial2.println();
+  loopStatsDiscardPass(); // ไม่นับเวลาที่ใช้พิมพ์บรรทัดนี้
+}
+
+void cmdStatsReset(const CommandArgs& args) {
+  loopStatsReset();
+  loopStatsDiscardPass();
+  Serial2.println(F("STATS_RESET_OK"));
+}
+
+// === BUS POLLING COMMANDS ===
+// POLL:<id>,<minMs>,<maxMs>,<priority>,<jitterMs> - คาบและลำดับความสำคัญของ slave
+void cmdPoll(const CommandArgs& args) {
+  uint8_t job = sensorJobForSlave(args.value[0]);
+  if (job == POLL_NONE || args.value[1] <= 0 || args.value[2] < args.value[1] ||
+      args.value[3] < 0 || args.value[3] > 255 || args.value[4] < 0 || args.value[4] > 65535) {
+    Serial2.println(F("POLL_ERROR:INVALID_ARGS"));
+    return;
+  }
+  PollConfig config = busScheduler.config(job);
+  config.minPeriodMs = args.value[1];
+  config.maxPeriodMs = args.value[2];
+  config.priority = args.value[3];
+  config.jitterMs = args.value[4];
+  busScheduler.configure(job, config);
+
+  LOG_INFO("📡 Poll ID%d: %ld-%ld ms prio %d jitter %ld ms", (int)args.value[0],
+           (long)args.value[1], (long)args.value[2], (int)args.value[3], (long)args.value[4]);
+  Serial2.print(F("POLL_OK:"));
+  Serial2.println(args.value[0]);
+}
+
+// POLL_WATCH:<id>,<threshold>,<band>,<delta> - เร่งการอ่านเมื่อค่าใกล้เกณฑ์หรือเปลี่ยนเร็ว
+// (หน่วยเดียวกับ telemetry: Temp x10, lux, EC x10, pH x100; band/delta = 0 ปิดเงื่อนไขนั้น)
+void cmdPollWatch(const CommandArgs& args) {
+  uint8_t job = sensorJobForSlave(args.value[0]);
+  if (job == POLL_NONE || args.value[2] < 0 || args.value[3] < 0) {
+    Serial2.println(F("POLL_ERROR:INVALID_ARGS"));
+    return;
+  }
+  PollConfig config = busScheduler.config(job);
+  config.threshold = args.value[1];
+  config.band = args.value[2];
+  config.deltaThreshold = args.value[3];
+  busScheduler.configure(job, config);
+
+  Serial2.print(F("POLL_WATCH_OK:"));
+  Serial2.println(args.value[0]);
+}
+
+// POLL_STATUS - คาบปัจจุบันของแต่ละ slave: POLL_STATUS:1=1000,1000,10000,1;2=...
+void cmdPollStatus(const CommandArgs& args) {
+  Serial2.print(F("POLL_STATUS:"));
+  for (uint8_t i = 0; i < SENSOR_JOB_COUNT; i++) {
+    const PollConfig& config = busScheduler.config(i);
+    if (i > 0) Serial2.print(';');
+    Serial2.print(sensorJobs[i].slaveId);
+    Serial2.print('=');
+    Serial2.print(busScheduler.periodMs(i));
+    Serial2.print(',');
+    Serial2.print(config.minPeriodMs);
+    Serial2.print(',');
+    Serial2.print(config.maxPeriodMs);
+    Serial2.print(',');
+    Serial2.print(config.priority);
+  }
+  Serial2.println();
+}
+
+// HEALTH - สถานะของแต่ละ slave:
+// HEALTH:1=<ok|stale|offline>,<พลาดติดกัน>,<ms ตั้งแต่อ่านได้ล่าสุด|-1>,<timeout>,<crc>,<exception>,<อื่นๆ>;2=...
+void cmdHealth(const CommandArgs& args) {
+  uint32_t now = millis();
+  Serial2.print(F("HEALTH:"));
+  for (uint8_t i = 0; i < SENSOR_JOB_COUNT; i++) {
+    const SlaveHealth& health = sensorHealth[i];
+    if (i > 0) Serial2.print(';');
+    Serial2.print(sensorJobs[i].slaveId);
+    Serial2.print('=');
+    Serial2.print(health.offline() ? F("offline") : health.stale() ? F("stale") : F("ok"));
+    Serial2.print(',');
+    Serial2.print(health.consecutiveFailures);
+    Serial2.print(',');
+    Serial2.print(health.everGood ? (long)(now - health.lastGoodMs) : -1L);
+    Serial2.print(',');
+    Serial2.print(health.timeouts);
+    Serial2.print(',');
+    Serial2.print(health.crcErrors);
+    Serial2.print(',');
+    Serial2.print(health.exceptions);
+    Serial2.print(',');
+    Serial2.print(health.otherErrors);
+  }
+  Serial2.println();
+}
+
+// HISTORY:<ช่อง>,<from> - ประวัติของช่อง (airTemp, co2, ec, ph, waterTemp, flow, acPower)
+// ตั้งแต่นาที from นับจากบูต (0 = ทั้งหมด) ตอบ HISTORY_BEGIN:<ช่อง>,<นาทีปัจจุบัน> แล้วส่ง H:... ใน loop()
+// คำขอใหม่แทนที่คำขอที่ยังส่งไม่จบ
+void cmdHistory(const CommandArgs& args) {
+  uint8_t channel = historyChannelFromName(args.text[0]);
+  if (channel == HISTORY_NONE || args.value[1] < 0) {
+    Serial2.println(F("HISTORY_ERROR:INVALID_ARGS"));
+    return;
+  }
+  historyStreamChannel = channel;
+  historyStreamFrom = args.value[1];
+  historyStreamCount = 0;
+  Serial2.print(F("HISTORY_BEGIN:"));
+  Serial2.print(args.text[0]);
+  Serial2.print(',');
+  Serial2.println(sensorHistory.currentMinute());
+}
+
+// ACK:<seq> - ESP32 ได้รับ record ที่ส่งซ้ำจนถึง seq แล้ว (สะสม) ไม่มีคำตอบ
+void cmdAck(const CommandArgs& args) {
+  if (args.value[0] < 1 || args.value[0] > 65535) {
+    Serial2.println(F("ACK_ERROR:INVALID_ARGS"));
+    return;
+  }
+  if (outbox.acknowledge((uint16_t)args.value[0]) > 0) {
+    replayInFlight = 0;   // ส่ง record ถัดไปได้ทันที
+  }
+}
+
+// OUTBOX - สถานะคิว: OUTBOX:queued=<จำนวน>,dropped=<ทิ้งเพราะคิวเต็ม>,last=<sequence ล่าสุด>,link=<OK|DOWN>
+void cmdOutbox(const CommandArgs& args) {
+  Serial2.print(F("OUTBOX:queued="));
+  Serial2.print(outbox.size());
+  Serial2.print(F(",dropped="));
+  Serial2.print(outbox.dropped());
+  Serial2.print(F(",last="));
+  Serial2.print(outbox.lastSequence());
+  Serial2.print(F(",link="));
+  Serial2.println(esp32LinkLost ? F("DOWN") : F("OK"));
+}
+
+// STORAGE - สถานะ journal ใน EEPROM:
+// STORAGE:seq=<record ล่าสุด>,bytes=<ไบต์ที่เขียนสะสม>,slot=<ช่องถัดไป>/<จำนวนช่อง>
+void cmdStorage(const CommandArgs& args) {
+  Serial2.print(F("STORAGE:seq="));
+  Serial2.print(stateJournal.sequence());
+  Serial2.print(F(",bytes="));
+  Serial2.print(stateJournal.bytesWritten());
+  Serial2.print(F(",slot="));
+  Serial2.print(stateJournal.nextSlot());
+  Serial2.print('/');
+  Serial2.println(stateJournal.slotCount());
+}
+
+// FILTER:<ช่อง>,<median>,<emaShift>,<maxRatePerSec> - ตั้งตัวกรองของช่อง (ล้างประวัติของช่องนั้น)
+// เช่น FILTER:ec,5,2,100 = median 5 ตัว, EMA 1/4, EC เปลี่ยนไม่เกิน 10.0 µS/cm ต่อวินาที
+void cmdFilter(const CommandArgs& args) {
+  uint8_t channel = filterChannelFromName(args.text[0]);
+  FilterConfig config;
+  config.median = (uint8_t)args.value[1];
+  config.emaShift = (uint8_t)args.value[2];
+  config.maxRatePerSec = (uint32_t)args.value[3];
+  if (channel == FILTER_NONE || args.value[1] < 1 || args.value[1] > FILTER_MEDIAN_MAX ||
+      args.value[2] < 0 || args.value[2] > FILTER_EMA_SHIFT_MAX || args.value[3] < 0 ||
+      !SensorFilter::valid(config)) {
+    Serial2.println(F("FILTER_ERROR:INVALID_ARGS"));
+    return;
+  }
+  sensorFilters[channel].configure(config);
+  Serial2.print(F("FILTER_OK:"));
+  Serial2.println(args.text[0]);
+}
+
+// FILTERS - ตั้งค่า ค่าดิบ/ค่าที่กรอง และต้นทุนของตัวกรอง:
+// FILTERS:ram=<ไบต์>,max_us=<ต่อตัวอย่าง>;<ช่อง>=<median>,<emaShift>,<rate>,<raw>,<value>,<limited>;...
+void cmdFilters(const CommandArgs& args) {
+  char name[FILTER_CHANNEL_NAME_MAX];
+  Serial2.print(F("FILTERS:ram="));
+  Serial2.print((unsigned)sizeof(sensorFilters));
+  Serial2.print(F(",max_us="));
+  Serial2.print(filterCostMaxUs);
+  for (uint8_t i = 0; i < FILTER_CHANNEL_COUNT; i++) {
+    const SensorFilter& filter = sensorFilters[i];
+    Serial2.print(';');
+    Serial2.print(filterChannelName(i, name));
+    Serial2.print('=');
+    Serial2.print(filter.config().median);
+    Serial2.print(',');
+    Serial2.print(filter.config().emaShift);
+    Serial2.print(',');
+    Serial2.print(filter.config().maxRatePerSec);
+    Serial2.print(',');
+    Serial2.print(filter.raw());
+    Serial2.print(',');
+    Serial2.print(filter.value());
+    Serial2.print(',');
+    Serial2.print(filter.rateLimited());
+  }
+  Serial2.println();
+}
+
+// === DOSING COMMANDS ===
+// DOSE_CONFIG:<EC|PH_ACID|PH_BASE>,<setpoint>,<deadband>,<gain>,<mix s>,<max pulse ms>,<max ms ต่อชั่วโมง>
+// หน่วยเดียวกับ telemetry (EC µS/cm x10, pH x100) gain = ms ต่อ error 100 หน่วย
+// PH_ACID = ปั๊ม K6 ลด pH, PH_BASE = เพิ่ม pH (ช่อง PH ช่องเดียว ทิศตามที่ตั้งล่าสุด)
+void cmdDoseConfig(const CommandArgs& args) {
+  const char* name = args.text[0];
+  bool isEc = strcmp(name, "EC") == 0;
+  bool isAcid = strcmp(name, "PH_ACID") == 0;
+  if ((!isEc && !isAcid && strcmp(name, "PH_BASE") != 0) ||
+      args.value[2] < 0 || args.value[2] > 65535L || args.value[3] < 0 || args.value[3] > 65535L ||
+      args.value[4] < 0 || args.value[4] > (long)DOSING_MIX_MAX_SECONDS || args.value[5] < 0 || args.value[6] < 0) {
+    Serial2.println(F("DOSE_ERROR:INVALID_ARGS"));
+    return;
+  }
+  uint8_t channel = isEc ? DOSE_EC : DOSE_PH;
+  DosingConfig config;
+  config.setpoint = args.value[1];
+  config.deadband = (uint16_t)args.value[2];
+  config.gain = (uint16_t)args.value[3];
+  config.raises = !isAcid;
+  config.mixDelayMs = (uint32_t)args.value[4] * 1000UL;
+  config.maxPulseMs = (uint32_t)args.value[5];
+  config.maxPerHourMs = (uint32_t)args.value[6];
+  if (!DosingController::valid(config)) {
+    Serial2.println(F("DOSE_ERROR:INVALID_ARGS"));
+    return;
+  }
+  dosing[channel].configure(config);
+  LOG_INFO("🧪 Dose %s: setpoint %ld, deadband %u, gain %u", name, (long)config.setpoint,
+           config.deadband, config.gain);
+  Serial2.print(F("DOSE_CONFIG_OK:"));
+  Serial2.println(name);
+}
+
+// DOSE_MODE:<EC|PH>,<AUTO|OFF> - OFF ระหว่างที่ตัวควบคุมปั๊มอยู่ หยุดปั๊มทันที
+void cmdDoseMode(const CommandArgs& args) {
+  const char* name = args.text[0];
+  const char* mode = args.text[1];
+  uint8_t channel = strcmp(name, "EC") == 0 ? DOSE_EC : strcmp(name, "PH") == 0 ? DOSE_PH : DOSE_CHANNEL_COUNT;
+  bool automatic = strcmp(mode, "AUTO") == 0;
+  if (channel == DOSE_CHANNEL_COUNT || (!automatic && strcmp(mode, "OFF") != 0)) {
+    Serial2.println(F("DOSE_ERROR:INVALID_ARGS"));
+    return;
+  }
+  if (automatic && !dosing[channel].configured()) {
+    Serial2.println(F("DOSE_ERROR:NOT_CONFIGURED"));
+    return;
+  }
+  if (!automatic && dosing[channel].state() == DOSING_PULSE) {
+    actuatorStop(dosePumpRelays[channel]);
+  }
+  dosing[channel].enable(automatic, millis());
+  LOG_INFO("🧪 Dose %s %s", name, mode);
+  Serial2.print(F("DOSE_MODE_OK:"));
+  Serial2.print(name);
+  Serial2.print(',');
+  Serial2.println(mode);
+}
+
+// DOSE_STATUS:<ช่อง>=<OFF|WAIT|PULSE|FAULT>,<setpoint>,<ค่าล่าสุด>,<ms ชั่วโมงนี้>,<ครั้ง>,<ms รวม>;...
+void cmdDoseStatus(const CommandArgs& args) {
+  unsigned long now = millis();
+  Serial2.print(F("DOSE_STATUS:"));
+  for (uint8_t i = 0; i < DOSE_CHANNEL_COUNT; i++) {
+    DosingController& controller = dosing[i];
+    if (i > 0) Serial2.print(';');
+    Serial2.print(i == DOSE_EC ? F("EC=") : F("PH="));
+    switch (controller.state()) {
+      case DOSING_OFF:   Serial2.print(F("OFF")); break;
+      case DOSING_WAIT:  Serial2.print(F("WAIT")); break;
+      case DOSING_PULSE: Serial2.print(F("PULSE")); break;
+      default:           Serial2.print(F("FAULT")); break;
+    }
+    Serial2.print(',');
+    Serial2.print(controller.config().setpoint);
+    Serial2.print(',');
+    Serial2.print(i == DOSE_EC ? ecValue : phValue);
+    Serial2.print(',');
+    Serial2.print(controller.usedThisHourMs(now));
+    Serial2.print(',');
+    Serial2.print(controller.doses());
+    Serial2.print(',');
+    Serial2.print(controller.totalDosedMs());
+  }
+  Serial2.println();
+}
+
+// === RELAY RULE COMMANDS ===
+// RULE:K<n>,<field>,<on>,<off>,<min on s>,<min off s> - ตั้ง/แทนกฎของ relay (หน่วยของ field เดียวกับ telemetry)
+// on > off: เปิดเมื่อค่าสูง (ทำความเย็น/ระบายอากาศ) on < off: เปิดเมื่อค่าต่ำ
+void cmdRule(const CommandArgs& args) {
+  int relayNum = relayIndexFromArg(args.value[0]);
+  uint8_t field = telemetryFieldFromName(args.text[1]);
+  if (relayNum < 0 || field == TELEMETRY_FIELD_COUNT || telemetryFieldIsBits(field) ||
+      args.value[4] < 0 || args.value[4] > 65535L || args.value[5] < 0 || args.value[5] > 65535L) {
+    Serial2.println(F("RULE_ERROR:INVALID_ARGS"));
+    return;
+  }
+  RelayRule rule;
+  rule.field = field;
+  rule.relay = relayNum;
+  rule.onValue = args.value[2];
+  rule.offValue = args.value[3];
+  rule.minOnSeconds = (uint16_t)args.value[4];
+  rule.minOffSeconds = (uint16_t)args.value[5];
+  if (!RuleEngine::valid(rule)) {
+    Serial2.println(F("RULE_ERROR:INVALID_ARGS"));
+    return;
+  }
+  if (!ruleEngine.set(rule)) {
+    Serial2.println(F("RULE_ERROR:FULL"));
+    return;
+  }
+  rulesDirty = true;
+  LOG_INFO("📏 Rule K%d: %s on %ld off %ld", relayNum + 1, args.text[1], (long)rule.onValue, (long)rule.offValue);
+  Serial2.print(F("RULE_OK:K"));
+  Serial2.println(relayNum + 1);
+}
+
+// RULE_CLEAR:K<n> - ลบกฎ relay คงสถานะปัจจุบัน (สั่งต่อด้วย RELAY: ได้)
+void cmdRuleClear(const CommandArgs& args) {
+  int relayNum = relayIndexFromArg(args.value[0]);
+  if (relayNum < 0 || !ruleEngine.clear(relayNum)) {
+    Serial2.println(F("RULE_ERROR:INVALID_ARGS"));
+    return;
+  }
+  rulesDirty = true;
+  Serial2.print(F("RULE_CLEAR_OK:K"));
+  Serial2.println(relayNum + 1);
+}
+
+// RULES:seq=<record ล่าสุดใน EEPROM>;K<n>=<field>,<on>,<off>,<min on>,<min off>,<ON|OFF>,<ครั้งที่สลับ>[,WAIT];...
+// WAIT = ค่าข้ามเกณฑ์แล้วแต่ยังไม่ครบเวลาขั้นต่ำ
+void cmdRules(const CommandArgs& args) {
+  Serial2.print(F("RULES:seq="));
+  Serial2.print(rulesJournal.sequence());
+  for (uint8_t i = 0; i < RULE_MAX; i++) {
+    const RelayRule& rule = ruleEngine.rule(i);
+    if (rule.field == RULE_NONE) {
+      continue;
+    }
+    Serial2.print(F(";K"));
+    Serial2.print(rule.relay + 1);
+    Serial2.print('=');
+    Serial2.print((const __FlashStringHelper*)pgm_read_ptr(&telemetryFieldNames[rule.field]));
+    Serial2.print(',');
+    Serial2.print(rule.onValue);
+    Serial2.print(',');
+    Serial2.print(rule.offValue);
+    Serial2.print(',');
+    Serial2.print(rule.minOnSeconds);
+    Serial2.print(',');
+    Serial2.print(rule.minOffSeconds);
+    Serial2.print(relayIsOn(rule.relay) ? F(",ON,") : F(",OFF,"));
+    Serial2.print(ruleEngine.switches(i));
+    if (ruleEngine.waiting(i)) {
+      Serial2.print(F(",WAIT"));
+    }
+  }
+  Serial2.println();
+}
+
+// CONFIG อื่นๆ ที่ไม่รู้จัก: ไม่ตอบกลับ (เหมือนเดิม)
+void cmdConfigIgnored(const CommandArgs& args) {
+}
+
+// ข้อความตอบกลับจาก ESP32 ที่ต้องเงียบไว้ ป้องกันการส่ง UNKNOWN_COMMAND วนไม่รู้จบ
+void cmdIgnored(const CommandArgs& args) {
+}
+
+// === COMMAND TABLE (PROGMEM) ===
+// ลำดับมีผล: รายการแรกที่ตรงจะถูกใช้
+const char KW_MEGA_TEST[] PROGMEM = "MEGA_TEST";
+const char KW_ESP32_OK[] PROGMEM = "ESP32_OK";
+const char KW_ESP32_TEST[] PROGMEM = "ESP32_TEST";
+const char KW_BOOT[] PROGMEM = "BOOT";
+const char KW_LINK[] PROGMEM = "LINK";
+const char KW_FAN_TIMING[] PROGMEM = "FAN_TIMING:K";
+const char KW_PUMP_TIMING_EC[] PROGMEM = "PUMP_TIMING:EC,";
+const char KW_PUMP_TIMING_PH[] PROGMEM = "PUMP_TIMING:PH_";
+const char KW_PUMP_TIMING_RELAY[] PROGMEM = "PUMP_TIMING:K";
+const char KW_TIMER_STOP[] PROGMEM = "TIMER_STOP:K";
+const char KW_RELAY_STATUS[] PROGMEM = "RELAY_STATUS";
+const char KW_RELAY[] PROGMEM = "RELAY:";
+const char KW_STATS[] PROGMEM = "STATS";
+const char KW_STATS_RESET[] PROGMEM = "STATS_RESET";
+const char KW_POLL_STATUS[] PROGMEM = "POLL_STATUS";
+const char KW_HEALTH[] PROGMEM = "HEALTH";
+const char KW_STORAGE[] PROGMEM = "STORAGE";
+const char KW_HISTORY[] PROGMEM = "HISTORY:";
+const char KW_ACK[] PROGMEM = "ACK:";
+const char KW_OUTBOX[] PROGMEM = "OUTBOX";
+const char KW_FILTER[] PROGMEM = "FILTER:";
+const char KW_FILTERS[] PROGMEM = "FILTERS";
+const char KW_DOSE_CONFIG[] PROGMEM = "DOSE_CONFIG:";
+const char KW_DOSE_MODE[] PROGMEM = "DOSE_MODE:";
+const char KW_DOSE_STATUS[] PROGMEM = "DOSE_STATUS";
+const char KW_RULE[] PROGMEM = "RULE:K";
+const char KW_RULE_CLEAR[] PROGMEM = "RULE_CLEAR:K";
+const char KW_RULES[] PROGMEM = "RULES";
+const char KW_POLL_WATCH[] PROGMEM = "POLL_WATCH:";
+const char KW_POLL[] PROGMEM = "POLL:";
+const char KW_CONFIG_EC_4400[] PROGMEM = "CONFIG:EC_RANGE:4400";
+const char KW_CONFIG_EC_44000[] PROGMEM = "CONFIG:EC_RANGE:44000";
+const char KW_CONFIG_RESET_ENERGY[] PROGMEM = "CONFIG:RESET_ENERGY";
+const char KW_CONFIG_RESET_FLOW[] PROGMEM = "CONFIG:RESET_FLOW";
+const char KW_CONFIG_TELEMETRY_BINARY[] PROGMEM = "CONFIG:TELEMETRY:BINARY";
+const char KW_CONFIG_TELEMETRY_JSON[] PROGMEM = "CONFIG:TELEMETRY:JSON";
+const char KW_CONFIG_TELEMETRY_DELTA[] PROGMEM = "CONFIG:TELEMETRY:DELTA";
+const char KW_CONFIG_TELEMETRY_FULL[] PROGMEM = "CONFIG:TELEMETRY:FULL";
+const char KW_TELEMETRY_DEADBAND[] PROGMEM = "TELEMETRY_DEADBAND:";
+const char KW_TELEMETRY_ALERT[] PROGMEM = "TELEMETRY_ALERT:";
+const char KW_SUBSCRIBE[] PROGMEM = "SUBSCRIBE:";
+const char KW_UNSUBSCRIBE[] PROGMEM = "UNSUBSCRIBE:";
+const char KW_SUBSCRIPTIONS[] PROGMEM = "SUBSCRIPTIONS";
+const char KW_CONFIG[] PROGMEM = "CONFIG:";
+const char KW_INVALID_FORMAT[] PROGMEM = "INVALID_FORMAT";
+const char KW_UNKNOWN_COMMAND[] PROGMEM = "UNKNOWN_COMMAND";
+const char KW_DATA_RECEIVED[] PROGMEM = "DATA_RECEIVED";
+
+const CommandEntry commandTable[] PROGMEM = {
+  {KW_MEGA_TEST,               CMD_EXACT,  0,            0,    cmdMegaTest},
+  {KW_ESP32_OK,                CMD_EXACT,  0,            0,    cmdEsp32Ok},
+  {KW_ESP32_TEST,              CMD_EXACT,  0,            0,    cmdEsp32Ok},
+  {KW_BOOT,                    CMD_EXACT,  0,            0,    cmdBoot},
+  {KW_LINK,                    CMD_EXACT,  0,            0,    cmdLink},
+  {KW_FAN_TIMING,              CMD_PREFIX, CMD_ANY_ARGS, 0x07, cmdFanTiming},
+  {KW_PUMP_TIMING_EC,          CMD_PREFIX, 1,            0x01, cmdPumpTimingEC},
+  {KW_PUMP_TIMING_PH,          CMD_PREFIX, 2,            0x02, cmdPumpTimingPH},
+  {KW_PUMP_TIMING_RELAY,       CMD_PREFIX, 2,            0x03, cmdPumpTimingRelay},
+  {KW_TIMER_STOP,              CMD_PREFIX, 1,            0x01, cmdTimerStop},
+  {KW_RELAY_STATUS,            CMD_EXACT,  0,            0,    cmdRelayStatus},
+  {KW_RELAY,                   CMD_PREFIX, CMD_ANY_ARGS, 0,    cmdRelay},
+  {KW_STATS,                   CMD_EXACT,  0,            0,    cmdStats},
+  {KW_STATS_RESET,             CMD_EXACT,  0,            0,    cmdStatsReset},
+  {KW_POLL_STATUS,             CMD_EXACT,  0,            0,    cmdPollStatus},
+  {KW_HEALTH,                  CMD_EXACT,  0,            0,    cmdHealth},
+  {KW_STORAGE,                 CMD_EXACT,  0,            0,    cmdStorage},
+  {KW_HISTORY,                 CMD_PREFIX, 2,            0x02, cmdHistory},
+  {KW_ACK,                     CMD_PREFIX, 1,            0x01, cmdAck},
+  {KW_OUTBOX,                  CMD_EXACT,  0,            0,    cmdOutbox},
+  {KW_FILTER,                  CMD_PREFIX, 4,            0x0E, cmdFilter},
+  {KW_FILTERS,                 CMD_EXACT,  0,            0,    cmdFilters},
+  {KW_DOSE_CONFIG,             CMD_PREFIX, 7,            0x7E, cmdDoseConfig},
+  {KW_DOSE_MODE,               CMD_PREFIX, 2,            0,    cmdDoseMode},
+  {KW_DOSE_STATUS,             CMD_EXACT,  0,            0,    cmdDoseStatus},
+  {KW_RULE,                    CMD_PREFIX, 6,            0x3D, cmdRule},
+  {KW_RULE_CLEAR,              CMD_PREFIX, 1,            0x01, cmdRuleClear},
+  {KW_RULES,                   CMD_EXACT,  0,            0,    cmdRules},
+  {KW_POLL_WATCH,              CMD_PREFIX, 4,            0x0F, cmdPollWatch},
+  {KW_POLL,                    CMD_PREFIX, 5,            0x1F, cmdPoll},
+  {KW_CONFIG_EC_4400,          CMD_EXACT,  0,            0,    cmdConfigEcRange4400},
+  {KW_CONFIG_EC_44000,         CMD_EXACT,  0,            0,    cmdConfigEcRange44000},
+  {KW_CONFIG_RESET_ENERGY,     CMD_EXACT,  0,            0,    cmdConfigResetEnergy},
+  {KW_CONFIG_RESET_FLOW,       CMD_EXACT,  0,            0,    cmdConfigResetFlow},
+  {KW_CONFIG_TELEMETRY_BINARY, CMD_EXACT,  0,            0,    cmdConfigTelemetryBinary},
+  {KW_CONFIG_TELEMETRY_JSON,   CMD_EXACT,  0,            0,    cmdConfigTelemetryJson},
+  {KW_CONFIG_TELEMETRY_DELTA,  CMD_EXACT,  0,            0,    cmdConfigTelemetryDelta},
+  {KW_CONFIG_TELEMETRY_FULL,   CMD_EXACT,  0,            0,    cmdConfigTelemetryFull},
+  {KW_TELEMETRY_DEADBAND,      CMD_PREFIX, 2,            0x02, cmdTelemetryDeadband},
+  {KW_TELEMETRY_ALERT,         CMD_PREFIX, 2,            0,    cmdTelemetryAlert},
+  {KW_SUBSCRIBE,               CMD_PREFIX, 2,            0x02, cmdSubscribe},
+  {KW_UNSUBSCRIBE,             CMD_PREFIX, 1,            0,    cmdUnsubscribe},
+  {KW_SUBSCRIPTIONS,           CMD_EXACT,  0,            0,    cmdSubscriptions},
+  {KW_CONFIG,                  CMD_PREFIX, CMD_ANY_ARGS, 0,    cmdConfigIgnored},
+  {KW_INVALID_FORMAT,          CMD_EXACT,  0,            0,    cmdIgnored},
+  {KW_UNKNOWN_COMMAND,         CMD_EXACT,  0,            0,    cmdIgnored},
+  {KW_DATA_RECEIVED,           CMD_EXACT,  0,            0,    cmdIgnored},
+};
+const uint8_t COMMAND_TABLE_SIZE = sizeof(commandTable) / sizeof(commandTable[0]);
+
+LineAssembler commandLine; // บัฟเฟอร์คำสั่งจาก ESP32 (Serial2)
+
+// === COMMAND ENVELOPE ===
+// #<seq>:<คำสั่ง>;<คำสั่ง>*<crc> ตรวจทุกคำสั่งก่อน แล้วทำทั้งหมดในรอบ loop เดียว ตอบ CMD_ACK:<seq>,<จำนวน>
+// ไม่ผ่าน: CMD_NAK:<seq>,<ลำดับคำสั่ง (0 = ทั้งเฟรม)>,<เหตุผล> และไม่มีคำสั่งใดถูกทำ (ดู COMMAND_ENVELOPE.md)
+EnvelopeHistory envelopeHistory;
+
+void replyEnvelopeNak(uint16_t sequence, uint8_t index, const __FlashStringHelper* reason) {
+  Serial2.print(F("CMD_NAK:"));
+  Serial2.print(sequence);
+  Serial2.print(',');
+  Serial2.print(index);
+  Serial2.print(',');
+  Serial2.println(reason);
+}
+
+void replyEnvelopeAck(uint16_t sequence, uint8_t count) {
+  Serial2.print(F("CMD_ACK:"));
+  Serial2.print(sequence);
+  Serial2.print(',');
+  Serial2.println(count);
+}
+
+// ตรวจอาร์กิวเมนต์ของคำสั่งสั่งงาน actuator ล่วงหน้า (เงื่อนไขเดียวกับใน handler) คืน NULL ถ้าผ่าน
+// คำสั่งอื่นอยู่ในเฟรมได้เฉพาะเมื่อมีคำสั่งเดียว เพราะตรวจล่วงหน้าไม่ได้
+const __FlashStringHelper* batchedCommandError(const CommandEntry& entry, const CommandArgs& args, uint8_t batchSize) {
+  if (entry.handler == cmdRelay) {
+    return args.count == 1 && strlen(args.text[0]) == 8 ? NULL : F("INVALID_LENGTH");
+  }
+  if (entry.handler == cmdFanTiming) {
+    if (args.count < 3 || args.count > 4 || (args.count == 4 && !(args.numericMask & 0x08))) {
+      return F("INVALID_FORMAT");
+    }
+    return relayIndexFromArg(args.value[0]) < 0 ? F("INVALID_RELAY") : NULL;
+  }
+  if (entry.handler == cmdPumpTimingRelay) {
+    return relayIndexFromArg(args.value[0]) < 0 || args.value[1] < 0 ? F("INVALID_RELAY") : NULL;
+  }
+  if (entry.handler == cmdTimerStop) {
+    return relayIndexFromArg(args.value[0]) < 0 ? F("INVALID_RELAY") : NULL;
+  }
+  if (entry.handler == cmdPumpTimingEC) {
+    return args.value[0] < 0 ? F("INVALID_DURATION") : NULL;
+  }
+  if (entry.handler == cmdPumpTimingPH) {
+    return args.value[1] < 0 ? F("INVALID_DURATION") : NULL;
+  }
+  return batchSize == 1 ? NULL : F("NOT_BATCHABLE");
+}
+
+void handleCommandEnvelope(char* line) {
+  CommandEnvelope envelope;
+  EnvelopeStatus status = parseCommandEnvelope(line, envelope);
+  if (status == ENVELOPE_BAD_CHECKSUM) {
+    LOG_WARN("⚠️ Envelope #%u checksum mismatch", envelope.sequence);
+    replyEnvelopeNak(envelope.sequence, 0, F("CHECKSUM"));
+    return;
+  }
+  if (status != ENVELOPE_OK) {
+    replyEnvelopeNak(envelope.sequence, 0, status == ENVELOPE_TOO_MANY ? F("TOO_MANY") : F("FORMAT"));
+    return;
+  }
+
+  // ESP32 ส่งซ้ำเพราะไม่เห็น ACK: ตอบซ้ำโดยไม่ทำอีก (relay ไม่ถูกสั่งซ้ำ ปั๊มไม่เริ่มนับใหม่)
+  uint8_t applied;
+  if (envelopeHistory.find(envelope.sequence, envelope.checksum, applied)) {
+    LOG_INFO("↩️ Envelope #%u already applied", envelope.sequence);
+    replyEnvelopeAck(envelope.sequence, applied);
+    return;
+  }
+
+  // ขั้นที่ 1: ตรวจทุกคำสั่ง (ยังไม่มีอะไรเปลี่ยน)
+  CommandEntry entries[COMMAND_BATCH_MAX];
+  CommandArgs args[COMMAND_BATCH_MAX];
+  for (uint8_t i = 0; i < envelope.count; i++) {
+    DispatchResult result = matchCommand(envelope.commands[i], commandTable, COMMAND_TABLE_SIZE, entries[i], args[i]);
+    const __FlashStringHelper* error = NULL;
+    if (result == DISPATCH_UNKNOWN) {
+      error = F("UNKNOWN_COMMAND");
+    } else if (result == DISPATCH_BAD_ARGS) {
+      error = F("INVALID_FORMAT");
+    } else {
+      error = batchedCommandError(entries[i], args[i], envelope.count);
+    }
+    if (error != NULL) {
+      LOG_WARN("⚠️ Envelope #%u rejected at command %u", envelope.sequence, (unsigned)(i + 1));
+      replyEnvelopeNak(envelope.sequence, i + 1, error);
+      return;
+    }
+  }
+
+  // ขั้นที่ 2: ทำทั้งหมดตามลำดับ
+  for (uint8_t i = 0; i < envelope.count; i++) {
+    entries[i].handler(args[i]);
+  }
+  envelopeHistory.remember(envelope.sequence, envelope.checksum, envelope.count);
+  replyEnvelopeAck(envelope.sequence, envelope.count);
+}
+
+// ฟังก์ชันรับคำสั่งจาก ESP32: อ่านเฉพาะไบต์ที่มีอยู่แล้ว ไม่รอ newline
+void receiveCommandFromESP32() {
+  while (Serial2.available() > 0) {
+    if (!commandLine.feed((char)Serial2.read())) {
+      continue;
+    }
+
+    char* command = commandLine.line();
+
+    // แสดงคำสั่งที่ได้รับ
+    LOG_DEBUG("ESP32 command: '%s' (%u)", command, (unsigned)commandLine.length());
+
+    if (command[0] == '#') {
+      handleCommandEnvelope(command);
+      esp32Link.frameReceived(millis());
+      continue;
+    }
+
+    DispatchResult result = dispatchCommand(command, commandTable, COMMAND_TABLE_SIZE);
+    if (result != DISPATCH_UNKNOWN) {
+      esp32Link.frameReceived(millis());   // บรรทัดที่รู้จัก = ESP32 ยังอยู่ (ขยะบนสายไม่นับ)
+    }
+    if (result == DISPATCH_BAD_ARGS) {
+      LOG_WARN("⚠️ Invalid command arguments");
+      Serial2.println(F("INVALID_FORMAT"));
+    } else if (result == DISPATCH_UNKNOWN) {
+      // คำสั่งที่ไม่รู้จัก
+      LOG_WARN("⚠️ Unknown command received: %s", command);
+      Serial2.println(F("UNKNOWN_COMMAND"));
+    }
+  }
+}
+
+// ตัดสินใจว่าจะส่ง telemetry รอบนี้หรือไม่ คืนค่า true ถ้าส่ง (ส่งไม่เกิน 1 ข้อความต่อรอบ loop)
+// - ลิงก์ขาด: ไม่ส่ง (snapshot เข้าคิวแทน)
+// - โหมด delta: ฟิลด์ที่ข้ามเกณฑ์ alert ส่งทันที (ตรวจทุก ALERT_CHECK_INTERVAL)
+// - กลุ่มที่ครบกำหนดและรอนานที่สุด: all = สตรีมหลัก, กลุ่มอื่น = ข้อความสั้นเฉพาะฟิลด์ของกลุ่ม
+bool serviceTelemetry() {
+  unsigned long now = millis();
+
+  // ไม่เขียนลง UART ที่ไม่มีใครอ่าน เก็บ snapshot เป็นระยะแทน
+  if (esp32LinkLost) {
+    queueSnapshot();
+    return false;
+  }
+
+  if (deltaTelemetry && telemetryTracker.hasBaseline() && now - lastAlertCheckTime >= ALERT_CHECK_INTERVAL) {
+    lastAlertCheckTime = now;
+    TelemetryFrameV1 frame;
+    buildTelemetryFrame(frame);
+    uint32_t alerts = telemetryTracker.alertFields(frame);
+    if (alerts != 0 && sendTelemetryDelta(frame, alerts)) {
+      return true;
+    }
+  }
+
+  uint8_t group = telemetrySubscriptions.nextDue(now);
+  if (group == TELEMETRY_GROUP_NONE) {
+    return false;
+  }
+  telemetrySubscriptions.markSent(group, now);
+  if (group == TELEMETRY_GROUP_ALL) {
+    return sendDataToESP32();
+  }
+
+  TelemetryFrameV1 frame;
+  buildTelemetryFrame(frame);
+  sendTelemetry(frame, telemetryGroupFields(group), group);
+  return true;
+}
+
+// สตรีมหลักไปยัง ESP32
+// โหมดปกติ: เฟรมเต็มทุกครั้ง
+// โหมด delta: keyframe เมื่อยังไม่มี baseline หรือครบ KEYFRAME_INTERVAL นอกนั้นเฉพาะฟิลด์ที่เปลี่ยนเกิน deadband
+// (ไม่มีอะไรเปลี่ยน = ไม่ส่ง คืนค่า false)
+bool sendDataToESP32() {
+  TelemetryFrameV1 frame;
+  buildTelemetryFrame(frame);
+
+  if (!deltaTelemetry) {
+    sendTelemetry(frame, TELEMETRY_ALL_FIELDS);
+    return true;
+  }
+
+  unsigned long now = millis();
+  if (!telemetryTracker.hasBaseline() || now - lastKeyframeTime >= KEYFRAME_INTERVAL) {
+    lastKeyframeTime = now;
+    telemetryTracker.markSent(frame, TELEMETRY_ALL_FIELDS);
+    sendTelemetry(frame, TELEMETRY_ALL_FIELDS);
+    return true;
+  }
+  return sendTelemetryDelta(frame, 0);
+}
+
+// ส่งฟิลด์ที่เปลี่ยนเกิน deadband รวมกับ extraFields (เช่น ฟิลด์ที่ข้ามเกณฑ์ alert)
+bool sendTelemetryDelta(TelemetryFrameV1& frame, uint32_t extraFields) {
+  uint32_t fields = telemetryTracker.changedFields(frame) | extraFields;
+  if (fields == 0) {
+    return false;
+  }
+  telemetryTracker.markSent(frame, fields);
+  sendTelemetry(frame, fields);
+  return true;
+}
+
+// ส่งฟิลด์ที่เลือกในรูปแบบที่ตั้งไว้ (TELEMETRY_ALL_FIELDS = เฟรมเต็ม)
+// group = กลุ่มที่ subscribe ไว้ หรือ TELEMETRY_GROUP_NONE สำหรับสตรีมหลัก
+void sendTelemetry(TelemetryFrameV1& frame, uint32_t fields, uint8_t group) {
+  if (binaryTelemetry) {
+    sendBinaryTelemetry(frame, fields);
+  } else {
+    sendJsonTelemetry(frame, fields, group);
+  }
+  telemetrySequence++;
+
+  // แสดงข้อมูลที่ส่งไป ESP32 (logFloat ใช้ได้ไม่เกิน 4 ค่าต่อข้อความ)
+  if (fields != TELEMETRY_ALL_FIELDS) {
+    LOG_DEBUG("📤 group=%d fields=0x%06lX", group == TELEMETRY_GROUP_NONE ? -1 : (int)group, (unsigned long)fields);
+    return;
+  }
+  LOG_DEBUG("📤 CO2=%d T=%sC H=%s%% Light=%lu EC=%s", co2Ppm,
+            logFixed(airTemp, 1), logFixed(airHumidity, 1), (unsigned long)luxValue, logFixed(ecValue, 1));
+  LOG_DEBUG("📤 PH=%s WTemp=%sC WLevel=%s ACV=%s",
+            logFixed(phValue, 2), logFixed(waterTemp, 1), waterDetected ? "YES" : "NO",
+            acSensorConnected ? logFixed(acVoltage, 1) : "-");
+  LOG_DEBUG("📤 Flow=%s,%s,%s L/min ACP=%sW",
+            logFixed(flowRate[0], 2), logFixed(flowRate[1], 2), logFixed(flowRate[2], 2),
+            acSensorConnected ? logFixed(acPower, 1) : "-");
+}
+
+// ค่าปัจจุบันทั้งหมดในหน่วย fixed-point ของ TelemetryFrameV1 (ใช้ทั้งเฟรม binary และตรวจการเปลี่ยนแปลง)
+void buildTelemetryFrame(TelemetryFrameV1& frame) {
+  memset(&frame, 0, sizeof(frame));
+
+  if (waterDetected) frame.flags |= TELEMETRY_FLAG_WATER_DETECTED;
+  if (acSensorConnected) frame.flags |= TELEMETRY_FLAG_AC_CONNECTED;
+  if (isEcSensorRange4400) frame.flags |= TELEMETRY_FLAG_EC_RANGE_4400;
+  frame.flags |= staleSensorFlags();
+  if (esp32Link.degraded()) frame.flags |= TELEMETRY_FLAG_LINK_DEGRADED;
+
+  frame.co2Ppm = co2Ppm;
+  frame.airTemp = airTemp;
+  frame.airHumidity = airHumidity;
+  frame.lux = luxValue;
+  frame.ec = ecValue;
+  frame.ph = phValue;
+  frame.waterTemp = waterTemp;
+
+  frame.acVoltage = acVoltage;
+  frame.acCurrent = acCurrent;
+  frame.acPower = acPower;
+  frame.acEnergy = acEnergy;
+  frame.acFrequency = acFrequency;
+  frame.acPowerFactor = acPowerFactor;
+
+  for (uint8_t i = 0; i < FLOW_CHANNELS; i++) {
+    frame.flowRate[i] = flowRate[i];
+    frame.flowTotal[i] = flowTotalMilliLitres(i);
+  }
+
+  frame.relayStates = relayStateMask();
+}
+
+// ส่งข้อมูลแบบ binary: เฟรมเต็ม TelemetryFrameV1 (61 ไบต์บนสาย) หรือเฟรม delta ของฟิลด์ที่เลือก
+// (ข้อความของกลุ่มที่ subscribe ใช้รูปแบบเฟรม delta เช่นกัน)
+void sendBinaryTelemetry(TelemetryFrameV1& frame, uint32_t fields) {
+  uint8_t wire[TELEMETRY_DELTA_WIRE_MAX];
+  size_t length;
+  if (fields == TELEMETRY_ALL_FIELDS) {
+    length = encodeTelemetryFrame(frame, telemetrySequence, wire, sizeof(wire));
+  } else {
+    length = encodeTelemetryDelta(frame, fields, telemetrySequence, wire, sizeof(wire));
+  }
+  Serial2.write(wire, length);
+}
+
+static inline bool hasField(uint32_t fields, uint8_t field) {
+  return fields & (1UL << field);
+}
+
+// ส่งข้อมูลแบบ JSON: SENSOR_DATA (ค่าทั้งหมด รูปแบบเดิม), SENSOR_DELTA (เฉพาะฟิลด์ที่เปลี่ยน)
+// หรือ SENSOR_GROUP (ฟิลด์ของกลุ่มที่ subscribe ไว้ พร้อม "group")
+// ค่ามาจาก frame จึงใช้ส่ง snapshot ที่เก็บไว้ในคิวซ้ำได้ (ฟิลด์ของ struct packed ต้องคัดลอกออกก่อนส่งให้ ArduinoJson)
+// live = false: snapshot ที่ส่งซ้ำ ไม่ใส่คุณภาพลิงก์ปัจจุบัน
+void sendJsonTelemetry(const TelemetryFrameV1& frame, uint32_t fields, uint8_t group, bool live) {
+  bool full = (fields == TELEMETRY_ALL_FIELDS);
+  bool acConnected = frame.flags & TELEMETRY_FLAG_AC_CONNECTED;
+
+  // สร้าง JSON เพื่อส่งข้อมูลทั้งหมดในครั้งเดียว
+  JsonDocument jsonDoc; // ใช้ JsonDocument แทน StaticJsonDocument
+  
+  // เพิ่ม marker เพื่อระบุชนิดข้อความ
+  if (full) {
+    jsonDoc["msgType"] = "SENSOR_DATA";
+  } else if (group != TELEMETRY_GROUP_NONE) {
+    char name[TELEMETRY_GROUP_NAME_MAX];
+    jsonDoc["msgType"] = "SENSOR_GROUP";
+    jsonDoc["group"] = telemetryGroupName(group, name);
+  } else {
+    jsonDoc["msgType"] = "SENSOR_DELTA";
+  }
+  if (deltaTelemetry || !full) {
+    jsonDoc["seq"] = telemetrySequence;   // ใช้ตรวจข้อความหาย
+  }
+  
+  // ข้อมูล CO2 Sensor - ส่งค่าเต็ม
+  if (hasField(fields, TELEMETRY_FIELD_CO2)) jsonDoc["co2"] = (uint16_t)frame.co2Ppm;
+  
+  // ค่า fixed-point แปลงเป็นทศนิยมตรงนี้ที่เดียว (ทศนิยม 1 ตำแหน่ง)
+  if (hasField(fields, TELEMETRY_FIELD_AIR_TEMP)) jsonDoc["airTemp"] = frame.airTemp / 10.0;
+  if (hasField(fields, TELEMETRY_FIELD_AIR_HUMIDITY)) jsonDoc["airHumidity"] = frame.airHumidity / 10.0;
+  
+  // ข้อมูล Light Sensor - ส่งค่าเต็ม
+  if (hasField(fields, TELEMETRY_FIELD_LUX)) jsonDoc["light"] = (uint32_t)frame.lux;
+  
+  // ข้อมูล EC Sensor - ปรับรูปแบบให้มีทศนิยม 1 ตำแหน่ง
+  if (hasField(fields, TELEMETRY_FIELD_EC)) jsonDoc["ec"] = frame.ec / 10.0;
+  
+  // ข้อมูล PH Sensor - ปรับรูปแบบให้มีทศนิยม 1 ตำแหน่ง
+  if (hasField(fields, TELEMETRY_FIELD_PH)) jsonDoc["ph"] = divRound((int32_t)frame.ph, 10) / 10.0;
+  if (hasField(fields, TELEMETRY_FIELD_WATER_TEMP)) jsonDoc["waterTemp"] = frame.waterTemp / 10.0;
+  
+  if (hasField(fields, TELEMETRY_FIELD_FLAGS)) {
+    // ข้อมูล Water Level
+    jsonDoc["waterLevel"] = (frame.flags & TELEMETRY_FLAG_WATER_DETECTED) ? 100 : 0;
+
+    // ฟิลด์ที่ค่าไม่สดแล้ว (ยังเป็นค่าล่าสุดที่อ่านได้ ไม่ใช่ 0)
+    // เฟรมเต็มใส่เฉพาะเมื่อมี ส่วน delta ใส่เสมอ (อาร์เรย์ว่าง = หายจาก stale แล้ว)
+    uint8_t staleFlags = frame.flags & (TELEMETRY_FLAG_STALE_AIR | TELEMETRY_FLAG_STALE_LIGHT |
+                                       TELEMETRY_FLAG_STALE_EC | TELEMETRY_FLAG_STALE_PH);
+    if (staleFlags || !full) {
+      JsonArray stale = jsonDoc["stale"].to<JsonArray>();
+      if (staleFlags & TELEMETRY_FLAG_STALE_AIR) {
+        stale.add("co2");
+        stale.add("airTemp");
+        stale.add("airHumidity");
+      }
+      if (staleFlags & TELEMETRY_FLAG_STALE_LIGHT) stale.add("light");
+      if (staleFlags & TELEMETRY_FLAG_STALE_EC) stale.add("ec");
+      if (staleFlags & TELEMETRY_FLAG_STALE_PH) {
+        stale.add("ph");
+        stale.add("waterTemp");
+      }
+    }
+    if (!full) {
+      jsonDoc["acConnected"] = acConnected;   // เฟรมเต็มบอกด้วยการมี/ไม่มีค่า AC
+    }
+
+    // คุณภาพลิงก์ตามที่ Mega เห็น: RTT เฉลี่ย (ms), loss (%), เวลาตั้งแต่บรรทัดที่ถูกต้องล่าสุด (ms)
+    if (live) {
+      JsonObject link = jsonDoc["link"].to<JsonObject>();
+      link["rtt"] = esp32Link.rttAverageMs();
+      link["loss"] = esp32Link.lossPercent();
+      link["silence"] = esp32Link.silenceMs(millis());
+    }
+  }
+
+  // ค่าดิบก่อนกรอง (หน่วยเดียวกับค่าที่กรองแล้ว) ของฟิลด์ที่มีในข้อความนี้
+  if (live && (hasField(fields, TELEMETRY_FIELD_CO2) || hasField(fields, TELEMETRY_FIELD_LUX) ||
+               hasField(fields, TELEMETRY_FIELD_EC) || hasField(fields, TELEMETRY_FIELD_PH))) {
+    JsonObject raw = jsonDoc["raw"].to<JsonObject>();
+    if (hasField(fields, TELEMETRY_FIELD_CO2)) raw["co2"] = sensorFilters[FILTER_CO2].raw();
+    if (hasField(fields, TELEMETRY_FIELD_LUX)) raw["light"] = (uint32_t)sensorFilters[FILTER_LIGHT].raw();
+    if (hasField(fields, TELEMETRY_FIELD_EC)) raw["ec"] = sensorFilters[FILTER_EC].raw() / 10.0;
+    if (hasField(fields, TELEMETRY_FIELD_PH)) raw["ph"] = divRound(sensorFilters[FILTER_PH].raw(), 10) / 10.0;
+  }
+
+  // สถานะ relay (bit0 = K1) มีเฉพาะในข้อความ delta/กลุ่ม - SENSOR_DATA คงรูปแบบเดิม
+  if (!full && hasField(fields, TELEMETRY_FIELD_RELAYS)) {
+    jsonDoc["relays"] = (uint8_t)frame.relayStates;
+  }
+  
+  // เพิ่มข้อมูล AC Power Sensor
+  if (acConnected) {
+    if (hasField(fields, TELEMETRY_FIELD_AC_VOLTAGE)) jsonDoc["acVoltage"] = frame.acVoltage / 10.0;
+    if (hasField(fields, TELEMETRY_FIELD_AC_CURRENT)) jsonDoc["acCurrent"] = frame.acCurrent / 1000.0;
+    if (hasField(fields, TELEMETRY_FIELD_AC_POWER)) jsonDoc["acPower"] = frame.acPower / 10.0;
+    if (hasField(fields, TELEMETRY_FIELD_AC_ENERGY)) jsonDoc["acEnergy"] = frame.acEnergy / 1000.0;   // kWh
+    if (hasField(fields, TELEMETRY_FIELD_AC_FREQUENCY)) jsonDoc["acFrequency"] = frame.acFrequency / 10.0;
+    if (hasField(fields, TELEMETRY_FIELD_AC_POWER_FACTOR)) jsonDoc["acPowerFactor"] = frame.acPowerFactor / 100.0;
+  }
+  
+  // เพิ่มข้อมูลจากเซนเซอร์วัดอัตราการไหลของน้ำ (Flow Sensors)
+  // L/min ทศนิยม 1 ตำแหน่ง และลิตรทศนิยม 2 ตำแหน่ง
+  static const char* const FLOW_RATE_KEYS[FLOW_CHANNELS] = {"flowSensor1_LPM", "flowSensor2_LPM", "flowSensor3_LPM"};
+  static const char* const FLOW_TOTAL_KEYS[FLOW_CHANNELS] = {"flowSensor1_Liters", "flowSensor2_Liters", "flowSensor3_Liters"};
+  for (uint8_t i = 0; i < FLOW_CHANNELS; i++) {
+    if (hasField(fields, TELEMETRY_FIELD_FLOW_RATE_1 + i)) {
+      jsonDoc[FLOW_RATE_KEYS[i]] = divRound((int32_t)frame.flowRate[i], 10) / 10.0;
+    }
+  }
+  for (uint8_t i = 0; i < FLOW_CHANNELS; i++) {
+    if (hasField(fields, TELEMETRY_FIELD_FLOW_TOTAL_1 + i)) {
+      jsonDoc[FLOW_TOTAL_KEYS[i]] = divRoundUnsigned(frame.flowTotal[i], 10) / 100.0;
+    }
+  }
+  
+  // แปลง JSON เป็น String และส่งไปยัง ESP32
+  serializeJson(jsonDoc, Serial2);
+  Serial2.println();  // ปิดท้ายบรรทัดให้ ESP32 อ่านง่าย
+}
+
+// ===== RELAY CONTROL FUNCTIONS =====
+
+/**
  * ฟังก์ชันเริ่มต้นระบบ Relay
- * ตั้งค่าขา OUTPUT และปิด relay ทั้งหมด
+ * ตั้งค่าขา OUTPUT และปิด relay ทั้งหมด (ไม่พิมพ์อะไร จึงเรียกได้ก่อน Serial.begin())
  * K1: Active High (HIGH = OFF, LOW = ON)
  * K2-K8: Active Low (HIGH = OFF, LOW = ON)
  */
 void initRelays() {
+  // ตั้งระดับ OFF ของทุกขาก่อนแล้วจึงเปลี่ยนเป็น OUTPUT
+  relayDriverBegin(relayPins, relayActiveHigh, relayPinCount);
+}
+
+/**
+ * แสดงขาและขั้วของ relay แต่ละตัวบน Serial Monitor (หลัง Serial.begin())
+ */
+void printRelayWiring() {
   Serial.println("\n--- เริ่มต้นระบบ Relay Control ---");
   Serial.println("K1 (Light): Active High | K2-K8: Active Low");
-  
+
   for (int i = 0; i < relayPinCount; i++) {
-    pinMode(relayPins[i], OUTPUT);
-    
-    if (relayActiveHigh[i]) {
-      // K1 (Light): Active High - HIGH = OFF, LOW = ON
-      digitalWrite(relayPins[i], LOW);
-      Serial.print("Relay K"); 
-      Serial.print(i + 1);
-      Serial.print(" (Pin ");
-      Serial.print(relayPins[i]);
-      Serial.println(") = OFF (Active High)");
-    } else {
-      // K2-K8: Active Low - HIGH = OFF, LOW = ON
-      digitalWrite(relayPins[i], HIGH);
-      Serial.print("Relay K"); 
-      Serial.print(i + 1);
-      Serial.print(" (Pin ");
-      Serial.print(relayPins[i]);
-      Serial.println(") = OFF (Active Low)");
-    }
-    
-    relayStates[i] = false;
+    // สถานะหลังคืนค่าจาก EEPROM (K1: Active High, K2-K8: Active Low)
+    Serial.print("Relay K");
+    Serial.print(i + 1);
+    Serial.print(" (Pin ");
+    Serial.print(relayPins[i]);
+    Serial.print(") = ");
+    Serial.print(relayIsOn(i) ? "ON" : "OFF");
+    Serial.println(relayActiveHigh[i] ? " (Active High)" : " (Active Low)");
   }
   Serial.println("✅ Relay system initialized\n");
 }
 
 /**
  * ฟังก์ชันควบคุม relay ตามคำสั่ง string
- * @param command String 8 ตัวอักษร เช่น "00110000"
- *                '1' = เปิด relay, '0' = ปิด relay
+ * relay ทุกตัวใน pattern เปลี่ยนพร้อมกันด้วย relayApply() ครั้งเดียว
+ * @param command ข้อความ 8 ตัวอักษร เช่น "00110000"
+ *                '1' = เปิด relay, '0' = ปิด relay, '-' = คงสถานะเดิม
  */
-void applyRelayCommand(String command) {
+void applyRelayCommand(const char* command) {
   // ตรวจสอบความยาวคำสั่ง
-  int len = command.length();
+  int len = strlen(command);
   int n = min(len, relayPinCount);
-  
-  Serial.println("\n=== Apply Relay Command ===");
-  Serial.println("Command: " + command);
-  Serial.println("K1:Active High | K2-K8:Active Low");
-  Serial.println("------------------------");
-  
+  uint8_t changeMask = 0;
+  uint8_t onMask = 0;
+
   for (int i = 0; i < n; i++) {
-    char bitChar = command.charAt(i);
-    bool shouldBeOn = (bitChar == '1');
-    
-    // ตรวจสอบว่าสถานะเปลี่ยนหรือไม่
-    if (relayStates[i] != shouldBeOn) {
-      relayStates[i] = shouldBeOn;
-      
-      if (shouldBeOn) {
-        // เปิด relay
-        if (relayActiveHigh[i]) {
-          // K1 (Light): Active High - HIGH = ON
-          digitalWrite(relayPins[i], HIGH);
-          Serial.print("✅ Relay K");
-          Serial.print(i + 1);
-          Serial.print(" (Pin ");
-          Serial.print(relayPins[i]);
-          Serial.println(") = ON (Active High)");
-        } else {
-          // K2-K8: Active Low - LOW = ON
-          digitalWrite(relayPins[i], LOW);
-          Serial.print("✅ Relay K");
-          Serial.print(i + 1);
-          Serial.print(" (Pin ");
-          Serial.print(relayPins[i]);
-          Serial.println(") = ON (Active Low)");
-        }
-      } else {
-        // ปิด relay
-        if (relayActiveHigh[i]) {
-          // K1 (Light): Active High - LOW = OFF
-          digitalWrite(relayPins[i], LOW);
-          Serial.print("❌ Relay K");
-          Serial.print(i + 1);
-          Serial.print(" (Pin ");
-          Serial.print(relayPins[i]);
-          Serial.println(") = OFF (Active High)");
-        } else {
-          // K2-K8: Active Low - HIGH = OFF
-          digitalWrite(relayPins[i], HIGH);
-          Serial.print("❌ Relay K");
-          Serial.print(i + 1);
-          Serial.print(" (Pin ");
-          Serial.print(relayPins[i]);
-          Serial.println(") = OFF (Active Low)");
-        }
-      }
+    char bitChar = command[i];
+    if (bitChar != '0' && bitChar != '1') {
+      continue; // '-' = คงสถานะเดิม (เช่น relay ที่ pump timer คุมอยู่)
+    }
+    changeMask |= (1 << i);
+    if (bitChar == '1') {
+      onMask |= (1 << i);
     }
   }
-  
-  // บันทึกคำสั่งล่าสุด
-  lastRelayCommand = command;
-  Serial.println("========================\n");
+
+  uint8_t before = relayStateMask();
+  relayApply(changeMask, onMask);
+  uint8_t after = relayStateMask();
+
+  for (int i = 0; i < n; i++) {
+    bool isOn = after & (1 << i);
+    if ((before ^ after) & (1 << i)) {
+      LOG_DEBUG("%s Relay K%d (Pin %d) = %s", isOn ? "✅" : "❌",
+                i + 1, relayPins[i], isOn ? "ON" : "OFF");
+    }
+
+    // บันทึกคำสั่งล่าสุด (ตำแหน่ง '-' เก็บสถานะจริง)
+    lastRelayCommand[i] = isOn ? '1' : '0';
+  }
 }
 
 /**
  * ฟังก์ชันแสดงสถานะ relay ทั้งหมด
  */
 void printRelayStatus() {
-  Serial.println("\n=== Relay Status ===");
-  Serial.println("K1:Active High | K2-K8:Active Low");
   for (int i = 0; i < relayPinCount; i++) {
-    Serial.print("K");
-    Serial.print(i + 1);
-    Serial.print(" (Pin ");
-    Serial.print(relayPins[i]);
-    Serial.print(") = ");
-    Serial.print(relayStates[i] ? "ON" : "OFF");
-    Serial.print(" (");
-    Serial.print(relayActiveHigh[i] ? "Active High" : "Active Low");
-    Serial.println(")");
+    LOG_INFO("K%d (Pin %d) = %s (%s)", i + 1, relayPins[i],
+             relayIsOn(i) ? "ON" : "OFF",
+             relayActiveHigh[i] ? "Active High" : "Active Low");
+  }
+  LOG_INFO("Current pattern: %s", lastRelayCommand);
+}
+
+// ===== SENSOR HISTORY FUNCTIONS =====
+
+// เก็บค่าปัจจุบันของทุกช่องลงนาทีปัจจุบัน (ข้ามเซ็นเซอร์ที่ยังไม่เคยอ่านได้หรือค่าไม่สดแล้ว)
+void recordHistorySamples() {
+  sensorHistory.update(millis());
+
+  const SlaveHealth& air = sensorHealth[0];     // ID 1
+  const SlaveHealth& ec = sensorHealth[2];      // ID 3
+  const SlaveHealth& ph = sensorHealth[3];      // ID 4
+  if (air.everGood && !air.stale()) {
+    sensorHistory.sample(HISTORY_AIR_TEMP, airTemp);
+    sensorHistory.sample(HISTORY_CO2, co2Ppm);
+  }
+  if (ec.everGood && !ec.stale()) {
+    sensorHistory.sample(HISTORY_EC, divRound(ecValue, 10));   // µS/cm x10 -> µS/cm
+  }
+  if (ph.everGood && !ph.stale()) {
+    sensorHistory.sample(HISTORY_PH, phValue);
+    sensorHistory.sample(HISTORY_WATER_TEMP, waterTemp);
+  }
+
+  int32_t totalFlow = 0;
+  for (uint8_t i = 0; i < FLOW_CHANNELS; i++) {
+    totalFlow += flowRate[i];
   }
-  Serial.println("Current pattern: " + lastRelayCommand);
-  Serial.println("===================\n");
+  sensorHistory.sample(HISTORY_FLOW, totalFlow);
+
+  if (acSensorConnected) {
+    sensorHistory.sample(HISTORY_AC_POWER, divRoundUnsigned(acPower, 10));   // W x10 -> W
+  }
+}
+
+/**
+ * ส่งประวัติที่ขอด้วย HISTORY: ต่ออีก 1 บรรทัด (เฉพาะเมื่อ TX buffer ของ Serial2 รับได้ทั้งบรรทัด)
+ * H:<นาทีเริ่ม>,<ความยาวช่อง นาที>,<min>,<max>,<mean> แล้วจบด้วย HISTORY_END:<ช่อง>,<จำนวนช่อง>
+ * @return true ถ้าส่งอะไรออกไป
+ */
+bool serviceHistoryStream() {
+  if (historyStreamChannel == HISTORY_NONE || Serial2.availableForWrite() < HISTORY_LINE_MAX) {
+    return false;
+  }
+
+  HistoryEntry entry;
+  if (sensorHistory.next(historyStreamChannel, historyStreamFrom, entry)) {
+    Serial2.print(F("H:"));
+    Serial2.print(entry.startMinute);
+    Serial2.print(',');
+    Serial2.print(entry.minutes);
+    Serial2.print(',');
+    Serial2.print(entry.value.min);
+    Serial2.print(',');
+    Serial2.print(entry.value.max);
+    Serial2.print(',');
+    Serial2.println(entry.value.mean);
+    historyStreamFrom = entry.startMinute + entry.minutes;
+    historyStreamCount++;
+    return true;
+  }
+
+  char name[HISTORY_CHANNEL_NAME_MAX];
+  Serial2.print(F("HISTORY_END:"));
+  Serial2.print(historyChannelName(historyStreamChannel, name));
+  Serial2.print(',');
+  Serial2.println(historyStreamCount);
+  historyStreamChannel = HISTORY_NONE;
+  return true;
+}
+
+// ===== PERSISTENT STATE FUNCTIONS =====
+
+// ms -> วินาที (ปัดใกล้สุด) จำกัดไม่เกิน limit
+static uint32_t persistSeconds(uint32_t ms, uint32_t limit) {
+  uint32_t seconds = divRoundUnsigned(ms, 1000);
+  return seconds > limit ? limit : seconds;
+}
+
+// สถานะปัจจุบันในรูปแบบที่เก็บลง journal (ไบต์ที่ไม่ใช้เป็น 0 เสมอ จึงเทียบด้วย memcmp ได้)
+void capturePersistentState(PersistentState& state) {
+  memset(&state, 0, sizeof(state));
+  state.version = PERSIST_VERSION;
+  state.relays = relayStateMask() & ~(actuatorActiveMask() | ruleEngine.relayMask());
+  state.flags = isEcSensorRange4400 ? PERSIST_FLAG_EC_RANGE_4400 : 0;
+
+  for (uint8_t relay = 0; relay < ACTUATOR_SLOT_COUNT && state.cycleCount < PERSIST_MAX_CYCLES; relay++) {
+    uint32_t onMs, offMs, maxRunMs;
+    if (!actuatorCycleConfig(relay, onMs, offMs, maxRunMs)) {
+      continue;
+    }
+    PersistedCycle& cycle = state.cycles[state.cycleCount++];
+    cycle.relay = relay;
+    cycle.onSeconds = persistSeconds(onMs, 0xFFFF);
+    cycle.offSeconds = persistSeconds(offMs, 0xFFFF);
+    cycle.maxRunSeconds = persistSeconds(maxRunMs, 0xFFFFFFFFUL / 1000);
+  }
+
+  for (uint8_t i = 0; i < FLOW_CHANNELS; i++) {
+    state.flowPulseTotal[i] = flowPulseTotal[i];
+  }
+}
+
+/**
+ * อ่าน record ล่าสุดจาก journal แล้วคืนสถานะ (เรียกหลัง initRelays() และ actuatorTimerBegin())
+ * EEPROM ว่างหรือ record คนละเวอร์ชัน: ใช้ค่าเริ่มต้นตามเดิม
+ */
+void restorePersistentState() {
+  uint8_t payload[JOURNAL_PAYLOAD_SIZE];
+  PersistentState saved;
+  bool found = stateJournal.begin(payload);
+  memcpy(&saved, payload, sizeof(saved));
+
+  if (found && saved.version == PERSIST_VERSION) {
+    isEcSensorRange4400 = saved.flags & PERSIST_FLAG_EC_RANGE_4400;
+    for (uint8_t i = 0; i < FLOW_CHANNELS; i++) {
+      flowPulseTotal[i] = saved.flowPulseTotal[i];
+    }
+
+    char pattern[RELAY_MAX + 1];
+    for (uint8_t i = 0; i < RELAY_MAX; i++) {
+      pattern[i] = (saved.relays & (1 << i)) ? '1' : '0';
+    }
+    pattern[RELAY_MAX] = '\0';
+    applyRelayCommand(pattern);
+
+    uint8_t cycles = min(saved.cycleCount, (uint8_t)PERSIST_MAX_CYCLES);
+    for (uint8_t i = 0; i < cycles; i++) {
+      const PersistedCycle& cycle = saved.cycles[i];
+      if (cycle.relay < ACTUATOR_SLOT_COUNT) {
+        actuatorStartCycle(cycle.relay, cycle.onSeconds * 1000UL, cycle.offSeconds * 1000UL,
+                           cycle.maxRunSeconds * 1000UL);
+      }
+    }
+    LOG_INFO("💾 Restored state #%lu: relays %s, %u cycle(s), EC range %s",
+             (unsigned long)stateJournal.sequence(), pattern, cycles,
+             isEcSensorRange4400 ? "4400" : "44000");
+  } else if (found) {
+    LOG_WARN("💾 Ignoring saved state version %u", saved.version);
+  }
+
+  PersistentRules savedRules;
+  if (rulesJournal.begin(payload)) {
+    memcpy(&savedRules, payload, sizeof(savedRules));
+    if (savedRules.version == RULES_PERSIST_VERSION) {
+      for (uint8_t i = 0; i < RULE_MAX; i++) {
+        const PersistedRule& persisted = savedRules.rules[i];
+        RelayRule rule;
+        rule.field = persisted.target & 0x1F;
+        rule.relay = persisted.target >> 5;
+        rule.onValue = persisted.onValue;
+        rule.offValue = persisted.offValue;
+        rule.minOnSeconds = persisted.minOnSeconds;
+        rule.minOffSeconds = persisted.minOffSeconds;
+        if (persisted.target != RULES_PERSIST_EMPTY && rule.field < TELEMETRY_FIELD_COUNT &&
+            RuleEngine::valid(rule)) {
+          ruleEngine.set(rule);
+        }
+      }
+      // relay ที่มีกฎเริ่มจากปิด และรอครบ minOff ก่อนเปิดครั้งแรก (กันคอมเพรสเซอร์สตาร์ตซ้ำหลังไฟกระพริบ)
+      ruleEngine.restartTimers(millis());
+      LOG_INFO("💾 Restored rules #%lu: relays 0x%02X", (unsigned long)rulesJournal.sequence(),
+               ruleEngine.relayMask());
+    }
+  }
+
+  capturePersistentState(persistedState);
+  lastFlowPersistTime = millis();
+}
+
+// ตารางกฎในรูปแบบที่เก็บลง journal
+void captureRules(PersistentRules& saved) {
+  memset(&saved, 0, sizeof(saved));
+  saved.version = RULES_PERSIST_VERSION;
+  for (uint8_t i = 0; i < RULE_MAX; i++) {
+    const RelayRule& rule = ruleEngine.rule(i);
+    PersistedRule& persisted = saved.rules[i];
+    if (rule.field == RULE_NONE) {
+      persisted.target = RULES_PERSIST_EMPTY;
+      continue;
+    }
+    persisted.target = rule.field | (rule.relay << 5);
+    persisted.onValue = rule.onValue;
+    persisted.offValue = rule.offValue;
+    persisted.minOnSeconds = rule.minOnSeconds;
+    persisted.minOffSeconds = rule.minOffSeconds;
+  }
+}
+
+/**
+ * เขียน journal ต่อทีละไบต์ และเพิ่ม record ใหม่เมื่อสถานะเปลี่ยน (ตรวจทุก PERSIST_CHECK_INTERVAL)
+ * ปริมาณน้ำสะสมอย่างเดียวเปลี่ยน: รอให้ครบ FLOW_PERSIST_INTERVAL ยกเว้นถูกรีเซ็ต (ค่าลดลง) ที่บันทึกทันที
+ */
+void servicePersistence() {
+  stateJournal.poll();
+  rulesJournal.poll();
+
+  // กฎเปลี่ยนเฉพาะจากคำสั่ง: เขียนเมื่อ record ก่อนหน้าของช่วงกฎเสร็จแล้ว
+  if (rulesDirty && !rulesJournal.busy()) {
+    PersistentRules saved;
+    captureRules(saved);
+    uint8_t payload[JOURNAL_PAYLOAD_SIZE];
+    memset(payload, 0, sizeof(payload));
+    memcpy(payload, &saved, sizeof(saved));
+    rulesDirty = !rulesJournal.append(payload);
+  }
+
+  if (millis() - lastPersistCheck < PERSIST_CHECK_INTERVAL || stateJournal.busy()) {
+    return;
+  }
+  lastPersistCheck = millis();
+
+  PersistentState state;
+  capturePersistentState(state);
+
+  bool flowChanged = false;
+  bool flowReset = false;
+  for (uint8_t i = 0; i < FLOW_CHANNELS; i++) {
+    flowChanged = flowChanged || state.flowPulseTotal[i] != persistedState.flowPulseTotal[i];
+    flowReset = flowReset || state.flowPulseTotal[i] < persistedState.flowPulseTotal[i];
+  }
+  if (flowChanged && !flowReset && millis() - lastFlowPersistTime < FLOW_PERSIST_INTERVAL) {
+    memcpy(state.flowPulseTotal, persistedState.flowPulseTotal, sizeof(state.flowPulseTotal));
+    flowChanged = false;
+  }
+
+  if (memcmp(&state, &persistedState, sizeof(state)) == 0) {
+    return;
+  }
+
+  uint8_t payload[JOURNAL_PAYLOAD_SIZE];
+  memset(payload, 0, sizeof(payload));
+  memcpy(payload, &state, sizeof(state));
+  if (!stateJournal.append(payload)) {
+    return;
+  }
+  if (flowChanged) {
+    lastFlowPersistTime = millis();
+  }
+  persistedState = state;
+  LOG_DEBUG("💾 Saving state #%lu to slot %u", (unsigned long)(stateJournal.sequence() + 1),
+            stateJournal.nextSlot());
 }
 
 // ===== EC CALIBRATION FUNCTION (หลัก) =====
 
 /**
  * ฟังก์ชันคำนวณค่า EC ที่แคลิเบรตแล้ว
- * สมการ: y = 15.968x - 53.913 (R² = 0.9973)
+ * สมการ: y = 15.968x - 53.913 (R² = 0.9973) คำนวณด้วยจำนวนเต็มผ่าน EcConversion*
  * 
- * @param rawValue ค่า raw จากเซ็นเซอร์ EC (x)
- * @return ค่า EC ที่แคลิเบรตแล้ว (y) หน่วย µS/cm
+ * @param rawValue ค่า register จากเซ็นเซอร์ EC (ช่วง 4400: x = raw / 10, ช่วง 44000: x = raw)
+ * @return ค่า EC ที่แคลิเบรตแล้ว (y) หน่วย µS/cm x10 จำกัดช่วง 0-5000 µS/cm
  */
-float calibrateEC(float rawValue) {
-  // สมการหลัก: y = 15.968x - 53.913
-  float calibratedValue = (EC_SLOPE * rawValue) + EC_INTERCEPT;
-  
-  // จำกัดช่วงค่าให้สมเหตุสมผล (0-5000 µS/cm)
-  if (calibratedValue < 0.0) {
-    calibratedValue = 0.0;    // ค่าต่ำสุด
-  } else if (calibratedValue > 5000.0) {
-    calibratedValue = 5000.0; // ค่าสูงสุด
+uint16_t calibrateEC(uint16_t rawValue) {
+  if (isEcSensorRange4400) {
+    return EcConversion4400::convert(rawValue);
   }
-  
-  return calibratedValue;
-}
\ No newline at end of file
+  return EcConversion44000::convert(rawValue);
+}
+
+// ===== STORE-AND-FORWARD FUNCTIONS =====
+
+// ส่งเหตุการณ์ทันที หรือเข้าคิวถ้าลิงก์ขาด/ยังมีของเก่าค้างในคิว (คงลำดับเดิม)
+void reportActuatorEvent(const ActuatorEvent& event) {
+  if (!esp32LinkLost && outbox.empty()) {
+    printActuatorEvent(event);
+    return;
+  }
+  // รอบ ON/OFF ของพัดลมเกิดบ่อยจึงห้ามเบียดเหตุการณ์ของปั๊มออกจากคิว
+  uint8_t priority = event.kind == ACTUATOR_CYCLE_SWITCH ? OUTBOUND_STATUS : OUTBOUND_CRITICAL;
+  if (outbox.push(OUTBOX_EVENT, priority, &event, sizeof(event), millis()) == 0) {
+    LOG_WARN("📦 Outbox full, K%d event dropped", event.relay + 1);
+  }
+}
+
+// เหตุการณ์ของตัวควบคุมการเติม: ทางเดียวกับเหตุการณ์ของ actuator
+void reportDoseEvent(const DoseEvent& event) {
+  if (!esp32LinkLost && outbox.empty()) {
+    printDoseEvent(event);
+    return;
+  }
+  uint8_t priority = event.step == DOSE_STEP_LIMIT || event.step == DOSE_STEP_FAULT ? OUTBOUND_CRITICAL
+                                                                                     : OUTBOUND_STATUS;
+  if (outbox.push(OUTBOX_DOSE, priority, &event, sizeof(event), millis()) == 0) {
+    LOG_WARN("📦 Outbox full, dose event dropped");
+  }
+}
+
+// การสลับของกฎ relay: ทางเดียวกับเหตุการณ์ของ actuator (พัดลม/ทำความเย็นสลับบ่อย จึงไม่ใช่ CRITICAL)
+void reportRuleEvent(const RuleSwitchEvent& event) {
+  if (!esp32LinkLost && outbox.empty()) {
+    printRuleEvent(event);
+    return;
+  }
+  if (outbox.push(OUTBOX_RULE, OUTBOUND_STATUS, &event, sizeof(event), millis()) == 0) {
+    LOG_WARN("📦 Outbox full, K%d rule event dropped", event.relay + 1);
+  }
+}
+
+// snapshot ของค่าทั้งหมดทุก OUTBOX_SNAPSHOT_INTERVAL ขณะลิงก์ขาด (ครั้งแรกทันทีที่ขาด)
+void queueSnapshot() {
+  unsigned long now = millis();
+  if (snapshotQueued && now - lastSnapshotQueued < OUTBOX_SNAPSHOT_INTERVAL) {
+    return;
+  }
+  snapshotQueued = true;
+  lastSnapshotQueued = now;
+
+  TelemetryFrameV1 frame;
+  buildTelemetryFrame(frame);
+  frame.sequence = telemetrySequence;   // เฟรม binary ที่ส่งซ้ำใช้เลขนี้ (ไม่นับเป็นเฟรมใหม่)
+  outbox.push(OUTBOX_SNAPSHOT, OUTBOUND_ROUTINE, &frame, sizeof(frame), now);
+}
+
+/**
+ * ส่ง record หัวคิวซ้ำเมื่อลิงก์ปกติ (ครั้งละ 1 record แล้วรอ ACK ไม่เกิน REPLAY_ACK_TIMEOUT)
+ * REPLAY:<seq>,<อายุ ms>,<บรรทัดเหตุการณ์เดิม หรือ JSON SENSOR_DATA>
+ * โหมด binary: REPLAY:<seq>,<อายุ ms> แล้วตามด้วยเฟรม binary ของ snapshot
+ * @return true ถ้าส่งรอบนี้
+ */
+bool serviceOutbox() {
+  const OutboundRecord* record = outbox.front();
+  if (record == NULL || esp32LinkLost) {
+    return false;
+  }
+  unsigned long now = millis();
+  if (replayInFlight == record->sequence && now - replaySentTime < REPLAY_ACK_TIMEOUT) {
+    return false;
+  }
+  replayInFlight = record->sequence;
+  replaySentTime = now;
+
+  Serial2.print(F("REPLAY:"));
+  Serial2.print(record->sequence);
+  Serial2.print(',');
+  Serial2.print(now - record->queuedMs);
+
+  if (record->kind == OUTBOX_EVENT) {
+    ActuatorEvent event;
+    memcpy(&event, record->payload, sizeof(event));
+    Serial2.print(',');
+    printActuatorEvent(event);
+    return true;
+  }
+  if (record->kind == OUTBOX_DOSE) {
+    DoseEvent event;
+    memcpy(&event, record->payload, sizeof(event));
+    Serial2.print(',');
+    printDoseEvent(event);
+    return true;
+  }
+  if (record->kind == OUTBOX_RULE) {
+    RuleSwitchEvent event;
+    memcpy(&event, record->payload, sizeof(event));
+    Serial2.print(',');
+    printRuleEvent(event);
+    return true;
+  }
+
+  TelemetryFrameV1 frame;
+  memcpy(&frame, record->payload, sizeof(frame));
+  if (binaryTelemetry) {
+    Serial2.println();
+    uint8_t wire[TELEMETRY_WIRE_MAX];
+    size_t length = encodeTelemetryFrame(frame, frame.sequence, wire, sizeof(wire));
+    Serial2.write(wire, length);
+  } else {
+    Serial2.print(',');
+    sendJsonTelemetry(frame, TELEMETRY_ALL_FIELDS, TELEMETRY_GROUP_NONE, false);
+  }
+  return true;
+}
@@ -0,0 +1,193 @@
+#include "modbus_rtu.h"
+
+void ModbusRtuMaster::begin(HardwareSerial& serial, unsigned long baud, uint8_t de, uint8_t re) {
+  port = &serial;
+  dePin = de;
+  rePin = re;
+
+  // Modbus RTU นับ 1 ตัวอักษร = 11 บิต, ช่วงเงียบคงที่ 1750us เมื่อ baud > 19200
+  charTimeUs = 11000000UL / baud;
+  silenceUs = (baud > 19200) ? 1750 : (charTimeUs * 35) / 10;
+
+  port->begin(baud, SERIAL_8N1);
+
+  if (dePin != MODBUS_NO_PIN) pinMode(dePin, OUTPUT);
+  if (rePin != MODBUS_NO_PIN) pinMode(rePin, OUTPUT);
+  setTransmit(false);
+
+  state = IDLE;
+  lastActivityUs = micros();
+}
+
+bool ModbusRtuMaster::readInputRegisters(uint8_t slaveId, uint16_t address, uint16_t quantity) {
+  return startRequest(slaveId, 0x04, address, quantity);
+}
+
+bool ModbusRtuMaster::readHoldingRegisters(uint8_t slaveId, uint16_t address, uint16_t quantity) {
+  return startRequest(slaveId, 0x03, address, quantity);
+}
+
+bool ModbusRtuMaster::startRequest(uint8_t slaveId, uint8_t function, uint16_t address, uint16_t quantity) {
+  if (state != IDLE || port == nullptr || quantity == 0 || quantity > MODBUS_MAX_REGISTERS) {
+    return false;
+  }
+
+  requestFrame[0] = slaveId;
+  requestFrame[1] = function;
+  requestFrame[2] = highByte(address);
+  requestFrame[3] = lowByte(address);
+  requestFrame[4] = highByte(quantity);
+  requestFrame[5] = lowByte(quantity);
+  uint16_t crc = modbusCrc16(requestFrame, 6);
+  requestFrame[6] = lowByte(crc);   // CRC ส่งไบต์ต่ำก่อน
+  requestFrame[7] = highByte(crc);
+  requestLength = MODBUS_REQUEST_FRAME;
+
+  responseLength = 0;
+  registerCount = 0;
+  state = WAIT_SILENCE;
+  return true;
+}
+
+bool ModbusRtuMaster::sendCommand(uint8_t slaveId, uint8_t function) {
+  if (state != IDLE || port == nullptr) {
+    return false;
+  }
+
+  requestFrame[0] = slaveId;
+  requestFrame[1] = function;
+  uint16_t crc = modbusCrc16(requestFrame, 2);
+  requestFrame[2] = lowByte(crc);
+  requestFrame[3] = highByte(crc);
+  requestLength = MODBUS_COMMAND_FRAME;
+
+  responseLength = 0;
+  registerCount = 0;
+  state = WAIT_SILENCE;
+  return true;
+}
+
+bool ModbusRtuMaster::poll() {
+  unsigned long now = micros();
+
+  switch (state) {
+    case IDLE:
+      return false;
+
+    case WAIT_SILENCE:
+      // ทิ้งข้อมูลค้างบนบัสและรอช่วงเงียบ 3.5 ตัวอักษรก่อนส่ง
+      while (port->available() > 0) {
+        port->read();
+        lastActivityUs = now;
+      }
+      if (now - lastActivityUs < silenceUs) {
+        return false;
+      }
+      setTransmit(true);
+      port->write(requestFrame, requestLength); // 4-8 ไบต์ลง TX buffer ได้ทันที ไม่บล็อก
+      txDurationUs = requestLength * charTimeUs;
+      phaseStartUs = now;
+      state = TRANSMITTING;
+      return false;
+
+    case TRANSMITTING:
+      // รอให้ส่งครบตามเวลาที่คำนวณไว้ แล้วจึงปล่อย DE/RE กลับเป็นโหมดรับ
+      if (now - phaseStartUs < txDurationUs) {
+        return false;
+      }
+      port->flush(); // ถึงจุดนี้ข้อมูลถูกส่งหมดแล้ว flush() จึงคืนค่าทันที
+      setTransmit(false);
+      phaseStartUs = micros();
+      lastActivityUs = phaseStartUs;
+      state = WAIT_RESPONSE;
+      return false;
+
+    case WAIT_RESPONSE:
+      while (port->available() > 0 && responseLength < MODBUS_MAX_FRAME) {
+        responseFrame[responseLength++] = port->read();
+        lastActivityUs = now;
+      }
+
+      if (responseLength > 0) {
+        uint8_t expected = expectedLength();
+        // เฟรมครบตามความยาว หรือบัสเงียบเกิน 3.5 ตัวอักษร = จบเฟรม
+        if ((expected > 0 && responseLength >= expected) || now - lastActivityUs >= silenceUs) {
+          finish(validateResponse());
+          return true;
+        }
+      }
+
+      if (now - phaseStartUs >= (unsigned long)responseTimeoutMs * 1000UL) {
+        finish(ku8MBResponseTimedOut);
+        return true;
+      }
+      return false;
+  }
+
+  return false;
+}
+
+uint16_t ModbusRtuMaster::getResponseBuffer(uint8_t index) const {
+  return (index < registerCount) ? registers[index] : 0xFFFF;
+}
+
+void ModbusRtuMaster::setTransmit(bool enable) {
+  if (rePin != MODBUS_NO_PIN) digitalWrite(rePin, enable ? HIGH : LOW);
+  if (dePin != MODBUS_NO_PIN) digitalWrite(dePin, enable ? HIGH : LOW);
+}
+
+void ModbusRtuMaster::finish(uint8_t code) {
+  lastResult = code;
+  state = IDLE;
+  lastActivityUs = micros();
+}
+
+uint8_t ModbusRtuMaster::expectedLength() const {
+  if (responseLength < 2) {
+    return 0; // ยังไม่รู้ความยาว
+  }
+  if (responseFrame[1] & 0x80) {
+    return 5; // exception: id, func, code, crc(2)
+  }
+  if (requestLength == MODBUS_COMMAND_FRAME) {
+    return MODBUS_COMMAND_FRAME; // echo ของคำสั่ง
+  }
+  if (responseLength < 3) {
+    return 0;
+  }
+  return 3 + responseFrame[2] + 2;
+}
+
+uint8_t ModbusRtuMaster::validateResponse() {
+  bool command = (requestLength == MODBUS_COMMAND_FRAME);
+  if (responseLength < (command ? MODBUS_COMMAND_FRAME : 5)) {
+    return ku8MBResponseTimedOut; // เฟรมสั้นเกินไป ถือว่าไม่ได้รับคำตอบ
+  }
+
+  uint16_t crc = modbusCrc16(responseFrame, responseLength - 2);
+  if (responseFrame[responseLength - 2] != lowByte(crc) || responseFrame[responseLength - 1] != highByte(crc)) {
+    return ku8MBInvalidCRC;
+  }
+  if (responseFrame[0] != requestFrame[0]) {
+    return ku8MBInvalidSlaveID;
+  }
+  if (responseFrame[1] & 0x80) {
+    return responseFrame[2]; // exception code จาก slave
+  }
+  if (responseFrame[1] != requestFrame[1]) {
+    return ku8MBInvalidFunction;
+  }
+  if (command) {
+    return ku8MBSuccess; // echo ถูกต้อง ไม่มี register
+  }
+
+  uint8_t byteCount = responseFrame[2];
+  if (byteCount + 5 > responseLength) {
+    return ku8MBInvalidCRC;
+  }
+  registerCount = min(byteCount / 2, MODBUS_MAX_REGISTERS);
+  for (uint8_t i = 0; i < registerCount; i++) {
+    registers[i] = word(responseFrame[3 + i * 2], responseFrame[4 + i * 2]);
+  }
+  return ku8MBSuccess;
+}
@@ -0,0 +1,51 @@
+#include "outbound_queue.h"
+
+#include <string.h>
+
+uint16_t OutboundQueue::push(uint8_t kind, uint8_t priority, const void* payload, uint8_t length, uint32_t nowMs) {
+  if (count == OUTBOUND_QUEUE_SLOTS) {
+    // หา record เก่าสุดที่ความสำคัญต่ำสุด (ไม่สูงกว่าของใหม่)
+    uint8_t victim = OUTBOUND_QUEUE_SLOTS;
+    for (uint8_t i = 0; i < count; i++) {
+      if (records[i].priority <= priority &&
+          (victim == OUTBOUND_QUEUE_SLOTS || records[i].priority < records[victim].priority)) {
+        victim = i;
+      }
+    }
+    droppedCount++;
+    if (victim == OUTBOUND_QUEUE_SLOTS) {
+      return 0;
+    }
+    removeAt(victim);
+  }
+
+  if (length > OUTBOUND_PAYLOAD_MAX) {
+    length = OUTBOUND_PAYLOAD_MAX;
+  }
+  if (++sequence == 0) {
+    sequence = 1;   // 0 = ไม่มี record
+  }
+  OutboundRecord& record = records[count++];
+  record.sequence = sequence;
+  record.kind = kind;
+  record.priority = priority;
+  record.queuedMs = nowMs;
+  memcpy(record.payload, payload, length);
+  memset(record.payload + length, 0, OUTBOUND_PAYLOAD_MAX - length);
+  return sequence;
+}
+
+uint8_t OutboundQueue::acknowledge(uint16_t upTo) {
+  // record เรียงตาม sequence: ลบจากหัวคิวจนเจอตัวที่ใหม่กว่า upTo
+  uint8_t removed = 0;
+  while (count > 0 && (int16_t)(records[0].sequence - upTo) <= 0) {
+    removeAt(0);
+    removed++;
+  }
+  return removed;
+}
+
+void OutboundQueue::removeAt(uint8_t index) {
+  count--;
+  memmove(&records[index], &records[index + 1], (count - index) * sizeof(OutboundRecord));
+}
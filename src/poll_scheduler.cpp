@@ -0,0 +1,101 @@
+#include "poll_scheduler.h"
+
+uint32_t PollScheduler::clampPeriod(uint32_t period, const PollConfig& config) {
+  if (period < config.minPeriodMs) return config.minPeriodMs;
+  if (period > config.maxPeriodMs) return config.maxPeriodMs;
+  return period;
+}
+
+uint8_t PollScheduler::add(const PollConfig& config) {
+  if (jobCount >= POLL_MAX_JOBS) {
+    return POLL_NONE;
+  }
+  Job& job = jobs[jobCount];
+  job.hasValue = false;
+  job.lastValue = 0;
+  job.dueMs = millis();
+  job.startedMs = job.dueMs;
+  job.periodMs = 0;
+  configure(jobCount, config);
+  return jobCount++;
+}
+
+void PollScheduler::configure(uint8_t index, const PollConfig& config) {
+  Job& job = jobs[index];
+  job.config = config;
+  if (job.config.minPeriodMs == 0) job.config.minPeriodMs = 1;
+  if (job.config.maxPeriodMs < job.config.minPeriodMs) job.config.maxPeriodMs = job.config.minPeriodMs;
+
+  // เริ่มที่คาบเร็วสุดเมื่อยังไม่มีค่า แล้วปล่อยให้ยืดออกเอง
+  uint32_t oldPeriod = job.periodMs;
+  job.periodMs = clampPeriod(job.hasValue ? job.periodMs : 0, job.config);
+  if (job.periodMs < oldPeriod) {
+    // คาบสั้นลง: ไม่ต้องรอครบคาบเดิม
+    uint32_t now = millis();
+    if ((int32_t)(job.dueMs - (now + job.periodMs)) > 0) {
+      job.dueMs = now + job.periodMs;
+    }
+  }
+}
+
+uint8_t PollScheduler::next(uint32_t nowMs) const {
+  uint8_t best = POLL_NONE;
+  bool bestOverdue = false;
+  uint32_t bestWaited = 0;       // overdue: เวลาที่เกินงบ jitter, ไม่ overdue: เวลาที่รอ
+
+  for (uint8_t i = 0; i < jobCount; i++) {
+    const Job& job = jobs[i];
+    int32_t late = (int32_t)(nowMs - job.dueMs);
+    if (late < 0) {
+      continue;
+    }
+    bool overdue = (uint32_t)late > job.config.jitterMs;
+    uint32_t waited = overdue ? (uint32_t)late - job.config.jitterMs : (uint32_t)late;
+
+    bool better;
+    if (best == POLL_NONE) {
+      better = true;
+    } else if (overdue != bestOverdue) {
+      better = overdue;                              // หมดงบ jitter แล้วได้ไปก่อน
+    } else if (!overdue && job.config.priority != jobs[best].config.priority) {
+      better = job.config.priority < jobs[best].config.priority;
+    } else {
+      better = waited > bestWaited;                    // เกินงบมากกว่า/รอนานกว่าได้ไปก่อน
+    }
+
+    if (better) {
+      best = i;
+      bestOverdue = overdue;
+      bestWaited = waited;
+    }
+  }
+  return best;
+}
+
+void PollScheduler::started(uint8_t index, uint32_t nowMs) {
+  jobs[index].startedMs = nowMs;
+  jobs[index].dueMs = nowMs + jobs[index].periodMs;
+}
+
+void PollScheduler::retryAfter(uint8_t index, uint32_t delayMs) {
+  jobs[index].dueMs = jobs[index].startedMs + delayMs;
+}
+
+void PollScheduler::reportValue(uint8_t index, int32_t value) {
+  Job& job = jobs[index];
+  const PollConfig& c = job.config;
+
+  bool changing = job.hasValue && c.deltaThreshold > 0 && labs(value - job.lastValue) >= c.deltaThreshold;
+  bool nearThreshold = c.band > 0 && labs(value - c.threshold) <= c.band;
+  job.lastValue = value;
+  job.hasValue = true;
+
+  uint32_t oldPeriod = job.periodMs;
+  if (changing || nearThreshold) {
+    job.periodMs = c.minPeriodMs;
+  } else {
+    job.periodMs = clampPeriod(job.periodMs + max(job.periodMs / 4, (uint32_t)1), c);
+  }
+  // started() ตั้งเวลาครั้งถัดไปไว้ด้วยคาบเดิม ปรับตามคาบใหม่
+  job.dueMs += job.periodMs - oldPeriod;
+}
@@ -0,0 +1,58 @@
+#include "pzem_meter.h"
+
+// ค่า 32 บิตจาก 2 register (word ต่ำมาก่อน)
+static uint32_t registerPair(const ModbusRtuMaster& bus, uint8_t index) {
+  return (uint32_t)bus.getResponseBuffer(index) | ((uint32_t)bus.getResponseBuffer(index + 1) << 16);
+}
+
+void PzemMeter::begin(HardwareSerial& serial, uint8_t meterAddress) {
+  address = meterAddress;
+  resetPending = false;
+  operation = OP_NONE;
+  lastOperation = OP_NONE;
+  bus.begin(serial, 9600);   // PZEM ต่อ TTL ตรง ไม่มี MAX485
+}
+
+bool PzemMeter::requestRead() {
+  if (isBusy() || !bus.readInputRegisters(address, 0x0000, PZEM_REGISTER_COUNT)) {
+    return false;
+  }
+  operation = OP_READ;
+  return true;
+}
+
+void PzemMeter::requestEnergyReset() {
+  if (bus.sendCommand(address, PZEM_CMD_RESET_ENERGY)) {
+    operation = OP_RESET_ENERGY;
+  } else {
+    resetPending = true;
+  }
+}
+
+bool PzemMeter::poll() {
+  bool done = bus.poll();
+  if (done) {
+    lastOperation = operation;
+    operation = OP_NONE;
+    if (lastOperation == OP_READ && bus.result() == ModbusRtuMaster::ku8MBSuccess) {
+      parse();
+    }
+  }
+
+  // reset ที่รอคิวอยู่ส่งต่อทันทีเมื่อบัสว่าง
+  if (resetPending && !bus.isBusy() && bus.sendCommand(address, PZEM_CMD_RESET_ENERGY)) {
+    resetPending = false;
+    operation = OP_RESET_ENERGY;
+  }
+  return done;
+}
+
+void PzemMeter::parse() {
+  values.voltage = bus.getResponseBuffer(0);
+  values.current = registerPair(bus, 1);
+  values.power = registerPair(bus, 3);
+  values.energy = registerPair(bus, 5);
+  values.frequency = bus.getResponseBuffer(7);
+  values.pf = bus.getResponseBuffer(8);
+  values.alarm = bus.getResponseBuffer(9) != 0;
+}
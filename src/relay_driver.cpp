@@ -0,0 +1,108 @@
+#include "relay_driver.h"
+
+static volatile uint8_t stateMask = 0;   // bit i = relay i เปิด
+static uint8_t invertMask = 0;           // bit i = relay i เป็น active low
+static uint8_t validMask = 0;            // bit ของ relay ที่มีอยู่จริง
+static uint8_t relayCount = 0;
+static uint8_t relayPins[RELAY_MAX];
+
+#ifdef ARDUINO_ARCH_AVR
+// แต่ละพอร์ต: register PORTx และบิตทั้งหมดที่เป็นของ relay
+struct RelayPort {
+  volatile uint8_t* out;
+  uint8_t mask;
+};
+static RelayPort ports[RELAY_MAX];   // กรณีแย่สุด relay ละพอร์ต
+static uint8_t portCount = 0;
+static uint8_t relayPort[RELAY_MAX];   // index ใน ports[]
+static uint8_t relayBit[RELAY_MAX];    // bit ใน PORTx
+#endif
+
+// เขียนระดับขาทั้งหมดตาม stateMask (เรียกขณะปิด interrupt)
+static void writeOutputs() {
+  uint8_t levels = stateMask ^ invertMask;   // bit i = ขา relay i เป็น HIGH
+#ifdef ARDUINO_ARCH_AVR
+  uint8_t bits[RELAY_MAX] = {0};
+  for (uint8_t i = 0; i < relayCount; i++) {
+    if (levels & (1 << i)) {
+      bits[relayPort[i]] |= relayBit[i];
+    }
+  }
+  for (uint8_t p = 0; p < portCount; p++) {
+    *ports[p].out = (*ports[p].out & ~ports[p].mask) | bits[p];
+  }
+#else
+  for (uint8_t i = 0; i < relayCount; i++) {
+    digitalWrite(relayPins[i], (levels & (1 << i)) ? HIGH : LOW);
+  }
+#endif
+}
+
+void relayDriverBegin(const int* pins, const bool* activeHigh, uint8_t count) {
+  relayCount = min(count, (uint8_t)RELAY_MAX);
+  validMask = (relayCount >= 8) ? 0xFF : (uint8_t)((1 << relayCount) - 1);
+  invertMask = 0;
+#ifdef ARDUINO_ARCH_AVR
+  portCount = 0;
+#endif
+
+  for (uint8_t i = 0; i < relayCount; i++) {
+    relayPins[i] = pins[i];
+    if (!activeHigh[i]) {
+      invertMask |= (1 << i);
+    }
+#ifdef ARDUINO_ARCH_AVR
+    volatile uint8_t* out = portOutputRegister(digitalPinToPort(pins[i]));
+    uint8_t p = 0;
+    while (p < portCount && ports[p].out != out) {
+      p++;
+    }
+    if (p == portCount) {
+      ports[portCount].out = out;
+      ports[portCount].mask = 0;
+      portCount++;
+    }
+    relayPort[i] = p;
+    relayBit[i] = digitalPinToBitMask(pins[i]);
+    ports[p].mask |= relayBit[i];
+#endif
+  }
+
+  // ตั้งระดับ "ปิด" ก่อนเปลี่ยนเป็น OUTPUT เพื่อไม่ให้ relay กระตุกตอนบูต
+  noInterrupts();
+  stateMask = 0;
+  writeOutputs();
+  interrupts();
+  for (uint8_t i = 0; i < relayCount; i++) {
+    pinMode(relayPins[i], OUTPUT);
+  }
+}
+
+void relayApply(uint8_t changeMask, uint8_t onMask) {
+#ifdef ARDUINO_ARCH_AVR
+  uint8_t sreg = SREG;   // เรียกได้ทั้งจาก loop() และ ISR
+  cli();
+#endif
+  changeMask &= validMask;
+  stateMask = (stateMask & ~changeMask) | (onMask & changeMask);
+  writeOutputs();
+#ifdef ARDUINO_ARCH_AVR
+  SREG = sreg;
+#endif
+}
+
+void relaySet(uint8_t index, bool on) {
+  if (index >= relayCount) {
+    return;
+  }
+  uint8_t bit = 1 << index;
+  relayApply(bit, on ? bit : 0);
+}
+
+uint8_t relayStateMask() {
+  return stateMask;
+}
+
+bool relayIsOn(uint8_t index) {
+  return index < relayCount && (stateMask & (1 << index));
+}
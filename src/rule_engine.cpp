@@ -0,0 +1,101 @@
+#include "rule_engine.h"
+
+RuleEngine::RuleEngine() {
+  for (uint8_t i = 0; i < RULE_MAX; i++) {
+    rules[i].field = RULE_NONE;
+    switched[i] = false;
+    held[i] = false;
+    switchCount[i] = 0;
+  }
+}
+
+bool RuleEngine::valid(const RelayRule& rule) {
+  return rule.field != RULE_NONE && rule.field < 32 && rule.relay < 8 && rule.onValue != rule.offValue;
+}
+
+bool RuleEngine::set(const RelayRule& rule) {
+  uint8_t slot = RULE_NONE;
+  for (uint8_t i = 0; i < RULE_MAX; i++) {
+    if (rules[i].field != RULE_NONE && rules[i].relay == rule.relay) {
+      slot = i;
+      break;
+    }
+    if (rules[i].field == RULE_NONE && slot == RULE_NONE) {
+      slot = i;
+    }
+  }
+  if (slot == RULE_NONE) {
+    return false;
+  }
+  rules[slot] = rule;
+  switched[slot] = false;
+  held[slot] = false;
+  switchCount[slot] = 0;
+  return true;
+}
+
+bool RuleEngine::clear(uint8_t relay) {
+  for (uint8_t i = 0; i < RULE_MAX; i++) {
+    if (rules[i].field != RULE_NONE && rules[i].relay == relay) {
+      rules[i].field = RULE_NONE;
+      held[i] = false;
+      return true;
+    }
+  }
+  return false;
+}
+
+void RuleEngine::restartTimers(uint32_t nowMs) {
+  for (uint8_t i = 0; i < RULE_MAX; i++) {
+    switched[i] = true;
+    lastSwitchMs[i] = nowMs;
+  }
+}
+
+uint8_t RuleEngine::relayMask() const {
+  uint8_t mask = 0;
+  for (uint8_t i = 0; i < RULE_MAX; i++) {
+    if (rules[i].field != RULE_NONE) mask |= 1 << rules[i].relay;
+  }
+  return mask;
+}
+
+uint32_t RuleEngine::fieldMask() const {
+  uint32_t mask = 0;
+  for (uint8_t i = 0; i < RULE_MAX; i++) {
+    if (rules[i].field != RULE_NONE) mask |= 1UL << rules[i].field;
+  }
+  return mask;
+}
+
+bool RuleEngine::evaluate(uint8_t index, int32_t value, bool relayOn, uint32_t nowMs, bool& turnOn) {
+  const RelayRule& rule = rules[index];
+  if (rule.field == RULE_NONE) {
+    return false;
+  }
+
+  bool want = relayOn;
+  if (rule.onValue > rule.offValue) {
+    if (value >= rule.onValue) want = true;
+    else if (value <= rule.offValue) want = false;
+  } else {
+    if (value <= rule.onValue) want = true;
+    else if (value >= rule.offValue) want = false;
+  }
+  if (want == relayOn) {
+    held[index] = false;
+    return false;
+  }
+
+  uint32_t minMs = (uint32_t)(relayOn ? rule.minOnSeconds : rule.minOffSeconds) * 1000UL;
+  if (switched[index] && nowMs - lastSwitchMs[index] < minMs) {
+    held[index] = true;
+    return false;
+  }
+  held[index] = false;
+  switched[index] = true;
+  lastSwitchMs[index] = nowMs;
+  switchCount[index]++;
+  turnOn = want;
+  return true;
+}
@@ -0,0 +1,92 @@
+#include "sensor_filter.h"
+
+static const char CHANNEL_NAMES[FILTER_CHANNEL_COUNT][FILTER_CHANNEL_NAME_MAX] PROGMEM = {
+  "co2", "light", "ec", "ph"
+};
+
+uint8_t filterChannelFromName(const char* name) {
+  for (uint8_t i = 0; i < FILTER_CHANNEL_COUNT; i++) {
+    if (strcmp_P(name, CHANNEL_NAMES[i]) == 0) {
+      return i;
+    }
+  }
+  return FILTER_NONE;
+}
+
+const char* filterChannelName(uint8_t channel, char* buffer) {
+  memcpy_P(buffer, CHANNEL_NAMES[channel], FILTER_CHANNEL_NAME_MAX);
+  return buffer;
+}
+
+bool SensorFilter::valid(const FilterConfig& config) {
+  return config.median >= 1 && config.median <= FILTER_MEDIAN_MAX && (config.median & 1) &&
+         config.emaShift <= FILTER_EMA_SHIFT_MAX && config.maxRatePerSec <= FILTER_RATE_MAX;
+}
+
+void SensorFilter::configure(const FilterConfig& config) {
+  settings = config;
+  head = 0;
+  count = 0;
+  primed = false;
+  limitedCount = 0;
+}
+
+int32_t SensorFilter::median(int32_t sample) {
+  window[head] = sample;
+  head = (head + 1) % settings.median;
+  if (count < settings.median) {
+    count++;
+  }
+
+  int32_t sorted[FILTER_MEDIAN_MAX];
+  for (uint8_t i = 0; i < count; i++) {
+    int32_t value = window[i];
+    uint8_t j = i;
+    while (j > 0 && sorted[j - 1] > value) {
+      sorted[j] = sorted[j - 1];
+      j--;
+    }
+    sorted[j] = value;
+  }
+  // จำนวนคู่ (ช่วงแรก) ใช้ค่ากลางตัวล่าง
+  return sorted[(count - 1) / 2];
+}
+
+int32_t SensorFilter::update(int32_t raw, uint32_t nowMs) {
+  lastRaw = raw;
+  if (raw > FILTER_VALUE_LIMIT) raw = FILTER_VALUE_LIMIT;
+  if (raw < -FILTER_VALUE_LIMIT) raw = -FILTER_VALUE_LIMIT;
+
+  int32_t value = settings.median > 1 ? median(raw) : raw;
+
+  if (!primed) {
+    primed = true;
+    limited = value;
+    emaScaled = value * (1L << FILTER_EMA_FRACTION_BITS);
+  } else {
+    if (settings.maxRatePerSec > 0) {
+      // เวลาระหว่างตัวอย่างไม่เกิน 60 s (หลังขาดการอ่านนานๆ ก็ไม่ให้กระโดดเกินนี้) และไม่ล้น uint32
+      uint32_t elapsed = nowMs - lastMs;
+      if (elapsed > 60000UL) elapsed = 60000UL;
+      uint32_t allowed = settings.maxRatePerSec * (elapsed / 1000) +
+                         settings.maxRatePerSec * (elapsed % 1000) / 1000;
+      if (allowed == 0) allowed = 1;
+      int32_t step = value - limited;
+      if (step > (int32_t)allowed) {
+        value = limited + (int32_t)allowed;
+        limitedCount++;
+      } else if (step < -(int32_t)allowed) {
+        value = limited - (int32_t)allowed;
+        limitedCount++;
+      }
+    }
+    limited = value;
+    int32_t scaled = value * (1L << FILTER_EMA_FRACTION_BITS);
+    emaScaled += (scaled - emaScaled) / (1L << settings.emaShift);
+  }
+  lastMs = nowMs;
+
+  output = settings.emaShift > 0 ? (emaScaled + (1L << (FILTER_EMA_FRACTION_BITS - 1))) >> FILTER_EMA_FRACTION_BITS
+                                 : limited;
+  return output;
+}
@@ -0,0 +1,175 @@
+#include "sensor_history.h"
+#include "fixed_point.h"
+
+#define HISTORY_NO_DATA (-32768)   // ค่าที่ sample() ไม่มีวันเก็บ (ค่าถูกจำกัดที่ ±32767)
+
+struct TierInfo {
+  uint8_t slots;
+  uint8_t offset;     // ตำแหน่งแรกของชั้นใน buckets[]
+  uint8_t minutes;    // ความยาวช่อง
+};
+
+static const TierInfo TIERS[HISTORY_TIERS] = {
+  {HISTORY_TIER0_SLOTS, 0,                                         1},
+  {HISTORY_TIER1_SLOTS, HISTORY_TIER0_SLOTS,                       15},
+  {HISTORY_TIER2_SLOTS, HISTORY_TIER0_SLOTS + HISTORY_TIER1_SLOTS, 120},
+};
+
+// ยุบรวมจากช่องในชั้นก่อนหน้า: ชั้นก่อนหน้าต้องมีช่องพอสำหรับ 1 ช่องของชั้นนี้
+static_assert(HISTORY_TIER0_SLOTS >= 15 / 1, "tier 0 must hold one tier-1 bucket");
+static_assert(HISTORY_TIER1_SLOTS >= 120 / 15, "tier 1 must hold one tier-2 bucket");
+static_assert(sizeof(SensorHistory) <= HISTORY_RAM_BUDGET, "SensorHistory exceeds its SRAM budget");
+
+static const char CHANNEL_NAMES[HISTORY_CHANNEL_COUNT][HISTORY_CHANNEL_NAME_MAX] PROGMEM = {
+  "airTemp", "co2", "ec", "ph", "waterTemp", "flow", "acPower"
+};
+
+uint8_t historyChannelFromName(const char* name) {
+  for (uint8_t i = 0; i < HISTORY_CHANNEL_COUNT; i++) {
+    if (strcmp_P(name, CHANNEL_NAMES[i]) == 0) {
+      return i;
+    }
+  }
+  return HISTORY_NONE;
+}
+
+const char* historyChannelName(uint8_t channel, char* buffer) {
+  memcpy_P(buffer, CHANNEL_NAMES[channel], HISTORY_CHANNEL_NAME_MAX);
+  return buffer;
+}
+
+static const HistoryBucket EMPTY_BUCKET = {HISTORY_NO_DATA, HISTORY_NO_DATA, HISTORY_NO_DATA};
+
+SensorHistory::SensorHistory() {
+  for (uint8_t slot = 0; slot < HISTORY_SLOTS; slot++) {
+    for (uint8_t channel = 0; channel < HISTORY_CHANNEL_COUNT; channel++) {
+      buckets[slot][channel] = EMPTY_BUCKET;
+    }
+  }
+  for (uint8_t tier = 0; tier < HISTORY_TIERS; tier++) {
+    tiers[tier].head = 0;
+    tiers[tier].count = 0;
+    tiers[tier].closed = 0;
+  }
+  for (uint8_t channel = 0; channel < HISTORY_CHANNEL_COUNT; channel++) {
+    current[channel].count = 0;
+  }
+}
+
+void SensorHistory::sample(uint8_t channel, int32_t value) {
+  if (value > 32767) value = 32767;
+  if (value < -32767) value = -32767;
+
+  Accumulator& acc = current[channel];
+  if (acc.count == 0) {
+    acc.sum = 0;
+    acc.min = value;
+    acc.max = value;
+  } else if (acc.count == 0xFFFF) {
+    return;   // 65535 ตัวอย่างต่อนาทีพอแล้ว (sum ยังไม่ล้น int32)
+  }
+  acc.sum += value;
+  acc.count++;
+  if (value < acc.min) acc.min = value;
+  if (value > acc.max) acc.max = value;
+}
+
+void SensorHistory::update(uint32_t nowMs) {
+  while (nowMs - minuteStartMs >= 60000UL) {
+    minuteStartMs += 60000UL;
+    closeMinute();
+  }
+}
+
+void SensorHistory::closeMinute() {
+  HistoryBucket values[HISTORY_CHANNEL_COUNT];
+  for (uint8_t channel = 0; channel < HISTORY_CHANNEL_COUNT; channel++) {
+    Accumulator& acc = current[channel];
+    if (acc.count == 0) {
+      values[channel] = EMPTY_BUCKET;
+      continue;
+    }
+    values[channel].min = acc.min;
+    values[channel].max = acc.max;
+    values[channel].mean = divRound(acc.sum, acc.count);
+    acc.count = 0;
+  }
+  minute++;
+  push(0, values);
+}
+
+// เพิ่มช่องที่ปิดแล้วในชั้น tier และยุบรวมขึ้นชั้นถัดไปเมื่อครบ 1 ช่องของชั้นนั้น
+void SensorHistory::push(uint8_t tier, const HistoryBucket* values) {
+  Tier& state = tiers[tier];
+  HistoryBucket* slot = buckets[TIERS[tier].offset + state.head];
+  for (uint8_t channel = 0; channel < HISTORY_CHANNEL_COUNT; channel++) {
+    slot[channel] = values[channel];
+  }
+  state.head = (state.head + 1) % TIERS[tier].slots;
+  if (state.count < TIERS[tier].slots) {
+    state.count++;
+  }
+  state.closed++;
+
+  uint8_t upper = tier + 1;
+  if (upper < HISTORY_TIERS && state.closed % (TIERS[upper].minutes / TIERS[tier].minutes) == 0) {
+    rollUp(upper);
+  }
+}
+
+// ช่องใหม่ของชั้น tier = min ของ min, max ของ max และค่าเฉลี่ยของ mean จากช่องล่าสุดในชั้นก่อนหน้า
+void SensorHistory::rollUp(uint8_t tier) {
+  uint8_t lower = tier - 1;
+  uint8_t ratio = TIERS[tier].minutes / TIERS[lower].minutes;
+
+  HistoryBucket values[HISTORY_CHANNEL_COUNT];
+  for (uint8_t channel = 0; channel < HISTORY_CHANNEL_COUNT; channel++) {
+    int32_t sum = 0;
+    uint8_t used = 0;
+    HistoryBucket merged = EMPTY_BUCKET;
+    for (uint8_t age = 0; age < ratio; age++) {
+      const HistoryBucket& part = bucket(lower, age, channel);
+      if (part.mean == HISTORY_NO_DATA) {
+        continue;
+      }
+      if (used == 0 || part.min < merged.min) merged.min = part.min;
+      if (used == 0 || part.max > merged.max) merged.max = part.max;
+      sum += part.mean;
+      used++;
+    }
+    if (used > 0) {
+      merged.mean = divRound(sum, used);
+    }
+    values[channel] = merged;
+  }
+  push(tier, values);
+}
+
+// age 0 = ช่องที่ปิดล่าสุดของชั้น
+const HistoryBucket& SensorHistory::bucket(uint8_t tier, uint8_t age, uint8_t channel) const {
+  uint8_t slots = TIERS[tier].slots;
+  uint8_t index = (tiers[tier].head + slots - 1 - age) % slots;
+  return buckets[TIERS[tier].offset + index][channel];
+}
+
+bool SensorHistory::next(uint8_t channel, uint32_t fromMinute, HistoryEntry& entry) const {
+  bool found = false;
+  for (uint8_t tier = 0; tier < HISTORY_TIERS; tier++) {
+    uint32_t end = tiers[tier].closed * TIERS[tier].minutes;   // นาทีที่ช่องใหม่สุดของชั้นจบ
+    for (uint8_t age = 0; age < tiers[tier].count; age++) {
+      uint32_t start = end - (uint32_t)(age + 1) * TIERS[tier].minutes;
+      if (start < fromMinute) {
+        break;   // ช่องที่เก่ากว่านี้เริ่มก่อน fromMinute ทั้งหมด
+      }
+      const HistoryBucket& value = bucket(tier, age, channel);
+      // เริ่มเร็วที่สุดก่อน ถ้าเริ่มพร้อมกันใช้ชั้นที่ละเอียดกว่า (ชั้นแรกที่พบ)
+      if (value.mean != HISTORY_NO_DATA && (!found || start < entry.startMinute)) {
+        found = true;
+        entry.startMinute = start;
+        entry.minutes = TIERS[tier].minutes;
+        entry.value = value;
+      }
+    }
+  }
+  return found;
+}
@@ -0,0 +1,39 @@
+#include "slave_health.h"
+#include "modbus_rtu.h"
+
+// เพิ่มตัวนับแบบไม่ล้น
+static inline void bump(uint16_t& counter) {
+  if (counter < 0xFFFF) counter++;
+}
+
+void SlaveHealth::recordSuccess(uint32_t nowMs) {
+  consecutiveFailures = 0;
+  everGood = true;
+  lastGoodMs = nowMs;
+}
+
+void SlaveHealth::recordFailure(uint8_t code) {
+  bump(consecutiveFailures);
+  if (code == ModbusRtuMaster::ku8MBResponseTimedOut) {
+    bump(timeouts);
+  } else if (code == ModbusRtuMaster::ku8MBInvalidCRC) {
+    bump(crcErrors);
+  } else if (code >= ModbusRtuMaster::ku8MBIllegalFunction && code <= ModbusRtuMaster::ku8MBSlaveDeviceFailure) {
+    bump(exceptions);
+  } else {
+    bump(otherErrors);
+  }
+}
+
+uint32_t SlaveHealth::retryDelayMs(uint32_t periodMs) const {
+  if (!offline()) {
+    return periodMs;
+  }
+  const uint32_t cap = SLAVE_BACKOFF_MAX_MS;
+  uint16_t doublings = consecutiveFailures - SLAVE_OFFLINE_FAILURES + 1;
+  uint32_t delay = periodMs;
+  while (doublings-- > 0 && delay < cap) {
+    delay <<= 1;
+  }
+  return max(periodMs, min(delay, cap));
+}
@@ -0,0 +1,142 @@
+#include "state_journal.h"
+#include "crc16.h"
+
+#include <EEPROM.h>
+#include <string.h>
+
+#ifdef ARDUINO_ARCH_AVR
+#include <avr/eeprom.h>
+#define JOURNAL_EEPROM_READY() eeprom_is_ready()
+#else
+#define JOURNAL_EEPROM_READY() true
+#endif
+
+#define JOURNAL_CRC_OFFSET (JOURNAL_RECORD_SIZE - 2)
+#define JOURNAL_ERASED_SEQUENCE 0xFFFFFFFFUL   // ช่องที่ยังไม่เคยเขียน
+
+static uint32_t getU32(const uint8_t* raw) {
+  return (uint32_t)raw[0] | ((uint32_t)raw[1] << 8) | ((uint32_t)raw[2] << 16) | ((uint32_t)raw[3] << 24);
+}
+
+static void putU32(uint8_t* raw, uint32_t value) {
+  for (uint8_t i = 0; i < 4; i++) {
+    raw[i] = (uint8_t)(value >> (8 * i));
+  }
+}
+
+static bool recordValid(const uint8_t* record) {
+  if (getU32(record) == JOURNAL_ERASED_SEQUENCE) {
+    return false;
+  }
+  uint16_t crc = modbusCrc16(record, JOURNAL_CRC_OFFSET);
+  return record[JOURNAL_CRC_OFFSET] == (uint8_t)crc && record[JOURNAL_CRC_OFFSET + 1] == (uint8_t)(crc >> 8);
+}
+
+static uint32_t readU32(uint16_t address) {
+  uint8_t raw[4];
+  for (uint8_t i = 0; i < 4; i++) {
+    raw[i] = EEPROM.read(address + i);
+  }
+  return getU32(raw);
+}
+
+bool StateJournal::begin(void* payload) {
+  slots = (regionLength > 0 ? regionLength : EEPROM.length() - baseAddress) / JOURNAL_RECORD_SIZE;
+  writing = false;
+  lastSequence = 0;
+  totalBytes = 0;
+  next = 0;
+
+  // อ่านเฉพาะ sequence ของทุกช่อง แล้วตรวจ CRC เฉพาะช่องที่ใหม่สุด (ปกติครั้งเดียว)
+  // ถ้า CRC ไม่ผ่าน (ไฟดับกลาง record) ถอยไปช่องที่ใหม่รองลงมา
+  uint8_t record[JOURNAL_RECORD_SIZE];
+  bool bounded = false;
+  uint32_t bound = 0;   // sequence ของช่องที่ตรวจแล้วไม่ผ่าน: หาเฉพาะที่เก่ากว่านี้
+  for (uint16_t attempt = 0; attempt < slots; attempt++) {
+    bool found = false;
+    uint16_t latest = 0;
+    uint32_t latestSequence = 0;
+    for (uint16_t slot = 0; slot < slots; slot++) {
+      uint32_t sequence = readU32(slotAddress(slot));
+      if (sequence == JOURNAL_ERASED_SEQUENCE || (bounded && (int32_t)(sequence - bound) >= 0)) {
+        continue;
+      }
+      if (!found || (int32_t)(sequence - latestSequence) > 0) {
+        found = true;
+        latest = slot;
+        latestSequence = sequence;
+      }
+    }
+    if (!found) {
+      return false;
+    }
+
+    uint16_t base = slotAddress(latest);
+    for (uint8_t i = 0; i < JOURNAL_RECORD_SIZE; i++) {
+      record[i] = EEPROM.read(base + i);
+    }
+    if (recordValid(record)) {
+      lastSequence = latestSequence;
+      totalBytes = getU32(record + 4);
+      memcpy(payload, record + JOURNAL_HEADER_SIZE, JOURNAL_PAYLOAD_SIZE);
+      next = (latest + 1) % slots;
+      return true;
+    }
+    bounded = true;
+    bound = latestSequence;
+  }
+  return false;
+}
+
+bool StateJournal::append(const void* payload) {
+  if (writing || slots == 0) {
+    return false;
+  }
+  uint32_t sequence = lastSequence + 1;
+  if (sequence == JOURNAL_ERASED_SEQUENCE) {
+    sequence = 1;
+  }
+  putU32(staged, sequence);
+  memcpy(staged + JOURNAL_HEADER_SIZE, payload, JOURNAL_PAYLOAD_SIZE);
+
+  // นับไบต์ที่ต่างจากของเดิมในช่อง (ไบต์ที่เท่าเดิมไม่ถูกเขียน) ตัวนับและ CRC นับว่าเปลี่ยนเสมอ
+  uint16_t base = slotAddress(next);
+  uint32_t changed = 4 + 2;
+  for (uint8_t i = 0; i < JOURNAL_CRC_OFFSET; i++) {
+    if ((i < 4 || i >= JOURNAL_HEADER_SIZE) && EEPROM.read(base + i) != staged[i]) {
+      changed++;
+    }
+  }
+  putU32(staged + 4, totalBytes + changed);
+
+  uint16_t crc = modbusCrc16(staged, JOURNAL_CRC_OFFSET);
+  staged[JOURNAL_CRC_OFFSET] = (uint8_t)crc;
+  staged[JOURNAL_CRC_OFFSET + 1] = (uint8_t)(crc >> 8);
+
+  writing = true;
+  writePosition = 0;
+  return true;
+}
+
+void StateJournal::poll() {
+  if (!writing || !JOURNAL_EEPROM_READY()) {
+    return;
+  }
+  uint16_t base = slotAddress(next);
+
+  // ข้ามไบต์ที่เท่าเดิม แล้วเขียนไม่เกิน 1 ไบต์ต่อครั้ง (ไบต์ถัดไปต้องรอ EEPROM ว่างอีกรอบ)
+  while (writePosition < JOURNAL_RECORD_SIZE && EEPROM.read(base + writePosition) == staged[writePosition]) {
+    writePosition++;
+  }
+  if (writePosition < JOURNAL_RECORD_SIZE) {
+    EEPROM.write(base + writePosition, staged[writePosition]);
+    writePosition++;
+    return;
+  }
+
+  // CRC เป็นไบต์สุดท้ายที่เขียน: จากนี้ record ใหม่คือสถานะล่าสุด
+  lastSequence = getU32(staged);
+  totalBytes = getU32(staged + 4);
+  next = (next + 1) % slots;
+  writing = false;
+}
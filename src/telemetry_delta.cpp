@@ -0,0 +1,232 @@
+#include "telemetry_delta.h"
+#include "crc16.h"
+
+#include <stddef.h>
+#include <string.h>
+
+// ตำแหน่งของแต่ละฟิลด์ใน TelemetryFrameV1 และ deadband ค่าเริ่มต้น (หน่วยของเฟรม)
+enum FieldKind : uint8_t { FIELD_UNSIGNED, FIELD_SIGNED, FIELD_BITS };
+
+struct FieldInfo {
+  uint8_t offset;
+  uint8_t size;
+  FieldKind kind;
+  uint16_t defaultDeadband;
+};
+
+static const FieldInfo FIELDS[TELEMETRY_FIELD_COUNT] = {
+  {offsetof(TelemetryFrameV1, flags),         1, FIELD_BITS,     0},
+  {offsetof(TelemetryFrameV1, co2Ppm),        2, FIELD_UNSIGNED, 20},    // 20 ppm
+  {offsetof(TelemetryFrameV1, airTemp),       2, FIELD_SIGNED,   2},     // 0.2 °C
+  {offsetof(TelemetryFrameV1, airHumidity),   2, FIELD_UNSIGNED, 10},    // 1 %RH
+  {offsetof(TelemetryFrameV1, lux),           4, FIELD_UNSIGNED, 50},    // 50 lux
+  {offsetof(TelemetryFrameV1, ec),            2, FIELD_UNSIGNED, 20},    // 2 µS/cm
+  {offsetof(TelemetryFrameV1, ph),            2, FIELD_UNSIGNED, 5},     // 0.05 pH
+  {offsetof(TelemetryFrameV1, waterTemp),     2, FIELD_SIGNED,   2},     // 0.2 °C
+  {offsetof(TelemetryFrameV1, acVoltage),     2, FIELD_UNSIGNED, 20},    // 2 V
+  {offsetof(TelemetryFrameV1, acCurrent),     4, FIELD_UNSIGNED, 50},    // 50 mA
+  {offsetof(TelemetryFrameV1, acPower),       4, FIELD_UNSIGNED, 50},    // 5 W
+  {offsetof(TelemetryFrameV1, acEnergy),      4, FIELD_UNSIGNED, 10},    // 10 Wh
+  {offsetof(TelemetryFrameV1, acFrequency),   2, FIELD_UNSIGNED, 2},     // 0.2 Hz
+  {offsetof(TelemetryFrameV1, acPowerFactor), 1, FIELD_UNSIGNED, 2},     // 0.02
+  {offsetof(TelemetryFrameV1, flowRate) + 0,  2, FIELD_UNSIGNED, 10},    // 0.1 L/min
+  {offsetof(TelemetryFrameV1, flowRate) + 2,  2, FIELD_UNSIGNED, 10},
+  {offsetof(TelemetryFrameV1, flowRate) + 4,  2, FIELD_UNSIGNED, 10},
+  {offsetof(TelemetryFrameV1, flowTotal) + 0, 4, FIELD_UNSIGNED, 100},   // 100 mL
+  {offsetof(TelemetryFrameV1, flowTotal) + 4, 4, FIELD_UNSIGNED, 100},
+  {offsetof(TelemetryFrameV1, flowTotal) + 8, 4, FIELD_UNSIGNED, 100},
+  {offsetof(TelemetryFrameV1, relayStates),   1, FIELD_BITS,     0},
+};
+
+static_assert(TELEMETRY_FIELD_COUNT <= 32, "fieldMask is 32 bits");
+
+uint32_t telemetryFieldValue(const TelemetryFrameV1& frame, uint8_t field) {
+  const FieldInfo& info = FIELDS[field];
+  const uint8_t* raw = (const uint8_t*)&frame + info.offset;
+  uint32_t value = 0;
+  for (uint8_t i = 0; i < info.size; i++) {
+    value |= (uint32_t)raw[i] << (8 * i);   // little-endian
+  }
+  if (info.kind == FIELD_SIGNED && info.size == 2) {
+    value = (uint32_t)(int32_t)(int16_t)value;
+  }
+  return value;
+}
+
+void setTelemetryFieldValue(TelemetryFrameV1& frame, uint8_t field, uint32_t value) {
+  const FieldInfo& info = FIELDS[field];
+  uint8_t* raw = (uint8_t*)&frame + info.offset;
+  for (uint8_t i = 0; i < info.size; i++) {
+    raw[i] = (uint8_t)(value >> (8 * i));
+  }
+}
+
+bool telemetryFieldIsBits(uint8_t field) {
+  return FIELDS[field].kind == FIELD_BITS;
+}
+
+// ระยะห่างระหว่างสองค่า (ฟิลด์ signed มีแค่ int16 จึงไม่ล้น)
+static uint32_t distance(uint32_t a, uint32_t b, FieldKind kind) {
+  if (kind == FIELD_SIGNED) {
+    int32_t d = (int32_t)a - (int32_t)b;
+    return d < 0 ? -d : d;
+  }
+  return a > b ? a - b : b - a;
+}
+
+static bool atOrAbove(uint32_t value, int32_t threshold, FieldKind kind) {
+  if (kind == FIELD_SIGNED) {
+    return (int32_t)value >= threshold;
+  }
+  return threshold < 0 || value >= (uint32_t)threshold;
+}
+
+TelemetryDeltaTracker::TelemetryDeltaTracker() {
+  memset(&lastSent, 0, sizeof(lastSent));
+  for (uint8_t i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+    deadbands[i] = FIELDS[i].defaultDeadband;
+    thresholds[i] = 0;
+  }
+  // น้ำเข้า/หมดเป็นเหตุการณ์ที่ ESP32 ต้องรู้ทันที
+  setAlert(TELEMETRY_FIELD_FLAGS, TELEMETRY_FLAG_WATER_DETECTED);
+}
+
+void TelemetryDeltaTracker::setAlert(uint8_t field, int32_t threshold) {
+  thresholds[field] = threshold;
+  alertMask |= 1UL << field;
+}
+
+uint32_t TelemetryDeltaTracker::changedFields(const TelemetryFrameV1& frame) const {
+  if (!baseline) {
+    return TELEMETRY_ALL_FIELDS;
+  }
+  uint32_t changed = 0;
+  for (uint8_t i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+    uint32_t now = telemetryFieldValue(frame, i);
+    uint32_t sent = telemetryFieldValue(lastSent, i);
+    if (now == sent) {
+      continue;
+    }
+    // ฟิลด์แบบบิตเปลี่ยนเมื่อบิตใดก็ได้เปลี่ยน ฟิลด์ตัวเลขต้องเปลี่ยนถึง deadband
+    if (FIELDS[i].kind == FIELD_BITS || distance(now, sent, FIELDS[i].kind) >= deadbands[i]) {
+      changed |= 1UL << i;
+    }
+  }
+  return changed;
+}
+
+uint32_t TelemetryDeltaTracker::alertFields(const TelemetryFrameV1& frame) const {
+  if (!baseline) {
+    return 0;
+  }
+  uint32_t alerts = 0;
+  for (uint8_t i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+    if (!(alertMask & (1UL << i))) {
+      continue;
+    }
+    uint32_t now = telemetryFieldValue(frame, i);
+    uint32_t sent = telemetryFieldValue(lastSent, i);
+    bool crossed;
+    if (FIELDS[i].kind == FIELD_BITS) {
+      crossed = ((now ^ sent) & (uint32_t)thresholds[i]) != 0;
+    } else {
+      crossed = atOrAbove(now, thresholds[i], FIELDS[i].kind) != atOrAbove(sent, thresholds[i], FIELDS[i].kind);
+    }
+    if (crossed) {
+      alerts |= 1UL << i;
+    }
+  }
+  return alerts;
+}
+
+void TelemetryDeltaTracker::markSent(const TelemetryFrameV1& frame, uint32_t fields) {
+  if (fields == TELEMETRY_ALL_FIELDS) {
+    lastSent = frame;
+    baseline = true;
+    return;
+  }
+  for (uint8_t i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+    if (fields & (1UL << i)) {
+      setTelemetryFieldValue(lastSent, i, telemetryFieldValue(frame, i));
+    }
+  }
+}
+
+size_t encodeTelemetryDelta(const TelemetryFrameV1& frame, uint32_t fields, uint16_t sequence,
+                            uint8_t* output, size_t outputSize) {
+  if (outputSize < TELEMETRY_DELTA_WIRE_MAX) {
+    return 0;
+  }
+
+  uint8_t raw[TELEMETRY_DELTA_MAX];
+  size_t length = 0;
+  fields &= TELEMETRY_ALL_FIELDS;
+  raw[length++] = TELEMETRY_DELTA_TYPE;
+  raw[length++] = (uint8_t)sequence;
+  raw[length++] = (uint8_t)(sequence >> 8);
+  for (uint8_t i = 0; i < 4; i++) {
+    raw[length++] = (uint8_t)(fields >> (8 * i));
+  }
+  for (uint8_t i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+    if (fields & (1UL << i)) {
+      memcpy(raw + length, (const uint8_t*)&frame + FIELDS[i].offset, FIELDS[i].size);
+      length += FIELDS[i].size;
+    }
+  }
+  uint16_t crc = modbusCrc16(raw, length);
+  raw[length++] = (uint8_t)crc;
+  raw[length++] = (uint8_t)(crc >> 8);
+
+  output[0] = 0x00;
+  size_t encoded = cobsEncode(raw, length, output + 1, outputSize - 2);
+  if (encoded == 0) {
+    return 0;
+  }
+  output[encoded + 1] = 0x00;
+  return encoded + 2;
+}
+
+TelemetryDecodeResult applyTelemetryDelta(const uint8_t* encoded, size_t length, TelemetryFrameV1& state) {
+  uint8_t raw[TELEMETRY_DELTA_MAX + 1];   // +1 เพื่อจับเฟรมที่ยาวเกิน
+  size_t decoded = cobsDecode(encoded, length, raw, sizeof(raw));
+  if (decoded == 0) {
+    return TELEMETRY_BAD_COBS;
+  }
+  if (decoded < 9 || decoded > TELEMETRY_DELTA_MAX) {
+    return TELEMETRY_BAD_LENGTH;
+  }
+  if (raw[0] != TELEMETRY_DELTA_TYPE) {
+    return TELEMETRY_BAD_VERSION;
+  }
+
+  uint32_t fields = 0;
+  for (uint8_t i = 0; i < 4; i++) {
+    fields |= (uint32_t)raw[3 + i] << (8 * i);
+  }
+  if (fields & ~TELEMETRY_ALL_FIELDS) {
+    return TELEMETRY_BAD_LENGTH;
+  }
+  size_t expected = 1 + 2 + 4 + 2;
+  for (uint8_t i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+    if (fields & (1UL << i)) expected += FIELDS[i].size;
+  }
+  if (decoded != expected) {
+    return TELEMETRY_BAD_LENGTH;
+  }
+
+  uint16_t crc = modbusCrc16(raw, decoded - 2);
+  uint16_t received = raw[decoded - 2] | (raw[decoded - 1] << 8);
+  if (crc != received) {
+    return TELEMETRY_BAD_CRC;
+  }
+
+  size_t at = 7;
+  for (uint8_t i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+    if (fields & (1UL << i)) {
+      memcpy((uint8_t*)&state + FIELDS[i].offset, raw + at, FIELDS[i].size);
+      at += FIELDS[i].size;
+    }
+  }
+  state.sequence = raw[1] | (raw[2] << 8);
+  return TELEMETRY_OK;
+}
@@ -0,0 +1,99 @@
+#include "telemetry_frame.h"
+#include "crc16.h"
+
+#include <string.h>
+
+size_t cobsEncode(const uint8_t* input, size_t length, uint8_t* output, size_t outputSize) {
+  if (outputSize < length + length / 254 + 1) {
+    return 0;
+  }
+
+  size_t codeIndex = 0;   // ตำแหน่งไบต์ code ของบล็อกปัจจุบัน
+  size_t outIndex = 1;
+  uint8_t code = 1;
+
+  for (size_t i = 0; i < length; i++) {
+    if (input[i] == 0) {
+      output[codeIndex] = code;
+      codeIndex = outIndex++;
+      code = 1;
+    } else {
+      output[outIndex++] = input[i];
+      code++;
+      if (code == 0xFF) {
+        output[codeIndex] = code;
+        codeIndex = outIndex++;
+        code = 1;
+      }
+    }
+  }
+  output[codeIndex] = code;
+  return outIndex;
+}
+
+size_t cobsDecode(const uint8_t* input, size_t length, uint8_t* output, size_t outputSize) {
+  size_t inIndex = 0;
+  size_t outIndex = 0;
+
+  while (inIndex < length) {
+    uint8_t code = input[inIndex++];
+    if (code == 0 || inIndex + code - 1 > length) {
+      return 0;
+    }
+    for (uint8_t i = 1; i < code; i++) {
+      if (outIndex >= outputSize || input[inIndex] == 0) {
+        return 0;
+      }
+      output[outIndex++] = input[inIndex++];
+    }
+    // code < 0xFF หมายถึงมีไบต์ 0 ตามหลัง (ยกเว้นบล็อกสุดท้าย)
+    if (code != 0xFF && inIndex < length) {
+      if (outIndex >= outputSize) {
+        return 0;
+      }
+      output[outIndex++] = 0;
+    }
+  }
+  return outIndex;
+}
+
+size_t encodeTelemetryFrame(TelemetryFrameV1& frame, uint16_t sequence, uint8_t* output, size_t outputSize) {
+  if (outputSize < TELEMETRY_WIRE_MAX) {
+    return 0;
+  }
+
+  frame.version = TELEMETRY_FRAME_VERSION;
+  frame.sequence = sequence;
+  frame.crc = modbusCrc16((const uint8_t*)&frame, sizeof(frame) - sizeof(frame.crc));
+
+  output[0] = 0x00;
+  size_t encoded = cobsEncode((const uint8_t*)&frame, sizeof(frame), output + 1, outputSize - 2);
+  if (encoded == 0) {
+    return 0;
+  }
+  output[encoded + 1] = 0x00;
+  return encoded + 2;
+}
+
+TelemetryDecodeResult decodeTelemetryFrame(const uint8_t* encoded, size_t length, TelemetryFrameV1& out) {
+  uint8_t raw[sizeof(TelemetryFrameV1) + 1]; // +1 เพื่อจับเฟรมที่ยาวเกิน
+  size_t decoded = cobsDecode(encoded, length, raw, sizeof(raw));
+  if (decoded == 0) {
+    return TELEMETRY_BAD_COBS;
+  }
+  if (decoded != sizeof(TelemetryFrameV1)) {
+    return TELEMETRY_BAD_LENGTH;
+  }
+  if (raw[0] != TELEMETRY_FRAME_VERSION) {
+    return TELEMETRY_BAD_VERSION;
+  }
+
+  uint16_t crc = modbusCrc16(raw, sizeof(TelemetryFrameV1) - 2);
+  uint16_t received = raw[sizeof(TelemetryFrameV1) - 2] | (raw[sizeof(TelemetryFrameV1) - 1] << 8);
+  if (crc != received) {
+    return TELEMETRY_BAD_CRC;
+  }
+
+  memcpy(&out, raw, sizeof(out));
+  return TELEMETRY_OK;
+}
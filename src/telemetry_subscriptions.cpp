@@ -0,0 +1,78 @@
+#include "telemetry_subscriptions.h"
+
+#define FIELD_BIT(field) (1UL << (field))
+
+// ชื่อกลุ่ม (เรียงตาม TelemetryGroup)
+static const char GROUP_NAMES[TELEMETRY_GROUP_COUNT][TELEMETRY_GROUP_NAME_MAX] PROGMEM = {
+  "all", "air", "light", "water", "ac", "flow", "status"
+};
+
+uint8_t telemetryGroupFromName(const char* name) {
+  for (uint8_t i = 0; i < TELEMETRY_GROUP_COUNT; i++) {
+    if (strcmp_P(name, GROUP_NAMES[i]) == 0) {
+      return i;
+    }
+  }
+  return TELEMETRY_GROUP_NONE;
+}
+
+const char* telemetryGroupName(uint8_t group, char* buffer) {
+  memcpy_P(buffer, GROUP_NAMES[group], TELEMETRY_GROUP_NAME_MAX);
+  return buffer;
+}
+
+uint32_t telemetryGroupFields(uint8_t group) {
+  switch (group) {
+    case TELEMETRY_GROUP_ALL:
+      return TELEMETRY_ALL_FIELDS;
+    case TELEMETRY_GROUP_AIR:
+      return FIELD_BIT(TELEMETRY_FIELD_CO2) | FIELD_BIT(TELEMETRY_FIELD_AIR_TEMP) |
+             FIELD_BIT(TELEMETRY_FIELD_AIR_HUMIDITY);
+    case TELEMETRY_GROUP_LIGHT:
+      return FIELD_BIT(TELEMETRY_FIELD_LUX);
+    case TELEMETRY_GROUP_WATER:
+      return FIELD_BIT(TELEMETRY_FIELD_EC) | FIELD_BIT(TELEMETRY_FIELD_PH) |
+             FIELD_BIT(TELEMETRY_FIELD_WATER_TEMP);
+    case TELEMETRY_GROUP_AC:
+      return FIELD_BIT(TELEMETRY_FIELD_AC_VOLTAGE) | FIELD_BIT(TELEMETRY_FIELD_AC_CURRENT) |
+             FIELD_BIT(TELEMETRY_FIELD_AC_POWER) | FIELD_BIT(TELEMETRY_FIELD_AC_ENERGY) |
+             FIELD_BIT(TELEMETRY_FIELD_AC_FREQUENCY) | FIELD_BIT(TELEMETRY_FIELD_AC_POWER_FACTOR);
+    case TELEMETRY_GROUP_FLOW:
+      return FIELD_BIT(TELEMETRY_FIELD_FLOW_RATE_1) | FIELD_BIT(TELEMETRY_FIELD_FLOW_RATE_2) |
+             FIELD_BIT(TELEMETRY_FIELD_FLOW_RATE_3) | FIELD_BIT(TELEMETRY_FIELD_FLOW_TOTAL_1) |
+             FIELD_BIT(TELEMETRY_FIELD_FLOW_TOTAL_2) | FIELD_BIT(TELEMETRY_FIELD_FLOW_TOTAL_3);
+    case TELEMETRY_GROUP_STATUS:
+      return FIELD_BIT(TELEMETRY_FIELD_FLAGS) | FIELD_BIT(TELEMETRY_FIELD_RELAYS);
+    default:
+      return 0;
+  }
+}
+
+void TelemetrySubscriptions::subscribe(uint8_t group, uint32_t periodMs) {
+  periods[group] = constrain(periodMs, TELEMETRY_SUBSCRIBE_MIN_MS, TELEMETRY_SUBSCRIBE_MAX_MS);
+  pending[group] = true;
+}
+
+uint8_t TelemetrySubscriptions::nextDue(uint32_t nowMs) const {
+  uint8_t best = TELEMETRY_GROUP_NONE;
+  uint32_t bestLate = 0;
+  for (uint8_t i = 0; i < TELEMETRY_GROUP_COUNT; i++) {
+    if (periods[i] == 0) {
+      continue;
+    }
+    if (pending[i]) {
+      return i;   // เพิ่ง subscribe
+    }
+    int32_t late = (int32_t)(nowMs - dueMs[i]);   // ปลอดภัยเมื่อ millis() วนรอบ
+    if (late >= 0 && (best == TELEMETRY_GROUP_NONE || (uint32_t)late > bestLate)) {
+      best = i;
+      bestLate = late;
+    }
+  }
+  return best;
+}
+
+void TelemetrySubscriptions::markSent(uint8_t group, uint32_t nowMs) {
+  pending[group] = false;
+  dueMs[group] = nowMs + periods[group];
+}
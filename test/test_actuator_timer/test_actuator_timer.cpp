@@ -0,0 +1,208 @@
+#include <unity.h>
+#include <native_hal.h>
+#include "relay_driver.h"
+#include "actuator_timer.h"
+#include "flow_counter.h"
+
+// === TIMER3 ACTUATORS + FLOW COUNTER ===
+// HAL เรียก ISR(TIMER3_COMPA_vect) ของ main.cpp ตามคาบที่ตั้งใน register จึงทดสอบเส้นทางเดียวกับบอร์ดจริง
+
+static const int pins[8] = {26, 28, 30, 27, 33, 31, 29, 32};
+static const bool activeHigh[8] = {true, false, false, false, false, false, false, false};
+static const uint8_t flowPins[FLOW_CHANNELS] = {22, 23, 24};
+
+// ระดับขาที่หมายถึง "เปิด" ของ relay แต่ละตัว
+static uint8_t onLevel(uint8_t relay) {
+  return activeHigh[relay] ? HIGH : LOW;
+}
+
+void setUp(void) {
+  halReset();
+  relayDriverBegin(pins, activeHigh, 8);
+  actuatorTimerBegin();
+  flowCounterBegin(flowPins);
+  ActuatorEvent drain;
+  while (actuatorPopEvent(drain)) {}
+}
+
+void tearDown(void) {
+  for (uint8_t relay = 0; relay < ACTUATOR_SLOT_COUNT; relay++) {
+    actuatorStop(relay);
+  }
+}
+
+void test_timer3_configured_for_1ms(void) {
+  TEST_ASSERT_EQUAL_UINT32(1000, halTimer3PeriodMicros());
+}
+
+void test_pulse_turns_off_exactly_on_time(void) {
+  actuatorStartPulse(6, 1500);
+  TEST_ASSERT_TRUE(relayIsOn(6));
+  TEST_ASSERT_EQUAL_UINT8(onLevel(6), halPinLevel(pins[6]));
+
+  halAdvanceMillis(1499);
+  TEST_ASSERT_TRUE(relayIsOn(6));
+  TEST_ASSERT_TRUE(actuatorActive(6));
+
+  halAdvanceMillis(1);
+  TEST_ASSERT_FALSE(relayIsOn(6));
+  TEST_ASSERT_FALSE(actuatorActive(6));
+  TEST_ASSERT_NOT_EQUAL(onLevel(6), halPinLevel(pins[6]));
+
+  ActuatorEvent event;
+  TEST_ASSERT_TRUE(actuatorPopEvent(event));
+  TEST_ASSERT_EQUAL_UINT8(6, event.relay);
+  TEST_ASSERT_EQUAL_UINT8(ACTUATOR_PULSE_END, event.kind);
+  TEST_ASSERT_FALSE(event.state);
+  TEST_ASSERT_EQUAL_UINT32(1500, event.targetMs);
+  TEST_ASSERT_EQUAL_UINT32(1500, event.elapsedMs);
+  TEST_ASSERT_FALSE(actuatorPopEvent(event));
+}
+
+void test_active_high_relay_polarity(void) {
+  actuatorStartPulse(0, 10);
+  TEST_ASSERT_EQUAL_UINT8(HIGH, halPinLevel(pins[0]));
+  halAdvanceMillis(10);
+  TEST_ASSERT_EQUAL_UINT8(LOW, halPinLevel(pins[0]));
+}
+
+void test_cycle_starts_off_and_alternates(void) {
+  actuatorStartCycle(4, 200, 300);
+  TEST_ASSERT_FALSE(relayIsOn(4));
+
+  halAdvanceMillis(300);
+  TEST_ASSERT_TRUE(relayIsOn(4));
+  halAdvanceMillis(200);
+  TEST_ASSERT_FALSE(relayIsOn(4));
+  halAdvanceMillis(300);
+  TEST_ASSERT_TRUE(relayIsOn(4));
+
+  ActuatorEvent event;
+  TEST_ASSERT_TRUE(actuatorPopEvent(event));
+  TEST_ASSERT_TRUE(event.state);
+  TEST_ASSERT_EQUAL_UINT32(300, event.elapsedMs);
+  TEST_ASSERT_TRUE(actuatorPopEvent(event));
+  TEST_ASSERT_FALSE(event.state);
+  TEST_ASSERT_EQUAL_UINT32(200, event.elapsedMs);
+}
+
+void test_zero_duration_stops_slot(void) {
+  actuatorStartPulse(6, 5000);
+  actuatorStartPulse(6, 0);
+  TEST_ASSERT_FALSE(actuatorActive(6));
+  TEST_ASSERT_FALSE(relayIsOn(6));
+}
+
+void test_progress_reports_elapsed(void) {
+  actuatorStartPulse(5, 1000);
+  halAdvanceMillis(250);
+  uint32_t elapsed = 0, target = 0;
+  TEST_ASSERT_TRUE(actuatorProgress(5, elapsed, target));
+  TEST_ASSERT_EQUAL_UINT32(250, elapsed);
+  TEST_ASSERT_EQUAL_UINT32(1000, target);
+}
+
+void test_concurrent_cycles_keep_their_own_timing(void) {
+  actuatorStartCycle(2, 100, 150);   // K3
+  actuatorStartCycle(4, 200, 300);   // K5
+  actuatorStartPulse(6, 400);        // K7
+  TEST_ASSERT_EQUAL_HEX8(0x54, actuatorActiveMask());
+
+  halAdvanceMillis(150);
+  TEST_ASSERT_TRUE(relayIsOn(2));
+  TEST_ASSERT_FALSE(relayIsOn(4));
+  halAdvanceMillis(100);             // t = 250
+  TEST_ASSERT_FALSE(relayIsOn(2));
+  halAdvanceMillis(50);              // t = 300
+  TEST_ASSERT_TRUE(relayIsOn(4));
+  halAdvanceMillis(100);             // t = 400
+  TEST_ASSERT_TRUE(relayIsOn(2));
+  TEST_ASSERT_FALSE(relayIsOn(6));
+  TEST_ASSERT_EQUAL_HEX8(0x14, actuatorActiveMask());
+
+  // ลำดับ event ตามเวลาจริงของแต่ละช่อง
+  const uint8_t expectRelay[] = {2, 2, 4, 2, 6};
+  const uint8_t expectKind[] = {ACTUATOR_CYCLE_SWITCH, ACTUATOR_CYCLE_SWITCH, ACTUATOR_CYCLE_SWITCH,
+                                ACTUATOR_CYCLE_SWITCH, ACTUATOR_PULSE_END};
+  ActuatorEvent event;
+  for (uint8_t i = 0; i < 5; i++) {
+    TEST_ASSERT_TRUE(actuatorPopEvent(event));
+    TEST_ASSERT_EQUAL_UINT8(expectRelay[i], event.relay);
+    TEST_ASSERT_EQUAL_UINT8(expectKind[i], event.kind);
+    TEST_ASSERT_EQUAL_UINT32(event.targetMs, event.elapsedMs);
+  }
+}
+
+void test_max_run_caps_cycle(void) {
+  actuatorStartCycle(3, 100, 100, 350);
+  halAdvanceMillis(349);
+  TEST_ASSERT_TRUE(actuatorActive(3));
+  TEST_ASSERT_TRUE(relayIsOn(3));    // ช่วง ON ที่ 2 (300-400)
+  halAdvanceMillis(1);
+  TEST_ASSERT_FALSE(actuatorActive(3));
+  TEST_ASSERT_FALSE(relayIsOn(3));
+
+  ActuatorEvent event;
+  uint8_t switches = 0;
+  while (actuatorPopEvent(event) && event.kind == ACTUATOR_CYCLE_SWITCH) {
+    switches++;
+  }
+  TEST_ASSERT_EQUAL_UINT8(3, switches);
+  TEST_ASSERT_EQUAL_UINT8(ACTUATOR_MAX_RUN, event.kind);
+  TEST_ASSERT_EQUAL_UINT8(3, event.relay);
+  TEST_ASSERT_EQUAL_UINT32(350, event.elapsedMs);
+  TEST_ASSERT_EQUAL_UINT32(350, event.targetMs);
+}
+
+void test_restart_replaces_slot_deadline(void) {
+  actuatorStartPulse(1, 100);
+  halAdvanceMillis(50);
+  actuatorStartPulse(1, 100);        // เริ่มใหม่: นับจากตอนนี้
+  halAdvanceMillis(99);
+  TEST_ASSERT_TRUE(relayIsOn(1));
+  halAdvanceMillis(1);
+  TEST_ASSERT_FALSE(relayIsOn(1));
+}
+
+void test_stop_one_slot_leaves_others_running(void) {
+  actuatorStartPulse(0, 100);
+  actuatorStartPulse(7, 200);
+  actuatorStop(0);
+  TEST_ASSERT_FALSE(relayIsOn(0));
+  halAdvanceMillis(199);
+  TEST_ASSERT_TRUE(relayIsOn(7));
+  halAdvanceMillis(1);
+  TEST_ASSERT_FALSE(relayIsOn(7));
+}
+
+void test_flow_counts_falling_edges(void) {
+  // 20 Hz บนช่อง 1, ช่อง 2-3 ลอย (pull-up = HIGH)
+  for (int i = 0; i < 20; i++) {
+    halSetPinInput(flowPins[0], LOW);
+    halAdvanceMillis(25);
+    halSetPinInput(flowPins[0], HIGH);
+    halAdvanceMillis(25);
+  }
+  FlowSnapshot snapshot;
+  flowCounterSnapshot(snapshot);
+  TEST_ASSERT_EQUAL_UINT32(20, snapshot.pulses[0]);
+  TEST_ASSERT_EQUAL_UINT32(0, snapshot.pulses[1]);
+  TEST_ASSERT_EQUAL_UINT32(0, snapshot.pulses[2]);
+  TEST_ASSERT_EQUAL_UINT32(1000, snapshot.timeMs);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_timer3_configured_for_1ms);
+  RUN_TEST(test_pulse_turns_off_exactly_on_time);
+  RUN_TEST(test_active_high_relay_polarity);
+  RUN_TEST(test_cycle_starts_off_and_alternates);
+  RUN_TEST(test_zero_duration_stops_slot);
+  RUN_TEST(test_progress_reports_elapsed);
+  RUN_TEST(test_concurrent_cycles_keep_their_own_timing);
+  RUN_TEST(test_max_run_caps_cycle);
+  RUN_TEST(test_restart_replaces_slot_deadline);
+  RUN_TEST(test_stop_one_slot_leaves_others_running);
+  RUN_TEST(test_flow_counts_falling_edges);
+  return UNITY_END();
+}
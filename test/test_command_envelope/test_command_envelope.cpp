@@ -0,0 +1,96 @@
+#include <unity.h>
+#include <stdio.h>
+#include "command_envelope.h"
+#include "command_parser.h"
+
+// === SEQUENCED COMMAND ENVELOPE ===
+
+static char line[COMMAND_LINE_MAX + 1];
+
+// ประกอบ envelope พร้อม crc ที่ถูกต้อง: #<body>*<crc>
+static char* wrap(const char* body) {
+  snprintf(line, sizeof(line), "#%s*%04X", body, commandEnvelopeChecksum(body, strlen(body)));
+  return line;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_single_command(void) {
+  CommandEnvelope envelope;
+  TEST_ASSERT_EQUAL(ENVELOPE_OK, parseCommandEnvelope(wrap("7:RELAY:00110000"), envelope));
+  TEST_ASSERT_EQUAL_UINT16(7, envelope.sequence);
+  TEST_ASSERT_EQUAL_UINT8(1, envelope.count);
+  TEST_ASSERT_EQUAL_STRING("RELAY:00110000", envelope.commands[0]);
+}
+
+void test_batch_is_split_on_semicolons(void) {
+  CommandEnvelope envelope;
+  TEST_ASSERT_EQUAL(ENVELOPE_OK,
+                    parseCommandEnvelope(wrap("42:RELAY:00110000;PUMP_TIMING:EC,1500;PUMP_TIMING:PH_ACID,800"), envelope));
+  TEST_ASSERT_EQUAL_UINT16(42, envelope.sequence);
+  TEST_ASSERT_EQUAL_UINT8(3, envelope.count);
+  TEST_ASSERT_EQUAL_STRING("RELAY:00110000", envelope.commands[0]);
+  TEST_ASSERT_EQUAL_STRING("PUMP_TIMING:EC,1500", envelope.commands[1]);
+  TEST_ASSERT_EQUAL_STRING("PUMP_TIMING:PH_ACID,800", envelope.commands[2]);
+}
+
+void test_checksum_accepts_lowercase_and_rejects_corruption(void) {
+  CommandEnvelope envelope;
+  const char* body = "9:TIMER_STOP:K3";
+  char lower[COMMAND_LINE_MAX + 1];
+  snprintf(lower, sizeof(lower), "#%s*%04x", body, commandEnvelopeChecksum(body, strlen(body)));
+  TEST_ASSERT_EQUAL(ENVELOPE_OK, parseCommandEnvelope(lower, envelope));
+
+  wrap("9:TIMER_STOP:K3");
+  line[15] = '4';                                              // K3 -> K4 บนสาย
+  TEST_ASSERT_EQUAL(ENVELOPE_BAD_CHECKSUM, parseCommandEnvelope(line, envelope));
+  TEST_ASSERT_EQUAL_UINT16(9, envelope.sequence);             // ยังตอบ CMD_NAK ด้วย seq ได้
+}
+
+void test_malformed_envelopes(void) {
+  CommandEnvelope envelope;
+  char noChecksum[] = "#3:RELAY:00000000";
+  TEST_ASSERT_EQUAL(ENVELOPE_BAD_FORMAT, parseCommandEnvelope(noChecksum, envelope));
+  char shortChecksum[] = "#3:RELAY:00000000*12";
+  TEST_ASSERT_EQUAL(ENVELOPE_BAD_FORMAT, parseCommandEnvelope(shortChecksum, envelope));
+  TEST_ASSERT_EQUAL(ENVELOPE_BAD_FORMAT, parseCommandEnvelope(wrap("0:RELAY:00000000"), envelope));
+  TEST_ASSERT_EQUAL(ENVELOPE_BAD_FORMAT, parseCommandEnvelope(wrap("70000:RELAY:00000000"), envelope));
+  TEST_ASSERT_EQUAL(ENVELOPE_BAD_FORMAT, parseCommandEnvelope(wrap("abc:RELAY:00000000"), envelope));
+  TEST_ASSERT_EQUAL(ENVELOPE_BAD_FORMAT, parseCommandEnvelope(wrap("4:RELAY:00000000;;STATS"), envelope));
+  TEST_ASSERT_EQUAL(ENVELOPE_BAD_FORMAT, parseCommandEnvelope(wrap("4:"), envelope));
+}
+
+void test_batch_limit(void) {
+  CommandEnvelope envelope;
+  TEST_ASSERT_EQUAL(ENVELOPE_OK, parseCommandEnvelope(wrap("5:TIMER_STOP:K1;TIMER_STOP:K2;TIMER_STOP:K3;TIMER_STOP:K4"), envelope));
+  TEST_ASSERT_EQUAL(ENVELOPE_TOO_MANY,
+                    parseCommandEnvelope(wrap("5:TIMER_STOP:K1;TIMER_STOP:K2;TIMER_STOP:K3;TIMER_STOP:K4;TIMER_STOP:K5"), envelope));
+}
+
+void test_history_recognises_resends_only(void) {
+  EnvelopeHistory history;
+  uint8_t count = 0;
+  TEST_ASSERT_FALSE(history.find(1, 0xBEEF, count));
+  history.remember(1, 0xBEEF, 3);
+  TEST_ASSERT_TRUE(history.find(1, 0xBEEF, count));
+  TEST_ASSERT_EQUAL_UINT8(3, count);
+  TEST_ASSERT_FALSE(history.find(1, 0x1234, count));          // seq เดิม คำสั่งต่าง (ESP32 รีบูต)
+
+  for (uint16_t seq = 2; seq < 2 + COMMAND_DEDUP_SLOTS; seq++) {
+    history.remember(seq, seq, 1);
+  }
+  TEST_ASSERT_FALSE(history.find(1, 0xBEEF, count));          // หลุดจากหน้าต่างแล้ว
+  TEST_ASSERT_TRUE(history.find(2, 2, count));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_single_command);
+  RUN_TEST(test_batch_is_split_on_semicolons);
+  RUN_TEST(test_checksum_accepts_lowercase_and_rejects_corruption);
+  RUN_TEST(test_malformed_envelopes);
+  RUN_TEST(test_batch_limit);
+  RUN_TEST(test_history_recognises_resends_only);
+  return UNITY_END();
+}
@@ -0,0 +1,147 @@
+#include <unity.h>
+#include "command_parser.h"
+
+// === COMMAND PARSER ===
+// LineAssembler, dispatchCommand, matchCommand และ parseInt32 (ไม่ต้องใช้เวลาจำลอง)
+
+static CommandArgs lastArgs;
+static uint8_t calls = 0;
+
+static void handler(const CommandArgs& args) {
+  lastArgs = args;
+  calls++;
+}
+
+static const char KW_TEST[] PROGMEM = "MEGA_TEST";
+static const char KW_PUMP[] PROGMEM = "PUMP:";
+static const char KW_ANY[] PROGMEM = "RELAY:";
+
+static const CommandEntry table[] PROGMEM = {
+  {KW_TEST, CMD_EXACT,  0,            0,    handler},
+  {KW_PUMP, CMD_PREFIX, 2,            0x02, handler},
+  {KW_ANY,  CMD_PREFIX, CMD_ANY_ARGS, 0,    handler},
+};
+
+static DispatchResult dispatch(const char* text) {
+  char line[COMMAND_LINE_MAX + 1];
+  strncpy(line, text, sizeof(line));
+  line[COMMAND_LINE_MAX] = '\0';
+  return dispatchCommand(line, table, sizeof(table) / sizeof(table[0]));
+}
+
+static bool feedAll(LineAssembler& assembler, const char* text) {
+  bool ready = false;
+  while (*text) {
+    ready = assembler.feed(*text++);
+  }
+  return ready;
+}
+
+void setUp(void) {
+  calls = 0;
+  memset(&lastArgs, 0, sizeof(lastArgs));
+}
+
+void tearDown(void) {}
+
+void test_line_trims_and_skips_blank_lines(void) {
+  LineAssembler assembler;
+  TEST_ASSERT_FALSE(feedAll(assembler, "\r\n\n"));
+  TEST_ASSERT_TRUE(feedAll(assembler, "  MEGA_TEST \r\n"));
+  TEST_ASSERT_EQUAL_STRING("MEGA_TEST", assembler.line());
+  TEST_ASSERT_EQUAL_UINT8(9, assembler.length());
+}
+
+void test_line_split_across_feeds(void) {
+  LineAssembler assembler;
+  TEST_ASSERT_FALSE(feedAll(assembler, "RELAY:0011"));
+  TEST_ASSERT_TRUE(feedAll(assembler, "0000\n"));
+  TEST_ASSERT_EQUAL_STRING("RELAY:00110000", assembler.line());
+}
+
+void test_line_overflow_discards_whole_line(void) {
+  LineAssembler assembler;
+  for (int i = 0; i < COMMAND_LINE_MAX + 10; i++) {
+    TEST_ASSERT_FALSE(assembler.feed('A'));
+  }
+  TEST_ASSERT_FALSE(assembler.feed('\n'));
+  TEST_ASSERT_EQUAL_UINT16(1, assembler.overflowCount());
+
+  TEST_ASSERT_TRUE(feedAll(assembler, "MEGA_TEST\n"));
+  TEST_ASSERT_EQUAL_STRING("MEGA_TEST", assembler.line());
+}
+
+void test_dispatch_exact_and_unknown(void) {
+  TEST_ASSERT_EQUAL(DISPATCH_OK, dispatch("MEGA_TEST"));
+  TEST_ASSERT_EQUAL_UINT8(1, calls);
+  TEST_ASSERT_EQUAL(DISPATCH_UNKNOWN, dispatch("MEGA_TESTX"));
+  TEST_ASSERT_EQUAL(DISPATCH_UNKNOWN, dispatch("HELLO"));
+  TEST_ASSERT_EQUAL_UINT8(1, calls);
+}
+
+void test_dispatch_prefix_with_numeric_args(void) {
+  TEST_ASSERT_EQUAL(DISPATCH_OK, dispatch("PUMP:ACID,1500"));
+  TEST_ASSERT_EQUAL_UINT8(2, lastArgs.count);
+  TEST_ASSERT_EQUAL_STRING("ACID", lastArgs.text[0]);
+  TEST_ASSERT_EQUAL_INT32(1500, lastArgs.value[1]);
+  TEST_ASSERT_EQUAL_HEX8(0x02, lastArgs.numericMask);
+}
+
+void test_dispatch_rejects_bad_args(void) {
+  TEST_ASSERT_EQUAL(DISPATCH_BAD_ARGS, dispatch("PUMP:ACID,15x0"));
+  TEST_ASSERT_EQUAL(DISPATCH_BAD_ARGS, dispatch("PUMP:ACID"));
+  TEST_ASSERT_EQUAL(DISPATCH_BAD_ARGS, dispatch("PUMP:ACID,1,2"));
+  TEST_ASSERT_EQUAL_UINT8(0, calls);
+}
+
+void test_dispatch_any_args(void) {
+  TEST_ASSERT_EQUAL(DISPATCH_OK, dispatch("RELAY:10000001"));
+  TEST_ASSERT_EQUAL_UINT8(1, lastArgs.count);
+  TEST_ASSERT_EQUAL_STRING("10000001", lastArgs.text[0]);
+}
+
+void test_match_does_not_call_handler(void) {
+  char line[] = "PUMP:ACID,1500";
+  CommandEntry entry;
+  CommandArgs args;
+  TEST_ASSERT_EQUAL(DISPATCH_OK, matchCommand(line, table, sizeof(table) / sizeof(table[0]), entry, args));
+  TEST_ASSERT_EQUAL_UINT8(0, calls);
+  TEST_ASSERT_TRUE(entry.handler == handler);
+  TEST_ASSERT_EQUAL_INT32(1500, args.value[1]);
+
+  // handler ถูกเรียกภายหลังด้วยอาร์กิวเมนต์ที่แยกไว้แล้ว
+  entry.handler(args);
+  TEST_ASSERT_EQUAL_STRING("ACID", lastArgs.text[0]);
+}
+
+void test_parse_int32(void) {
+  int32_t value = 0;
+  TEST_ASSERT_TRUE(parseInt32("-42", value));
+  TEST_ASSERT_EQUAL_INT32(-42, value);
+  TEST_ASSERT_TRUE(parseInt32("300000", value));
+  TEST_ASSERT_EQUAL_INT32(300000, value);
+  TEST_ASSERT_FALSE(parseInt32("", value));
+  TEST_ASSERT_FALSE(parseInt32("-", value));
+  TEST_ASSERT_FALSE(parseInt32("12a", value));
+  TEST_ASSERT_TRUE(parseInt32("2147483647", value));
+  TEST_ASSERT_EQUAL_INT32(2147483647L, value);
+  TEST_ASSERT_TRUE(parseInt32("-2147483647", value));
+  TEST_ASSERT_EQUAL_INT32(-2147483647L, value);
+  TEST_ASSERT_FALSE(parseInt32("2147483648", value));
+  TEST_ASSERT_FALSE(parseInt32("99999999999", value));
+  TEST_ASSERT_FALSE(parseInt32("-99999999999", value));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_line_trims_and_skips_blank_lines);
+  RUN_TEST(test_line_split_across_feeds);
+  RUN_TEST(test_line_overflow_discards_whole_line);
+  RUN_TEST(test_dispatch_exact_and_unknown);
+  RUN_TEST(test_dispatch_prefix_with_numeric_args);
+  RUN_TEST(test_dispatch_rejects_bad_args);
+  RUN_TEST(test_dispatch_any_args);
+  RUN_TEST(test_match_does_not_call_handler);
+  RUN_TEST(test_parse_int32);
+  return UNITY_END();
+}
@@ -0,0 +1,181 @@
+#include <unity.h>
+#include <native_hal.h>
+#include "dosing_controller.h"
+
+// === CLOSED-LOOP DOSING CONTROLLER ===
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// EC 1600.0 µS/cm ±10, 1 s ต่อ 100 µS/cm (gain 100 = 100 ms ต่อ 10 µS/cm), ผสม 60 s
+static DosingConfig ecConfig() {
+  DosingConfig config = {16000, 100, 100, true, 60000UL, 5000UL, 20000UL};
+  return config;
+}
+
+static DosingController makeController(const DosingConfig& config) {
+  DosingController controller;
+  TEST_ASSERT_TRUE(DosingController::valid(config));
+  controller.begin(0);
+  controller.configure(config);
+  controller.enable(true, 0);
+  return controller;
+}
+
+static void expectEvent(DosingController& controller, uint8_t step, int32_t value, int32_t reference, uint32_t amount) {
+  DoseEvent event;
+  TEST_ASSERT_TRUE(controller.popEvent(event));
+  TEST_ASSERT_EQUAL_UINT8(step, event.step);
+  TEST_ASSERT_EQUAL_INT32(value, event.value);
+  TEST_ASSERT_EQUAL_INT32(reference, event.reference);
+  TEST_ASSERT_EQUAL_UINT32(amount, event.amount);
+}
+
+void test_pulse_then_wait_then_measure(void) {
+  DosingController controller = makeController(ecConfig());
+  controller.sample(15500, 1000);                              // ต่ำกว่าค่าตั้ง 50 µS/cm
+  TEST_ASSERT_EQUAL_UINT32(500, controller.poll(1000, false));
+  TEST_ASSERT_EQUAL(DOSING_PULSE, controller.state());
+  expectEvent(controller, DOSE_STEP_PULSE, 15500, 16000, 500);
+
+  TEST_ASSERT_EQUAL_UINT32(0, controller.poll(1200, true));   // ปั๊มยังทำงาน
+  TEST_ASSERT_EQUAL_UINT32(0, controller.poll(1500, false));  // ปั๊มหยุด: เริ่มนับเวลาผสม
+  TEST_ASSERT_EQUAL(DOSING_WAIT, controller.state());
+
+  // ค่าระหว่างผสมไม่ถูกใช้ตัดสิน
+  controller.sample(17000, 30000);
+  TEST_ASSERT_EQUAL_UINT32(0, controller.poll(30000, false));
+  DoseEvent event;
+  TEST_ASSERT_FALSE(controller.popEvent(event));
+
+  controller.sample(15800, 61500);
+  TEST_ASSERT_EQUAL_UINT32(200, controller.poll(61500, false));
+  expectEvent(controller, DOSE_STEP_RESULT, 15800, 15500, 500);
+  expectEvent(controller, DOSE_STEP_PULSE, 15800, 16000, 200);
+  TEST_ASSERT_EQUAL_UINT16(2, controller.doses());
+  TEST_ASSERT_EQUAL_UINT32(700, controller.totalDosedMs());
+}
+
+void test_settled_is_reported_once(void) {
+  DosingController controller = makeController(ecConfig());
+  controller.sample(15950, 1000);                              // อยู่ใน deadband
+  TEST_ASSERT_EQUAL_UINT32(0, controller.poll(1000, false));
+  expectEvent(controller, DOSE_STEP_SETTLED, 15950, 16000, 0);
+  controller.sample(16400, 3000);                              // สูงเกิน: ปุ๋ยลดเองไม่ได้
+  TEST_ASSERT_EQUAL_UINT32(0, controller.poll(3000, false));
+  DoseEvent event;
+  TEST_ASSERT_FALSE(controller.popEvent(event));
+}
+
+void test_acid_lowers_value(void) {
+  DosingConfig config = {600, 10, 2000, false, 30000UL, 3000UL, 20000UL};   // pH 6.00 ±0.10, 2 s ต่อ 1.00
+  DosingController controller = makeController(config);
+  controller.sample(580, 1000);                                // ต่ำกว่าค่าตั้ง: กรดช่วยไม่ได้
+  TEST_ASSERT_EQUAL_UINT32(0, controller.poll(1000, false));
+  expectEvent(controller, DOSE_STEP_SETTLED, 580, 600, 0);
+  controller.sample(650, 3000);
+  TEST_ASSERT_EQUAL_UINT32(1000, controller.poll(3000, false));
+}
+
+void test_pulse_and_hourly_caps(void) {
+  DosingController controller = makeController(ecConfig());
+  uint32_t now = 1000;
+  controller.sample(10000, now);                               // error 600 µS/cm -> 6 s จำกัดที่ 5 s
+  TEST_ASSERT_EQUAL_UINT32(5000, controller.poll(now, false));
+
+  // ค่าขยับทุกรอบแต่ยังไม่ถึงค่าตั้ง: 5 + 5 + 5 + 5 = 20 s เต็มโควตาชั่วโมง
+  int32_t value = 10000;
+  for (uint8_t i = 0; i < 3; i++) {
+    controller.poll(now += 5000, false);
+    controller.sample(value += 100, now += 60000);
+    TEST_ASSERT_EQUAL_UINT32(5000, controller.poll(now, false));
+  }
+  controller.poll(now += 5000, false);
+  controller.sample(value += 100, now += 60000);
+  TEST_ASSERT_EQUAL_UINT32(0, controller.poll(now, false));
+  TEST_ASSERT_EQUAL_UINT32(20000, controller.usedThisHourMs(now));
+
+  DoseEvent event;
+  while (controller.popEvent(event) && event.step != DOSE_STEP_LIMIT) {}
+  TEST_ASSERT_EQUAL_UINT8(DOSE_STEP_LIMIT, event.step);
+  TEST_ASSERT_EQUAL_UINT32(20000, event.amount);
+
+  // เกินหนึ่งชั่วโมงจากการเติมครั้งแรก: โควตาคืน
+  now += DOSING_BUDGET_SLOTS * DOSING_BUDGET_SLOT_MS;
+  controller.sample(value, now);
+  TEST_ASSERT_EQUAL_UINT32(0, controller.usedThisHourMs(now));
+  TEST_ASSERT_EQUAL_UINT32(5000, controller.poll(now, false));
+}
+
+void test_no_response_faults(void) {
+  DosingController controller = makeController(ecConfig());
+  uint32_t now = 1000;
+  controller.sample(15000, now);
+  TEST_ASSERT_EQUAL_UINT32(1000, controller.poll(now, false));
+  for (uint8_t i = 0; i < DOSING_NO_RESPONSE_LIMIT; i++) {
+    controller.poll(now += 1000, false);
+    controller.sample(15000, now += 60000);                    // ถังปุ๋ยหมด: ค่าไม่ขยับ
+    controller.poll(now, false);
+  }
+  TEST_ASSERT_EQUAL(DOSING_FAULT, controller.state());
+  TEST_ASSERT_EQUAL_UINT16(DOSING_NO_RESPONSE_LIMIT, controller.doses());
+
+  DoseEvent event;
+  DoseEvent last;
+  while (controller.popEvent(event)) last = event;
+  TEST_ASSERT_EQUAL_UINT8(DOSE_STEP_FAULT, last.step);
+  TEST_ASSERT_EQUAL_UINT32(DOSING_NO_RESPONSE_LIMIT, last.amount);
+
+  controller.sample(15000, now += 5000);
+  TEST_ASSERT_EQUAL_UINT32(0, controller.poll(now, false));
+
+  controller.enable(true, now);                                // ESP32 เปิดใหม่หลังแก้ไข
+  controller.sample(15000, now += 2000);
+  TEST_ASSERT_EQUAL_UINT32(1000, controller.poll(now, false));
+}
+
+void test_busy_pump_and_disable(void) {
+  DosingController controller = makeController(ecConfig());
+  controller.sample(15000, 1000);
+  TEST_ASSERT_EQUAL_UINT32(0, controller.poll(1000, true));   // ESP32 สั่งปั๊มอยู่: ไม่ซ้อน
+  controller.sample(15000, 3000);
+  TEST_ASSERT_EQUAL_UINT32(1000, controller.poll(3000, false));
+
+  controller.enable(false, 3100);
+  TEST_ASSERT_EQUAL(DOSING_OFF, controller.state());
+  controller.sample(15000, 70000);
+  TEST_ASSERT_EQUAL_UINT32(0, controller.poll(70000, false));
+}
+
+void test_config_validation(void) {
+  DosingConfig config = ecConfig();
+  TEST_ASSERT_TRUE(DosingController::valid(config));
+  config.gain = 0;
+  TEST_ASSERT_FALSE(DosingController::valid(config));
+  config = ecConfig();
+  config.mixDelayMs = 500;
+  TEST_ASSERT_FALSE(DosingController::valid(config));
+  config = ecConfig();
+  config.maxPulseMs = DOSING_PULSE_MAX_MS + 1;
+  TEST_ASSERT_FALSE(DosingController::valid(config));
+  config = ecConfig();
+  config.setpoint = 0;
+  TEST_ASSERT_FALSE(DosingController::valid(config));
+
+  DosingController controller;
+  TEST_ASSERT_FALSE(controller.configured());
+  controller.sample(15000, 1000);
+  TEST_ASSERT_EQUAL_UINT32(0, controller.poll(1000, false));  // ยังไม่เปิด
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_pulse_then_wait_then_measure);
+  RUN_TEST(test_settled_is_reported_once);
+  RUN_TEST(test_acid_lowers_value);
+  RUN_TEST(test_pulse_and_hourly_caps);
+  RUN_TEST(test_no_response_faults);
+  RUN_TEST(test_busy_pump_and_disable);
+  RUN_TEST(test_config_validation);
+  return UNITY_END();
+}
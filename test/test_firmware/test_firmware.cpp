@@ -0,0 +1,915 @@
+#include <unity.h>
+#include <native_hal.h>
+#include <sim_modbus.h>
+#include <string>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "telemetry_frame.h"
+#include "telemetry_delta.h"
+#include "slave_health.h"
+#include "relay_driver.h"
+#include "actuator_timer.h"
+#include "link_monitor.h"
+#include "outbound_queue.h"
+#include "command_parser.h"
+#include "command_envelope.h"
+#include "sensor_filter.h"
+#include "rule_engine.h"
+
+// state ของ firmware ที่ test จำลองการรีบูต (ดู test_state_survives_reboot)
+extern bool isEcSensorRange4400;
+extern LinkMonitor esp32Link;
+extern bool esp32LinkLost;
+extern OutboundQueue outbox;
+extern SensorFilter sensorFilters[FILTER_CHANNEL_COUNT];
+extern uint16_t ecValue;
+extern uint16_t phValue;
+extern int16_t waterTemp;
+extern RuleEngine ruleEngine;
+void restorePersistentState();
+
+// === FIRMWARE SCENARIOS ===
+// รัน setup()/loop() ของ main.cpp ทั้งตัวกับอุปกรณ์จำลอง:
+//   Serial1 = Modbus slave ID 1-4, Serial3 = PZEM-004T (address 0xF8), Serial2 = ESP32 จำลอง
+// test แต่ละตัวต่อเนื่องจากตัวก่อนหน้า (firmware มี state แบบ global)
+
+static SimModbusBus sensors;
+static SimModbusBus meterBus;
+
+// ESP32 จำลอง: เก็บทุกอย่างที่ Mega ส่งมา ตอบ MEGA_TEST และ ACK ข้อความที่ส่งซ้ำ (REPLAY:) อัตโนมัติ
+struct FakeEsp32 {
+  std::string received;
+  size_t scanned = 0;
+  size_t acked = 0;
+  bool silent = false;       // จำลองลิงก์ขาด: ไม่ตอบอะไรเลย
+  bool ackReplays = true;
+
+  void service() {
+    received += Serial2.takeOutput();
+    if (silent) {
+      scanned = acked = received.size();
+      return;
+    }
+    size_t at;
+    while ((at = received.find("MEGA_TEST\r\n", scanned)) != std::string::npos) {
+      scanned = at + 1;
+      Serial2.inject("ESP32_OK\n");
+    }
+    while (ackReplays && (at = received.find("REPLAY:", acked)) != std::string::npos) {
+      acked = at + 1;
+      std::string ack = "ACK:" + std::to_string(strtoul(received.c_str() + at + 7, NULL, 10)) + "\n";
+      Serial2.inject(ack.c_str());
+    }
+  }
+
+  void clear() {
+    received.clear();
+    scanned = 0;
+    acked = 0;
+  }
+
+  void send(const char* line) {
+    Serial2.inject(line);
+    Serial2.inject("\n");
+  }
+
+  bool sawLine(const char* text) const {
+    return received.find(std::string(text) + "\r\n") != std::string::npos;
+  }
+
+  // ถอดเฟรม binary ล่าสุดที่ผ่านการตรวจ CRC
+  bool lastFrame(TelemetryFrameV1& frame) const {
+    bool found = false;
+    size_t start = 0;
+    while (start < received.size()) {
+      size_t end = received.find('\0', start);
+      if (end == std::string::npos) break;
+      if (end > start) {
+        TelemetryFrameV1 candidate;
+        if (decodeTelemetryFrame((const uint8_t*)received.data() + start, end - start, candidate) == TELEMETRY_OK) {
+          frame = candidate;
+          found = true;
+        }
+      }
+      start = end + 1;
+    }
+    return found;
+  }
+
+  // นับเฟรม binary ตั้งแต่ตำแหน่ง from: เฟรมเต็มแทนที่ state ส่วนเฟรม delta เขียนทับเฉพาะฟิลด์ที่มี
+  void scanFrames(size_t from, int& full, int& delta, TelemetryFrameV1& state) const {
+    full = 0;
+    delta = 0;
+    size_t start = from;
+    while (start < received.size()) {
+      size_t end = received.find('\0', start);
+      if (end == std::string::npos) break;
+      if (end > start) {
+        const uint8_t* chunk = (const uint8_t*)received.data() + start;
+        if (decodeTelemetryFrame(chunk, end - start, state) == TELEMETRY_OK) {
+          full++;
+        } else if (applyTelemetryDelta(chunk, end - start, state) == TELEMETRY_OK) {
+          delta++;
+        }
+      }
+      start = end + 1;
+    }
+  }
+};
+
+static FakeEsp32 esp32;
+
+static void serviceEsp32(void* context) {
+  static_cast<FakeEsp32*>(context)->service();
+}
+
+static const uint8_t WATER_LEVEL_PIN = 54;
+static const uint8_t RELAY_K1_PIN = 26;
+static const uint8_t RELAY_K2_PIN = 28;
+static const uint8_t RELAY_K3_PIN = 30;
+static const uint8_t RELAY_K5_PIN = 33;
+static const uint8_t RELAY_K7_PIN = 29;
+static const uint8_t RELAY_K8_PIN = 32;
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_boot_handshake_and_relays_off(void) {
+  TEST_ASSERT_EQUAL_UINT8(LOW, halPinLevel(RELAY_K1_PIN));   // K1 active high
+  TEST_ASSERT_EQUAL_UINT8(HIGH, halPinLevel(RELAY_K7_PIN));  // K2-K8 active low
+  TEST_ASSERT_EQUAL_UINT32(1000, halTimer3PeriodMicros());
+
+  // setup() ไม่รอ ESP32: MEGA_TEST ถูกส่งในรอบแรกของ loop() แล้วรับคำตอบแบบไม่บล็อก
+  TEST_ASSERT_FALSE(esp32.sawLine("MEGA_TEST"));
+  esp32.send("BOOT");
+  halRunLoop(50);
+  TEST_ASSERT_TRUE(esp32.sawLine("MEGA_TEST"));
+  TEST_ASSERT_EQUAL_UINT32(1, esp32Link.probesSent());
+  TEST_ASSERT_FALSE(esp32Link.probePending());               // ตอบแล้วผ่านตัวแยกคำสั่งปกติ
+
+  size_t at = esp32.received.find("BOOT:ready_us=");
+  TEST_ASSERT_TRUE(at != std::string::npos);
+  char* end;
+  unsigned long ready = strtoul(esp32.received.c_str() + at + 14, &end, 10);
+  TEST_ASSERT_EQUAL(0, strncmp(end, ",setup_us=", 10));
+  unsigned long setupUs = strtoul(end + 10, NULL, 10);
+  TEST_ASSERT_TRUE(ready <= setupUs);
+  TEST_ASSERT_TRUE(setupUs < 100000);                        // เดิม > 3 วินาที
+}
+
+void test_binary_telemetry_carries_sensor_values(void) {
+  esp32.send("CONFIG:TELEMETRY:BINARY");
+  halRunLoop(5000);
+  TEST_ASSERT_TRUE(esp32.sawLine("CONFIG_OK:TELEMETRY_BINARY"));
+
+  TelemetryFrameV1 frame;
+  TEST_ASSERT_TRUE(esp32.lastFrame(frame));
+  TEST_ASSERT_EQUAL_UINT16(812, frame.co2Ppm);
+  TEST_ASSERT_EQUAL_INT16(253, frame.airTemp);
+  TEST_ASSERT_EQUAL_UINT16(655, frame.airHumidity);
+  TEST_ASSERT_EQUAL_UINT32(1234, frame.lux);
+  TEST_ASSERT_EQUAL_UINT16(15429, frame.ec);   // 15.968 x 100.0 - 53.913
+  TEST_ASSERT_EQUAL_UINT16(610, frame.ph);
+  TEST_ASSERT_EQUAL_INT16(215, frame.waterTemp);
+  TEST_ASSERT_EQUAL_UINT16(2301, frame.acVoltage);
+  TEST_ASSERT_EQUAL_UINT32(1500, frame.acCurrent);
+  TEST_ASSERT_EQUAL_UINT32(3450, frame.acPower);
+  TEST_ASSERT_EQUAL_UINT32(71234, frame.acEnergy);
+  TEST_ASSERT_EQUAL_UINT16(500, frame.acFrequency);
+  TEST_ASSERT_EQUAL_UINT8(95, frame.acPowerFactor);
+  TEST_ASSERT_TRUE(frame.flags & TELEMETRY_FLAG_AC_CONNECTED);
+  TEST_ASSERT_TRUE(frame.flags & TELEMETRY_FLAG_EC_RANGE_4400);
+}
+
+void test_sensor_polling_keeps_running_with_offline_slave(void) {
+  esp32.send("POLL:2,1000,1000,0,200");   // ตรึงคาบของ ID2 ไว้ที่ 1 วินาที
+  esp32.send("POLL:1,1000,1000,1,500");
+  halRunLoop(50);
+  TEST_ASSERT_TRUE(esp32.sawLine("POLL_OK:2"));
+
+  uint32_t before = sensors.slave(2)->requests;
+  sensors.slave(1)->online = false;
+  halRunLoop(5000);
+  TEST_ASSERT_GREATER_OR_EQUAL(before + 4, sensors.slave(2)->requests);
+
+  // ID1 offline: ค่าเดิมคงอยู่พร้อม flag stale ไม่ใช่ 0
+  TelemetryFrameV1 frame;
+  TEST_ASSERT_TRUE(esp32.lastFrame(frame));
+  TEST_ASSERT_TRUE(frame.flags & TELEMETRY_FLAG_STALE_AIR);
+  TEST_ASSERT_FALSE(frame.flags & TELEMETRY_FLAG_STALE_LIGHT);
+  TEST_ASSERT_EQUAL_INT16(253, frame.airTemp);
+  TEST_ASSERT_EQUAL_UINT16(812, frame.co2Ppm);
+
+  // backoff: 25 วินาทีที่ offline ลองแค่ ~6 ครั้ง (1, 2, 3, 5, 9, 17 s) ไม่ใช่ทุก 1 วินาที
+  halRunLoop(20000);
+  esp32.received.clear();
+  esp32.scanned = 0;
+  esp32.send("HEALTH");
+  halRunLoop(50);
+  size_t at = esp32.received.find("HEALTH:1=offline,");
+  TEST_ASSERT_TRUE(at != std::string::npos);
+  int failures = atoi(esp32.received.c_str() + at + strlen("HEALTH:1=offline,"));
+  TEST_ASSERT_GREATER_OR_EQUAL(5, failures);
+  TEST_ASSERT_LESS_OR_EQUAL(7, failures);
+
+  // กลับมา online: probe ครั้งถัดไป (ไม่เกินเพดาน backoff) อ่านได้และ flag หายไป
+  sensors.slave(1)->online = true;
+  halRunLoop(SLAVE_BACKOFF_MAX_MS + 3000);
+  TEST_ASSERT_TRUE(esp32.lastFrame(frame));
+  TEST_ASSERT_FALSE(frame.flags & TELEMETRY_FLAG_STALE_AIR);
+}
+
+void test_poll_periods_adapt_to_sensor_changes(void) {
+  esp32.send("POLL:4,1000,8000,2,2000");
+  halRunLoop(20000);                                   // pH นิ่ง: คาบยืดจนถึง max
+  esp32.received.clear();
+  esp32.scanned = 0;
+  esp32.send("POLL_STATUS");
+  halRunLoop(50);
+  TEST_ASSERT_TRUE(esp32.received.find(";4=8000,1000,8000,2") != std::string::npos);
+
+  uint32_t before = sensors.slave(4)->requests;
+  sensors.slave(4)->holding[1] = 70;                   // pH 6.1 -> 7.0
+  halRunLoop(8000);                                    // อ่านเจอการเปลี่ยน แล้วกลับไปเร็ว
+  halRunLoop(3000);
+  TEST_ASSERT_GREATER_OR_EQUAL(before + 3, sensors.slave(4)->requests);
+
+  // ค่าใกล้เกณฑ์ควบคุม: อยู่ที่คาบเร็วสุดต่อไปแม้ค่านิ่ง
+  esp32.send("POLL_WATCH:4,700,20,0");
+  halRunLoop(10000);
+  esp32.received.clear();
+  esp32.scanned = 0;
+  esp32.send("POLL_STATUS");
+  halRunLoop(50);
+  TEST_ASSERT_TRUE(esp32.received.find(";4=1000,1000,8000,2") != std::string::npos);
+
+  sensors.slave(4)->holding[1] = 61;
+  esp32.send("POLL_WATCH:4,0,0,10");
+  esp32.send("POLL:9,1000,2000,0,0");
+  halRunLoop(50);
+  TEST_ASSERT_TRUE(esp32.sawLine("POLL_ERROR:INVALID_ARGS"));
+}
+
+void test_energy_reset_goes_through_meter_bus(void) {
+  SimModbusSlave* meter = meterBus.slave(0xF8);
+  uint32_t readsBefore = meter->requests;
+  esp32.send("CONFIG:RESET_ENERGY");
+  halRunLoop(3000);
+  TEST_ASSERT_TRUE(esp32.sawLine("CONFIG_OK:ENERGY_RESET"));
+  TEST_ASSERT_EQUAL_UINT32(1, meter->energyResets);
+  TEST_ASSERT_TRUE(meter->requests - readsBefore >= 3);     // การอ่านปกติยังเดินต่อ
+  TEST_ASSERT_EQUAL_UINT32(0, meterBus.badFrames());
+
+  TelemetryFrameV1 frame;
+  TEST_ASSERT_TRUE(esp32.lastFrame(frame));
+  TEST_ASSERT_EQUAL_UINT32(0, frame.acEnergy);
+  TEST_ASSERT_EQUAL_UINT16(2301, frame.acVoltage);
+}
+
+void test_ec_pump_pulse_is_exact(void) {
+  esp32.received.clear();
+  esp32.scanned = 0;
+  esp32.send("PUMP_TIMING:EC,1500");
+  halRunLoop(100);
+  TEST_ASSERT_TRUE(esp32.sawLine("EC_PUMP_TIMING_OK"));
+  TEST_ASSERT_EQUAL_UINT8(LOW, halPinLevel(RELAY_K7_PIN));   // เปิด
+
+  halRunLoop(1500);
+  TEST_ASSERT_EQUAL_UINT8(HIGH, halPinLevel(RELAY_K7_PIN));  // ปิดแล้ว
+  TEST_ASSERT_TRUE(esp32.sawLine("EC_PUMP_STOPPED:1500,1500,100.00,0"));
+
+  // เวลาติดลบไม่ถูกแปลงเป็น unsigned long (~49 วัน)
+  esp32.clear();
+  esp32.send("PUMP_TIMING:EC,-1");
+  esp32.send("PUMP_TIMING:PH_ACID,-500");
+  halRunLoop(20);
+  TEST_ASSERT_TRUE(esp32.received.find("PUMP_TIMING_ERROR:INVALID_DURATION\r\nPUMP_TIMING_ERROR:INVALID_DURATION\r\n") != std::string::npos);
+  TEST_ASSERT_EQUAL_UINT8(HIGH, halPinLevel(RELAY_K7_PIN));
+}
+
+void test_relay_pattern_command(void) {
+  esp32.send("RELAY:10000000");
+  halRunLoop(50);
+  TEST_ASSERT_TRUE(esp32.sawLine("RELAY_OK"));
+  TEST_ASSERT_EQUAL_UINT8(HIGH, halPinLevel(RELAY_K1_PIN));
+
+  esp32.send("RELAY:101");
+  halRunLoop(50);
+  TEST_ASSERT_TRUE(esp32.sawLine("RELAY_ERROR:INVALID_LENGTH"));
+}
+
+void test_concurrent_timed_relays(void) {
+  esp32.received.clear();
+  esp32.scanned = 0;
+  esp32.send("FAN_TIMING:K3,1,1");
+  esp32.send("FAN_TIMING:K5,2,1,4");
+  esp32.send("PUMP_TIMING:K8,500");
+  halRunLoop(100);
+  TEST_ASSERT_TRUE(esp32.sawLine("FAN_TIMING_OK"));
+  TEST_ASSERT_TRUE(esp32.sawLine("PUMP_TIMING_OK:K8"));
+
+  // RELAY: ไม่แตะ relay ที่ตารางจับเวลาคุมอยู่
+  esp32.send("RELAY:11111111");
+  halRunLoop(1000);                                          // t ~ 1.1 s
+  TEST_ASSERT_TRUE(esp32.sawLine("PUMP_STOPPED:K8,500,500,100.00"));
+  TEST_ASSERT_EQUAL_UINT8(LOW, halPinLevel(RELAY_K3_PIN));   // K3 ON (active low)
+  TEST_ASSERT_EQUAL_UINT8(LOW, halPinLevel(RELAY_K5_PIN));   // K5 ON
+
+  halRunLoop(1000);                                          // t ~ 2.1 s
+  TEST_ASSERT_EQUAL_UINT8(HIGH, halPinLevel(RELAY_K3_PIN));
+  TEST_ASSERT_TRUE(esp32.sawLine("FAN_CYCLE_STATE:ON,1000,100.00,K3"));
+
+  halRunLoop(2000);                                          // K5 ครบเพดาน 4 s
+  TEST_ASSERT_TRUE(esp32.sawLine("TIMER_MAX_RUN:K5,4000"));
+  TEST_ASSERT_EQUAL_UINT8(HIGH, halPinLevel(RELAY_K5_PIN));
+
+  esp32.send("TIMER_STOP:K3");
+  halRunLoop(50);
+  TEST_ASSERT_TRUE(esp32.sawLine("TIMER_STOP_OK:K3"));
+  TEST_ASSERT_EQUAL_UINT8(HIGH, halPinLevel(RELAY_K3_PIN));
+
+  esp32.send("RELAY:00000000");
+  halRunLoop(50);
+}
+
+void test_stats_command_reports_stages(void) {
+  esp32.send("STATS_RESET");
+  halRunLoop(3000);
+  TEST_ASSERT_TRUE(esp32.sawLine("STATS_RESET_OK"));
+
+  esp32.received.clear();
+  esp32.scanned = 0;
+  esp32.send("STATS");
+  halRunLoop(10);
+  size_t at = esp32.received.find("STATS:T=");
+  TEST_ASSERT_TRUE(at != std::string::npos);
+  std::string line = esp32.received.substr(at, esp32.received.find("\r\n", at) - at);
+  TEST_ASSERT_TRUE(line.find(";MB=") != std::string::npos);
+  TEST_ASSERT_TRUE(line.find(";PUMP=") != std::string::npos);
+  TEST_ASSERT_TRUE(line.find(";RPL=") != std::string::npos);
+  TEST_ASSERT_TRUE(line.find(";HIST=") != std::string::npos);
+  TEST_ASSERT_TRUE(line.find(";LOOP=") != std::string::npos);
+  TEST_ASSERT_TRUE(line.find(";TX=0,") == std::string::npos); // ส่ง telemetry แล้วอย่างน้อย 1 ครั้ง
+}
+
+void test_delta_telemetry_sends_changes_and_alerts(void) {
+  esp32.received.clear();
+  esp32.scanned = 0;
+  esp32.send("CONFIG:TELEMETRY:DELTA");
+  halRunLoop(2500);
+  TEST_ASSERT_TRUE(esp32.sawLine("CONFIG_OK:TELEMETRY_DELTA"));
+
+  TelemetryFrameV1 state;
+  int full = 0;
+  int delta = 0;
+  esp32.scanFrames(0, full, delta, state);
+  TEST_ASSERT_TRUE(full >= 1);                              // keyframe แรกหลังเปิดโหมด
+  TEST_ASSERT_FALSE(state.flags & TELEMETRY_FLAG_WATER_DETECTED);
+
+  // ค่านิ่ง: ไม่มีอะไรส่งเลย (เดิมส่งเฟรมเต็มทุก 2 วินาที)
+  size_t mark = esp32.received.size();
+  halRunLoop(10000);
+  esp32.scanFrames(mark, full, delta, state);
+  TEST_ASSERT_EQUAL(0, full);
+  TEST_ASSERT_EQUAL(0, delta);
+
+  // น้ำเข้า: ส่ง delta ทันทีที่อ่านระดับน้ำรอบถัดไป ไม่รอ SEND_INTERVAL
+  halSetPinInput(WATER_LEVEL_PIN, HIGH);
+  uint32_t waitedMs = 0;
+  do {
+    halRunLoop(10);
+    waitedMs += 10;
+    esp32.scanFrames(mark, full, delta, state);
+  } while (delta == 0 && waitedMs < 3000);
+  TEST_ASSERT_EQUAL(1, delta);
+  TEST_ASSERT_EQUAL(0, full);
+  TEST_ASSERT_TRUE(waitedMs <= 1100);                        // READ_INTERVAL + ตรวจ alert ทุก 50 ms
+  TEST_ASSERT_TRUE(state.flags & TELEMETRY_FLAG_WATER_DETECTED);
+  TEST_ASSERT_EQUAL_UINT16(2301, state.acVoltage);           // ฟิลด์อื่นยังเป็นค่าจาก keyframe
+
+  // keyframe เป็นระยะแม้ไม่มีอะไรเปลี่ยน
+  mark = esp32.received.size();
+  halRunLoop(30000);
+  esp32.scanFrames(mark, full, delta, state);
+  TEST_ASSERT_EQUAL(1, full);
+  TEST_ASSERT_EQUAL(0, delta);
+
+  halSetPinInput(WATER_LEVEL_PIN, LOW);
+  esp32.send("CONFIG:TELEMETRY:FULL");
+  halRunLoop(50);
+  TEST_ASSERT_TRUE(esp32.sawLine("CONFIG_OK:TELEMETRY_FULL"));
+}
+
+void test_group_subscriptions_run_at_their_own_rate(void) {
+  esp32.received.clear();
+  esp32.scanned = 0;
+  esp32.send("SUBSCRIBE:flow,250");
+  esp32.send("UNSUBSCRIBE:all");
+  halRunLoop(50);
+  TEST_ASSERT_TRUE(esp32.sawLine("SUBSCRIBE_OK:flow,250"));
+  TEST_ASSERT_TRUE(esp32.sawLine("UNSUBSCRIBE_OK:all"));
+
+  // กลุ่ม flow ใช้รูปแบบเฟรม delta: 2 วินาทีได้ ~8 เฟรม และไม่มีเฟรมเต็มอีก
+  TelemetryFrameV1 state = {};
+  int full = 0;
+  int delta = 0;
+  size_t mark = esp32.received.size();
+  halRunLoop(2000);
+  esp32.scanFrames(mark, full, delta, state);
+  TEST_ASSERT_EQUAL(0, full);
+  TEST_ASSERT_TRUE(delta >= 7 && delta <= 9);
+  TEST_ASSERT_EQUAL_UINT16(0, state.acVoltage);              // ฟิลด์นอกกลุ่มไม่ถูกส่ง
+
+  esp32.send("SUBSCRIPTIONS");
+  esp32.send("SUBSCRIBE:pumps,1000");
+  esp32.send("SUBSCRIBE:air,50");
+  halRunLoop(50);
+  TEST_ASSERT_TRUE(esp32.sawLine("SUBSCRIPTIONS:flow=250"));
+  TEST_ASSERT_TRUE(esp32.sawLine("SUBSCRIBE_ERROR:INVALID_ARGS"));
+
+  esp32.send("UNSUBSCRIBE:flow");
+  esp32.send("SUBSCRIBE:all,2000");
+  halRunLoop(2500);
+  mark = esp32.received.size();
+  halRunLoop(4100);
+  esp32.scanFrames(mark, full, delta, state);
+  TEST_ASSERT_EQUAL(2, full);
+  TEST_ASSERT_EQUAL(0, delta);
+  TEST_ASSERT_EQUAL_UINT16(2301, state.acVoltage);
+}
+
+void test_state_survives_reboot(void) {
+  esp32.send("RELAY:01000001");
+  esp32.send("FAN_TIMING:K3,2,3,600");
+  esp32.send("CONFIG:EC_RANGE:44000");
+  halRunLoop(3000);                                          // ตรวจทุก 1 s แล้วเขียนทีละไบต์
+
+  esp32.received.clear();
+  esp32.scanned = 0;
+  esp32.send("STORAGE");
+  halRunLoop(10);
+  size_t at = esp32.received.find("STORAGE:seq=");
+  TEST_ASSERT_TRUE(at != std::string::npos);
+  TEST_ASSERT_TRUE(strtoul(esp32.received.c_str() + at + 12, NULL, 10) >= 1);
+  TEST_ASSERT_TRUE(esp32.received.find(",slot=", at) != std::string::npos);
+  TEST_ASSERT_TRUE(esp32.received.find("/48\r\n", at) != std::string::npos);
+
+  // ไฟดับ: RAM กลับเป็นค่าเริ่มต้น แล้ว setup() อ่าน journal คืน
+  actuatorStop(2);
+  relayApply(0xFF, 0x00);
+  isEcSensorRange4400 = true;
+  restorePersistentState();
+
+  TEST_ASSERT_EQUAL_UINT8(LOW, halPinLevel(RELAY_K2_PIN));   // K2 ON (active low)
+  TEST_ASSERT_EQUAL_UINT8(LOW, halPinLevel(RELAY_K8_PIN));   // K8 ON
+  TEST_ASSERT_EQUAL_UINT8(LOW, halPinLevel(RELAY_K1_PIN));   // K1 OFF (active high)
+  TEST_ASSERT_TRUE(actuatorActive(2));                       // วงจร K3 เริ่มใหม่
+  uint32_t onMs, offMs, maxRunMs;
+  TEST_ASSERT_TRUE(actuatorCycleConfig(2, onMs, offMs, maxRunMs));
+  TEST_ASSERT_EQUAL_UINT32(2000, onMs);
+  TEST_ASSERT_EQUAL_UINT32(3000, offMs);
+  TEST_ASSERT_EQUAL_UINT32(600000, maxRunMs);
+  TEST_ASSERT_FALSE(isEcSensorRange4400);
+
+  esp32.send("TIMER_STOP:K3");
+  esp32.send("RELAY:00000000");
+  esp32.send("CONFIG:EC_RANGE:4400");
+  halRunLoop(50);
+}
+
+void test_history_returns_minute_buckets(void) {
+  halRunLoop(125000);                                        // ให้มีนาทีที่ปิดแล้วอย่างน้อย 2 ช่อง
+
+  esp32.received.clear();
+  esp32.scanned = 0;
+  esp32.send("HISTORY:airTemp,0");
+  esp32.send("HISTORY:lux,0");
+  halRunLoop(200);
+  TEST_ASSERT_TRUE(esp32.received.find("HISTORY_BEGIN:airTemp,") != std::string::npos);
+  TEST_ASSERT_TRUE(esp32.sawLine("HISTORY_ERROR:INVALID_ARGS"));
+  size_t end = esp32.received.find("HISTORY_END:airTemp,");
+  TEST_ASSERT_TRUE(end != std::string::npos);
+
+  // ทุกช่องเป็น 25.3 °C (x10) และเรียงจากเก่าไปใหม่
+  unsigned long lines = 0;
+  long lastStart = -1;
+  size_t at = 0;
+  while ((at = esp32.received.find("\nH:", at)) != std::string::npos && at < end) {
+    char* cursor = NULL;
+    long start = strtol(esp32.received.c_str() + at + 3, &cursor, 10);
+    TEST_ASSERT_TRUE(start > lastStart);
+    TEST_ASSERT_TRUE(strncmp(cursor, ",1,253,253,253\r\n", 16) == 0);
+    lastStart = start;
+    lines++;
+    at += 3;
+  }
+  TEST_ASSERT_TRUE(lines >= 2);
+  TEST_ASSERT_EQUAL_UINT32(lines, strtoul(esp32.received.c_str() + end + 20, NULL, 10));
+}
+
+// รอจนเซ็นเซอร์ EC ถูกอ่านอีกครั้ง
+static void waitForRead(uint8_t slaveId) {
+  uint32_t before = sensors.slave(slaveId)->requests;
+  while (sensors.slave(slaveId)->requests == before) {
+    halRunLoop(10);
+  }
+  halRunLoop(50);
+}
+
+static void waitForEcRead(void) {
+  waitForRead(3);
+}
+
+void test_single_ec_spike_is_filtered(void) {
+  waitForEcRead();
+  TEST_ASSERT_EQUAL_UINT16(15429, ecValue);                  // 1542.9 µS/cm
+
+  sensors.slave(3)->holding[1] = 3000;                       // ค่าโดดตัวเดียวหลังเติมปุ๋ย
+  waitForEcRead();
+  sensors.slave(3)->holding[1] = 1000;
+  TEST_ASSERT_TRUE(sensorFilters[FILTER_EC].raw() > 40000);
+  TEST_ASSERT_EQUAL_UINT16(15429, ecValue);                  // median-of-3 ตัดทิ้ง
+
+  esp32.send("FILTERS");
+  esp32.send("FILTER:ec,5,2,50");
+  esp32.send("FILTER:ec,4,0,0");
+  esp32.send("FILTER:airTemp,3,0,0");
+  halRunLoop(50);
+  TEST_ASSERT_TRUE(esp32.received.find(";ec=3,0,0,") != std::string::npos);
+  TEST_ASSERT_TRUE(esp32.received.find(",15429,0;ph=3,0,0,") != std::string::npos);
+  TEST_ASSERT_TRUE(esp32.sawLine("FILTER_OK:ec"));
+  TEST_ASSERT_TRUE(esp32.sawLine("FILTER_ERROR:INVALID_ARGS"));
+
+  esp32.clear();
+  esp32.send("FILTERS");
+  halRunLoop(50);
+  TEST_ASSERT_TRUE(esp32.received.find(";ec=5,2,50,") != std::string::npos);
+  esp32.send("FILTER:ec,3,0,0");
+  halRunLoop(50);
+}
+
+void test_missing_ec_measurement_stays_out_of_filter(void) {
+  sensors.slave(3)->holding[1] = 0;                          // หัววัดไม่อยู่ในน้ำ: ไม่มีการวัด
+  waitForEcRead();
+  waitForEcRead();
+  TEST_ASSERT_EQUAL_UINT16(0, ecValue);
+
+  // ค่าจริงตัวแรกหลังค่าที่ไม่มีการวัดต้องไม่ถูก median กลบด้วย 0
+  sensors.slave(3)->holding[1] = 1000;
+  waitForEcRead();
+  TEST_ASSERT_EQUAL_UINT16(15429, ecValue);
+  TEST_ASSERT_EQUAL_INT32(15429, sensorFilters[FILTER_EC].value());
+}
+
+// ส่งคำสั่งใน envelope: #<body>*<crc>
+static void sendEnvelope(const char* body) {
+  char line[COMMAND_LINE_MAX + 1];
+  snprintf(line, sizeof(line), "#%s*%04X", body, commandEnvelopeChecksum(body, strlen(body)));
+  esp32.send(line);
+}
+
+void test_batched_commands_apply_atomically(void) {
+  const char* batch = "21:RELAY:10000000;PUMP_TIMING:EC,300;PUMP_TIMING:K8,300";
+  esp32.clear();
+  sendEnvelope(batch);
+  halRunLoop(20);
+  TEST_ASSERT_TRUE(esp32.sawLine("CMD_ACK:21,3"));
+  TEST_ASSERT_EQUAL_UINT8(HIGH, halPinLevel(RELAY_K1_PIN));
+  TEST_ASSERT_EQUAL_UINT8(LOW, halPinLevel(RELAY_K7_PIN));
+  TEST_ASSERT_EQUAL_UINT8(LOW, halPinLevel(RELAY_K8_PIN));
+  halRunLoop(400);
+  TEST_ASSERT_EQUAL_UINT8(HIGH, halPinLevel(RELAY_K7_PIN));
+
+  // ESP32 ไม่เห็น ACK แล้วส่งเฟรมเดิมซ้ำ: ตอบ ACK เดิม ปั๊มไม่ถูกเปิดอีก
+  esp32.clear();
+  sendEnvelope(batch);
+  halRunLoop(20);
+  TEST_ASSERT_TRUE(esp32.sawLine("CMD_ACK:21,3"));
+  TEST_ASSERT_TRUE(esp32.received.find("EC_PUMP_TIMING_OK") == std::string::npos);
+  TEST_ASSERT_EQUAL_UINT8(HIGH, halPinLevel(RELAY_K7_PIN));
+
+  // คำสั่งใดไม่ผ่าน = ไม่ทำเลยทั้งเฟรม
+  sendEnvelope("22:RELAY:00000000;TIMER_STOP:K9");
+  sendEnvelope("23:RELAY:00000000;STATS");
+  sendEnvelope("24:RELAY:00000000;PUMP_TIMING:EC");
+  halRunLoop(20);
+  TEST_ASSERT_TRUE(esp32.sawLine("CMD_NAK:22,2,INVALID_RELAY"));
+  TEST_ASSERT_TRUE(esp32.sawLine("CMD_NAK:23,2,NOT_BATCHABLE"));
+  TEST_ASSERT_TRUE(esp32.sawLine("CMD_NAK:24,2,UNKNOWN_COMMAND"));
+  TEST_ASSERT_EQUAL_UINT8(HIGH, halPinLevel(RELAY_K1_PIN));
+
+  esp32.send("#25:RELAY:00000000*0000");
+  halRunLoop(20);
+  TEST_ASSERT_TRUE(esp32.sawLine("CMD_NAK:25,0,CHECKSUM"));
+  TEST_ASSERT_EQUAL_UINT8(HIGH, halPinLevel(RELAY_K1_PIN));
+
+  // คำสั่งเดียวใน envelope ใช้ได้ทุกคำสั่ง
+  sendEnvelope("26:RELAY:00000000");
+  halRunLoop(20);
+  TEST_ASSERT_TRUE(esp32.sawLine("CMD_ACK:26,1"));
+  TEST_ASSERT_EQUAL_UINT8(LOW, halPinLevel(RELAY_K1_PIN));
+
+  sendEnvelope("27:RELAY:10000000;PUMP_TIMING:EC,-1");
+  halRunLoop(20);
+  TEST_ASSERT_TRUE(esp32.sawLine("CMD_NAK:27,2,INVALID_DURATION"));
+  TEST_ASSERT_EQUAL_UINT8(LOW, halPinLevel(RELAY_K1_PIN));
+  TEST_ASSERT_EQUAL_UINT8(HIGH, halPinLevel(RELAY_K7_PIN));
+}
+
+void test_link_quality_is_measured_passively(void) {
+  esp32.clear();
+  esp32.send("LINK");
+  halRunLoop(10);
+  TEST_ASSERT_TRUE(esp32.received.find("LINK:rtt=") != std::string::npos);
+  TEST_ASSERT_TRUE(esp32.received.find(",loss=0,") != std::string::npos);
+  TEST_ASSERT_TRUE(esp32.received.find(",lost=0,state=OK\r\n") != std::string::npos);
+
+  // ESP32 ไม่ตอบ probe 1 ครั้ง: นับเป็น loss แต่คำสั่งที่มาระหว่างนั้นยังถูกทำทุกคำสั่ง
+  esp32.silent = true;
+  uint32_t sent = esp32Link.probesSent();
+  while (esp32Link.probesSent() == sent) {
+    halRunLoop(10);
+  }
+  halRunLoop(1100);
+  esp32.send("RELAY:00000010");
+  halRunLoop(10);
+  TEST_ASSERT_TRUE(esp32.sawLine("RELAY_OK"));
+  esp32.silent = false;
+  halRunLoop(5000);
+  TEST_ASSERT_EQUAL_UINT32(1, esp32Link.probesLost());
+  TEST_ASSERT_TRUE(esp32Link.lossPercent() > 0);
+  TEST_ASSERT_TRUE(esp32Link.silenceMs(millis()) < 5000);
+
+  esp32.clear();
+  esp32.send("LINK");
+  esp32.send("RELAY:00000000");
+  halRunLoop(10);
+  TEST_ASSERT_TRUE(esp32.received.find(",lost=1,state=OK\r\n") != std::string::npos);
+}
+
+void test_events_are_queued_while_link_is_down(void) {
+  esp32.send("CONFIG:TELEMETRY:JSON");
+  esp32.send("PUMP_TIMING:EC,15000");
+  halRunLoop(10);
+  TEST_ASSERT_TRUE(esp32.sawLine("EC_PUMP_TIMING_OK"));
+
+  // ESP32 เงียบ (ไม่ส่งอะไรเลย) เกิน 12 s = ลิงก์ขาด
+  esp32.silent = true;
+  halRunLoop(13000);
+  TEST_ASSERT_TRUE(esp32LinkLost);
+  TEST_ASSERT_EQUAL_UINT8(1, outbox.size());                 // snapshot ทันทีที่ขาด
+
+  // ปั๊มหยุดขณะลิงก์ขาด: เข้าคิว ไม่เขียนลง UART และไม่มี telemetry
+  size_t mark = esp32.received.size();
+  halRunLoop(7000);
+  TEST_ASSERT_EQUAL_UINT8(HIGH, halPinLevel(RELAY_K7_PIN));
+  TEST_ASSERT_EQUAL_UINT8(2, outbox.size());
+  TEST_ASSERT_TRUE(esp32.received.find("EC_PUMP_STOPPED", mark) == std::string::npos);
+  TEST_ASSERT_TRUE(esp32.received.find("SENSOR_DATA", mark) == std::string::npos);
+
+  // ลิงก์กลับมา (คำตอบของ MEGA_TEST รอบถัดไป): ส่งซ้ำตามลำดับ snapshot ก่อนแล้วจึงเหตุการณ์ ESP32 ตอบ ACK
+  esp32.silent = false;
+  esp32.ackReplays = false;
+  esp32.clear();
+  halRunLoop(7000);
+  TEST_ASSERT_TRUE(esp32.sawLine("MEGA_TEST"));
+  size_t first = esp32.received.find("REPLAY:");
+  TEST_ASSERT_TRUE(first != std::string::npos);
+  char* cursor = NULL;
+  unsigned long snapshotSeq = strtoul(esp32.received.c_str() + first + 7, &cursor, 10);
+  unsigned long age = strtoul(cursor + 1, &cursor, 10);
+  TEST_ASSERT_TRUE(age >= 8000);                             // เข้าคิวตอนตัดสินว่าลิงก์ขาด
+  TEST_ASSERT_EQUAL(0, strncmp(cursor, ",{\"msgType\":\"SENSOR_DATA\"", 25));
+  TEST_ASSERT_TRUE(esp32.received.find("REPLAY:", first + 1) != std::string::npos);   // ไม่มี ACK: ส่งซ้ำ
+  TEST_ASSERT_TRUE(esp32.received.find("EC_PUMP_STOPPED") == std::string::npos);     // รอ record ก่อนหน้า
+
+  esp32.ackReplays = true;
+  halRunLoop(100);
+  std::string eventLine = "REPLAY:" + std::to_string(snapshotSeq + 1) + ",";
+  size_t event = esp32.received.find(eventLine);
+  TEST_ASSERT_TRUE(event != std::string::npos);
+  TEST_ASSERT_TRUE(esp32.received.find(",EC_PUMP_STOPPED:15000,15000,100.00,0\r\n", event) != std::string::npos);
+
+  esp32.clear();
+  esp32.send("OUTBOX");
+  esp32.send("ACK:0");
+  halRunLoop(10);
+  TEST_ASSERT_TRUE(esp32.received.find("OUTBOX:queued=0,dropped=0,") != std::string::npos);
+  TEST_ASSERT_TRUE(esp32.received.find(",link=OK\r\n") != std::string::npos);
+  TEST_ASSERT_TRUE(esp32.sawLine("ACK_ERROR:INVALID_ARGS"));
+
+  // ลิงก์ปกติ: เหตุการณ์ส่งทันทีแบบเดิม
+  esp32.send("PUMP_TIMING:EC,200");
+  halRunLoop(400);
+  TEST_ASSERT_TRUE(esp32.sawLine("EC_PUMP_STOPPED:200,200,100.00,0"));
+
+  esp32.send("CONFIG:TELEMETRY:BINARY");
+  halRunLoop(50);
+}
+
+void test_dosing_controller_closes_the_loop(void) {
+  esp32.clear();
+  esp32.send("DOSE_MODE:EC,AUTO");
+  esp32.send("DOSE_CONFIG:PH_NEUTRAL,600,10,100,10,3000,60000");
+  esp32.send("DOSE_CONFIG:EC,16000,100,100,0,3000,60000");   // ผสม 0 s ไม่ได้
+  halRunLoop(10);
+  TEST_ASSERT_TRUE(esp32.sawLine("DOSE_ERROR:NOT_CONFIGURED"));
+  TEST_ASSERT_TRUE(esp32.received.find("DOSE_ERROR:INVALID_ARGS\r\nDOSE_ERROR:INVALID_ARGS\r\n") != std::string::npos);
+
+  // EC 1600.0 ±10 µS/cm, 100 ms ต่อ 10 µS/cm, ผสม 60 s (นานกว่าคาบอ่าน EC ที่ช้าสุด 2 รอบ ให้ median ตามทัน)
+  esp32.send("DOSE_CONFIG:EC,16000,100,100,60,3000,60000");
+  esp32.send("DOSE_MODE:EC,AUTO");
+  halRunLoop(10);
+  TEST_ASSERT_TRUE(esp32.sawLine("DOSE_CONFIG_OK:EC"));
+  TEST_ASSERT_TRUE(esp32.sawLine("DOSE_MODE_OK:EC,AUTO"));
+
+  // ค่าที่อ่านได้ครั้งถัดไป: ต่ำกว่าค่าตั้ง 57.1 µS/cm -> ปั๊ม 571 ms โดยไม่ต้องรอคำสั่งจาก ESP32
+  waitForEcRead();
+  TEST_ASSERT_TRUE(esp32.sawLine("DOSE:EC,PULSE,15429,16000,571"));
+  TEST_ASSERT_EQUAL_UINT8(LOW, halPinLevel(RELAY_K7_PIN));
+  sensors.slave(3)->holding[1] = 1040;                       // ปุ๋ยผสมแล้วค่าขึ้น
+  halRunLoop(600);
+  TEST_ASSERT_EQUAL_UINT8(HIGH, halPinLevel(RELAY_K7_PIN));
+  TEST_ASSERT_TRUE(esp32.sawLine("EC_PUMP_STOPPED:571,571,100.00,0"));
+
+  // ค่าระหว่างผสมไม่ถูกใช้ หลังครบ 60 s วัดผลแล้วหยุดเพราะถึงค่าตั้ง
+  halRunLoop(59000);
+  TEST_ASSERT_TRUE(esp32.received.find("DOSE:EC,RESULT") == std::string::npos);
+  halRunLoop(10000);
+  std::string after = std::to_string(ecValue);
+  TEST_ASSERT_TRUE(ecValue > 16000);
+  TEST_ASSERT_TRUE(esp32.sawLine(("DOSE:EC,RESULT," + after + ",15429,571").c_str()));
+  TEST_ASSERT_TRUE(esp32.sawLine(("DOSE:EC,SETTLED," + after + ",16000,0").c_str()));
+  TEST_ASSERT_EQUAL_UINT8(HIGH, halPinLevel(RELAY_K7_PIN));
+
+  esp32.clear();
+  esp32.send("DOSE_STATUS");
+  esp32.send("DOSE_MODE:EC,OFF");
+  halRunLoop(10);
+  TEST_ASSERT_TRUE(esp32.sawLine(("DOSE_STATUS:EC=WAIT,16000," + after + ",571,1,571;PH=OFF,0,610,0,0,0").c_str()));
+  TEST_ASSERT_TRUE(esp32.sawLine("DOSE_MODE_OK:EC,OFF"));
+  sensors.slave(3)->holding[1] = 1000;
+}
+
+void test_dosing_waits_for_a_real_ec_measurement(void) {
+  // เปิด AUTO ตอนหัววัดยังไม่มีการวัด (ตัวกรองเพิ่งล้าง เหมือนหลังบูต)
+  sensors.slave(3)->holding[1] = 0;
+  esp32.clear();
+  esp32.send("FILTER:ec,3,0,0");
+  esp32.send("DOSE_MODE:EC,AUTO");
+  halRunLoop(10);
+  TEST_ASSERT_TRUE(esp32.sawLine("DOSE_MODE_OK:EC,AUTO"));
+  waitForEcRead();
+  waitForEcRead();
+  TEST_ASSERT_EQUAL_UINT16(0, ecValue);
+  TEST_ASSERT_TRUE(esp32.received.find("DOSE:EC,") == std::string::npos);
+  TEST_ASSERT_EQUAL_UINT8(HIGH, halPinLevel(RELAY_K7_PIN));
+
+  // ค่าจริงตัวแรกตัดสินจากค่าที่วัดได้ ไม่ใช่ 0 (ซึ่งจะได้ pulse เต็ม 3000 ms)
+  sensors.slave(3)->holding[1] = 1000;
+  waitForEcRead();
+  TEST_ASSERT_TRUE(esp32.sawLine("DOSE:EC,PULSE,15429,16000,571"));
+  TEST_ASSERT_TRUE(esp32.received.find("DOSE:EC,PULSE,0,") == std::string::npos);
+
+  halRunLoop(600);
+  esp32.send("DOSE_MODE:EC,OFF");
+  halRunLoop(10);
+  TEST_ASSERT_EQUAL_UINT8(HIGH, halPinLevel(RELAY_K7_PIN));
+}
+
+void test_relay_rules_switch_after_each_read(void) {
+  SimModbusSlave* air = sensors.slave(1);
+  esp32.clear();
+  esp32.send("RELAY:00000000");
+  esp32.send("RULE:K9,airTemp,250,220,0,0");
+  esp32.send("RULE:K2,relayStates,1,0,0,0");
+  esp32.send("RULE:K2,airTemp,250,250,0,0");
+  esp32.send("RULE:K2,airTemp,250,220,0,0");                // ทำความเย็น: ON >= 25.0 °C, OFF <= 22.0 °C
+  halRunLoop(10);
+  TEST_ASSERT_TRUE(esp32.received.find("RULE_ERROR:INVALID_ARGS\r\nRULE_ERROR:INVALID_ARGS\r\nRULE_ERROR:INVALID_ARGS\r\n") != std::string::npos);
+  TEST_ASSERT_TRUE(esp32.sawLine("RULE_OK:K2"));
+
+  // ตัดสินทันทีหลังอ่าน CO2/อากาศสำเร็จ ไม่ต้องรอ ESP32
+  air->input[1] = 260;
+  halRunLoop(11000);
+  TEST_ASSERT_EQUAL_UINT8(LOW, halPinLevel(RELAY_K2_PIN));
+  TEST_ASSERT_TRUE(esp32.sawLine("RULE_SWITCH:K2,ON,260"));
+
+  // RELAY: สั่ง relay ที่มีกฎไม่ได้ และค่าในช่วง hysteresis คงสถานะเดิม
+  esp32.send("RELAY:00000000");
+  air->input[1] = 230;
+  halRunLoop(11000);
+  TEST_ASSERT_EQUAL_UINT8(LOW, halPinLevel(RELAY_K2_PIN));
+  air->input[1] = 215;
+  halRunLoop(11000);
+  TEST_ASSERT_EQUAL_UINT8(HIGH, halPinLevel(RELAY_K2_PIN));
+  TEST_ASSERT_TRUE(esp32.sawLine("RULE_SWITCH:K2,OFF,215"));
+
+  esp32.clear();
+  esp32.send("RULES");
+  halRunLoop(10);
+  TEST_ASSERT_TRUE(esp32.received.find("RULES:seq=1;K2=airTemp,250,220,0,0,OFF,2\r\n") != std::string::npos);
+
+  // ไฟดับ: กฎกลับมาจาก EEPROM ช่วงของตัวเอง
+  ruleEngine.clear(1);
+  restorePersistentState();
+  TEST_ASSERT_EQUAL_UINT8(0x02, ruleEngine.relayMask());
+  TEST_ASSERT_EQUAL_INT32(250, ruleEngine.rule(0).onValue);
+
+  esp32.clear();
+  esp32.send("RULE_CLEAR:K2");
+  esp32.send("RULE_CLEAR:K2");
+  esp32.send("RELAY:01000000");
+  halRunLoop(10);
+  TEST_ASSERT_TRUE(esp32.sawLine("RULE_CLEAR_OK:K2"));
+  TEST_ASSERT_TRUE(esp32.sawLine("RULE_ERROR:INVALID_ARGS"));
+  TEST_ASSERT_EQUAL_UINT8(LOW, halPinLevel(RELAY_K2_PIN));
+  air->input[1] = 253;
+}
+
+void test_relay_rules_skip_missing_water_measurements(void) {
+  SimModbusSlave* ph = sensors.slave(4);
+  esp32.send("RELAY:00000000");
+  esp32.send("RULE:K2,waterTemp,250,220,0,0");   // ทำความเย็นน้ำ
+  esp32.send("RULE:K3,ph,500,550,0,0");          // เปิดเมื่อค่าต่ำ (on < off)
+  ph->holding[0] = 260;
+  waitForRead(4);
+  TEST_ASSERT_EQUAL_UINT8(LOW, halPinLevel(RELAY_K2_PIN));
+  TEST_ASSERT_EQUAL_UINT8(HIGH, halPinLevel(RELAY_K3_PIN));
+
+  // หัววัดตอบแต่ไม่มีการวัด (raw <= 10 รายงานเป็น 0): relay คงสถานะเดิม
+  esp32.clear();
+  ph->holding[0] = 5;
+  ph->holding[1] = 5;
+  waitForRead(4);
+  waitForRead(4);
+  TEST_ASSERT_EQUAL_INT16(0, waterTemp);
+  TEST_ASSERT_EQUAL_UINT16(0, phValue);
+  TEST_ASSERT_EQUAL_UINT8(LOW, halPinLevel(RELAY_K2_PIN));
+  TEST_ASSERT_EQUAL_UINT8(HIGH, halPinLevel(RELAY_K3_PIN));
+  TEST_ASSERT_TRUE(esp32.received.find("RULE_SWITCH:") == std::string::npos);
+
+  ph->holding[0] = 215;
+  ph->holding[1] = 61;
+  waitForRead(4);
+  TEST_ASSERT_TRUE(esp32.sawLine("RULE_SWITCH:K2,OFF,215"));
+  esp32.send("RULE_CLEAR:K2");
+  esp32.send("RULE_CLEAR:K3");
+  halRunLoop(10);
+}
+
+int main(int argc, char** argv) {
+  halReset();
+
+  sensors.attach(Serial1);
+  SimModbusSlave* co2 = sensors.addSlave(1);
+  co2->input[1] = 253;   // 25.3 C
+  co2->input[2] = 655;   // 65.5 %
+  co2->input[3] = 812;   // ppm
+  SimModbusSlave* light = sensors.addSlave(2);
+  light->input[1] = 1234; // lux low word
+  SimModbusSlave* ec = sensors.addSlave(3);
+  ec->holding[1] = 1000;  // 100.0 (range 4400)
+  SimModbusSlave* ph = sensors.addSlave(4);
+  ph->holding[0] = 215;   // 21.5 C
+  ph->holding[1] = 61;    // pH 6.1
+
+  meterBus.attach(Serial3);
+  SimModbusSlave* meter = meterBus.addSlave(0xF8);
+  meter->input[0] = 2301;  // 230.1 V
+  meter->input[1] = 1500;  // 1.500 A (low word)
+  meter->input[3] = 3450;  // 345.0 W (low word)
+  meter->input[5] = 5698;  // 71234 Wh = 0x00011642 (low word)
+  meter->input[6] = 1;     // (high word)
+  meter->input[7] = 500;   // 50.0 Hz
+  meter->input[8] = 95;    // PF 0.95
+
+  halAttachPeripheral(serviceEsp32, &esp32);
+  setup();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_boot_handshake_and_relays_off);
+  RUN_TEST(test_binary_telemetry_carries_sensor_values);
+  RUN_TEST(test_sensor_polling_keeps_running_with_offline_slave);
+  RUN_TEST(test_poll_periods_adapt_to_sensor_changes);
+  RUN_TEST(test_energy_reset_goes_through_meter_bus);
+  RUN_TEST(test_ec_pump_pulse_is_exact);
+  RUN_TEST(test_relay_pattern_command);
+  RUN_TEST(test_concurrent_timed_relays);
+  RUN_TEST(test_stats_command_reports_stages);
+  RUN_TEST(test_delta_telemetry_sends_changes_and_alerts);
+  RUN_TEST(test_group_subscriptions_run_at_their_own_rate);
+  RUN_TEST(test_state_survives_reboot);
+  RUN_TEST(test_history_returns_minute_buckets);
+  RUN_TEST(test_single_ec_spike_is_filtered);
+  RUN_TEST(test_missing_ec_measurement_stays_out_of_filter);
+  RUN_TEST(test_batched_commands_apply_atomically);
+  RUN_TEST(test_link_quality_is_measured_passively);
+  RUN_TEST(test_events_are_queued_while_link_is_down);
+  RUN_TEST(test_dosing_controller_closes_the_loop);
+  RUN_TEST(test_dosing_waits_for_a_real_ec_measurement);
+  RUN_TEST(test_relay_rules_switch_after_each_read);
+  RUN_TEST(test_relay_rules_skip_missing_water_measurements);
+  return UNITY_END();
+}
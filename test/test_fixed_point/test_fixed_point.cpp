@@ -0,0 +1,91 @@
+#include <unity.h>
+#include <native_hal.h>
+#include <math.h>
+#include "fixed_point.h"
+#include "log.h"
+
+// === FIXED-POINT SENSOR CONVERSION ===
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_div_round_matches_lround(void) {
+  for (int32_t n = -1000; n <= 1000; n++) {
+    TEST_ASSERT_EQUAL_INT32(lround(n / 7.0), divRound(n, 7));
+    TEST_ASSERT_EQUAL_INT32(lround(n / 10.0), divRound(n, 10));
+  }
+  TEST_ASSERT_EQUAL_UINT32(3, divRoundUnsigned(5, 2));
+  TEST_ASSERT_EQUAL_UINT32(1, divRoundUnsigned(4, 3));
+  TEST_ASSERT_EQUAL_UINT32(2, divRoundUnsigned(5, 3));
+  TEST_ASSERT_EQUAL_UINT32(429496730UL, divRoundUnsigned(0xFFFFFFFFUL, 10));   // ไม่ล้นที่ขอบ 32 บิต
+}
+
+void test_constants_are_reduced_at_compile_time(void) {
+  typedef FixedConversion<15968, 1000> Slope;
+  TEST_ASSERT_EQUAL_INT32(1996, Slope::num);
+  TEST_ASSERT_EQUAL_INT32(125, Slope::den);
+  typedef FixedConversion<15968, 1000, -539130> Ec;   // ห.ร.ม. รวม offset ด้วย
+  TEST_ASSERT_EQUAL_INT32(7984, Ec::num);
+  TEST_ASSERT_EQUAL_INT32(500, Ec::den);
+  TEST_ASSERT_EQUAL_INT32(-269565, Ec::offset);
+  typedef FixedConversion<10> Ph;
+  TEST_ASSERT_EQUAL_INT32(10, Ph::num);
+  TEST_ASSERT_EQUAL_INT32(1, Ph::den);
+}
+
+// สมการ EC เดิม y = 15.968x - 53.913 (x = raw / 10) ในหน่วย µS/cm x10 ทุกค่า raw 16 บิต
+void test_ec_conversion_matches_float_equation(void) {
+  typedef FixedConversion<15968, 1000, -539130, 0, 50000> Ec;
+  for (uint32_t raw = 0; raw <= 0xFFFF; raw++) {
+    double y = 15.968 * (raw / 10.0) - 53.913;
+    int32_t expected = lround(y * 10);
+    if (expected < 0) expected = 0;
+    if (expected > 50000) expected = 50000;
+    TEST_ASSERT_EQUAL_INT32(expected, Ec::convert(raw));
+  }
+}
+
+void test_large_raw_does_not_overflow(void) {
+  // pulses x 1000 เกิน 32 บิตตั้งแต่ 4.3 ล้านพัลส์ แต่แยกผลหาร/เศษแล้วยังถูกต้อง
+  typedef FixedConversion<1000, 450> FlowVolume;
+  TEST_ASSERT_EQUAL_INT32(2, FlowVolume::convert(1));
+  TEST_ASSERT_EQUAL_INT32(1000, FlowVolume::convert(450));
+  TEST_ASSERT_EQUAL_INT32(222222222L, FlowVolume::convert(100000000L));
+  TEST_ASSERT_EQUAL_INT32(-5, (FixedConversion<1, 2>::convert(-9)));   // -4.5 ปัดออกจาก 0
+}
+
+void test_output_is_clamped(void) {
+  typedef FixedConversion<1, 1, 0, 0, 100> Percent;
+  TEST_ASSERT_EQUAL_INT32(0, Percent::convert(-3));
+  TEST_ASSERT_EQUAL_INT32(42, Percent::convert(42));
+  TEST_ASSERT_EQUAL_INT32(100, Percent::convert(250));
+}
+
+void test_rate_over_window(void) {
+  // flow: 450 พัลส์ต่อลิตร -> L/min x100
+  TEST_ASSERT_EQUAL_UINT32(100, (fixedRate<60000UL * 100, 450>(75, 10000)));   // 7.5 Hz = 1.00 L/min
+  TEST_ASSERT_EQUAL_UINT32(1000, (fixedRate<60000UL * 100, 450>(75, 1000)));
+  TEST_ASSERT_EQUAL_UINT32(1333, (fixedRate<60000UL * 100, 450>(100, 1000)));  // 13.333 -> 13.33
+  TEST_ASSERT_EQUAL_UINT32(0, (fixedRate<60000UL * 100, 450>(100, 0)));
+}
+
+void test_log_fixed_formats_without_float(void) {
+  TEST_ASSERT_EQUAL_STRING("25.3", logFixed(253, 1));
+  TEST_ASSERT_EQUAL_STRING("-0.5", logFixed(-5, 1));
+  TEST_ASSERT_EQUAL_STRING("6.05", logFixed(605, 2));
+  TEST_ASSERT_EQUAL_STRING("71234", logFixed(71234, 0));
+  TEST_ASSERT_EQUAL_STRING("-2147483648", logFixed(-2147483647L - 1, 0));
+  TEST_ASSERT_EQUAL_STRING("-2.147483648", logFixed(-2147483647L - 1, 9));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_div_round_matches_lround);
+  RUN_TEST(test_constants_are_reduced_at_compile_time);
+  RUN_TEST(test_ec_conversion_matches_float_equation);
+  RUN_TEST(test_large_raw_does_not_overflow);
+  RUN_TEST(test_output_is_clamped);
+  RUN_TEST(test_rate_over_window);
+  RUN_TEST(test_log_fixed_formats_without_float);
+  return UNITY_END();
+}
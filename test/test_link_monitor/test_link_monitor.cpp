@@ -0,0 +1,137 @@
+#include <unity.h>
+#include <native_hal.h>
+#include "link_monitor.h"
+
+// === ESP32 LINK MONITOR ===
+
+#define TIMEOUT 1000
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// probe ที่ได้คำตอบหลัง rtt ms (เริ่มที่ now แล้วเลื่อน now)
+static void answeredProbe(LinkMonitor& link, uint32_t& now, uint32_t rtt) {
+  link.probeSent(now);
+  now += rtt;
+  link.poll(now, TIMEOUT);
+  link.probeAnswered(now);
+}
+
+static void lostProbe(LinkMonitor& link, uint32_t& now) {
+  link.probeSent(now);
+  now += TIMEOUT;
+  link.poll(now, TIMEOUT);
+}
+
+void test_rtt_last_average_and_max(void) {
+  LinkMonitor link;
+  uint32_t now = 1000;
+  link.begin(now);
+  TEST_ASSERT_EQUAL_UINT16(0, link.rttAverageMs());
+
+  answeredProbe(link, now, 40);
+  TEST_ASSERT_EQUAL_UINT16(40, link.rttLastMs());
+  TEST_ASSERT_EQUAL_UINT16(40, link.rttAverageMs());          // ค่าแรกใช้ตรงๆ
+
+  answeredProbe(link, now, 120);
+  TEST_ASSERT_EQUAL_UINT16(120, link.rttLastMs());
+  TEST_ASSERT_EQUAL_UINT16(50, link.rttAverageMs());          // 40 + (120 - 40) / 8
+  TEST_ASSERT_EQUAL_UINT16(120, link.rttMaxMs());
+
+  answeredProbe(link, now, 10);
+  TEST_ASSERT_EQUAL_UINT16(120, link.rttMaxMs());
+  TEST_ASSERT_EQUAL_UINT32(3, link.probesSent());
+  TEST_ASSERT_EQUAL_UINT32(0, link.probesLost());
+  TEST_ASSERT_FALSE(link.degraded());
+}
+
+void test_timeout_counts_as_loss_and_late_answer_is_ignored(void) {
+  LinkMonitor link;
+  uint32_t now = 0;
+  link.begin(now);
+  answeredProbe(link, now, 30);
+
+  link.probeSent(now);
+  now += TIMEOUT - 1;
+  link.poll(now, TIMEOUT);
+  TEST_ASSERT_TRUE(link.probePending());
+  now += 1;
+  link.poll(now, TIMEOUT);
+  TEST_ASSERT_FALSE(link.probePending());
+  TEST_ASSERT_EQUAL_UINT32(1, link.probesLost());
+
+  // คำตอบที่มาช้า: นับเป็นบรรทัดที่ได้ยิน แต่ไม่ใช่ RTT
+  now += 500;
+  link.probeAnswered(now);
+  TEST_ASSERT_EQUAL_UINT16(30, link.rttLastMs());
+  TEST_ASSERT_EQUAL_UINT32(0, link.silenceMs(now));
+  TEST_ASSERT_EQUAL_UINT8(50, link.lossPercent());
+}
+
+void test_new_probe_while_pending_loses_the_old_one(void) {
+  LinkMonitor link;
+  link.begin(0);
+  link.probeSent(0);
+  link.probeSent(100);
+  TEST_ASSERT_EQUAL_UINT32(1, link.probesLost());
+  link.probeAnswered(150);
+  TEST_ASSERT_EQUAL_UINT16(50, link.rttLastMs());
+}
+
+void test_loss_is_measured_over_a_sliding_window(void) {
+  LinkMonitor link;
+  uint32_t now = 0;
+  link.begin(now);
+  for (uint8_t i = 0; i < 4; i++) {
+    lostProbe(link, now);
+  }
+  TEST_ASSERT_EQUAL_UINT8(100, link.lossPercent());
+  TEST_ASSERT_TRUE(link.degraded());
+
+  for (uint8_t i = 0; i < 12; i++) {
+    answeredProbe(link, now, 20);
+  }
+  TEST_ASSERT_EQUAL_UINT8(25, link.lossPercent());            // 4 ใน 16
+  TEST_ASSERT_TRUE(link.degraded());
+
+  answeredProbe(link, now, 20);                               // probe หายตัวแรกหลุดหน้าต่าง
+  TEST_ASSERT_EQUAL_UINT8(19, link.lossPercent());            // 3 ใน 16
+  TEST_ASSERT_FALSE(link.degraded());
+  TEST_ASSERT_EQUAL_UINT32(4, link.probesLost());
+}
+
+void test_slow_link_is_degraded(void) {
+  LinkMonitor link;
+  uint32_t now = 0;
+  link.begin(now);
+  answeredProbe(link, now, LINK_DEGRADED_RTT_MS - 1);
+  TEST_ASSERT_FALSE(link.degraded());
+  answeredProbe(link, now, LINK_DEGRADED_RTT_MS + 20);
+  TEST_ASSERT_TRUE(link.degraded());
+  TEST_ASSERT_EQUAL_UINT8(0, link.lossPercent());
+}
+
+void test_any_frame_resets_silence(void) {
+  LinkMonitor link;
+  link.begin(5000);
+  TEST_ASSERT_EQUAL_UINT32(3000, link.silenceMs(8000));      // ยังไม่เคยได้ยิน = นับจาก begin()
+  link.frameReceived(8000);
+  TEST_ASSERT_EQUAL_UINT32(0, link.silenceMs(8000));
+  TEST_ASSERT_EQUAL_UINT32(12000, link.silenceMs(20000));
+  TEST_ASSERT_FALSE(link.probePending());                     // คำสั่งทั่วไปไม่ใช่คำตอบของ probe
+
+  // millis() วน
+  link.frameReceived(0xFFFFFF00UL);
+  TEST_ASSERT_EQUAL_UINT32(0x200, link.silenceMs(0x100));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_rtt_last_average_and_max);
+  RUN_TEST(test_timeout_counts_as_loss_and_late_answer_is_ignored);
+  RUN_TEST(test_new_probe_while_pending_loses_the_old_one);
+  RUN_TEST(test_loss_is_measured_over_a_sliding_window);
+  RUN_TEST(test_slow_link_is_degraded);
+  RUN_TEST(test_any_frame_resets_silence);
+  return UNITY_END();
+}
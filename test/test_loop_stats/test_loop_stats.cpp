@@ -0,0 +1,115 @@
+#include <unity.h>
+#include <native_hal.h>
+#include <string>
+#include "loop_stats.h"
+
+// === LOOP STAGE TIMING ===
+
+// เก็บผลของ loopStatsPrint() เป็นข้อความ
+class CapturePrint : public Print {
+public:
+  size_t write(uint8_t b) override { text += (char)b; return 1; }
+  std::string text;
+};
+
+// จำลองขั้นที่ใช้เวลา durationUs
+static void runStage(uint8_t stage, uint32_t durationUs) {
+  uint32_t start = micros();
+  halAdvanceMicros(durationUs);
+  loopStatsEnd(stage, start);
+}
+
+void setUp(void) {
+  halReset();
+  loopStatsReset();
+}
+
+void tearDown(void) {}
+
+void test_bins_are_log2(void) {
+  TEST_ASSERT_EQUAL_UINT8(0, loopStatsBin(0));
+  TEST_ASSERT_EQUAL_UINT8(0, loopStatsBin(127));
+  TEST_ASSERT_EQUAL_UINT8(1, loopStatsBin(128));
+  TEST_ASSERT_EQUAL_UINT8(1, loopStatsBin(255));
+  TEST_ASSERT_EQUAL_UINT8(2, loopStatsBin(256));
+  TEST_ASSERT_EQUAL_UINT8(8, loopStatsBin(32767));
+  TEST_ASSERT_EQUAL_UINT8(9, loopStatsBin(32768));
+  TEST_ASSERT_EQUAL_UINT8(9, loopStatsBin(5000000));
+}
+
+void test_min_max_mean_and_histogram(void) {
+  loopStatsBeginPass();
+  runStage(STAGE_MODBUS, 100);
+  runStage(STAGE_MODBUS, 300);
+  runStage(STAGE_MODBUS, 2000);
+
+  const StageStats& s = loopStatsStage(STAGE_MODBUS);
+  TEST_ASSERT_EQUAL_UINT32(3, s.count);
+  TEST_ASSERT_EQUAL_UINT32(100, s.minUs);
+  TEST_ASSERT_EQUAL_UINT32(2000, s.maxUs);
+  TEST_ASSERT_EQUAL_UINT32(800, (uint32_t)(s.totalUs / s.count));
+  TEST_ASSERT_EQUAL_UINT16(1, s.histogram[0]);
+  TEST_ASSERT_EQUAL_UINT16(1, s.histogram[2]);
+  TEST_ASSERT_EQUAL_UINT16(1, s.histogram[4]);
+  TEST_ASSERT_EQUAL_UINT32(0, loopStatsStage(STAGE_SEND).count);
+}
+
+void test_pump_gap_tracks_worst_case(void) {
+  loopStatsBeginPass();
+  loopStatsPumpCheck();
+  halAdvanceMicros(500);
+  loopStatsPumpCheck();
+  halAdvanceMicros(45000);  // เช่น รอบที่ส่ง JSON
+  loopStatsPumpCheck();
+  halAdvanceMicros(700);
+  loopStatsPumpCheck();
+  TEST_ASSERT_EQUAL_UINT32(45000, loopStatsMaxPumpGapUs());
+}
+
+void test_discarded_pass_is_not_counted(void) {
+  uint32_t start = loopStatsBeginPass();
+  loopStatsPumpCheck();
+  runStage(STAGE_COMMANDS, 60000);  // พิมพ์ STATS
+  loopStatsDiscardPass();
+  runStage(STAGE_PUMP_TIMING, 10);
+  loopStatsPumpCheck();
+  loopStatsEnd(STAGE_LOOP, start);
+
+  TEST_ASSERT_EQUAL_UINT32(1, loopStatsStage(STAGE_COMMANDS).count);
+  TEST_ASSERT_EQUAL_UINT32(0, loopStatsStage(STAGE_PUMP_TIMING).count);
+  TEST_ASSERT_EQUAL_UINT32(0, loopStatsStage(STAGE_LOOP).count);
+  TEST_ASSERT_EQUAL_UINT32(0, loopStatsMaxPumpGapUs());
+
+  // รอบถัดไปนับตามปกติ
+  loopStatsBeginPass();
+  runStage(STAGE_PUMP_TIMING, 10);
+  TEST_ASSERT_EQUAL_UINT32(1, loopStatsStage(STAGE_PUMP_TIMING).count);
+}
+
+void test_print_format(void) {
+  loopStatsBeginPass();
+  runStage(STAGE_FLOW, 200);
+  halAdvanceMillis(1000);
+
+  CapturePrint out;
+  loopStatsPrint(out);
+  TEST_ASSERT_EQUAL_STRING(
+    "T=1000,GAP=0;COMM=0,0,0,0,0:0:0:0:0:0:0:0:0:0;MB=0,0,0,0,0:0:0:0:0:0:0:0:0:0"
+    ";FLOW=1,200,200,200,0:1:0:0:0:0:0:0:0:0;AC=0,0,0,0,0:0:0:0:0:0:0:0:0:0"
+    ";TX=0,0,0,0,0:0:0:0:0:0:0:0:0:0;RPL=0,0,0,0,0:0:0:0:0:0:0:0:0:0"
+    ";HIST=0,0,0,0,0:0:0:0:0:0:0:0:0:0;CMD=0,0,0,0,0:0:0:0:0:0:0:0:0:0"
+    ";PUMP=0,0,0,0,0:0:0:0:0:0:0:0:0:0;EEP=0,0,0,0,0:0:0:0:0:0:0:0:0:0"
+    ";LOG=0,0,0,0,0:0:0:0:0:0:0:0:0:0"
+    ";LOOP=0,0,0,0,0:0:0:0:0:0:0:0:0:0",
+    out.text.c_str());
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_bins_are_log2);
+  RUN_TEST(test_min_max_mean_and_histogram);
+  RUN_TEST(test_pump_gap_tracks_worst_case);
+  RUN_TEST(test_discarded_pass_is_not_counted);
+  RUN_TEST(test_print_format);
+  return UNITY_END();
+}
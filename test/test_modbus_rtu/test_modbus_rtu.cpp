@@ -0,0 +1,128 @@
+#include <unity.h>
+#include <native_hal.h>
+#include <sim_modbus.h>
+#include "modbus_rtu.h"
+
+// === MODBUS RTU MASTER ===
+// ModbusRtuMaster บน Serial1 จำลอง คุยกับ slave จำลอง (ID 1-4 เหมือนบอร์ดจริง)
+
+static SimModbusBus bus;
+static ModbusRtuMaster master;
+
+// เดินเวลาทีละ 100 us และ poll จนธุรกรรมจบ คืนเวลาที่ใช้ (ms)
+static uint32_t runTransaction(uint32_t limitMs = 1000) {
+  uint64_t start = halNowMicros();
+  while (halNowMicros() - start < (uint64_t)limitMs * 1000) {
+    if (master.poll()) {
+      return (uint32_t)((halNowMicros() - start) / 1000);
+    }
+    halAdvanceMicros(100);
+  }
+  TEST_FAIL_MESSAGE("transaction did not finish");
+  return 0;
+}
+
+void setUp(void) {
+  halReset();
+  bus.attach(Serial1);
+  for (uint8_t id = 1; id <= 4; id++) {
+    bus.addSlave(id);
+  }
+  master = ModbusRtuMaster();
+  master.begin(Serial1, 9600, 2, 3);
+}
+
+void tearDown(void) {}
+
+void test_read_input_registers(void) {
+  SimModbusSlave* co2 = bus.slave(1);
+  co2->input[0] = 655;   // humidity x10
+  co2->input[1] = 0xFF9C; // -10.0 C
+  co2->input[3] = 812;
+
+  TEST_ASSERT_TRUE(master.readInputRegisters(1, 0, 4));
+  runTransaction();
+
+  TEST_ASSERT_EQUAL_HEX8(ModbusRtuMaster::ku8MBSuccess, master.result());
+  TEST_ASSERT_EQUAL_UINT16(655, master.getResponseBuffer(0));
+  TEST_ASSERT_EQUAL_INT16(-100, (int16_t)master.getResponseBuffer(1));
+  TEST_ASSERT_EQUAL_UINT16(812, master.getResponseBuffer(3));
+  TEST_ASSERT_EQUAL_UINT16(0xFFFF, master.getResponseBuffer(4)); // นอกช่วง
+  TEST_ASSERT_EQUAL_UINT32(1, co2->requests);
+}
+
+void test_read_holding_registers(void) {
+  bus.slave(4)->holding[1] = 612;
+  TEST_ASSERT_TRUE(master.readHoldingRegisters(4, 0, 3));
+  runTransaction();
+  TEST_ASSERT_EQUAL_HEX8(ModbusRtuMaster::ku8MBSuccess, master.result());
+  TEST_ASSERT_EQUAL_UINT16(612, master.getResponseBuffer(1));
+  TEST_ASSERT_EQUAL_UINT32(0, bus.badFrames());
+}
+
+void test_rejects_request_while_busy(void) {
+  TEST_ASSERT_TRUE(master.readInputRegisters(1, 0, 4));
+  TEST_ASSERT_TRUE(master.isBusy());
+  TEST_ASSERT_FALSE(master.readInputRegisters(2, 1, 2));
+  runTransaction();
+  TEST_ASSERT_FALSE(master.isBusy());
+  TEST_ASSERT_EQUAL_UINT32(0, bus.slave(2)->requests);
+}
+
+void test_offline_slave_times_out(void) {
+  bus.slave(3)->online = false;
+  master.setResponseTimeout(200);
+  TEST_ASSERT_TRUE(master.readHoldingRegisters(3, 0, 2));
+  uint32_t elapsed = runTransaction();
+  TEST_ASSERT_EQUAL_HEX8(ModbusRtuMaster::ku8MBResponseTimedOut, master.result());
+  // silence + ส่ง 8 ไบต์ (~13 ms) + timeout 200 ms
+  TEST_ASSERT_UINT32_WITHIN(20, 210, elapsed);
+}
+
+void test_corrupted_crc_is_reported(void) {
+  bus.slave(2)->corruptNext = 1;
+  TEST_ASSERT_TRUE(master.readInputRegisters(2, 1, 2));
+  runTransaction();
+  TEST_ASSERT_EQUAL_HEX8(ModbusRtuMaster::ku8MBInvalidCRC, master.result());
+
+  // คำขอถัดไปกลับมาปกติ
+  TEST_ASSERT_TRUE(master.readInputRegisters(2, 1, 2));
+  runTransaction();
+  TEST_ASSERT_EQUAL_HEX8(ModbusRtuMaster::ku8MBSuccess, master.result());
+}
+
+void test_exception_response(void) {
+  bus.slave(1)->exceptionCode = ModbusRtuMaster::ku8MBSlaveDeviceFailure;
+  TEST_ASSERT_TRUE(master.readInputRegisters(1, 0, 4));
+  runTransaction();
+  TEST_ASSERT_EQUAL_HEX8(ModbusRtuMaster::ku8MBSlaveDeviceFailure, master.result());
+}
+
+void test_transaction_time_follows_wire_timing(void) {
+  // ไม่บล็อก: เวลารวม ~ silence 4 ms + คำขอ 9 ms + latency 10 ms + คำตอบ 15 ไบต์ 17 ms
+  TEST_ASSERT_TRUE(master.readInputRegisters(1, 0, 4));
+  uint32_t elapsed = runTransaction();
+  TEST_ASSERT_EQUAL_HEX8(ModbusRtuMaster::ku8MBSuccess, master.result());
+  TEST_ASSERT_UINT32_WITHIN(6, 40, elapsed);
+}
+
+void test_de_re_released_after_transmit(void) {
+  TEST_ASSERT_TRUE(master.readInputRegisters(1, 0, 4));
+  runTransaction();
+  TEST_ASSERT_EQUAL_UINT8(LOW, halPinLevel(2));
+  TEST_ASSERT_EQUAL_UINT8(LOW, halPinLevel(3));
+  TEST_ASSERT_GREATER_OR_EQUAL(2, halPinWriteCount(2)); // เปิดส่งแล้วปล่อยกลับ
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_read_input_registers);
+  RUN_TEST(test_read_holding_registers);
+  RUN_TEST(test_rejects_request_while_busy);
+  RUN_TEST(test_offline_slave_times_out);
+  RUN_TEST(test_corrupted_crc_is_reported);
+  RUN_TEST(test_exception_response);
+  RUN_TEST(test_transaction_time_follows_wire_timing);
+  RUN_TEST(test_de_re_released_after_transmit);
+  return UNITY_END();
+}
@@ -0,0 +1,132 @@
+#include <unity.h>
+#include <native_hal.h>
+#include "outbound_queue.h"
+
+// === STORE-AND-FORWARD QUEUE ===
+
+enum { KIND_EVENT, KIND_SNAPSHOT };
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static uint16_t pushValue(OutboundQueue& queue, uint8_t priority, uint8_t value) {
+  uint8_t kind = priority == OUTBOUND_ROUTINE ? KIND_SNAPSHOT : KIND_EVENT;
+  return queue.push(kind, priority, &value, 1, value * 100UL);
+}
+
+// ค่าของ record ตามลำดับในคิว (ลบออกทีละตัวด้วย ACK)
+static void expectOrder(OutboundQueue& queue, const uint8_t* values, uint8_t count) {
+  TEST_ASSERT_EQUAL_UINT8(count, queue.size());
+  for (uint8_t i = 0; i < count; i++) {
+    const OutboundRecord* record = queue.front();
+    TEST_ASSERT_NOT_NULL(record);
+    TEST_ASSERT_EQUAL_UINT8(values[i], record->payload[0]);
+    TEST_ASSERT_EQUAL_UINT8(1, queue.acknowledge(record->sequence));
+  }
+  TEST_ASSERT_TRUE(queue.empty());
+}
+
+void test_records_keep_order_and_payload(void) {
+  OutboundQueue queue;
+  TEST_ASSERT_NULL(queue.front());
+  TEST_ASSERT_EQUAL_UINT16(0, queue.lastSequence());
+
+  uint8_t frame[OUTBOUND_PAYLOAD_MAX];
+  for (uint8_t i = 0; i < sizeof(frame); i++) {
+    frame[i] = i + 1;
+  }
+  TEST_ASSERT_EQUAL_UINT16(1, queue.push(KIND_SNAPSHOT, OUTBOUND_ROUTINE, frame, sizeof(frame), 5000));
+  TEST_ASSERT_EQUAL_UINT16(2, pushValue(queue, OUTBOUND_CRITICAL, 7));
+
+  const OutboundRecord* record = queue.front();
+  TEST_ASSERT_EQUAL_UINT16(1, record->sequence);
+  TEST_ASSERT_EQUAL_UINT8(KIND_SNAPSHOT, record->kind);
+  TEST_ASSERT_EQUAL_UINT32(5000, record->queuedMs);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(frame, record->payload, sizeof(frame));
+
+  TEST_ASSERT_EQUAL_UINT8(1, queue.acknowledge(1));
+  record = queue.front();
+  TEST_ASSERT_EQUAL_UINT16(2, record->sequence);
+  TEST_ASSERT_EQUAL_UINT8(KIND_EVENT, record->kind);
+  TEST_ASSERT_EQUAL_UINT8(7, record->payload[0]);
+  TEST_ASSERT_EQUAL_UINT8(0, record->payload[1]);          // ส่วนที่เหลือของ payload เป็น 0
+}
+
+void test_ack_is_cumulative(void) {
+  OutboundQueue queue;
+  for (uint8_t i = 0; i < 5; i++) {
+    pushValue(queue, OUTBOUND_CRITICAL, i);
+  }
+  TEST_ASSERT_EQUAL_UINT8(3, queue.acknowledge(3));
+  TEST_ASSERT_EQUAL_UINT8(0, queue.acknowledge(2));          // ACK ซ้ำ/เก่า ไม่มีผล
+  TEST_ASSERT_EQUAL_UINT16(4, queue.front()->sequence);
+  TEST_ASSERT_EQUAL_UINT8(2, queue.acknowledge(9));
+  TEST_ASSERT_TRUE(queue.empty());
+}
+
+void test_events_push_out_snapshots_when_full(void) {
+  OutboundQueue queue;
+  for (uint8_t i = 0; i < OUTBOUND_QUEUE_SLOTS; i++) {
+    pushValue(queue, i < 3 ? OUTBOUND_CRITICAL : OUTBOUND_ROUTINE, i);
+  }
+  // snapshot ใหม่แทนที่ snapshot เก่าสุด เหตุการณ์ใหม่ก็แทนที่ snapshot เก่าสุดเช่นกัน
+  TEST_ASSERT_TRUE(pushValue(queue, OUTBOUND_ROUTINE, 10) != 0);
+  TEST_ASSERT_TRUE(pushValue(queue, OUTBOUND_CRITICAL, 11) != 0);
+  TEST_ASSERT_EQUAL_UINT16(2, queue.dropped());
+
+  const uint8_t expected[] = {0, 1, 2, 5, 6, 7, 8, 9, 10, 11};
+  expectOrder(queue, expected, sizeof(expected));
+}
+
+void test_critical_events_are_never_displaced_by_lower_priority(void) {
+  OutboundQueue queue;
+  for (uint8_t i = 0; i < OUTBOUND_QUEUE_SLOTS; i++) {
+    pushValue(queue, i % 2 ? OUTBOUND_STATUS : OUTBOUND_CRITICAL, i);
+  }
+  TEST_ASSERT_EQUAL_UINT16(0, pushValue(queue, OUTBOUND_ROUTINE, 20));   // snapshot ถูกทิ้งเอง
+  TEST_ASSERT_TRUE(pushValue(queue, OUTBOUND_STATUS, 21) != 0);          // แทน status เก่าสุด (1)
+  TEST_ASSERT_TRUE(pushValue(queue, OUTBOUND_CRITICAL, 22) != 0);        // แทน status เก่าสุด (3)
+  TEST_ASSERT_EQUAL_UINT16(3, queue.dropped());
+
+  const uint8_t expected[] = {0, 2, 4, 5, 6, 7, 8, 9, 21, 22};
+  expectOrder(queue, expected, sizeof(expected));
+}
+
+void test_full_of_critical_events_drops_the_oldest(void) {
+  OutboundQueue queue;
+  for (uint8_t i = 0; i < OUTBOUND_QUEUE_SLOTS + 2; i++) {
+    TEST_ASSERT_TRUE(pushValue(queue, OUTBOUND_CRITICAL, i) != 0);
+  }
+  TEST_ASSERT_EQUAL_UINT16(2, queue.dropped());
+  TEST_ASSERT_EQUAL_UINT8(2, queue.front()->payload[0]);
+}
+
+void test_sequence_wraps_without_zero(void) {
+  OutboundQueue queue;
+  uint16_t last = 0;
+  for (uint32_t i = 0; i < 65540UL; i++) {
+    last = pushValue(queue, OUTBOUND_CRITICAL, 1);
+    TEST_ASSERT_TRUE(last != 0);
+    if (i % 4 == 3) {
+      queue.acknowledge(last);
+    }
+  }
+  // record ที่ค้างอยู่ข้ามจุดวน 65535 -> 1 ได้
+  queue.acknowledge(65535);
+  pushValue(queue, OUTBOUND_CRITICAL, 2);
+  pushValue(queue, OUTBOUND_CRITICAL, 3);
+  uint8_t pending = queue.size();
+  TEST_ASSERT_EQUAL_UINT8(pending, queue.acknowledge(queue.lastSequence()));
+  TEST_ASSERT_TRUE(queue.empty());
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_records_keep_order_and_payload);
+  RUN_TEST(test_ack_is_cumulative);
+  RUN_TEST(test_events_push_out_snapshots_when_full);
+  RUN_TEST(test_critical_events_are_never_displaced_by_lower_priority);
+  RUN_TEST(test_full_of_critical_events_drops_the_oldest);
+  RUN_TEST(test_sequence_wraps_without_zero);
+  return UNITY_END();
+}
@@ -0,0 +1,125 @@
+#include <unity.h>
+#include <native_hal.h>
+#include "poll_scheduler.h"
+
+// === ADAPTIVE BUS POLLING SCHEDULER ===
+
+// min, max, priority, jitter, threshold, band, delta
+static const PollConfig FAST_IMPORTANT = {1000, 4000, 0, 100, 0, 0, 0};
+static const PollConfig SLOW_MINOR = {1000, 4000, 2, 500, 0, 0, 0};
+
+void setUp(void) {
+  halReset();
+}
+
+void tearDown(void) {}
+
+void test_new_jobs_are_due_immediately_in_priority_order(void) {
+  PollScheduler scheduler;
+  uint8_t minor = scheduler.add(SLOW_MINOR);
+  uint8_t important = scheduler.add(FAST_IMPORTANT);
+
+  TEST_ASSERT_EQUAL_UINT8(important, scheduler.next(millis()));
+  scheduler.started(important, millis());
+  TEST_ASSERT_EQUAL_UINT8(minor, scheduler.next(millis()));
+  scheduler.started(minor, millis());
+  TEST_ASSERT_EQUAL_UINT8(POLL_NONE, scheduler.next(millis()));
+  TEST_ASSERT_EQUAL_UINT8(POLL_NONE, scheduler.next(millis() + 999));
+  TEST_ASSERT_EQUAL_UINT8(important, scheduler.next(millis() + 1000));
+}
+
+void test_stable_value_stretches_period_to_max(void) {
+  PollScheduler scheduler;
+  uint8_t job = scheduler.add(FAST_IMPORTANT);
+  TEST_ASSERT_EQUAL_UINT32(1000, scheduler.periodMs(job));
+
+  const uint32_t expected[] = {1250, 1562, 1952, 2440, 3050, 3812, 4000, 4000};
+  for (uint8_t i = 0; i < 8; i++) {
+    scheduler.started(job, millis());
+    scheduler.reportValue(job, 100);
+    TEST_ASSERT_EQUAL_UINT32(expected[i], scheduler.periodMs(job));
+  }
+}
+
+void test_fast_change_returns_to_min_period(void) {
+  PollConfig config = FAST_IMPORTANT;
+  config.deltaThreshold = 10;
+  PollScheduler scheduler;
+  uint8_t job = scheduler.add(config);
+  for (uint8_t i = 0; i < 10; i++) {
+    scheduler.reportValue(job, 100 + i);   // เปลี่ยนทีละ 1 < delta
+  }
+  TEST_ASSERT_EQUAL_UINT32(4000, scheduler.periodMs(job));
+
+  scheduler.started(job, 0);
+  scheduler.reportValue(job, 130);
+  TEST_ASSERT_EQUAL_UINT32(1000, scheduler.periodMs(job));
+  TEST_ASSERT_EQUAL_UINT8(job, scheduler.next(1000));      // ครั้งถัดไปใช้คาบใหม่ทันที
+}
+
+void test_near_threshold_holds_min_period(void) {
+  PollConfig config = FAST_IMPORTANT;
+  config.threshold = 500;
+  config.band = 50;
+  PollScheduler scheduler;
+  uint8_t job = scheduler.add(config);
+  for (uint8_t i = 0; i < 5; i++) {
+    scheduler.reportValue(job, 460);
+  }
+  TEST_ASSERT_EQUAL_UINT32(1000, scheduler.periodMs(job));
+  scheduler.reportValue(job, 449);
+  TEST_ASSERT_EQUAL_UINT32(1250, scheduler.periodMs(job));
+}
+
+void test_job_past_jitter_budget_overtakes_priority(void) {
+  PollConfig minorConfig = SLOW_MINOR;
+  minorConfig.jitterMs = 300;
+  PollScheduler scheduler;
+  uint8_t important = scheduler.add(FAST_IMPORTANT);
+  uint8_t minor = scheduler.add(minorConfig);
+
+  // งานรองรอมา 210 ms (ยังอยู่ในงบ) -> งานสำคัญได้ก่อน
+  scheduler.started(important, 400);
+  scheduler.started(minor, 200);
+  TEST_ASSERT_EQUAL_UINT8(important, scheduler.next(1410));
+
+  // งานรองรอมา 410 ms (เกินงบ 300) -> ได้ไปก่อนแม้ priority ต่ำกว่า
+  scheduler.started(minor, 0);
+  TEST_ASSERT_EQUAL_UINT8(minor, scheduler.next(1410));
+}
+
+void test_configure_clamps_running_period(void) {
+  PollScheduler scheduler;
+  uint8_t job = scheduler.add(FAST_IMPORTANT);
+  for (uint8_t i = 0; i < 10; i++) {
+    scheduler.reportValue(job, 1);
+  }
+  scheduler.started(job, millis());
+  TEST_ASSERT_EQUAL_UINT32(4000, scheduler.periodMs(job));
+
+  PollConfig config = FAST_IMPORTANT;
+  config.maxPeriodMs = 2000;
+  scheduler.configure(job, config);
+  TEST_ASSERT_EQUAL_UINT32(2000, scheduler.periodMs(job));
+  TEST_ASSERT_EQUAL_UINT8(job, scheduler.next(millis() + 2000));
+}
+
+void test_table_is_bounded(void) {
+  PollScheduler scheduler;
+  for (uint8_t i = 0; i < POLL_MAX_JOBS; i++) {
+    TEST_ASSERT_EQUAL_UINT8(i, scheduler.add(SLOW_MINOR));
+  }
+  TEST_ASSERT_EQUAL_UINT8(POLL_NONE, scheduler.add(SLOW_MINOR));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_new_jobs_are_due_immediately_in_priority_order);
+  RUN_TEST(test_stable_value_stretches_period_to_max);
+  RUN_TEST(test_fast_change_returns_to_min_period);
+  RUN_TEST(test_near_threshold_holds_min_period);
+  RUN_TEST(test_job_past_jitter_budget_overtakes_priority);
+  RUN_TEST(test_configure_clamps_running_period);
+  RUN_TEST(test_table_is_bounded);
+  return UNITY_END();
+}
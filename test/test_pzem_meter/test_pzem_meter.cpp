@@ -0,0 +1,135 @@
+#include <unity.h>
+#include <native_hal.h>
+#include <sim_modbus.h>
+#include "pzem_meter.h"
+
+// === PZEM-004T DRIVER ===
+// PzemMeter บน Serial3 จำลอง (address 0xF8) และ Modbus master อีกตัวบน Serial1 เพื่อดูว่าทำงานพร้อมกันได้
+
+static SimModbusBus meterBus;
+static SimModbusBus sensorBus;
+static PzemMeter meter;
+static ModbusRtuMaster sensors;
+
+// เดินเวลาทีละ 100 us จน meter.poll() รายงานธุรกรรมจบ
+static void runMeter(uint32_t limitMs = 1000) {
+  uint64_t start = halNowMicros();
+  while (halNowMicros() - start < (uint64_t)limitMs * 1000) {
+    if (meter.poll()) {
+      return;
+    }
+    halAdvanceMicros(100);
+  }
+  TEST_FAIL_MESSAGE("transaction did not finish");
+}
+
+void setUp(void) {
+  halReset();
+  meterBus.attach(Serial3);
+  SimModbusSlave* pzem = meterBus.addSlave(PZEM_DEFAULT_ADDRESS);
+  pzem->input[0] = 2301;   // 230.1 V
+  pzem->input[1] = 0x86A0; // 100.000 A = 100000 mA (low word)
+  pzem->input[2] = 0x0001; // (high word)
+  pzem->input[3] = 3450;   // 345.0 W
+  pzem->input[5] = 5698;   // 71234 Wh (low word)
+  pzem->input[6] = 1;      // (high word)
+  pzem->input[7] = 499;    // 49.9 Hz
+  pzem->input[8] = 95;     // PF 0.95
+  pzem->input[9] = 0xFFFF; // alarm
+  meter = PzemMeter();
+  meter.begin(Serial3);
+}
+
+void tearDown(void) {}
+
+void test_one_request_reads_all_values(void) {
+  TEST_ASSERT_TRUE(meter.requestRead());
+  TEST_ASSERT_FALSE(meter.requestRead());   // ธุรกรรมค้างอยู่
+  runMeter();
+
+  TEST_ASSERT_EQUAL(PzemMeter::OP_READ, meter.completed());
+  TEST_ASSERT_EQUAL_HEX8(ModbusRtuMaster::ku8MBSuccess, meter.result());
+  TEST_ASSERT_EQUAL_UINT32(1, meterBus.slave(PZEM_DEFAULT_ADDRESS)->requests);
+
+  const PzemReading& reading = meter.reading();
+  TEST_ASSERT_EQUAL_UINT16(2301, reading.voltage);
+  TEST_ASSERT_EQUAL_UINT32(100000, reading.current);
+  TEST_ASSERT_EQUAL_UINT32(3450, reading.power);
+  TEST_ASSERT_EQUAL_UINT32(71234, reading.energy);
+  TEST_ASSERT_EQUAL_UINT16(499, reading.frequency);
+  TEST_ASSERT_EQUAL_UINT8(95, reading.pf);
+  TEST_ASSERT_TRUE(reading.alarm);
+}
+
+void test_energy_reset_waits_for_running_read(void) {
+  SimModbusSlave* pzem = meterBus.slave(PZEM_DEFAULT_ADDRESS);
+  TEST_ASSERT_TRUE(meter.requestRead());
+  meter.requestEnergyReset();
+  TEST_ASSERT_TRUE(meter.isBusy());
+
+  runMeter();
+  TEST_ASSERT_EQUAL(PzemMeter::OP_READ, meter.completed());
+  TEST_ASSERT_EQUAL_UINT32(71234, meter.reading().energy);
+
+  runMeter();
+  TEST_ASSERT_EQUAL(PzemMeter::OP_RESET_ENERGY, meter.completed());
+  TEST_ASSERT_EQUAL_HEX8(ModbusRtuMaster::ku8MBSuccess, meter.result());
+  TEST_ASSERT_EQUAL_UINT32(1, pzem->energyResets);
+  TEST_ASSERT_FALSE(meter.isBusy());
+
+  TEST_ASSERT_TRUE(meter.requestRead());
+  runMeter();
+  TEST_ASSERT_EQUAL_UINT32(0, meter.reading().energy);
+  TEST_ASSERT_EQUAL_UINT32(0, meterBus.badFrames());
+}
+
+void test_offline_meter_times_out_and_keeps_last_values(void) {
+  TEST_ASSERT_TRUE(meter.requestRead());
+  runMeter();
+  meterBus.slave(PZEM_DEFAULT_ADDRESS)->online = false;
+
+  TEST_ASSERT_TRUE(meter.requestRead());
+  runMeter();
+  TEST_ASSERT_EQUAL_HEX8(ModbusRtuMaster::ku8MBResponseTimedOut, meter.result());
+  TEST_ASSERT_FALSE(meter.isBusy());
+  TEST_ASSERT_EQUAL_UINT16(2301, meter.reading().voltage);
+}
+
+void test_meter_and_sensor_bus_run_concurrently(void) {
+  sensorBus.attach(Serial1);
+  SimModbusSlave* ec = sensorBus.addSlave(3);
+  ec->holding[1] = 1000;
+  ec->latencyMs = 100;
+  meterBus.slave(PZEM_DEFAULT_ADDRESS)->latencyMs = 100;
+  sensors = ModbusRtuMaster();
+  sensors.begin(Serial1, 9600, 2, 3);
+
+  TEST_ASSERT_TRUE(sensors.readHoldingRegisters(3, 0, 2));
+  TEST_ASSERT_TRUE(meter.requestRead());
+
+  // แต่ละธุรกรรมใช้ > 100 ms ถ้าทำต่อกันจะเกิน 200 ms
+  bool sensorDone = false;
+  bool meterDone = false;
+  uint64_t start = halNowMicros();
+  while ((!sensorDone || !meterDone) && halNowMicros() - start < 1000000) {
+    sensorDone |= sensors.poll();
+    meterDone |= meter.poll();
+    halAdvanceMicros(100);
+  }
+  uint32_t elapsedMs = (uint32_t)((halNowMicros() - start) / 1000);
+
+  TEST_ASSERT_TRUE(sensorDone && meterDone);
+  TEST_ASSERT_EQUAL_HEX8(ModbusRtuMaster::ku8MBSuccess, sensors.result());
+  TEST_ASSERT_EQUAL_HEX8(ModbusRtuMaster::ku8MBSuccess, meter.result());
+  TEST_ASSERT_EQUAL_UINT16(1000, sensors.getResponseBuffer(1));
+  TEST_ASSERT_TRUE(elapsedMs < 200);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_one_request_reads_all_values);
+  RUN_TEST(test_energy_reset_waits_for_running_read);
+  RUN_TEST(test_offline_meter_times_out_and_keeps_last_values);
+  RUN_TEST(test_meter_and_sensor_bus_run_concurrently);
+  return UNITY_END();
+}
@@ -0,0 +1,82 @@
+#include <unity.h>
+#include <native_hal.h>
+#include "relay_driver.h"
+
+// === ATOMIC RELAY DRIVER ===
+
+static const int pins[8] = {26, 28, 30, 27, 33, 31, 29, 32};
+static const bool activeHigh[8] = {true, false, false, false, false, false, false, false};
+
+// ระดับขาที่หมายถึง "เปิด" ของ relay แต่ละตัว
+static uint8_t onLevel(uint8_t relay) {
+  return activeHigh[relay] ? HIGH : LOW;
+}
+
+void setUp(void) {
+  halReset();
+  relayDriverBegin(pins, activeHigh, 8);
+}
+
+void tearDown(void) {}
+
+void test_begin_drives_all_relays_off(void) {
+  TEST_ASSERT_EQUAL_HEX8(0x00, relayStateMask());
+  for (uint8_t i = 0; i < 8; i++) {
+    TEST_ASSERT_EQUAL_UINT8(OUTPUT, halPinMode(pins[i]));
+    TEST_ASSERT_NOT_EQUAL(onLevel(i), halPinLevel(pins[i]));
+  }
+}
+
+void test_apply_pattern_respects_polarity(void) {
+  relayApply(0xFF, 0x41);   // K1 + K7
+  TEST_ASSERT_EQUAL_HEX8(0x41, relayStateMask());
+  TEST_ASSERT_EQUAL_UINT8(HIGH, halPinLevel(pins[0]));  // K1 active high
+  TEST_ASSERT_EQUAL_UINT8(LOW, halPinLevel(pins[6]));   // K7 active low
+  TEST_ASSERT_EQUAL_UINT8(HIGH, halPinLevel(pins[1]));  // K2 ปิด
+  TEST_ASSERT_TRUE(relayIsOn(0));
+  TEST_ASSERT_FALSE(relayIsOn(1));
+}
+
+void test_change_mask_keeps_other_relays(void) {
+  relayApply(0xFF, 0x60);   // K6 + K7 (ปั๊ม)
+  relayApply(0x9F, 0x01);   // pattern ที่ไม่แตะ K6/K7
+  TEST_ASSERT_EQUAL_HEX8(0x61, relayStateMask());
+  TEST_ASSERT_EQUAL_UINT8(onLevel(5), halPinLevel(pins[5]));
+  TEST_ASSERT_EQUAL_UINT8(onLevel(6), halPinLevel(pins[6]));
+}
+
+void test_set_single_relay(void) {
+  relaySet(4, true);
+  TEST_ASSERT_EQUAL_HEX8(0x10, relayStateMask());
+  relaySet(4, false);
+  TEST_ASSERT_EQUAL_HEX8(0x00, relayStateMask());
+  relaySet(8, true);        // นอกช่วง
+  TEST_ASSERT_EQUAL_HEX8(0x00, relayStateMask());
+}
+
+void test_pattern_changes_without_time_passing(void) {
+  uint64_t before = halNowMicros();
+  relayApply(0xFF, 0xFF);
+  TEST_ASSERT_TRUE(before == halNowMicros());
+  for (uint8_t i = 0; i < 8; i++) {
+    TEST_ASSERT_EQUAL_UINT8(onLevel(i), halPinLevel(pins[i]));
+  }
+}
+
+void test_count_limits_valid_relays(void) {
+  relayDriverBegin(pins, activeHigh, 3);
+  relayApply(0xFF, 0xFF);
+  TEST_ASSERT_EQUAL_HEX8(0x07, relayStateMask());
+  TEST_ASSERT_FALSE(relayIsOn(3));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_begin_drives_all_relays_off);
+  RUN_TEST(test_apply_pattern_respects_polarity);
+  RUN_TEST(test_change_mask_keeps_other_relays);
+  RUN_TEST(test_set_single_relay);
+  RUN_TEST(test_pattern_changes_without_time_passing);
+  RUN_TEST(test_count_limits_valid_relays);
+  return UNITY_END();
+}
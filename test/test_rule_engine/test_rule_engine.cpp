@@ -0,0 +1,131 @@
+#include <unity.h>
+#include <native_hal.h>
+#include "rule_engine.h"
+
+// === LOCAL RELAY RULES ===
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// K2 ทำความเย็น: ON ที่ 25.0 °C, OFF ที่ 22.0 °C (airTemp x10 = field 2)
+static const RelayRule COOLER = {2, 1, 250, 220, 0, 0};
+
+static bool step(RuleEngine& engine, int32_t value, bool& relayOn, uint32_t nowMs) {
+  bool turnOn = false;
+  if (engine.evaluate(0, value, relayOn, nowMs, turnOn)) {
+    relayOn = turnOn;
+    return true;
+  }
+  return false;
+}
+
+void test_hysteresis_band_holds_state(void) {
+  RuleEngine engine;
+  TEST_ASSERT_TRUE(engine.set(COOLER));
+  bool on = false;
+  TEST_ASSERT_FALSE(step(engine, 240, on, 1000));
+  TEST_ASSERT_TRUE(step(engine, 251, on, 2000));
+  TEST_ASSERT_TRUE(on);
+  TEST_ASSERT_FALSE(step(engine, 230, on, 3000));            // อยู่ในช่วง: ยังเปิด
+  TEST_ASSERT_TRUE(step(engine, 220, on, 4000));
+  TEST_ASSERT_FALSE(on);
+  TEST_ASSERT_FALSE(step(engine, 245, on, 5000));            // อยู่ในช่วง: ยังปิด
+  TEST_ASSERT_EQUAL_UINT16(2, engine.switches(0));
+}
+
+void test_inverse_rule_turns_on_when_low(void) {
+  RuleEngine engine;
+  RelayRule humidifier = {3, 4, 600, 700, 0, 0};             // ความชื้น x10: ON <= 60 %, OFF >= 70 %
+  TEST_ASSERT_TRUE(engine.set(humidifier));
+  bool on = false;
+  TEST_ASSERT_TRUE(step(engine, 590, on, 1000));
+  TEST_ASSERT_TRUE(on);
+  TEST_ASSERT_FALSE(step(engine, 650, on, 2000));
+  TEST_ASSERT_TRUE(step(engine, 700, on, 3000));
+  TEST_ASSERT_FALSE(on);
+}
+
+void test_minimum_on_and_off_times(void) {
+  RuleEngine engine;
+  RelayRule compressor = COOLER;
+  compressor.minOnSeconds = 60;
+  compressor.minOffSeconds = 180;
+  engine.set(compressor);
+  bool on = false;
+  TEST_ASSERT_TRUE(step(engine, 260, on, 1000));             // กฎใหม่: สลับได้ทันที
+
+  TEST_ASSERT_FALSE(step(engine, 210, on, 30000));           // เปิดมา 29 s
+  TEST_ASSERT_TRUE(engine.waiting(0));
+  TEST_ASSERT_TRUE(on);
+  TEST_ASSERT_TRUE(step(engine, 210, on, 61000));
+  TEST_ASSERT_FALSE(on);
+  TEST_ASSERT_FALSE(engine.waiting(0));
+
+  TEST_ASSERT_FALSE(step(engine, 260, on, 200000));          // ปิดมา 139 s
+  TEST_ASSERT_TRUE(engine.waiting(0));
+  TEST_ASSERT_FALSE(step(engine, 240, on, 230000));          // กลับเข้าช่วง: ไม่ต้องรอแล้ว
+  TEST_ASSERT_FALSE(engine.waiting(0));
+  TEST_ASSERT_TRUE(step(engine, 260, on, 241000));
+  TEST_ASSERT_TRUE(on);
+}
+
+void test_restart_applies_minimum_off_time(void) {
+  RuleEngine engine;
+  RelayRule compressor = COOLER;
+  compressor.minOffSeconds = 180;
+  engine.set(compressor);
+  engine.restartTimers(500);                                 // บูต: relay ดับไปพร้อมไฟ
+  bool on = false;
+  TEST_ASSERT_FALSE(step(engine, 260, on, 1000));
+  TEST_ASSERT_TRUE(engine.waiting(0));
+  TEST_ASSERT_TRUE(step(engine, 260, on, 180500));
+  TEST_ASSERT_TRUE(on);
+}
+
+void test_one_rule_per_relay_and_table_limit(void) {
+  RuleEngine engine;
+  TEST_ASSERT_TRUE(engine.set(COOLER));
+  RelayRule replacement = COOLER;
+  replacement.onValue = 270;
+  TEST_ASSERT_TRUE(engine.set(replacement));                 // relay เดิม: แทนที่
+  TEST_ASSERT_EQUAL_INT32(270, engine.rule(0).onValue);
+  TEST_ASSERT_EQUAL_UINT8(0x02, engine.relayMask());
+
+  for (uint8_t relay = 2; relay < 2 + RULE_MAX - 1; relay++) {
+    RelayRule rule = {5, relay, 100, 50, 0, 0};
+    TEST_ASSERT_TRUE(engine.set(rule));
+  }
+  RelayRule extra = {5, 7, 100, 50, 0, 0};
+  TEST_ASSERT_FALSE(engine.set(extra));
+  TEST_ASSERT_EQUAL_UINT32((1UL << 2) | (1UL << 5), engine.fieldMask());
+
+  TEST_ASSERT_TRUE(engine.clear(1));
+  TEST_ASSERT_FALSE(engine.clear(1));
+  TEST_ASSERT_TRUE(engine.set(extra));
+  TEST_ASSERT_EQUAL_UINT8(0x80 | 0x1C, engine.relayMask());
+}
+
+void test_validation(void) {
+  RelayRule noBand = {2, 1, 250, 250, 0, 0};
+  RelayRule badRelay = {2, 8, 250, 220, 0, 0};
+  RelayRule empty = {RULE_NONE, 1, 250, 220, 0, 0};
+  TEST_ASSERT_TRUE(RuleEngine::valid(COOLER));
+  TEST_ASSERT_FALSE(RuleEngine::valid(noBand));
+  TEST_ASSERT_FALSE(RuleEngine::valid(badRelay));
+  TEST_ASSERT_FALSE(RuleEngine::valid(empty));
+
+  RuleEngine engine;
+  bool turnOn = false;
+  TEST_ASSERT_FALSE(engine.evaluate(0, 999, false, 0, turnOn));   // ช่องว่าง
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_hysteresis_band_holds_state);
+  RUN_TEST(test_inverse_rule_turns_on_when_low);
+  RUN_TEST(test_minimum_on_and_off_times);
+  RUN_TEST(test_restart_applies_minimum_off_time);
+  RUN_TEST(test_one_rule_per_relay_and_table_limit);
+  RUN_TEST(test_validation);
+  return UNITY_END();
+}
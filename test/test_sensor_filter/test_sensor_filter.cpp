@@ -0,0 +1,124 @@
+#include <unity.h>
+#include <native_hal.h>
+#include "sensor_filter.h"
+
+// === SENSOR FILTER PIPELINE ===
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static SensorFilter makeFilter(uint8_t median, uint8_t emaShift, uint32_t maxRate) {
+  SensorFilter filter;
+  FilterConfig config = {median, emaShift, maxRate};
+  TEST_ASSERT_TRUE(SensorFilter::valid(config));
+  filter.configure(config);
+  return filter;
+}
+
+void test_pass_through_when_disabled(void) {
+  SensorFilter filter;
+  TEST_ASSERT_EQUAL_INT32(1200, filter.update(1200, 0));
+  TEST_ASSERT_EQUAL_INT32(9000, filter.update(9000, 2000));
+  TEST_ASSERT_EQUAL_INT32(9000, filter.raw());
+}
+
+void test_median_rejects_a_single_spike(void) {
+  // EC หลังเติมปุ๋ย: ค่าโดดตัวเดียวไม่ผ่าน
+  SensorFilter filter = makeFilter(3, 0, 0);
+  uint32_t now = 0;
+  TEST_ASSERT_EQUAL_INT32(15000, filter.update(15000, now += 2000));
+  TEST_ASSERT_EQUAL_INT32(15000, filter.update(15100, now += 2000));   // ยังไม่ครบ 3: ค่ากลางตัวล่าง
+  TEST_ASSERT_EQUAL_INT32(15100, filter.update(40000, now += 2000));
+  TEST_ASSERT_EQUAL_INT32(40000, filter.raw());
+  TEST_ASSERT_EQUAL_INT32(15100, filter.update(15050, now += 2000));
+  TEST_ASSERT_EQUAL_INT32(15050, filter.update(15020, now += 2000));
+
+  // การเปลี่ยนจริง (ค้าง 2 ตัวอย่าง) ผ่านหลังตัวอย่างที่สอง
+  TEST_ASSERT_EQUAL_INT32(15050, filter.update(18000, now += 2000));
+  TEST_ASSERT_EQUAL_INT32(18000, filter.update(18000, now += 2000));
+}
+
+void test_median_of_seven(void) {
+  SensorFilter filter = makeFilter(7, 0, 0);
+  const int32_t samples[] = {700, 710, 9999, 690, 705, -500, 702};
+  int32_t value = 0;
+  for (uint8_t i = 0; i < 7; i++) {
+    value = filter.update(samples[i], i * 1000UL);
+  }
+  TEST_ASSERT_EQUAL_INT32(702, value);
+}
+
+void test_rate_limit_follows_elapsed_time(void) {
+  // pH x100 เปลี่ยนได้ไม่เกิน 0.10 ต่อวินาที
+  SensorFilter filter = makeFilter(1, 0, 10);
+  TEST_ASSERT_EQUAL_INT32(650, filter.update(650, 1000));
+  TEST_ASSERT_EQUAL_INT32(670, filter.update(900, 3000));     // 2 s -> +20
+  TEST_ASSERT_EQUAL_INT32(665, filter.update(665, 3500));     // อยู่ในขอบเขต
+  TEST_ASSERT_EQUAL_INT32(660, filter.update(100, 4000));     // 0.5 s -> -5
+  TEST_ASSERT_EQUAL_UINT16(2, filter.rateLimited());
+
+  // ขาดการอ่านนาน: นับเวลาไม่เกิน 60 s
+  TEST_ASSERT_EQUAL_INT32(100, filter.update(100, 600000));
+  TEST_ASSERT_EQUAL_INT32(700, filter.update(5000, 700000));
+}
+
+void test_ema_smooths_and_converges(void) {
+  SensorFilter filter = makeFilter(1, 2, 0);                  // น้ำหนัก 1/4
+  TEST_ASSERT_EQUAL_INT32(400, filter.update(400, 0));
+  TEST_ASSERT_EQUAL_INT32(500, filter.update(800, 1000));     // 400 + 400/4
+  TEST_ASSERT_EQUAL_INT32(575, filter.update(800, 2000));
+  int32_t value = 0;
+  for (uint8_t i = 0; i < 40; i++) {
+    value = filter.update(800, 3000UL + i * 1000UL);
+  }
+  TEST_ASSERT_INT_WITHIN(1, 800, value);
+}
+
+void test_stages_compose(void) {
+  SensorFilter filter = makeFilter(3, 1, 100);
+  filter.update(1000, 0);
+  filter.update(1000, 1000);
+  TEST_ASSERT_EQUAL_INT32(1000, filter.update(60000, 2000));  // median ตัดก่อนถึง rate/EMA
+  TEST_ASSERT_EQUAL_INT32(1050, filter.update(60000, 3000));  // median = 60000, rate -> 1100, EMA -> 1050
+  TEST_ASSERT_EQUAL_UINT16(1, filter.rateLimited());
+}
+
+void test_configure_validates_and_resets(void) {
+  FilterConfig even = {4, 0, 0};
+  FilterConfig tooSlow = {3, FILTER_EMA_SHIFT_MAX + 1, 0};
+  FilterConfig tooFast = {3, 0, FILTER_RATE_MAX + 1};
+  FilterConfig zero = {0, 0, 0};
+  TEST_ASSERT_FALSE(SensorFilter::valid(even));
+  TEST_ASSERT_FALSE(SensorFilter::valid(tooSlow));
+  TEST_ASSERT_FALSE(SensorFilter::valid(tooFast));
+  TEST_ASSERT_FALSE(SensorFilter::valid(zero));
+
+  SensorFilter filter = makeFilter(1, 0, 5);
+  filter.update(100, 0);
+  filter.update(900, 1000);
+  FilterConfig median = {3, 0, 0};
+  filter.configure(median);
+  TEST_ASSERT_EQUAL_UINT16(0, filter.rateLimited());
+  TEST_ASSERT_EQUAL_INT32(900, filter.update(900, 2000));     // ประวัติเดิมถูกล้าง
+}
+
+void test_channel_names(void) {
+  char name[FILTER_CHANNEL_NAME_MAX];
+  TEST_ASSERT_EQUAL_UINT8(FILTER_EC, filterChannelFromName("ec"));
+  TEST_ASSERT_EQUAL_UINT8(FILTER_LIGHT, filterChannelFromName("light"));
+  TEST_ASSERT_EQUAL_UINT8(FILTER_NONE, filterChannelFromName("airTemp"));
+  TEST_ASSERT_EQUAL_STRING("ph", filterChannelName(FILTER_PH, name));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_pass_through_when_disabled);
+  RUN_TEST(test_median_rejects_a_single_spike);
+  RUN_TEST(test_median_of_seven);
+  RUN_TEST(test_rate_limit_follows_elapsed_time);
+  RUN_TEST(test_ema_smooths_and_converges);
+  RUN_TEST(test_stages_compose);
+  RUN_TEST(test_configure_validates_and_resets);
+  RUN_TEST(test_channel_names);
+  return UNITY_END();
+}
@@ -0,0 +1,144 @@
+#include <unity.h>
+#include <native_hal.h>
+#include "sensor_history.h"
+
+// === ON-DEVICE SENSOR HISTORY ===
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// 1 ตัวอย่างต่อนาที ค่าตาม valueOf(นาที) แล้วปิดนาทีนั้น
+static void runMinutes(SensorHistory& history, uint32_t minutes, int32_t (*valueOf)(uint32_t)) {
+  for (uint32_t i = 0; i < minutes; i++) {
+    uint32_t minute = history.currentMinute();
+    history.sample(HISTORY_EC, valueOf(minute));
+    history.update((minute + 1) * 60000UL);
+  }
+}
+
+static int32_t minuteValue(uint32_t minute) { return (int32_t)minute; }
+
+void test_channel_names(void) {
+  TEST_ASSERT_EQUAL_UINT8(HISTORY_AIR_TEMP, historyChannelFromName("airTemp"));
+  TEST_ASSERT_EQUAL_UINT8(HISTORY_AC_POWER, historyChannelFromName("acPower"));
+  TEST_ASSERT_EQUAL_UINT8(HISTORY_NONE, historyChannelFromName("lux"));
+  char name[HISTORY_CHANNEL_NAME_MAX];
+  TEST_ASSERT_EQUAL_STRING("waterTemp", historyChannelName(HISTORY_WATER_TEMP, name));
+}
+
+void test_minute_bucket_aggregates_samples(void) {
+  SensorHistory history;
+  HistoryEntry entry;
+  TEST_ASSERT_FALSE(history.next(HISTORY_PH, 0, entry));
+
+  history.sample(HISTORY_PH, 610);
+  history.sample(HISTORY_PH, 590);
+  history.sample(HISTORY_PH, 615);
+  history.update(59999);
+  TEST_ASSERT_FALSE(history.next(HISTORY_PH, 0, entry));    // นาทีแรกยังไม่ปิด
+  history.update(60000);
+
+  TEST_ASSERT_TRUE(history.next(HISTORY_PH, 0, entry));
+  TEST_ASSERT_EQUAL_UINT32(0, entry.startMinute);
+  TEST_ASSERT_EQUAL_UINT16(1, entry.minutes);
+  TEST_ASSERT_EQUAL_INT16(590, entry.value.min);
+  TEST_ASSERT_EQUAL_INT16(615, entry.value.max);
+  TEST_ASSERT_EQUAL_INT16(605, entry.value.mean);
+  TEST_ASSERT_FALSE(history.next(HISTORY_PH, 1, entry));
+  TEST_ASSERT_FALSE(history.next(HISTORY_CO2, 0, entry));   // ไม่มีตัวอย่าง = ไม่มีข้อมูล
+}
+
+void test_values_are_clamped_to_int16(void) {
+  SensorHistory history;
+  history.sample(HISTORY_AC_POWER, 100000);
+  history.sample(HISTORY_AC_POWER, -100000);
+  history.update(60000);
+  HistoryEntry entry;
+  TEST_ASSERT_TRUE(history.next(HISTORY_AC_POWER, 0, entry));
+  TEST_ASSERT_EQUAL_INT16(32767, entry.value.max);
+  TEST_ASSERT_EQUAL_INT16(-32767, entry.value.min);
+  TEST_ASSERT_EQUAL_INT16(0, entry.value.mean);
+}
+
+void test_old_minutes_roll_up_into_quarter_hours(void) {
+  SensorHistory history;
+  runMinutes(history, 20, minuteValue);
+
+  // นาที 0-4 ถูกเขียนทับแล้ว: ได้ช่อง 15 นาที [0,15) ตามด้วยช่องนาทีละเอียด 15-19
+  HistoryEntry entry;
+  TEST_ASSERT_TRUE(history.next(HISTORY_EC, 0, entry));
+  TEST_ASSERT_EQUAL_UINT32(0, entry.startMinute);
+  TEST_ASSERT_EQUAL_UINT16(15, entry.minutes);
+  TEST_ASSERT_EQUAL_INT16(0, entry.value.min);
+  TEST_ASSERT_EQUAL_INT16(14, entry.value.max);
+  TEST_ASSERT_EQUAL_INT16(7, entry.value.mean);
+
+  uint32_t from = entry.startMinute + entry.minutes;
+  for (uint32_t minute = 15; minute < 20; minute++) {
+    TEST_ASSERT_TRUE(history.next(HISTORY_EC, from, entry));
+    TEST_ASSERT_EQUAL_UINT32(minute, entry.startMinute);
+    TEST_ASSERT_EQUAL_UINT16(1, entry.minutes);
+    TEST_ASSERT_EQUAL_INT16(minute, entry.value.mean);
+    from = entry.startMinute + entry.minutes;
+  }
+  TEST_ASSERT_FALSE(history.next(HISTORY_EC, from, entry));
+}
+
+void test_a_day_is_covered_without_gaps_or_overlap(void) {
+  SensorHistory history;
+  runMinutes(history, 26 * 60 + 7, minuteValue);
+
+  HistoryEntry entry;
+  uint32_t from = 0;
+  uint32_t expectedStart = 0;
+  uint16_t entries = 0;
+  bool first = true;
+  while (history.next(HISTORY_EC, from, entry)) {
+    if (first) {
+      TEST_ASSERT_EQUAL_UINT16(120, entry.minutes);         // เก่าสุดเป็นช่อง 2 ชั่วโมง
+      TEST_ASSERT_TRUE(history.currentMinute() - entry.startMinute >= 24 * 60);
+      expectedStart = entry.startMinute;
+      first = false;
+    }
+    TEST_ASSERT_EQUAL_UINT32(expectedStart, entry.startMinute);
+    TEST_ASSERT_EQUAL_INT16(entry.startMinute, entry.value.min);
+    TEST_ASSERT_EQUAL_INT16(entry.startMinute + entry.minutes - 1, entry.value.max);
+    expectedStart = entry.startMinute + entry.minutes;
+    from = expectedStart;
+    entries++;
+  }
+  TEST_ASSERT_EQUAL_UINT32(history.currentMinute(), expectedStart);   // ถึงนาทีล่าสุดที่ปิดแล้ว
+  TEST_ASSERT_TRUE(entries <= HISTORY_SLOTS);
+}
+
+void test_minutes_continue_across_millis_wrap(void) {
+  SensorHistory history;
+  history.update(0xFFFFFFFFUL - 30000);
+  uint32_t before = history.currentMinute();
+  history.sample(HISTORY_FLOW, 250);
+  history.update(30999UL);   // millis() ล้นแล้ว: (0xFFFFFFFF - 30000) + 61000 mod 2^32
+  TEST_ASSERT_EQUAL_UINT32(before + 1, history.currentMinute());
+
+  HistoryEntry entry;
+  TEST_ASSERT_TRUE(history.next(HISTORY_FLOW, before, entry));
+  TEST_ASSERT_EQUAL_UINT32(before, entry.startMinute);
+  TEST_ASSERT_EQUAL_INT16(250, entry.value.mean);
+}
+
+void test_memory_budget(void) {
+  TEST_ASSERT_TRUE(sizeof(SensorHistory) <= HISTORY_RAM_BUDGET);
+  TEST_ASSERT_EQUAL(HISTORY_SLOTS * HISTORY_CHANNEL_COUNT * 6,
+                    HISTORY_SLOTS * HISTORY_CHANNEL_COUNT * sizeof(HistoryBucket));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_channel_names);
+  RUN_TEST(test_minute_bucket_aggregates_samples);
+  RUN_TEST(test_values_are_clamped_to_int16);
+  RUN_TEST(test_old_minutes_roll_up_into_quarter_hours);
+  RUN_TEST(test_a_day_is_covered_without_gaps_or_overlap);
+  RUN_TEST(test_minutes_continue_across_millis_wrap);
+  RUN_TEST(test_memory_budget);
+  return UNITY_END();
+}
@@ -0,0 +1,72 @@
+#include <unity.h>
+#include <native_hal.h>
+#include "slave_health.h"
+#include "modbus_rtu.h"
+
+// === MODBUS SLAVE HEALTH ===
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_new_slave_is_stale_until_first_read(void) {
+  SlaveHealth health = {};
+  TEST_ASSERT_TRUE(health.stale());
+  TEST_ASSERT_FALSE(health.offline());
+  health.recordSuccess(1234);
+  TEST_ASSERT_FALSE(health.stale());
+  TEST_ASSERT_EQUAL_UINT32(1234, health.lastGoodMs);
+}
+
+void test_failures_mark_stale_then_offline(void) {
+  SlaveHealth health = {};
+  health.recordSuccess(0);
+  health.recordFailure(ModbusRtuMaster::ku8MBResponseTimedOut);
+  TEST_ASSERT_FALSE(health.stale());                 // พลาดครั้งเดียวยังเชื่อค่าเดิม
+  health.recordFailure(ModbusRtuMaster::ku8MBResponseTimedOut);
+  TEST_ASSERT_TRUE(health.stale());
+  TEST_ASSERT_FALSE(health.offline());
+  health.recordFailure(ModbusRtuMaster::ku8MBResponseTimedOut);
+  TEST_ASSERT_TRUE(health.offline());
+
+  health.recordSuccess(5000);
+  TEST_ASSERT_FALSE(health.stale());
+  TEST_ASSERT_EQUAL_UINT16(0, health.consecutiveFailures);
+  TEST_ASSERT_EQUAL_UINT16(3, health.timeouts);
+}
+
+void test_error_codes_are_counted_by_kind(void) {
+  SlaveHealth health = {};
+  health.recordFailure(ModbusRtuMaster::ku8MBResponseTimedOut);
+  health.recordFailure(ModbusRtuMaster::ku8MBInvalidCRC);
+  health.recordFailure(ModbusRtuMaster::ku8MBInvalidCRC);
+  health.recordFailure(ModbusRtuMaster::ku8MBIllegalDataAddress);
+  health.recordFailure(ModbusRtuMaster::ku8MBInvalidSlaveID);
+  TEST_ASSERT_EQUAL_UINT16(1, health.timeouts);
+  TEST_ASSERT_EQUAL_UINT16(2, health.crcErrors);
+  TEST_ASSERT_EQUAL_UINT16(1, health.exceptions);
+  TEST_ASSERT_EQUAL_UINT16(1, health.otherErrors);
+  TEST_ASSERT_EQUAL_UINT16(5, health.consecutiveFailures);
+}
+
+void test_backoff_doubles_up_to_cap(void) {
+  SlaveHealth health = {};
+  health.recordFailure(ModbusRtuMaster::ku8MBResponseTimedOut);
+  health.recordFailure(ModbusRtuMaster::ku8MBResponseTimedOut);
+  TEST_ASSERT_EQUAL_UINT32(2000, health.retryDelayMs(2000));   // ยังไม่ offline
+
+  const uint32_t expected[] = {4000, 8000, 16000, 32000, 60000, 60000};
+  for (uint8_t i = 0; i < 6; i++) {
+    health.recordFailure(ModbusRtuMaster::ku8MBResponseTimedOut);
+    TEST_ASSERT_EQUAL_UINT32(expected[i], health.retryDelayMs(2000));
+  }
+  TEST_ASSERT_EQUAL_UINT32(90000, health.retryDelayMs(90000));  // คาบปกติยาวกว่าเพดานอยู่แล้ว
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_new_slave_is_stale_until_first_read);
+  RUN_TEST(test_failures_mark_stale_then_offline);
+  RUN_TEST(test_error_codes_are_counted_by_kind);
+  RUN_TEST(test_backoff_doubles_up_to_cap);
+  return UNITY_END();
+}
@@ -0,0 +1,202 @@
+#include <unity.h>
+#include <native_hal.h>
+#include <EEPROM.h>
+#include <string.h>
+#include "state_journal.h"
+
+// === WEAR-LEVELLED EEPROM STATE JOURNAL ===
+
+static uint8_t payload[JOURNAL_PAYLOAD_SIZE];
+static uint8_t recovered[JOURNAL_PAYLOAD_SIZE];
+
+void setUp(void) {
+  halEepromErase();
+  memset(payload, 0, sizeof(payload));
+  memset(recovered, 0, sizeof(recovered));
+}
+void tearDown(void) {}
+
+// เขียน record จนเสร็จ คืนจำนวนครั้งที่เรียก poll()
+static int flush(StateJournal& journal) {
+  int polls = 0;
+  while (journal.busy()) {
+    journal.poll();
+    polls++;
+  }
+  return polls;
+}
+
+static void save(StateJournal& journal, uint8_t value) {
+  payload[0] = value;
+  TEST_ASSERT_TRUE(journal.append(payload));
+  flush(journal);
+}
+
+void test_empty_eeprom_has_no_record(void) {
+  StateJournal journal;
+  TEST_ASSERT_FALSE(journal.begin(recovered));
+  TEST_ASSERT_EQUAL_UINT32(0, journal.sequence());
+  TEST_ASSERT_EQUAL_UINT16(64, journal.slotCount());
+  TEST_ASSERT_EQUAL_UINT16(0, journal.nextSlot());
+}
+
+void test_record_is_recovered_after_reboot(void) {
+  StateJournal journal;
+  journal.begin(recovered);
+  for (uint8_t i = 0; i < JOURNAL_PAYLOAD_SIZE; i++) {
+    payload[i] = i * 3;
+  }
+  TEST_ASSERT_TRUE(journal.append(payload));
+  TEST_ASSERT_FALSE(journal.append(payload));               // ยังเขียนไม่เสร็จ
+  flush(journal);
+  save(journal, 42);
+
+  StateJournal rebooted;
+  TEST_ASSERT_TRUE(rebooted.begin(recovered));
+  TEST_ASSERT_EQUAL_UINT32(2, rebooted.sequence());
+  TEST_ASSERT_EQUAL_UINT8(42, recovered[0]);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(payload, recovered, JOURNAL_PAYLOAD_SIZE);
+  TEST_ASSERT_EQUAL_UINT16(2, rebooted.nextSlot());
+}
+
+void test_one_byte_per_poll(void) {
+  StateJournal journal;
+  journal.begin(recovered);
+  TEST_ASSERT_TRUE(journal.append(payload));
+  journal.poll();
+  TEST_ASSERT_EQUAL_UINT32(1, halEepromTotalWrites());
+  journal.poll();
+  TEST_ASSERT_EQUAL_UINT32(2, halEepromTotalWrites());
+}
+
+void test_writes_spread_over_all_slots(void) {
+  StateJournal journal;
+  journal.begin(recovered);
+  for (uint16_t i = 0; i < 64 * 3; i++) {
+    save(journal, (uint8_t)i);
+  }
+  // sequence อยู่ที่ต้น record: ทุกช่องถูกเขียนเท่ากัน
+  for (uint16_t slot = 0; slot < 64; slot++) {
+    TEST_ASSERT_EQUAL_UINT32(halEepromCellWrites(0), halEepromCellWrites(slot * JOURNAL_RECORD_SIZE));
+  }
+  TEST_ASSERT_TRUE(halEepromCellWrites(0) <= 3);
+
+  StateJournal rebooted;
+  TEST_ASSERT_TRUE(rebooted.begin(recovered));
+  TEST_ASSERT_EQUAL_UINT32(192, rebooted.sequence());
+  TEST_ASSERT_EQUAL_UINT8(191, recovered[0]);
+  TEST_ASSERT_EQUAL_UINT16(0, rebooted.nextSlot());
+}
+
+void test_torn_write_keeps_previous_record(void) {
+  StateJournal journal;
+  journal.begin(recovered);
+  save(journal, 1);
+  payload[0] = 2;
+  payload[10] = 0x55;
+  TEST_ASSERT_TRUE(journal.append(payload));
+  for (uint8_t i = 0; i < 8; i++) {                         // ไฟดับระหว่างเขียน
+    journal.poll();
+  }
+
+  StateJournal rebooted;
+  TEST_ASSERT_TRUE(rebooted.begin(recovered));
+  TEST_ASSERT_EQUAL_UINT32(1, rebooted.sequence());
+  TEST_ASSERT_EQUAL_UINT8(1, recovered[0]);
+  TEST_ASSERT_EQUAL_UINT16(1, rebooted.nextSlot());          // เขียนทับช่องที่ไม่สมบูรณ์
+}
+
+void test_corrupted_record_falls_back(void) {
+  StateJournal journal;
+  journal.begin(recovered);
+  save(journal, 1);
+  save(journal, 2);
+  halEepromPoke(JOURNAL_RECORD_SIZE + JOURNAL_HEADER_SIZE, 0x77);  // payload ของ record ที่ 2
+
+  StateJournal rebooted;
+  TEST_ASSERT_TRUE(rebooted.begin(recovered));
+  TEST_ASSERT_EQUAL_UINT32(1, rebooted.sequence());
+  TEST_ASSERT_EQUAL_UINT8(1, recovered[0]);
+}
+
+void test_boot_skips_every_broken_record(void) {
+  StateJournal journal;
+  journal.begin(recovered);
+  save(journal, 1);
+  save(journal, 2);
+  save(journal, 3);
+  uint16_t crcAddress = 3 * JOURNAL_RECORD_SIZE - 1;             // CRC ของ record ที่ 3
+  halEepromPoke(crcAddress, EEPROM.read(crcAddress) ^ 0xFF);
+  halEepromPoke(1 * JOURNAL_RECORD_SIZE + JOURNAL_HEADER_SIZE, 0x77);
+
+  StateJournal rebooted;
+  TEST_ASSERT_TRUE(rebooted.begin(recovered));
+  TEST_ASSERT_EQUAL_UINT32(1, rebooted.sequence());
+  TEST_ASSERT_EQUAL_UINT8(1, recovered[0]);
+  TEST_ASSERT_EQUAL_UINT16(1, rebooted.nextSlot());
+
+  halEepromPoke(JOURNAL_HEADER_SIZE, 0x77);
+  TEST_ASSERT_FALSE(rebooted.begin(recovered));
+}
+
+void test_bytes_written_counts_only_changed_bytes(void) {
+  StateJournal journal;
+  journal.begin(recovered);
+  for (uint16_t i = 0; i < 64; i++) {
+    save(journal, 0);
+  }
+  uint32_t before = halEepromTotalWrites();
+  TEST_ASSERT_EQUAL_UINT32(before, journal.bytesWritten());
+
+  // รอบที่สอง payload เหมือนเดิม: เขียนเฉพาะ sequence ตัวนับ และ CRC
+  // (ตัวนับและ CRC ถูกนับเต็ม 6 ไบต์เสมอ จึงไม่น้อยกว่าที่เขียนจริง)
+  save(journal, 0);
+  uint32_t delta = halEepromTotalWrites() - before;
+  uint32_t counted = journal.bytesWritten() - before;
+  TEST_ASSERT_TRUE(delta <= 10);
+  TEST_ASSERT_TRUE(counted >= delta && counted <= 10);
+
+  StateJournal rebooted;
+  rebooted.begin(recovered);
+  TEST_ASSERT_EQUAL_UINT32(journal.bytesWritten(), rebooted.bytesWritten());
+}
+
+void test_regions_are_independent(void) {
+  StateJournal lower(0, 3072);
+  StateJournal upper(3072, 1024);
+  lower.begin(recovered);
+  upper.begin(recovered);
+  TEST_ASSERT_EQUAL_UINT16(48, lower.slotCount());
+  TEST_ASSERT_EQUAL_UINT16(16, upper.slotCount());
+
+  // journal บนวนครบหลายรอบ: ไม่เขียนเลยช่วงของตัวเอง
+  for (uint8_t i = 1; i <= 40; i++) {
+    save(upper, i);
+  }
+  save(lower, 200);
+  TEST_ASSERT_EQUAL_UINT32(0, halEepromCellWrites(JOURNAL_RECORD_SIZE));   // lower เขียนแค่ช่องแรก
+  TEST_ASSERT_EQUAL_UINT32(0, halEepromCellWrites(3071));                  // upper ไม่ล้ำลงมา
+
+  StateJournal lowerRebooted(0, 3072);
+  StateJournal upperRebooted(3072, 1024);
+  TEST_ASSERT_TRUE(lowerRebooted.begin(recovered));
+  TEST_ASSERT_EQUAL_UINT8(200, recovered[0]);
+  TEST_ASSERT_EQUAL_UINT32(1, lowerRebooted.sequence());
+  TEST_ASSERT_TRUE(upperRebooted.begin(recovered));
+  TEST_ASSERT_EQUAL_UINT8(40, recovered[0]);
+  TEST_ASSERT_EQUAL_UINT16(40 % 16, upperRebooted.nextSlot());
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_empty_eeprom_has_no_record);
+  RUN_TEST(test_record_is_recovered_after_reboot);
+  RUN_TEST(test_one_byte_per_poll);
+  RUN_TEST(test_writes_spread_over_all_slots);
+  RUN_TEST(test_torn_write_keeps_previous_record);
+  RUN_TEST(test_corrupted_record_falls_back);
+  RUN_TEST(test_boot_skips_every_broken_record);
+  RUN_TEST(test_bytes_written_counts_only_changed_bytes);
+  RUN_TEST(test_regions_are_independent);
+  return UNITY_END();
+}
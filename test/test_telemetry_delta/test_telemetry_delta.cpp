@@ -0,0 +1,158 @@
+#include <unity.h>
+#include "telemetry_delta.h"
+#include <string.h>
+
+// === CHANGE-DRIVEN (DELTA) TELEMETRY ===
+// การตรวจการเปลี่ยนแปลงตาม deadband, เกณฑ์ alert และการเข้า/ถอดเฟรม delta (ไม่ขึ้นกับ Arduino)
+
+static TelemetryFrameV1 sampleFrame() {
+  TelemetryFrameV1 frame;
+  memset(&frame, 0, sizeof(frame));
+  frame.flags = TELEMETRY_FLAG_AC_CONNECTED;
+  frame.co2Ppm = 812;
+  frame.airTemp = -35;
+  frame.ec = 14250;
+  frame.ph = 612;
+  frame.flowTotal[1] = 5000;
+  frame.relayStates = 0x01;
+  return frame;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_everything_changed_until_first_keyframe(void) {
+  TelemetryDeltaTracker tracker;
+  TelemetryFrameV1 frame = sampleFrame();
+  TEST_ASSERT_FALSE(tracker.hasBaseline());
+  TEST_ASSERT_EQUAL_HEX32(TELEMETRY_ALL_FIELDS, tracker.changedFields(frame));
+  TEST_ASSERT_EQUAL_HEX32(0, tracker.alertFields(frame));
+
+  tracker.markSent(frame, TELEMETRY_ALL_FIELDS);
+  TEST_ASSERT_TRUE(tracker.hasBaseline());
+  TEST_ASSERT_EQUAL_HEX32(0, tracker.changedFields(frame));
+}
+
+void test_deadband_accumulates_against_last_sent_value(void) {
+  TelemetryDeltaTracker tracker;
+  tracker.setDeadband(TELEMETRY_FIELD_PH, 5);
+  TelemetryFrameV1 frame = sampleFrame();
+  tracker.markSent(frame, TELEMETRY_ALL_FIELDS);
+
+  // ค่อยๆ ลอยทีละ 0.02 pH: ยังไม่ส่งจนกว่าจะรวมกันถึง deadband
+  frame.ph = 614;
+  TEST_ASSERT_EQUAL_HEX32(0, tracker.changedFields(frame));
+  frame.ph = 616;
+  TEST_ASSERT_EQUAL_HEX32(0, tracker.changedFields(frame));
+  frame.ph = 617;
+  TEST_ASSERT_EQUAL_HEX32(1UL << TELEMETRY_FIELD_PH, tracker.changedFields(frame));
+
+  tracker.markSent(frame, 1UL << TELEMETRY_FIELD_PH);
+  TEST_ASSERT_EQUAL_HEX32(0, tracker.changedFields(frame));
+
+  // ฟิลด์ signed ลดลงข้ามศูนย์
+  frame.airTemp = -37;
+  TEST_ASSERT_EQUAL_HEX32(1UL << TELEMETRY_FIELD_AIR_TEMP, tracker.changedFields(frame));
+}
+
+void test_bit_fields_change_on_any_bit(void) {
+  TelemetryDeltaTracker tracker;
+  TelemetryFrameV1 frame = sampleFrame();
+  tracker.markSent(frame, TELEMETRY_ALL_FIELDS);
+  frame.relayStates = 0x03;
+  TEST_ASSERT_EQUAL_HEX32(1UL << TELEMETRY_FIELD_RELAYS, tracker.changedFields(frame));
+  TEST_ASSERT_EQUAL_HEX32(0, tracker.alertFields(frame));   // relay ไม่มี alert ค่าเริ่มต้น
+}
+
+void test_water_flag_alerts_by_default(void) {
+  TelemetryDeltaTracker tracker;
+  TelemetryFrameV1 frame = sampleFrame();
+  tracker.markSent(frame, TELEMETRY_ALL_FIELDS);
+
+  frame.flags |= TELEMETRY_FLAG_STALE_EC;
+  TEST_ASSERT_EQUAL_HEX32(0, tracker.alertFields(frame));
+  frame.flags |= TELEMETRY_FLAG_WATER_DETECTED;
+  TEST_ASSERT_EQUAL_HEX32(1UL << TELEMETRY_FIELD_FLAGS, tracker.alertFields(frame));
+
+  tracker.clearAlert(TELEMETRY_FIELD_FLAGS);
+  TEST_ASSERT_EQUAL_HEX32(0, tracker.alertFields(frame));
+}
+
+void test_numeric_alert_fires_on_threshold_crossing(void) {
+  TelemetryDeltaTracker tracker;
+  tracker.setAlert(TELEMETRY_FIELD_EC, 15000);
+  tracker.setAlert(TELEMETRY_FIELD_AIR_TEMP, 0);
+  TelemetryFrameV1 frame = sampleFrame();
+  tracker.markSent(frame, TELEMETRY_ALL_FIELDS);
+
+  frame.ec = 14990;   // ใกล้แต่ยังไม่ข้าม
+  TEST_ASSERT_EQUAL_HEX32(0, tracker.alertFields(frame));
+  frame.ec = 15000;
+  TEST_ASSERT_EQUAL_HEX32(1UL << TELEMETRY_FIELD_EC, tracker.alertFields(frame));
+  tracker.markSent(frame, 1UL << TELEMETRY_FIELD_EC);
+  TEST_ASSERT_EQUAL_HEX32(0, tracker.alertFields(frame));
+
+  frame.airTemp = 4;  // -3.5 -> +0.4 °C
+  TEST_ASSERT_EQUAL_HEX32(1UL << TELEMETRY_FIELD_AIR_TEMP, tracker.alertFields(frame));
+}
+
+void test_delta_round_trip_updates_only_sent_fields(void) {
+  TelemetryFrameV1 state = sampleFrame();
+  TelemetryFrameV1 frame = sampleFrame();
+  frame.ph = 650;
+  frame.flowTotal[1] = 0x00010000;
+  frame.co2Ppm = 999;   // ไม่ได้เลือก -> ฝั่งรับต้องไม่เปลี่ยน
+  uint32_t fields = (1UL << TELEMETRY_FIELD_PH) | (1UL << TELEMETRY_FIELD_FLOW_TOTAL_2);
+
+  uint8_t wire[TELEMETRY_DELTA_WIRE_MAX];
+  size_t length = encodeTelemetryDelta(frame, fields, 77, wire, sizeof(wire));
+  TEST_ASSERT_EQUAL(0x00, wire[0]);
+  TEST_ASSERT_EQUAL(0x00, wire[length - 1]);
+  TEST_ASSERT_LESS_THAN(20, length);   // เทียบกับเฟรมเต็ม 61 ไบต์
+
+  TEST_ASSERT_EQUAL(TELEMETRY_OK, applyTelemetryDelta(wire + 1, length - 2, state));
+  TEST_ASSERT_EQUAL_UINT16(77, state.sequence);
+  TEST_ASSERT_EQUAL_UINT16(650, state.ph);
+  TEST_ASSERT_EQUAL_UINT32(0x00010000, state.flowTotal[1]);
+  TEST_ASSERT_EQUAL_UINT16(812, state.co2Ppm);
+
+  // เฟรม delta ไม่ใช่เฟรมเต็ม และเฟรมเต็มไม่ใช่ delta
+  TelemetryFrameV1 other;
+  TEST_ASSERT_NOT_EQUAL(TELEMETRY_OK, decodeTelemetryFrame(wire + 1, length - 2, other));
+  uint8_t full[TELEMETRY_WIRE_MAX];
+  size_t fullLength = encodeTelemetryFrame(frame, 78, full, sizeof(full));
+  TEST_ASSERT_EQUAL(TELEMETRY_BAD_VERSION, applyTelemetryDelta(full + 1, fullLength - 2, state));
+}
+
+void test_largest_delta_fits_wire_buffer(void) {
+  TelemetryFrameV1 frame = sampleFrame();
+  uint8_t wire[TELEMETRY_DELTA_WIRE_MAX];
+  size_t length = encodeTelemetryDelta(frame, TELEMETRY_ALL_FIELDS, 1, wire, sizeof(wire));
+  TEST_ASSERT_GREATER_THAN(0, length);
+  TEST_ASSERT_LESS_OR_EQUAL(TELEMETRY_DELTA_WIRE_MAX, length);
+  TEST_ASSERT_EQUAL(0, encodeTelemetryDelta(frame, TELEMETRY_ALL_FIELDS, 1, wire, TELEMETRY_DELTA_WIRE_MAX - 1));
+}
+
+void test_delta_detects_corruption(void) {
+  TelemetryFrameV1 frame = sampleFrame();
+  TelemetryFrameV1 state = sampleFrame();
+  uint8_t wire[TELEMETRY_DELTA_WIRE_MAX];
+  size_t length = encodeTelemetryDelta(frame, 1UL << TELEMETRY_FIELD_EC, 5, wire, sizeof(wire));
+  wire[length - 3] ^= 0x01;
+  if (wire[length - 3] == 0x00) wire[length - 3] = 0x02;   // คงรูปแบบ COBS
+  TEST_ASSERT_NOT_EQUAL(TELEMETRY_OK, applyTelemetryDelta(wire + 1, length - 2, state));
+  TEST_ASSERT_EQUAL_UINT16(14250, state.ec);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_everything_changed_until_first_keyframe);
+  RUN_TEST(test_deadband_accumulates_against_last_sent_value);
+  RUN_TEST(test_bit_fields_change_on_any_bit);
+  RUN_TEST(test_water_flag_alerts_by_default);
+  RUN_TEST(test_numeric_alert_fires_on_threshold_crossing);
+  RUN_TEST(test_delta_round_trip_updates_only_sent_fields);
+  RUN_TEST(test_largest_delta_fits_wire_buffer);
+  RUN_TEST(test_delta_detects_corruption);
+  return UNITY_END();
+}
@@ -0,0 +1,107 @@
+#include <unity.h>
+#include "telemetry_frame.h"
+#include <string.h>
+
+// === BINARY TELEMETRY FRAME ===
+// COBS และการเข้า/ถอดรหัส TelemetryFrameV1 (ไม่ขึ้นกับ Arduino)
+
+static TelemetryFrameV1 sampleFrame() {
+  TelemetryFrameV1 frame;
+  memset(&frame, 0, sizeof(frame));
+  frame.flags = TELEMETRY_FLAG_WATER_DETECTED | TELEMETRY_FLAG_AC_CONNECTED;
+  frame.co2Ppm = 812;
+  frame.airTemp = -35;
+  frame.airHumidity = 655;
+  frame.lux = 120000;
+  frame.ec = 14250;
+  frame.ph = 612;
+  frame.acVoltage = 2301;
+  frame.flowTotal[2] = 0x00010000; // มีไบต์ 0x00 หลายตัวติดกัน
+  frame.relayStates = 0x81;
+  return frame;
+}
+
+// แยก payload ระหว่างตัวคั่น 0x00 ของข้อมูลบนสาย
+static size_t payload(const uint8_t* wire, size_t length, const uint8_t** start) {
+  TEST_ASSERT_EQUAL_HEX8(0x00, wire[0]);
+  TEST_ASSERT_EQUAL_HEX8(0x00, wire[length - 1]);
+  *start = wire + 1;
+  return length - 2;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_cobs_round_trip_with_zeros(void) {
+  const uint8_t input[] = {0x00, 0x11, 0x00, 0x00, 0x22, 0x33, 0x00};
+  uint8_t encoded[16];
+  uint8_t decoded[16];
+
+  size_t encodedLength = cobsEncode(input, sizeof(input), encoded, sizeof(encoded));
+  TEST_ASSERT_EQUAL(sizeof(input) + 1, encodedLength);
+  for (size_t i = 0; i < encodedLength; i++) {
+    TEST_ASSERT_NOT_EQUAL(0x00, encoded[i]);
+  }
+
+  size_t decodedLength = cobsDecode(encoded, encodedLength, decoded, sizeof(decoded));
+  TEST_ASSERT_EQUAL(sizeof(input), decodedLength);
+  TEST_ASSERT_EQUAL_MEMORY(input, decoded, sizeof(input));
+}
+
+void test_cobs_rejects_small_output(void) {
+  const uint8_t input[] = {0x01, 0x02, 0x03};
+  uint8_t encoded[3];
+  TEST_ASSERT_EQUAL(0, cobsEncode(input, sizeof(input), encoded, sizeof(encoded)));
+}
+
+void test_frame_round_trip(void) {
+  TelemetryFrameV1 frame = sampleFrame();
+  uint8_t wire[TELEMETRY_WIRE_MAX];
+  size_t length = encodeTelemetryFrame(frame, 4242, wire, sizeof(wire));
+  TEST_ASSERT_GREATER_THAN(0, length);
+  TEST_ASSERT_LESS_OR_EQUAL(TELEMETRY_WIRE_MAX, length);
+
+  const uint8_t* body;
+  size_t bodyLength = payload(wire, length, &body);
+  TelemetryFrameV1 decoded;
+  TEST_ASSERT_EQUAL(TELEMETRY_OK, decodeTelemetryFrame(body, bodyLength, decoded));
+  TEST_ASSERT_EQUAL_UINT16(4242, decoded.sequence);
+  TEST_ASSERT_EQUAL_UINT8(TELEMETRY_FRAME_VERSION, decoded.version);
+  TEST_ASSERT_EQUAL_INT16(-35, decoded.airTemp);
+  TEST_ASSERT_EQUAL_UINT32(120000, decoded.lux);
+  TEST_ASSERT_EQUAL_UINT32(0x00010000, decoded.flowTotal[2]);
+  TEST_ASSERT_EQUAL_HEX8(0x81, decoded.relayStates);
+}
+
+void test_frame_detects_corruption(void) {
+  TelemetryFrameV1 frame = sampleFrame();
+  uint8_t wire[TELEMETRY_WIRE_MAX];
+  size_t length = encodeTelemetryFrame(frame, 1, wire, sizeof(wire));
+  const uint8_t* body;
+  size_t bodyLength = payload(wire, length, &body);
+
+  uint8_t damaged[TELEMETRY_WIRE_MAX];
+  memcpy(damaged, body, bodyLength);
+  damaged[10] ^= 0x01;
+  if (damaged[10] == 0x00) damaged[10] = 0x02; // คงรูปแบบ COBS (ไม่มี 0x00)
+
+  TelemetryFrameV1 decoded;
+  TelemetryDecodeResult result = decodeTelemetryFrame(damaged, bodyLength, decoded);
+  TEST_ASSERT_NOT_EQUAL(TELEMETRY_OK, result);
+}
+
+void test_frame_rejects_text_chunk(void) {
+  const char* text = "RELAY_OK\r\n";
+  TelemetryFrameV1 decoded;
+  TEST_ASSERT_NOT_EQUAL(TELEMETRY_OK, decodeTelemetryFrame((const uint8_t*)text, strlen(text), decoded));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_cobs_round_trip_with_zeros);
+  RUN_TEST(test_cobs_rejects_small_output);
+  RUN_TEST(test_frame_round_trip);
+  RUN_TEST(test_frame_detects_corruption);
+  RUN_TEST(test_frame_rejects_text_chunk);
+  return UNITY_END();
+}
@@ -0,0 +1,94 @@
+#include <unity.h>
+#include <native_hal.h>
+#include "telemetry_subscriptions.h"
+
+// === TELEMETRY SUBSCRIPTIONS ===
+
+void setUp(void) {
+  halReset();
+}
+
+void tearDown(void) {}
+
+void test_nothing_due_without_subscriptions(void) {
+  TelemetrySubscriptions subscriptions;
+  TEST_ASSERT_EQUAL_UINT8(TELEMETRY_GROUP_NONE, subscriptions.nextDue(0));
+  TEST_ASSERT_EQUAL_UINT8(TELEMETRY_GROUP_NONE, subscriptions.nextDue(100000));
+}
+
+void test_new_subscription_is_due_at_once_then_periodic(void) {
+  TelemetrySubscriptions subscriptions;
+  subscriptions.subscribe(TELEMETRY_GROUP_FLOW, 250);
+  TEST_ASSERT_EQUAL_UINT8(TELEMETRY_GROUP_FLOW, subscriptions.nextDue(1000));
+  subscriptions.markSent(TELEMETRY_GROUP_FLOW, 1000);
+  TEST_ASSERT_EQUAL_UINT8(TELEMETRY_GROUP_NONE, subscriptions.nextDue(1249));
+  TEST_ASSERT_EQUAL_UINT8(TELEMETRY_GROUP_FLOW, subscriptions.nextDue(1250));
+
+  subscriptions.unsubscribe(TELEMETRY_GROUP_FLOW);
+  TEST_ASSERT_EQUAL_UINT32(0, subscriptions.periodMs(TELEMETRY_GROUP_FLOW));
+  TEST_ASSERT_EQUAL_UINT8(TELEMETRY_GROUP_NONE, subscriptions.nextDue(5000));
+}
+
+void test_most_overdue_group_goes_first(void) {
+  TelemetrySubscriptions subscriptions;
+  subscriptions.subscribe(TELEMETRY_GROUP_ALL, 2000);
+  subscriptions.subscribe(TELEMETRY_GROUP_AC, 30000);
+  subscriptions.subscribe(TELEMETRY_GROUP_STATUS, 250);
+  subscriptions.markSent(TELEMETRY_GROUP_ALL, 0);      // ครบ 2000
+  subscriptions.markSent(TELEMETRY_GROUP_AC, 0);       // ครบ 30000
+  subscriptions.markSent(TELEMETRY_GROUP_STATUS, 1900); // ครบ 2150
+
+  TEST_ASSERT_EQUAL_UINT8(TELEMETRY_GROUP_ALL, subscriptions.nextDue(2200));
+  subscriptions.markSent(TELEMETRY_GROUP_ALL, 2200);
+  TEST_ASSERT_EQUAL_UINT8(TELEMETRY_GROUP_STATUS, subscriptions.nextDue(2200));
+  subscriptions.markSent(TELEMETRY_GROUP_STATUS, 2200);
+  TEST_ASSERT_EQUAL_UINT8(TELEMETRY_GROUP_NONE, subscriptions.nextDue(2200));
+}
+
+void test_due_time_survives_millis_wrap(void) {
+  TelemetrySubscriptions subscriptions;
+  subscriptions.subscribe(TELEMETRY_GROUP_WATER, 1000);
+  subscriptions.markSent(TELEMETRY_GROUP_WATER, 0xFFFFFF00UL);
+  TEST_ASSERT_EQUAL_UINT8(TELEMETRY_GROUP_NONE, subscriptions.nextDue(0xFFFFFFF0UL));
+  TEST_ASSERT_EQUAL_UINT8(TELEMETRY_GROUP_NONE, subscriptions.nextDue(0x00000100UL));
+  TEST_ASSERT_EQUAL_UINT8(TELEMETRY_GROUP_WATER, subscriptions.nextDue(0x00000300UL));
+}
+
+void test_period_is_clamped(void) {
+  TelemetrySubscriptions subscriptions;
+  subscriptions.subscribe(TELEMETRY_GROUP_AIR, 10);
+  TEST_ASSERT_EQUAL_UINT32(TELEMETRY_SUBSCRIBE_MIN_MS, subscriptions.periodMs(TELEMETRY_GROUP_AIR));
+}
+
+void test_groups_cover_every_field_once(void) {
+  uint32_t seen = 0;
+  for (uint8_t group = TELEMETRY_GROUP_AIR; group < TELEMETRY_GROUP_COUNT; group++) {
+    uint32_t fields = telemetryGroupFields(group);
+    TEST_ASSERT_TRUE(fields != 0);
+    TEST_ASSERT_EQUAL_HEX32(0, seen & fields);
+    seen |= fields;
+  }
+  TEST_ASSERT_EQUAL_HEX32(TELEMETRY_ALL_FIELDS, seen);
+  TEST_ASSERT_EQUAL_HEX32(TELEMETRY_ALL_FIELDS, telemetryGroupFields(TELEMETRY_GROUP_ALL));
+}
+
+void test_group_names_round_trip(void) {
+  char name[TELEMETRY_GROUP_NAME_MAX];
+  for (uint8_t group = 0; group < TELEMETRY_GROUP_COUNT; group++) {
+    TEST_ASSERT_EQUAL_UINT8(group, telemetryGroupFromName(telemetryGroupName(group, name)));
+  }
+  TEST_ASSERT_EQUAL_STRING("flow", telemetryGroupName(TELEMETRY_GROUP_FLOW, name));
+  TEST_ASSERT_EQUAL_UINT8(TELEMETRY_GROUP_NONE, telemetryGroupFromName("pumps"));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_nothing_due_without_subscriptions);
+  RUN_TEST(test_new_subscription_is_due_at_once_then_periodic);
+  RUN_TEST(test_most_overdue_group_goes_first);
+  RUN_TEST(test_due_time_survives_millis_wrap);
+  RUN_TEST(test_period_is_clamped);
+  RUN_TEST(test_groups_cover_every_field_once);
+  RUN_TEST(test_group_names_round_trip);
+  return UNITY_END();
+}